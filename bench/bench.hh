@@ -0,0 +1,49 @@
+#ifndef BENCH_HH
+#define BENCH_HH
+#include <chrono>
+#include <cstddef>
+#include <format>
+#include <iostream>
+#include <string_view>
+
+namespace potmaker::bench {
+
+    /*
+     * Benchmarks are small programs that print what they measured. They are
+     * built with the rest, but not run as tests: timings depend too much on
+     * the machine to pass or fail on. Build in Release to compare numbers
+     */
+
+    /**
+     * Keeps the compiler from optimizing a value away
+     * @param value The value
+     */
+    template<typename T> auto keep(const T& value) -> void
+    {
+        asm volatile("" : : "g"(&value) : "memory");
+    }
+
+    /**
+     * Calls a function repeatedly and prints how long each call took
+     * @param name What is measured
+     * @param calls How many times to call it
+     * @param body The function
+     * @return The time per call, in nanoseconds
+     */
+    template<typename body_t>
+    auto time_per_call(const std::string_view name, const std::size_t calls,
+                       const body_t& body) -> double
+    {
+        const auto start = std::chrono::steady_clock::now();
+        for (std::size_t i = 0; i < calls; ++i) { body(); }
+        const std::chrono::duration<double, std::nano> elapsed
+                = std::chrono::steady_clock::now() - start;
+
+        const double per_call = elapsed.count() / static_cast<double>(calls);
+        std::cout << std::format("{:<40} {:>12.1f} ns\n", name, per_call);
+        return per_call;
+    }
+
+} // namespace potmaker::bench
+
+#endif // BENCH_HH
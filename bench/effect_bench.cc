@@ -0,0 +1,106 @@
+#include "bench.hh"
+#include "content_library.hh"
+#include "entity.hh"
+#include "ingredient.hh"
+#include "potionmaker_game.hh"
+#include "util.hh"
+#include <cstddef>
+#include <format>
+#include <iostream>
+#include <memory>
+
+/*
+ * Built-in ingredients and enemies run virtual C++ functions, and the same
+ * types loaded from resources/content.potmk run effect programs. This
+ * times both on the same targets, type by type. Planning is not compared,
+ * since scripted enemies decide while they act
+ */
+
+namespace potmaker {
+
+    namespace {
+
+        constexpr std::size_t calls = 200000;
+
+        /**
+         * Brings a target back to full health without effects, so that
+         * every call does the same work
+         */
+        auto refresh(entity& target) -> void
+        {
+            target.clear_status_effects();
+            target.modify_health(target.max_health() - target.health());
+        }
+
+        auto ingredients(const content_library& library) -> void
+        {
+            std::cout << "Applying an ingredient\n";
+            for (std::size_t type = 0; type < library.ingredients().size();
+                 ++type) {
+                const std::string& id = library.ingredients()[type].id;
+                const std::unique_ptr<ingredient> built_in(
+                        create_ingredient_by_type(static_cast<int>(type), id,
+                                                  3));
+                const std::unique_ptr<ingredient> scripted(
+                        library.create_ingredient(type, id, 3));
+                const std::unique_ptr<enemy> target(create_enemy_by_type(
+                        0, "Target", 50, enemy_rolls{0.5, 0.5}));
+
+                for (ingredient* ing: {built_in.get(), scripted.get()}) {
+                    std::size_t call = 0;
+                    bench::time_per_call(
+                            std::format("  {} {}", id,
+                                        ing == built_in.get() ? "built-in"
+                                                              : "bytecode"),
+                            calls, [&] {
+                                if (++call % 16 == 0) { refresh(*target); }
+                                ing->on_applied(*target);
+                            });
+                }
+            }
+        }
+
+        auto enemies(const content_library& library) -> void
+        {
+            std::cout << "Playing an enemy's turn\n";
+            player p("Player", 100.0, 15.0, 50.0);
+            for (std::size_t type = 0; type < library.enemies().size();
+                 ++type) {
+                const std::string& id = library.enemies()[type].id;
+                const std::unique_ptr<enemy> built_in(create_enemy_by_type(
+                        static_cast<int>(type), id, 3,
+                        enemy_rolls{0.5, 0.5}));
+                const std::unique_ptr<enemy> scripted(library.create_enemy(
+                        type, id, 3, enemy_rolls{0.5, 0.5}));
+
+                for (enemy* e: {built_in.get(), scripted.get()}) {
+                    enemy_party party{e};
+                    std::size_t call = 0;
+                    bench::time_per_call(
+                            std::format("  {} {}", id,
+                                        e == built_in.get() ? "built-in"
+                                                            : "bytecode"),
+                            calls, [&] {
+                                if (++call % 16 == 0) {
+                                    refresh(p);
+                                    refresh(*e);
+                                }
+                                e->act(p, party);
+                            });
+                }
+            }
+        }
+
+    } // namespace
+
+} // namespace potmaker
+
+auto main() -> int
+{
+    const potmaker::scoped_quiet_output quiet;
+    potmaker::seed_random(1);
+    const auto library = potmaker::content_library::load(
+            POTMK_RESOURCES_DIR "/content.potmk");
+    potmaker::ingredients(library);
+    potmaker::enemies(library);
+}
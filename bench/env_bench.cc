@@ -0,0 +1,61 @@
+#include "bench.hh"
+#include "battle_env.hh"
+#include "potionmaker_game.hh"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <iostream>
+#include <vector>
+
+/*
+ * Times battle_env with every run attacking its first enemy each step, the
+ * cheapest action, so the environment's own cost dominates
+ */
+
+namespace potmaker {
+
+    namespace {
+
+        constexpr std::size_t step_count = 2000;
+
+        auto steps(const std::size_t env_count) -> void
+        {
+            battle_env env(env_config{env_count, 8, 8, 5});
+            std::vector<float> observations(env.size()
+                                            * env.observation_size());
+            std::vector<float> rewards(env.size());
+            std::vector<std::uint8_t> dones(env.size());
+            std::vector<env_action> actions(env.size());
+            for (auto& action: actions) {
+                action.type = static_cast<std::int32_t>(
+                        battle_action::kind::basic_attack);
+            }
+            env.reset(observations);
+
+            std::size_t finished = 0;
+            const auto start = std::chrono::steady_clock::now();
+            for (std::size_t step = 0; step < step_count; ++step) {
+                env.step(actions, observations, rewards, dones);
+                for (const std::uint8_t done: dones) { finished += done; }
+            }
+            const std::chrono::duration<double> elapsed
+                    = std::chrono::steady_clock::now() - start;
+
+            const double run_steps
+                    = static_cast<double>(step_count * env.size());
+            std::cout << std::format(
+                    "{} runs: {:.0f} run steps/s, {} runs finished\n",
+                    env.size(), run_steps / elapsed.count(), finished);
+        }
+
+    } // namespace
+
+} // namespace potmaker
+
+auto main() -> int
+{
+    for (const std::size_t env_count: {1, 64, 256}) {
+        potmaker::steps(env_count);
+    }
+}
@@ -0,0 +1,81 @@
+#include "bench.hh"
+#include "combat_math.hh"
+#include "simulation.hh"
+#include "util.hh"
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <iostream>
+#include <type_traits>
+
+/*
+ * Compares the arithmetic of a combat round in double and in fixed_point,
+ * then times whole simulated runs in whichever type combat_value is. Build
+ * once with and once without POTMK_FIXED_POINT to compare the runs
+ */
+
+namespace potmaker {
+
+    namespace {
+
+        constexpr std::size_t rounds = 20000000;
+        constexpr std::uint64_t run_count = 2000;
+
+        /**
+         * Plays out the numbers of a battle round: damage scaled by a
+         * modifier and the target's armour, poison ticking and healing
+         * @return The target's health afterwards, so the work is kept
+         */
+        template<typename value_t> auto combat_round(value_t health) -> value_t
+        {
+            const value_t damage = 15.0;
+            const value_t armour = 0.85;
+            const value_t poison = 2.5;
+            const std::array<value_t, 4> modifiers{1.0, 1.1, 1.21, 1.331};
+
+            for (std::size_t round = 0; round < 64; ++round) {
+                health -= damage * modifiers[round % 4] * armour;
+                health -= poison;
+                health += (value_t(100) - health) / value_t(4);
+            }
+            return health;
+        }
+
+        template<typename value_t> auto arithmetic(const char* name) -> void
+        {
+            value_t health = 100;
+            bench::time_per_call(std::format("64 combat rounds, {}", name),
+                                 rounds / 64, [&] {
+                                     health = combat_round(health);
+                                     bench::keep(health);
+                                 });
+        }
+
+        auto runs() -> void
+        {
+            const simulation_limits limits;
+            const auto start = std::chrono::steady_clock::now();
+            const run_stats stats = simulate_runs(1, run_count, 1, limits);
+            const std::chrono::duration<double> elapsed
+                    = std::chrono::steady_clock::now() - start;
+            std::cout << std::format(
+                    "{} runs on one thread with {} combat values: "
+                    "{:.0f} runs/s\n",
+                    stats.runs(),
+                    std::is_same_v<combat_value, double> ? "double"
+                                                         : "fixed-point",
+                    static_cast<double>(stats.runs()) / elapsed.count());
+        }
+
+    } // namespace
+
+} // namespace potmaker
+
+auto main() -> int
+{
+    potmaker::arithmetic<double>("double");
+    potmaker::arithmetic<potmaker::fixed_point>("fixed_point");
+    potmaker::runs();
+}
@@ -0,0 +1,63 @@
+#include "bench.hh"
+#include "potionmaker_game.hh"
+#include "save_file.hh"
+#include "util.hh"
+#include <cstddef>
+#include <cstdio>
+#include <filesystem>
+#include <format>
+#include <iostream>
+#include <string>
+
+/*
+ * Times saving and loading a run that has been going for a while, so that
+ * the save holds a full inventory and shop
+ */
+
+namespace potmaker {
+
+    namespace {
+
+        constexpr std::size_t calls = 2000;
+
+        /**
+         * Wins battles and shops until the inventory is well stocked
+         */
+        auto play_a_while(game_state& game) -> void
+        {
+            for (int battle = 0; battle < 12; ++battle) {
+                game.begin_battle();
+                game.end_battle(true);
+                game.buy_planned();
+            }
+        }
+
+    } // namespace
+
+} // namespace potmaker
+
+auto main() -> int
+{
+    const potmaker::scoped_quiet_output quiet;
+    potmaker::seed_random(3);
+    potmaker::game_state game("Benchmark");
+    potmaker::play_a_while(game);
+
+    const std::string path
+            = (std::filesystem::temp_directory_path() / "potmk_bench.sav")
+                      .string();
+    game.save_game(path);
+    std::cout << std::format("Save file of {} bytes, {} ingredients\n",
+                             std::filesystem::file_size(path),
+                             potmaker::save::reader(path).ingredients().size());
+
+    potmaker::bench::time_per_call("save_game", potmaker::calls,
+                                   [&] { game.save_game(path); });
+    potmaker::bench::time_per_call("load_game", potmaker::calls,
+                                   [&] { game.load_game(path); });
+    potmaker::bench::time_per_call("save::reader", potmaker::calls, [&] {
+        const potmaker::save::reader in(path);
+        potmaker::bench::keep(in.header().gold);
+    });
+    std::remove(path.c_str());
+}
@@ -0,0 +1,52 @@
+#include "bench.hh"
+#include "entity.hh"
+#include "status_effect.hh"
+#include <cstddef>
+#include <initializer_list>
+#include <iostream>
+#include <string_view>
+
+/*
+ * Times entity::tick with long-lasting effects, so that none expires while
+ * it is measured. Ticking should cost in proportion to the effects that
+ * deal damage, whatever else the entity holds
+ */
+
+namespace potmaker {
+
+    namespace {
+
+        constexpr std::size_t calls = 10000000;
+
+        /**
+         * Times ticking a player that holds effects of some kinds
+         * @param name What the kinds are
+         * @param kinds Their make_status_effect kinds
+         */
+        auto tick(const std::string_view name,
+                  const std::initializer_list<std::size_t> kinds) -> void
+        {
+            // Enough health that no tick kills it
+            player p("Player", 1e12, 10.0, 0.0);
+            for (const std::size_t kind: kinds) {
+                p.add_status_effect(make_status_effect(kind, 1 << 30, 1));
+            }
+            bench::time_per_call(name, calls, [&] { p.tick(); });
+            bench::keep(p.health());
+        }
+
+    } // namespace
+
+} // namespace potmaker
+
+auto main() -> int
+{
+    // Kinds in status_effect_variant order: burning, freezing, poison,
+    // wither, regeneration, protection, strength
+    std::cout << "Ticking an entity\n";
+    potmaker::tick("  no effects", {});
+    potmaker::tick("  protection and strength", {5, 6});
+    potmaker::tick("  burning", {0});
+    potmaker::tick("  burning, protection and strength", {0, 5, 6});
+    potmaker::tick("  every kind", {0, 1, 2, 3, 4, 5, 6});
+}
@@ -0,0 +1,130 @@
+#include "bench.hh"
+#include "entity.hh"
+#include "potionmaker_game.hh"
+#include "status_effect.hh"
+#include "util.hh"
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <format>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <variant>
+
+/*
+ * Counts the heap allocations a battle turn makes and times turns and
+ * entity ticks. Turns are played with basic attacks, as a simulated run
+ * would, and only game_state::play_turn is measured: starting battles and
+ * shopping allocate on purpose
+ */
+
+namespace {
+
+    // Allocations made since the program started
+    std::size_t allocations = 0;
+
+} // namespace
+
+auto operator new(const std::size_t size) -> void*
+{
+    ++allocations;
+    if (void* p = std::malloc(size == 0 ? 1 : size)) { return p; }
+    throw std::bad_alloc();
+}
+
+auto operator delete(void* p) noexcept -> void
+{
+    std::free(p);
+}
+
+auto operator delete(void* p, std::size_t) noexcept -> void
+{
+    std::free(p);
+}
+
+namespace potmaker {
+
+    namespace {
+
+        constexpr std::size_t turn_count = 200000;
+        constexpr std::size_t tick_calls = 1000000;
+
+        /**
+         * Plays runs with basic attacks until enough turns have been played
+         */
+        auto turns() -> void
+        {
+            std::size_t played = 0;
+            std::size_t allocated = 0;
+            std::chrono::duration<double, std::nano> elapsed{0};
+            const battle_action action{battle_action::kind::basic_attack, 0,
+                                       {}};
+
+            while (played < turn_count) {
+                auto game = std::make_unique<game_state>("Benchmark");
+                while (game->running() && played < turn_count) {
+                    enemy_party enemies = game->begin_battle();
+                    battle_outcome outcome = battle_outcome::ongoing;
+                    while (outcome == battle_outcome::ongoing
+                           && played < turn_count) {
+                        const std::size_t before = allocations;
+                        const auto start = std::chrono::steady_clock::now();
+                        outcome = game->play_turn(enemies, action);
+                        elapsed += std::chrono::steady_clock::now() - start;
+                        allocated += allocations - before;
+                        ++played;
+                    }
+                    (void)game->end_battle(outcome == battle_outcome::won);
+                    game->buy_planned();
+                }
+            }
+
+            std::cout << std::format(
+                    "{} turns, {:.3f} allocations and {:.1f} ns per turn\n",
+                    played,
+                    static_cast<double>(allocated)
+                            / static_cast<double>(played),
+                    elapsed.count() / static_cast<double>(played));
+        }
+
+        /**
+         * Times the player's end of turn with one effect of every kind
+         */
+        auto ticks() -> void
+        {
+            player p("Player", 1.0e6, 15.0, 50.0);
+            const std::size_t kinds
+                    = std::variant_size_v<status_effect_variant>;
+            std::size_t call = 0;
+            const std::size_t before = allocations;
+            bench::time_per_call("entity::tick, every effect", tick_calls,
+                                 [&] {
+                                     if (call++ % 3 == 0) {
+                                         p.clear_status_effects();
+                                         p.modify_health(p.max_health()
+                                                         - p.health());
+                                         for (std::size_t kind = 0;
+                                              kind < kinds; ++kind) {
+                                             p.add_status_effect(
+                                                     make_status_effect(
+                                                             kind, 3, 2));
+                                         }
+                                     }
+                                     p.tick();
+                                 });
+            std::cout << std::format("{} allocations in {} ticks\n",
+                                     allocations - before, tick_calls);
+        }
+
+    } // namespace
+
+} // namespace potmaker
+
+auto main() -> int
+{
+    const potmaker::scoped_quiet_output quiet;
+    potmaker::seed_random(7);
+    potmaker::turns();
+    potmaker::ticks();
+}
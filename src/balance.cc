@@ -0,0 +1,206 @@
+#include "balance.hh"
+#include <array>
+#include <charconv>
+#include <cstddef>
+#include <format>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace potmaker {
+
+    namespace {
+
+        using number_field = std::pair<std::string_view,
+                                       double balance_params::*>;
+
+        constexpr std::array<number_field, 10> number_fields{{
+                {"fire_damage", &balance_params::fire_damage},
+                {"chill_damage", &balance_params::chill_damage},
+                {"poison_damage", &balance_params::poison_damage},
+                {"wither_damage", &balance_params::wither_damage},
+                {"heal_amount", &balance_params::heal_amount},
+                {"regen_heal", &balance_params::regen_heal},
+                {"protect_fraction", &balance_params::protect_fraction},
+                {"cleanse_heal", &balance_params::cleanse_heal},
+                {"joker_heal", &balance_params::joker_heal},
+                {"joker_damage", &balance_params::joker_damage},
+        }};
+
+        const balance_params default_balance;
+        thread_local const balance_params* active = &default_balance;
+
+        [[noreturn]] auto fail(const std::size_t line, const std::string& what)
+                -> void
+        {
+            throw std::runtime_error(
+                    std::format("balance line {}: {}", line, what));
+        }
+
+        /**
+         * Splits a line into words. # starts a comment
+         */
+        auto tokenize(std::string_view line) -> std::vector<std::string_view>
+        {
+            line = line.substr(0, line.find('#'));
+
+            std::vector<std::string_view> tokens;
+            std::size_t i = 0;
+            while (i < line.size()) {
+                const std::size_t start = line.find_first_not_of(" \t\r", i);
+                if (start == std::string_view::npos) { break; }
+                std::size_t end = line.find_first_of(" \t\r", start);
+                if (end == std::string_view::npos) { end = line.size(); }
+                tokens.push_back(line.substr(start, end - start));
+                i = end;
+            }
+            return tokens;
+        }
+
+        template<typename value_t>
+        auto parse_value(const std::string_view text, const std::size_t line)
+                -> value_t
+        {
+            value_t value{};
+            const auto [ptr, ec] = std::from_chars(
+                    text.data(), text.data() + text.size(), value);
+            if (ec != std::errc{} || ptr != text.data() + text.size()) {
+                fail(line, std::format("expected a number, got '{}'", text));
+            }
+            return value;
+        }
+
+    } // namespace
+
+    auto balance_params::enemy_count(const std::int32_t stage) const
+            -> std::int32_t
+    {
+        return 1 + (stage - 1) / stages_per_enemy;
+    }
+
+    auto balance_params::load(const std::string& path) -> balance_params
+    {
+        std::ifstream file(path);
+        if (!file) {
+            throw std::runtime_error(
+                    std::format("could not open balance file {}", path));
+        }
+
+        std::stringstream ss;
+        ss << file.rdbuf();
+        return parse(ss.str());
+    }
+
+    auto balance_params::parse(const std::string_view source)
+            -> balance_params
+    {
+        balance_params params;
+
+        std::size_t line_number = 0;
+        std::size_t start = 0;
+        while (start <= source.size()) {
+            std::size_t newline = source.find('\n', start);
+            if (newline == std::string_view::npos) { newline = source.size(); }
+            const std::string_view line
+                    = source.substr(start, newline - start);
+            start = newline + 1;
+            ++line_number;
+
+            const std::vector<std::string_view> t = tokenize(line);
+            if (t.empty()) { continue; }
+
+            if (t[0] == "enemy") {
+                if (t.size() != 10) {
+                    fail(line_number, "expected 'enemy <type>' and 8 stats");
+                }
+                const auto type = parse_value<std::size_t>(t[1], line_number);
+                if (type >= params.enemy_stats.size()) {
+                    fail(line_number, std::format("no enemy type {}", type));
+                }
+                enemy_stat_formula& stats = params.enemy_stats[type];
+                stats.base_health = parse_value<int>(t[2], line_number);
+                stats.health_per_level = parse_value<int>(t[3], line_number);
+                stats.health_variance_min
+                        = parse_value<double>(t[4], line_number);
+                stats.health_variance_max
+                        = parse_value<double>(t[5], line_number);
+                stats.base_damage = parse_value<int>(t[6], line_number);
+                stats.damage_level_divisor
+                        = parse_value<int>(t[7], line_number);
+                stats.damage_variance_min
+                        = parse_value<double>(t[8], line_number);
+                stats.damage_variance_max
+                        = parse_value<double>(t[9], line_number);
+                if (stats.damage_level_divisor <= 0) {
+                    fail(line_number, "the damage divisor must be positive");
+                }
+                continue;
+            }
+
+            if (t.size() != 2) {
+                fail(line_number, "expected a name and a value");
+            }
+            if (t[0] == "stages_per_enemy") {
+                params.stages_per_enemy = parse_value<int>(t[1], line_number);
+                if (params.stages_per_enemy <= 0) {
+                    fail(line_number, "stages_per_enemy must be positive");
+                }
+                continue;
+            }
+
+            bool known = false;
+            for (const auto& [name, field]: number_fields) {
+                if (t[0] == name) {
+                    params.*field = parse_value<double>(t[1], line_number);
+                    known = true;
+                }
+            }
+            if (!known) {
+                fail(line_number, std::format("unknown name '{}'", t[0]));
+            }
+        }
+
+        return params;
+    }
+
+    auto balance_params::to_string() const -> std::string
+    {
+        std::string out
+                = std::format("stages_per_enemy {}\n", stages_per_enemy);
+        for (std::size_t type = 0; type < enemy_stats.size(); ++type) {
+            const enemy_stat_formula& s = enemy_stats[type];
+            out += std::format("enemy {} {} {} {} {} {} {} {} {}\n", type,
+                               s.base_health, s.health_per_level,
+                               to_double(s.health_variance_min),
+                               to_double(s.health_variance_max),
+                               s.base_damage, s.damage_level_divisor,
+                               to_double(s.damage_variance_min),
+                               to_double(s.damage_variance_max));
+        }
+        for (const auto& [name, field]: number_fields) {
+            out += std::format("{} {}\n", name, this->*field);
+        }
+        return out;
+    }
+
+    auto active_balance() -> const balance_params&
+    {
+        return *active;
+    }
+
+    scoped_balance::scoped_balance(const balance_params& params)
+        : previous_(active)
+    {
+        active = &params;
+    }
+
+    scoped_balance::~scoped_balance()
+    {
+        active = previous_;
+    }
+
+} // namespace potmaker
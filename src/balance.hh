@@ -0,0 +1,103 @@
+#ifndef BALANCE_HH
+#define BALANCE_HH
+#include "entity.hh"
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace potmaker {
+
+    /**
+     * The numbers that set the game's difficulty. The defaults are the
+     * game's own balance. Enemies and ingredients from a content library
+     * carry their own numbers and are not affected
+     */
+    struct balance_params {
+        // Battles on stage s have 1 + (s - 1) / stages_per_enemy enemies
+        std::int32_t stages_per_enemy = 2;
+
+        // The stats of each built-in enemy type, by create_enemy_by_type
+        // type
+        std::array<enemy_stat_formula, 9> enemy_stats{
+                flaming_enemy::stats,       chilling_enemy::stats,
+                poisonous_enemy::stats,     withering_enemy::stats,
+                healing_enemy::stats,       regenerative_enemy::stats,
+                protective_enemy::stats,    strengthening_enemy::stats,
+                cleansing_enemy::stats};
+
+        // What each built-in ingredient does right away, per potency
+        double fire_damage = 15.0;
+        double chill_damage = 5.0;
+        double poison_damage = 8.0;
+        double wither_damage = 10.0;
+        double heal_amount = 20.0;
+        double regen_heal = 5.0;
+        // A fraction of the drinker's max health
+        double protect_fraction = 0.1;
+        double cleanse_heal = 5.0;
+        // The joker's super heal and lucky strike
+        double joker_heal = 30.0;
+        double joker_damage = 25.0;
+
+        /**
+         * @param stage A stage
+         * @return How many enemies a battle on the stage has
+         */
+        [[nodiscard]] auto enemy_count(std::int32_t stage) const
+                -> std::int32_t;
+
+        /**
+         * Reads balance numbers from a file. Each line holds a name and its
+         * value, or 'enemy <type>' and the type's 8 stats in the order of a
+         * content file's 'stats' line. # starts a comment, and numbers not
+         * in the file keep their defaults
+         * @param path The file
+         * @return The numbers
+         * @throws std::runtime_error If the file is missing or malformed
+         */
+        static auto load(const std::string& path) -> balance_params;
+
+        /**
+         * Reads balance numbers from text in the format load reads
+         * @param source The text
+         * @return The numbers
+         * @throws std::runtime_error If the text is malformed
+         */
+        static auto parse(std::string_view source) -> balance_params;
+
+        /**
+         * @return Every number, in the format load reads
+         */
+        [[nodiscard]] auto to_string() const -> std::string;
+    };
+
+    /**
+     * @return The balance the calling thread plays with
+     */
+    [[nodiscard]] auto active_balance() -> const balance_params&;
+
+    /**
+     * Makes the current thread play with other balance numbers for as long
+     * as it is alive. Scopes nest; the previous numbers are restored on
+     * destruction
+     */
+    class scoped_balance {
+    public:
+        /**
+         * Starts playing with other numbers
+         * @param params The numbers. Must outlive the scope
+         */
+        explicit scoped_balance(const balance_params& params);
+        ~scoped_balance();
+
+        scoped_balance(const scoped_balance&) = delete;
+        auto operator=(const scoped_balance&) -> scoped_balance& = delete;
+
+    private:
+        const balance_params* previous_;
+    };
+
+} // namespace potmaker
+
+#endif // BALANCE_HH
@@ -0,0 +1,228 @@
+#include "battle_env.hh"
+#include "util.hh"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <utility>
+#include <variant>
+
+namespace potmaker {
+
+    namespace {
+
+        auto health_of(const enemy_party& enemies) -> double
+        {
+            double total = 0.0;
+            for (const enemy* e: enemies) {
+                total += std::max(0.0, to_double(e->health()));
+            }
+            return total;
+        }
+
+    } // namespace
+
+    battle_env::battle_env(const env_config& config)
+        : config_(config),
+          inventory_cells_(static_cast<std::size_t>(ingredient_type_count())
+                           * static_cast<std::size_t>(
+                                   std::max(config.max_potency, 1)))
+    {
+        if (config.env_count == 0) {
+            throw std::invalid_argument("A battle_env needs at least one run");
+        }
+        if (config.max_potency <= 0) {
+            throw std::invalid_argument("The potency cap must be positive");
+        }
+
+        seed_random(config.seed);
+        const scoped_quiet_output quiet;
+        runs_.resize(config.env_count);
+        for (run& r: runs_) { restart(r); }
+    }
+
+    auto battle_env::observation_size() const -> std::size_t
+    {
+        return header_size + effect_kind_count * effect_size
+               + config_.max_enemies * enemy_size + inventory_cells_;
+    }
+
+    auto battle_env::size() const -> std::size_t
+    {
+        return runs_.size();
+    }
+
+    auto battle_env::reset(const std::span<float> observations) -> void
+    {
+        check_size(observations.size(), observation_size());
+
+        const scoped_quiet_output quiet;
+        const std::size_t width = observation_size();
+        for (std::size_t i = 0; i < runs_.size(); ++i) {
+            restart(runs_[i]);
+            observe(runs_[i], observations.subspan(i * width, width));
+        }
+    }
+
+    auto battle_env::step(const std::span<const env_action> actions,
+                          const std::span<float> observations,
+                          const std::span<float> rewards,
+                          const std::span<std::uint8_t> dones) -> void
+    {
+        check_size(actions.size(), 1);
+        check_size(observations.size(), observation_size());
+        check_size(rewards.size(), 1);
+        check_size(dones.size(), 1);
+
+        const scoped_quiet_output quiet;
+        const std::size_t width = observation_size();
+        for (std::size_t i = 0; i < runs_.size(); ++i) {
+            const auto [reward, done] = play(runs_[i], actions[i]);
+            rewards[i] = reward;
+            dones[i] = done ? 1 : 0;
+            observe(runs_[i], observations.subspan(i * width, width));
+        }
+    }
+
+    auto battle_env::restart(run& r) -> void
+    {
+        // The old run's enemies go with its game
+        r.enemies.clear();
+        r.game = std::make_unique<game_state>("Agent");
+        r.enemies = r.game->begin_battle();
+        r.turn = 0;
+    }
+
+    auto battle_env::play(run& r, const env_action& action)
+            -> std::pair<float, bool>
+    {
+        game_state& game = *r.game;
+        player& p = game.current_player();
+        const inventory& stock = p.stored_ingredients();
+
+        const auto type = static_cast<battle_action::kind>(std::clamp(
+                action.type, 0,
+                static_cast<std::int32_t>(
+                        battle_action::kind::splash_potion)));
+        action_.type = type;
+        action_.target = static_cast<std::size_t>(std::max(action.target, 0));
+        action_.picks.clear();
+        for (const std::int32_t cell: action.ingredients) {
+            if (cell < 0) { continue; }
+
+            // The fullest stack in the cell, so that picking a cell twice
+            // takes two ingredients when it can
+            std::size_t best = stock.stacks().size();
+            for (std::size_t s = 0; s < stock.stacks().size(); ++s) {
+                const inventory::stack& stack = stock.stacks()[s];
+                if (stack.units.empty()
+                    || cell_of(stack) != static_cast<std::size_t>(cell)) {
+                    continue;
+                }
+                if (best == stock.stacks().size()
+                    || stack.units.size() > stock.stacks()[best].units.size()) {
+                    best = s;
+                }
+            }
+            if (best < stock.stacks().size()) { action_.picks.push_back(best); }
+        }
+
+        // Enemies that die leave the party but stay alive in memory until
+        // the battle is settled, so the damage dealt is read off a copy
+        before_ = r.enemies;
+        const double enemy_health = health_of(before_);
+        const double player_health = to_double(p.health());
+
+        const battle_outcome outcome = game.play_turn(r.enemies, action_);
+        ++r.turn;
+
+        double reward = (enemy_health - health_of(before_)
+                         - (player_health - to_double(p.health())))
+                        / 100.0;
+        before_.clear();
+
+        switch (outcome) {
+        case battle_outcome::ongoing:
+            break;
+        case battle_outcome::won:
+            reward += 1.0;
+            game.end_battle(true);
+            game.buy_planned();
+            r.enemies = game.begin_battle();
+            r.turn = 0;
+            break;
+        case battle_outcome::lost:
+            reward -= 1.0;
+            game.end_battle(false);
+            restart(r);
+            return {static_cast<float>(reward), true};
+        }
+
+        return {static_cast<float>(reward), false};
+    }
+
+    auto battle_env::observe(run& r, const std::span<float> row) const
+            -> void
+    {
+        std::ranges::fill(row, 0.0f);
+        player& p = r.game->current_player();
+
+        std::size_t at = 0;
+        row[at++] = static_cast<float>(r.game->stage());
+        row[at++] = static_cast<float>(r.turn);
+        row[at++] = static_cast<float>(to_double(p.health()));
+        row[at++] = static_cast<float>(to_double(p.max_health()));
+        row[at++] = static_cast<float>(to_double(p.gold()));
+
+        for (const auto& effect: p.status_effects()) {
+            float* cell = &row[at + effect.index() * effect_size];
+            cell[0] = static_cast<float>(std::visit(
+                    [](const auto& e) { return e.potency(); }, effect));
+            cell[1] = static_cast<float>(p.turns_left(effect));
+        }
+        at += effect_kind_count * effect_size;
+
+        const std::size_t shown
+                = std::min(r.enemies.size(), config_.max_enemies);
+        for (std::size_t i = 0; i < shown; ++i) {
+            const enemy& e = *r.enemies[i];
+            float* cell = &row[at + i * enemy_size];
+            cell[0] = e.is_dead() ? 0.0f : 1.0f;
+            cell[1] = static_cast<float>(to_double(e.health()));
+            cell[2] = static_cast<float>(to_double(e.max_health()));
+            cell[3] = static_cast<float>(e.level());
+            cell[4] = static_cast<float>(e.element());
+        }
+        at += config_.max_enemies * enemy_size;
+
+        for (const auto& stack: p.stored_ingredients().stacks()) {
+            if (stack.units.empty()) { continue; }
+            row[at + cell_of(stack)] += static_cast<float>(stack.units.size());
+        }
+    }
+
+    auto battle_env::cell_of(const inventory::stack& stack) const
+            -> std::size_t
+    {
+        const auto type = static_cast<std::size_t>(
+                ingredient_type_of(*stack.units.front()));
+        const auto potency = static_cast<std::size_t>(
+                std::clamp(stack.potency, 1, config_.max_potency));
+        const std::size_t cell
+                = type * static_cast<std::size_t>(config_.max_potency)
+                  + potency - 1;
+        return std::min(cell, inventory_cells_ - 1);
+    }
+
+    auto battle_env::check_size(const std::size_t actual,
+                                const std::size_t width) const -> void
+    {
+        if (actual != runs_.size() * width) {
+            throw std::invalid_argument(
+                    "Buffer size does not match the number of runs");
+        }
+    }
+
+} // namespace potmaker
@@ -0,0 +1,164 @@
+#ifndef BATTLE_ENV_HH
+#define BATTLE_ENV_HH
+#include "potionmaker_game.hh"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace potmaker {
+
+    /**
+     * The shape of a battle_env
+     */
+    struct env_config {
+        // How many runs are played side by side
+        std::size_t env_count = 1;
+        // How many enemies each observation describes. Enemies past these
+        // still fight but are not observed
+        std::size_t max_enemies = 8;
+        // Ingredients above this potency are counted as this potency
+        std::int32_t max_potency = 8;
+        // Reseeds the game's random number generator when the environment
+        // is created
+        std::uint64_t seed = 0;
+    };
+
+    /**
+     * What an agent does in one run for one step. Ingredients are named by
+     * their cell in the observed inventory histogram,
+     * type * max_potency + potency - 1
+     */
+    struct env_action {
+        static constexpr std::size_t max_ingredients = 4;
+
+        // A battle_action::kind as a number
+        std::int32_t type = 0;
+        // The enemy's place in the party
+        std::int32_t target = 0;
+        // Negative entries are unused
+        std::array<std::int32_t, max_ingredients> ingredients{-1, -1, -1, -1};
+    };
+
+    /**
+     * Plays several independent runs in lockstep for agents trained outside
+     * the game. Each step takes one action per run, plays one turn of every
+     * run and writes what each run looks like afterwards into flat arrays
+     * the caller owns, one row of observation_size floats per run.
+     *
+     * A run goes from battle to battle: after a win it shops with
+     * game_state::buy_planned and starts the next stage. When the player
+     * dies or surrenders the run is done and is replaced by a new one, so
+     * the observation returned with done set is already the new run's.
+     *
+     * Observation row layout:
+     * - stage, turn, player health, max health and gold
+     * - for each kind of status effect, the player's potency and turns left
+     * - for each of max_enemies places, whether there is a living enemy, its
+     *   health, max health, level and element
+     * - how many ingredients of each type and potency the player holds
+     *
+     * The reward is the health taken from enemies minus the health the
+     * player lost, in hundreds, plus one for each battle won and minus one
+     * for a run lost. Battles are played with console output silenced
+     */
+    class battle_env {
+    public:
+        /**
+         * Starts every run
+         * @param config The environment's shape
+         * @throws std::invalid_argument If there are no runs or the potency
+         * cap is not positive
+         */
+        explicit battle_env(const env_config& config);
+
+        /**
+         * @return How many floats describe one run
+         */
+        [[nodiscard]] auto observation_size() const -> std::size_t;
+
+        /**
+         * @return How many runs are played
+         */
+        [[nodiscard]] auto size() const -> std::size_t;
+
+        /**
+         * Replaces every run with a new one
+         * @param observations Where to write the runs' observations, size()
+         * rows of observation_size() floats
+         * @throws std::invalid_argument If the buffer has the wrong size
+         */
+        auto reset(std::span<float> observations) -> void;
+
+        /**
+         * Plays one turn of every run
+         * @param actions One action per run
+         * @param observations Where to write the runs' observations, size()
+         * rows of observation_size() floats
+         * @param rewards Where to write each run's reward
+         * @param dones Where to write whether each run ended and restarted
+         * @throws std::invalid_argument If a buffer has the wrong size
+         */
+        auto step(std::span<const env_action> actions,
+                  std::span<float> observations, std::span<float> rewards,
+                  std::span<std::uint8_t> dones) -> void;
+
+    private:
+        struct run {
+            std::unique_ptr<game_state> game;
+            enemy_party enemies;
+            std::uint32_t turn = 0;
+        };
+
+        // Stage, turn, health, max health and gold
+        static constexpr std::size_t header_size = 5;
+        // Potency and turns left
+        static constexpr std::size_t effect_size = 2;
+        // Alive, health, max health, level and element
+        static constexpr std::size_t enemy_size = 5;
+        static constexpr std::size_t effect_kind_count
+                = std::variant_size_v<status_effect_variant>;
+
+        /**
+         * Replaces a run with a new one, at its first battle
+         */
+        static auto restart(run& r) -> void;
+
+        /**
+         * Plays one turn of a run
+         * @return The run's reward, and whether it ended
+         */
+        auto play(run& r, const env_action& action)
+                -> std::pair<float, bool>;
+
+        /**
+         * Writes a run's observation
+         */
+        auto observe(run& r, std::span<float> row) const -> void;
+
+        /**
+         * @return The histogram cell of a stack's ingredients
+         */
+        [[nodiscard]] auto cell_of(const inventory::stack& stack) const
+                -> std::size_t;
+
+        /**
+         * Checks that a buffer holds one row of the given width per run
+         */
+        auto check_size(std::size_t actual, std::size_t width) const -> void;
+
+        env_config config_;
+        std::size_t inventory_cells_;
+        std::vector<run> runs_;
+        // Reused so that translating actions does not allocate
+        battle_action action_;
+        enemy_party before_;
+    };
+
+} // namespace potmaker
+
+#endif // BATTLE_ENV_HH
@@ -0,0 +1,195 @@
+#include "checkpoint.hh"
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+namespace potmaker::checkpoint {
+
+    namespace {
+
+        auto corrupted() -> std::runtime_error
+        {
+            return std::runtime_error("checkpoint is corrupted");
+        }
+
+        /**
+         * @return The bytes a record's checksum covers: all but itself
+         */
+        auto covered(const unit_record& record) -> std::span<const std::byte>
+        {
+            return std::as_bytes(std::span(&record, 1))
+                    .first(offsetof(unit_record, checksum));
+        }
+
+        /**
+         * Writes all of a buffer at an offset
+         * @return Whether it was written
+         */
+        auto write_all(const int fd, const void* data, const std::size_t size,
+                       const ::off_t offset) -> bool
+        {
+            const auto* bytes = static_cast<const std::byte*>(data);
+            std::size_t written = 0;
+            while (written < size) {
+                const ::ssize_t n
+                        = ::pwrite(fd, bytes + written, size - written,
+                                   offset + static_cast<::off_t>(written));
+                if (n <= 0) { return false; }
+                written += static_cast<std::size_t>(n);
+            }
+            return true;
+        }
+
+        /**
+         * Creates a checkpoint with nothing but its header. The header is
+         * written next to the destination and moved into place, so the
+         * checkpoint never exists without one
+         */
+        auto create(const std::string& path, const header& h) -> void
+        {
+            const std::string temp_path = path + ".tmp";
+            const int fd = ::open(temp_path.c_str(),
+                                  O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (fd < 0) {
+                throw std::runtime_error(
+                        "could not open checkpoint for writing");
+            }
+            const bool written
+                    = write_all(fd, &h, sizeof(h), 0) && ::fsync(fd) == 0;
+            ::close(fd);
+            if (!written) {
+                ::unlink(temp_path.c_str());
+                throw std::runtime_error("could not write checkpoint");
+            }
+
+            if (std::rename(temp_path.c_str(), path.c_str()) != 0) {
+                ::unlink(temp_path.c_str());
+                throw std::runtime_error("could not create checkpoint");
+            }
+        }
+
+    } // namespace
+
+    auto checksum(const std::span<const std::byte> bytes) -> std::uint64_t
+    {
+        std::uint64_t hash = 0xcbf29ce484222325ULL;
+        for (const std::byte b: bytes) {
+            hash ^= static_cast<std::uint64_t>(b);
+            hash *= 0x100000001b3ULL;
+        }
+        return hash;
+    }
+
+    journal::journal(const std::string& path, const std::uint64_t sweep,
+                     const std::uint64_t unit_count)
+        : unit_count_(unit_count),
+          committed_(static_cast<std::size_t>(unit_count))
+    {
+        const header expected{magic, format_version, 0, sweep, unit_count};
+        if (::access(path.c_str(), F_OK) != 0) { create(path, expected); }
+
+        fd_ = ::open(path.c_str(), O_RDWR);
+        if (fd_ < 0) { throw std::runtime_error("could not open checkpoint"); }
+
+        // Checkpoints stay small, a record per unit, so they are read in
+        // one go
+        struct stat info{};
+        if (::fstat(fd_, &info) != 0) {
+            ::close(fd_);
+            throw std::runtime_error("could not read checkpoint");
+        }
+        std::vector<std::byte> image(static_cast<std::size_t>(info.st_size));
+        std::size_t read = 0;
+        while (read < image.size()) {
+            const ::ssize_t n
+                    = ::pread(fd_, image.data() + read, image.size() - read,
+                              static_cast<::off_t>(read));
+            if (n <= 0) {
+                ::close(fd_);
+                throw std::runtime_error("could not read checkpoint");
+            }
+            read += static_cast<std::size_t>(n);
+        }
+
+        try {
+            if (image.size() < sizeof(header)) {
+                throw std::runtime_error("checkpoint is truncated");
+            }
+            header h{};
+            std::memcpy(&h, image.data(), sizeof(h));
+            if (h.magic != magic) {
+                throw std::runtime_error("not a potionmaker checkpoint");
+            }
+            if (h.version != format_version) {
+                throw std::runtime_error("unsupported checkpoint version");
+            }
+            if (h.sweep != sweep || h.unit_count != unit_count) {
+                throw std::runtime_error(
+                        "the checkpoint belongs to another sweep");
+            }
+
+            // Every record up to the first torn one is committed
+            std::size_t end = sizeof(header);
+            while (end + sizeof(unit_record) <= image.size()) {
+                unit_record record{};
+                std::memcpy(&record, image.data() + end, sizeof(record));
+                if (record.checksum != checksum(covered(record))) { break; }
+                if (record.unit >= unit_count_
+                    || committed_[static_cast<std::size_t>(record.unit)]) {
+                    throw corrupted();
+                }
+                committed_[static_cast<std::size_t>(record.unit)] = true;
+                records_.push_back(record);
+                end += sizeof(unit_record);
+            }
+
+            if (end != image.size()
+                && (::ftruncate(fd_, static_cast<::off_t>(end)) != 0
+                    || ::fsync(fd_) != 0)) {
+                throw std::runtime_error("could not repair checkpoint");
+            }
+        }
+        catch (...) {
+            ::close(fd_);
+            throw;
+        }
+    }
+
+    journal::~journal()
+    {
+        if (fd_ >= 0) { ::close(fd_); }
+    }
+
+    auto journal::records() const -> const std::vector<unit_record>&
+    {
+        return records_;
+    }
+
+    auto journal::commit(unit_record record) -> void
+    {
+        if (record.unit >= unit_count_
+            || committed_[static_cast<std::size_t>(record.unit)]) {
+            throw std::invalid_argument("the unit cannot be committed");
+        }
+
+        record.checksum = checksum(covered(record));
+        const auto end = static_cast<::off_t>(
+                sizeof(header) + records_.size() * sizeof(unit_record));
+        if (!write_all(fd_, &record, sizeof(record), end)
+            || ::fsync(fd_) != 0) {
+            throw std::runtime_error("could not write checkpoint");
+        }
+
+        committed_[static_cast<std::size_t>(record.unit)] = true;
+        records_.push_back(record);
+    }
+
+} // namespace potmaker::checkpoint
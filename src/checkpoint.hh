@@ -0,0 +1,122 @@
+#ifndef CHECKPOINT_HH
+#define CHECKPOINT_HH
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace potmaker::checkpoint {
+
+    /*
+     * Checkpoints record the finished work units of a long sweep, so that
+     * a sweep that was cut short picks up where it stopped:
+     *
+     * [header][unit_record...]
+     *
+     * The header is written next to the destination and moved into place,
+     * so a checkpoint always has a whole one. Records are only ever
+     * appended, one write each, and synced to disk before the unit counts
+     * as done. Each record ends with a checksum of the rest of it, so a
+     * record torn by a crash is recognized, and it is cut off together with
+     * anything after it when the checkpoint is opened again. A record is
+     * thereby committed exactly when all of it is on disk.
+     *
+     * The header identifies the sweep by a hash of everything its results
+     * depend on, so a checkpoint is never resumed by a different sweep
+     */
+
+    constexpr std::array<char, 8> magic{'P', 'O', 'T', 'M', 'K', 'C', 'K', 'P'};
+    constexpr std::uint32_t format_version = 1;
+
+    struct header {
+        std::array<char, 8> magic;
+        std::uint32_t version;
+        std::uint32_t reserved;
+        std::uint64_t sweep;
+        std::uint64_t unit_count;
+    };
+
+    /**
+     * What a finished work unit measured
+     */
+    struct unit_record {
+        std::uint64_t unit;
+        // The unit's RNG cursor. Its runs were seeded with every seed from
+        // first_seed up to next_seed, and each run seeds the generator
+        // afresh, so the cursor is all the random state a unit leaves
+        std::uint64_t first_seed;
+        std::uint64_t next_seed;
+        std::uint64_t battles;
+        std::uint64_t wins;
+        // Sums, and sums of squares, over the unit's runs
+        double stages;
+        double stage_squares;
+        double turns;
+        double turn_squares;
+        double gold;
+        double gold_squares;
+        std::uint64_t checksum;
+    };
+
+    static_assert(std::is_trivially_copyable_v<header>);
+    static_assert(std::is_trivially_copyable_v<unit_record>);
+    static_assert(sizeof(header) % 8 == 0);
+    static_assert(sizeof(unit_record) % 8 == 0);
+
+    /**
+     * 64-bit FNV-1a
+     * @param bytes The bytes to hash
+     * @return Their hash
+     */
+    [[nodiscard]] auto checksum(std::span<const std::byte> bytes)
+            -> std::uint64_t;
+
+    /**
+     * An open checkpoint, appended to as units finish
+     */
+    class journal {
+    public:
+        /**
+         * Opens a checkpoint, or creates it if there is none at the path.
+         * A torn record at the end, and anything after it, is cut off
+         * @param path The checkpoint
+         * @param sweep The hash identifying the sweep
+         * @param unit_count How many units the sweep has
+         * @throws std::runtime_error If the file could not be created,
+         * read or written, belongs to another sweep or is corrupted
+         */
+        journal(const std::string& path, std::uint64_t sweep,
+                std::uint64_t unit_count);
+        ~journal();
+
+        journal(const journal&) = delete;
+        auto operator=(const journal&) -> journal& = delete;
+
+        /**
+         * @return The committed records, in the order they were committed
+         */
+        [[nodiscard]] auto records() const
+                -> const std::vector<unit_record>&;
+
+        /**
+         * Appends a record and waits until it is on disk
+         * @param record The record. Its checksum is filled in
+         * @throws std::invalid_argument If the unit is out of range or
+         * already committed
+         * @throws std::runtime_error If the record could not be written
+         */
+        auto commit(unit_record record) -> void;
+
+    private:
+        int fd_ = -1;
+        std::uint64_t unit_count_;
+        std::vector<unit_record> records_;
+        std::vector<bool> committed_;
+    };
+
+} // namespace potmaker::checkpoint
+
+#endif // CHECKPOINT_HH
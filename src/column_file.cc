@@ -0,0 +1,709 @@
+#include "column_file.hh"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+namespace potmaker::columns {
+
+    namespace {
+
+        // Scans filter this many rows at a time into a mask, then gather the
+        // matching rows from it. Both loops are free of branches on the data
+        // so that the compiler turns them into vector instructions
+        constexpr std::size_t scan_block = 1024;
+
+        constexpr std::size_t max_dictionary_size = 256;
+
+        constexpr auto padded(const std::size_t bytes) -> std::size_t
+        {
+            return (bytes + 7) & ~std::size_t{7};
+        }
+
+        /**
+         * Maps a double to an integer that sorts the same way. Negative
+         * doubles sort backwards by their bits, so those bits are flipped.
+         * The mapping is its own inverse
+         */
+        auto key_of(const std::int64_t bits) -> std::int64_t
+        {
+            const auto negative = static_cast<std::uint64_t>(bits >> 63);
+            return bits ^ static_cast<std::int64_t>(negative >> 1);
+        }
+
+        auto key_of(const double value) -> std::int64_t
+        {
+            return key_of(std::bit_cast<std::int64_t>(value));
+        }
+
+        auto value_of(const std::int64_t key) -> double
+        {
+            return std::bit_cast<double>(key_of(key));
+        }
+
+        auto zigzag(const std::int64_t value) -> std::uint64_t
+        {
+            return (static_cast<std::uint64_t>(value) << 1)
+                   ^ static_cast<std::uint64_t>(value >> 63);
+        }
+
+        auto unzigzag(const std::uint64_t value) -> std::uint64_t
+        {
+            return (value >> 1) ^ (0 - (value & 1));
+        }
+
+        /**
+         * Encodes one chunk the smallest way it can be
+         * @param values The chunk's values
+         * @param scratch Space to work out the dictionary in
+         * @param out Receives the encoded chunk, padded to 8 bytes
+         * @return The chunk's record, short of its place in the file
+         */
+        auto encode_chunk(const std::span<const std::int64_t> values,
+                          std::vector<std::int64_t>& scratch,
+                          std::vector<std::byte>& out) -> chunk_record
+        {
+            chunk_record chunk{};
+            chunk.row_count = static_cast<std::uint32_t>(values.size());
+            const auto [min, max] = std::ranges::minmax(values);
+            chunk.min = min;
+            chunk.max = max;
+
+            scratch.assign(values.begin(), values.end());
+            std::ranges::sort(scratch);
+            scratch.erase(std::ranges::unique(scratch).begin(), scratch.end());
+
+            std::uint64_t widest = 0;
+            for (std::size_t i = 1; i < values.size(); ++i) {
+                const auto delta = static_cast<std::int64_t>(
+                        static_cast<std::uint64_t>(values[i])
+                        - static_cast<std::uint64_t>(values[i - 1]));
+                widest = std::max(widest, zigzag(delta));
+            }
+            const std::uint8_t width = widest <= 0xff         ? 1
+                                       : widest <= 0xffff     ? 2
+                                       : widest <= 0xffffffff ? 4
+                                                              : 0;
+
+            const std::size_t plain_size = values.size() * 8;
+            const std::size_t delta_size
+                    = width != 0 ? padded(width * (values.size() - 1))
+                                 : plain_size;
+            const std::size_t dictionary_size
+                    = scratch.size() <= max_dictionary_size
+                              ? scratch.size() * 8 + padded(values.size())
+                              : plain_size;
+
+            if (dictionary_size <= delta_size
+                && dictionary_size < plain_size) {
+                chunk.encoding = encoding::dictionary;
+                chunk.dictionary_size
+                        = static_cast<std::uint16_t>(scratch.size());
+                out.assign(dictionary_size, std::byte{0});
+                std::memcpy(out.data(), scratch.data(), scratch.size() * 8);
+                auto* codes = reinterpret_cast<std::uint8_t*>(
+                        out.data() + scratch.size() * 8);
+                for (std::size_t i = 0; i < values.size(); ++i) {
+                    codes[i] = static_cast<std::uint8_t>(
+                            std::ranges::lower_bound(scratch, values[i])
+                            - scratch.begin());
+                }
+            }
+            else if (delta_size < plain_size) {
+                chunk.encoding = encoding::delta;
+                chunk.width = width;
+                chunk.base = values.front();
+                out.assign(delta_size, std::byte{0});
+                for (std::size_t i = 1; i < values.size(); ++i) {
+                    const std::uint64_t delta
+                            = zigzag(static_cast<std::int64_t>(
+                                    static_cast<std::uint64_t>(values[i])
+                                    - static_cast<std::uint64_t>(
+                                            values[i - 1])));
+                    // Little-endian, like every other number in the file
+                    std::memcpy(out.data() + (i - 1) * width, &delta, width);
+                }
+            }
+            else {
+                chunk.encoding = encoding::plain;
+                out.assign(plain_size, std::byte{0});
+                std::memcpy(out.data(), values.data(), plain_size);
+            }
+
+            chunk.size = static_cast<std::uint32_t>(out.size());
+            return chunk;
+        }
+
+        /**
+         * Appends first + i for every i below count whose value lies in
+         * [low, low + range]. The values are compared with unsigned
+         * arithmetic, so one comparison checks both ends
+         */
+        template<typename value_t>
+        auto filter(const value_t* values, const std::size_t count,
+                    const value_t low, const value_t range,
+                    const std::uint64_t first,
+                    std::vector<std::uint64_t>& rows) -> void
+        {
+            std::array<std::uint8_t, scan_block> mask;
+            const auto matches = [&](const std::size_t i) -> std::uint8_t {
+                return static_cast<value_t>(values[i] - low) <= range;
+            };
+            // A whole block has a fixed length, which lets the loop vectorize
+            if (count == scan_block) {
+                for (std::size_t i = 0; i < scan_block; ++i) {
+                    mask[i] = matches(i);
+                }
+            }
+            else {
+                for (std::size_t i = 0; i < count; ++i) {
+                    mask[i] = matches(i);
+                }
+            }
+
+            const std::size_t start = rows.size();
+            rows.resize(start + count);
+            std::size_t end = start;
+            for (std::size_t i = 0; i < count; ++i) {
+                rows[end] = first + i;
+                end += mask[i];
+            }
+            rows.resize(end);
+        }
+
+        /**
+         * Undoes the differences of a delta chunk, from row first on
+         * @param deltas The chunk's differences
+         * @param first The first row to decode, past the base
+         * @param count How many rows to decode
+         * @param previous The value of the row before first, updated to the
+         * last value decoded
+         * @param out Receives the values
+         */
+        template<typename delta_t>
+        auto undo_deltas(const std::byte* deltas, const std::size_t first,
+                         const std::size_t count, std::uint64_t& previous,
+                         std::uint64_t* out) -> void
+        {
+            const auto* d = reinterpret_cast<const delta_t*>(deltas)
+                            + (first - 1);
+            for (std::size_t i = 0; i < count; ++i) {
+                previous += unzigzag(d[i]);
+                out[i] = previous;
+            }
+        }
+
+        auto undo_deltas(const chunk_record& chunk, const std::byte* deltas,
+                         const std::size_t first, const std::size_t count,
+                         std::uint64_t& previous, std::uint64_t* out) -> void
+        {
+            switch (chunk.width) {
+            case 1:
+                undo_deltas<std::uint8_t>(deltas, first, count, previous, out);
+                break;
+            case 2:
+                undo_deltas<std::uint16_t>(deltas, first, count, previous,
+                                           out);
+                break;
+            default:
+                undo_deltas<std::uint32_t>(deltas, first, count, previous,
+                                           out);
+                break;
+            }
+        }
+
+    } // namespace
+
+    writer::writer(const std::string& path)
+        : path_(path), temp_path_(path + ".tmp")
+    {
+        fd_ = ::open(temp_path_.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd_ < 0) {
+            throw std::runtime_error("could not open column file for writing");
+        }
+
+        // The header is filled in once everything else is written
+        const columns::header blank{};
+        write_bytes(&blank, sizeof(blank));
+    }
+
+    writer::~writer()
+    {
+        if (fd_ >= 0) {
+            ::close(fd_);
+            ::unlink(temp_path_.c_str());
+        }
+    }
+
+    auto writer::add_column(const std::string_view name, const value_type type)
+            -> std::size_t
+    {
+        if (row_count_ != 0 || next_column_ != 0) {
+            throw std::invalid_argument("columns must come before rows");
+        }
+
+        const auto offset = static_cast<std::uint32_t>(strings_.size());
+        strings_.append(name);
+        columns_.push_back(
+                {offset, static_cast<std::uint32_t>(name.size()), type, 0});
+        pending_.emplace_back().reserve(chunk_rows);
+        return columns_.size() - 1;
+    }
+
+    auto writer::push(const std::int64_t value) -> void
+    {
+        push_key(value, value_type::int64);
+    }
+
+    auto writer::push(const double value) -> void
+    {
+        push_key(key_of(value), value_type::float64);
+    }
+
+    auto writer::push_key(const std::int64_t key, const value_type type)
+            -> void
+    {
+        if (next_column_ >= columns_.size()) {
+            throw std::invalid_argument("the row has no more columns");
+        }
+        if (columns_[next_column_].type != type) {
+            throw std::invalid_argument("value does not fit the column");
+        }
+        pending_[next_column_++].push_back(key);
+    }
+
+    auto writer::end_row() -> void
+    {
+        if (columns_.empty()) {
+            throw std::invalid_argument("the file has no columns");
+        }
+        if (next_column_ != columns_.size()) {
+            throw std::invalid_argument("the row is missing columns");
+        }
+        next_column_ = 0;
+        ++row_count_;
+        if (pending_.front().size() == chunk_rows) { flush_group(); }
+    }
+
+    auto writer::flush_group() -> void
+    {
+        std::vector<std::int64_t> scratch;
+        for (std::size_t c = 0; c < columns_.size(); ++c) {
+            chunk_record chunk = encode_chunk(pending_[c], scratch, encoded_);
+            chunk.offset = written_;
+            chunk.column = static_cast<std::uint32_t>(c);
+            write_bytes(encoded_.data(), encoded_.size());
+            chunks_.push_back(chunk);
+            pending_[c].clear();
+        }
+    }
+
+    auto writer::write_bytes(const void* data, const std::size_t size) -> void
+    {
+        const auto* bytes = static_cast<const std::byte*>(data);
+        std::size_t done = 0;
+        while (done < size) {
+            const ::ssize_t n = ::write(fd_, bytes + done, size - done);
+            if (n <= 0) {
+                throw std::runtime_error("could not write column file");
+            }
+            done += static_cast<std::size_t>(n);
+        }
+        written_ += size;
+    }
+
+    auto writer::finish() -> void
+    {
+        if (fd_ < 0) { throw std::runtime_error("column file is finished"); }
+        if (columns_.empty()) {
+            throw std::invalid_argument("the file has no columns");
+        }
+        if (next_column_ != 0) {
+            throw std::invalid_argument("the last row is missing columns");
+        }
+        if (!pending_.front().empty()) { flush_group(); }
+
+        columns::header h{};
+        h.magic = magic;
+        h.version = format_version;
+        h.column_count = static_cast<std::uint32_t>(columns_.size());
+        h.row_count = row_count_;
+        h.chunk_count = chunks_.size();
+        h.directory_offset = written_;
+        h.strings_size = strings_.size();
+
+        write_bytes(columns_.data(), std::span(columns_).size_bytes());
+        write_bytes(chunks_.data(), std::span(chunks_).size_bytes());
+        write_bytes(strings_.data(), strings_.size());
+        h.file_size = written_;
+
+        if (::pwrite(fd_, &h, sizeof(h), 0)
+            != static_cast<::ssize_t>(sizeof(h))) {
+            throw std::runtime_error("could not write column file");
+        }
+        ::close(fd_);
+        fd_ = -1;
+
+        if (std::rename(temp_path_.c_str(), path_.c_str()) != 0) {
+            ::unlink(temp_path_.c_str());
+            throw std::runtime_error("could not replace column file");
+        }
+    }
+
+    reader::reader(const std::string& path)
+    {
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) { throw std::runtime_error("column file not found"); }
+
+        struct stat info{};
+        if (::fstat(fd, &info) != 0
+            || static_cast<std::size_t>(info.st_size)
+                       < sizeof(columns::header)) {
+            ::close(fd);
+            throw std::runtime_error("column file is truncated");
+        }
+
+        size_ = static_cast<std::size_t>(info.st_size);
+        void* mapping = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+
+        if (mapping == MAP_FAILED) {
+            throw std::runtime_error("could not map column file");
+        }
+        data_ = static_cast<const std::byte*>(mapping);
+
+        const columns::header& h = header();
+        if (h.magic != magic) {
+            unmap();
+            throw std::runtime_error("not a potionmaker column file");
+        }
+        if (h.version != format_version) {
+            unmap();
+            throw std::runtime_error("unsupported column file version");
+        }
+
+        // Every group has one chunk per column. The sizes come from the
+        // file, so each is checked against what is left of it before it
+        // is added, and nothing can wrap around
+        const std::uint64_t groups = h.row_count / chunk_rows
+                                     + (h.row_count % chunk_rows != 0 ? 1 : 0);
+        const bool directory_fits
+                = h.file_size == size_ && h.directory_offset % 8 == 0
+                  && h.directory_offset <= size_
+                  && h.column_count <= (size_ - h.directory_offset)
+                                               / sizeof(column_record);
+        if (directory_fits) {
+            chunks_offset_ = h.directory_offset
+                             + h.column_count * sizeof(column_record);
+        }
+        const bool chunks_fit
+                = directory_fits
+                  && h.chunk_count
+                             <= (size_ - chunks_offset_) / sizeof(chunk_record)
+                  && (h.column_count == 0
+                              ? h.chunk_count == 0
+                              : h.chunk_count % h.column_count == 0
+                                        && h.chunk_count / h.column_count
+                                                   == groups);
+        if (chunks_fit) {
+            strings_offset_ = chunks_offset_
+                              + h.chunk_count * sizeof(chunk_record);
+        }
+        if (!chunks_fit || h.strings_size != size_ - strings_offset_) {
+            unmap();
+            throw std::runtime_error("column file is corrupted");
+        }
+
+        for (const column_record& column: column_records()) {
+            if (static_cast<std::uint64_t>(column.name_offset)
+                        + column.name_length
+                > h.strings_size) {
+                unmap();
+                throw std::runtime_error("column file is corrupted");
+            }
+        }
+
+        // Chunks are checked once here, so scans can trust them
+        const std::span<const chunk_record> chunks = chunk_records();
+        for (std::size_t i = 0; i < chunks.size(); ++i) {
+            const chunk_record& chunk = chunks[i];
+            const std::uint64_t group = i / h.column_count;
+            const std::uint64_t rows = std::min<std::uint64_t>(
+                    chunk_rows, h.row_count - group * chunk_rows);
+
+            std::size_t needed = 0;
+            switch (chunk.encoding) {
+            case encoding::plain:
+                needed = rows * 8;
+                break;
+            case encoding::delta:
+                needed = chunk.width == 1 || chunk.width == 2
+                                         || chunk.width == 4
+                                 ? chunk.width * (rows - 1)
+                                 : size_;
+                break;
+            case encoding::dictionary:
+                needed = chunk.dictionary_size != 0
+                                         && chunk.dictionary_size
+                                                    <= max_dictionary_size
+                                 ? chunk.dictionary_size * 8 + rows
+                                 : size_;
+                break;
+            default:
+                needed = size_;
+                break;
+            }
+
+            if (chunk.column != i % h.column_count || chunk.row_count != rows
+                || chunk.offset % 8 != 0
+                || chunk.offset < sizeof(columns::header)
+                || chunk.size < needed
+                || chunk.offset > h.directory_offset
+                || chunk.size > h.directory_offset - chunk.offset) {
+                unmap();
+                throw std::runtime_error("column file is corrupted");
+            }
+        }
+    }
+
+    reader::~reader()
+    {
+        unmap();
+    }
+
+    auto reader::unmap() -> void
+    {
+        if (data_ != nullptr) {
+            ::munmap(const_cast<std::byte*>(data_), size_);
+            data_ = nullptr;
+        }
+    }
+
+    auto reader::header() const -> const columns::header&
+    {
+        return *reinterpret_cast<const columns::header*>(data_);
+    }
+
+    auto reader::column_records() const -> std::span<const column_record>
+    {
+        return {reinterpret_cast<const column_record*>(
+                        data_ + header().directory_offset),
+                header().column_count};
+    }
+
+    auto reader::chunk_records() const -> std::span<const chunk_record>
+    {
+        return {reinterpret_cast<const chunk_record*>(data_ + chunks_offset_),
+                static_cast<std::size_t>(header().chunk_count)};
+    }
+
+    auto reader::rows() const -> std::uint64_t
+    {
+        return header().row_count;
+    }
+
+    auto reader::columns() const -> std::size_t
+    {
+        return header().column_count;
+    }
+
+    auto reader::name(const std::size_t column) const -> std::string_view
+    {
+        const column_record& record = column_records()[column];
+        return {reinterpret_cast<const char*>(data_ + strings_offset_
+                                              + record.name_offset),
+                record.name_length};
+    }
+
+    auto reader::type(const std::size_t column) const -> value_type
+    {
+        return column_records()[column].type;
+    }
+
+    auto reader::find(const std::string_view name) const -> std::size_t
+    {
+        for (std::size_t c = 0; c < columns(); ++c) {
+            if (this->name(c) == name) { return c; }
+        }
+        throw std::out_of_range("no such column");
+    }
+
+    auto reader::integers(const std::size_t column) const
+            -> std::vector<std::int64_t>
+    {
+        return decode(column, value_type::int64);
+    }
+
+    auto reader::reals(const std::size_t column) const -> std::vector<double>
+    {
+        const std::vector<std::int64_t> keys
+                = decode(column, value_type::float64);
+        std::vector<double> values(keys.size());
+        std::ranges::transform(keys, values.begin(),
+                               [](const std::int64_t key) {
+                                   return value_of(key);
+                               });
+        return values;
+    }
+
+    auto reader::scan(const std::size_t column, const std::int64_t min,
+                      const std::int64_t max) const
+            -> std::vector<std::uint64_t>
+    {
+        return scan_keys(column, value_type::int64, min, max);
+    }
+
+    auto reader::scan(const std::size_t column, const double min,
+                      const double max) const -> std::vector<std::uint64_t>
+    {
+        return scan_keys(column, value_type::float64, key_of(min),
+                         key_of(max));
+    }
+
+    auto reader::decode(const std::size_t column, const value_type type) const
+            -> std::vector<std::int64_t>
+    {
+        if (this->type(column) != type) {
+            throw std::invalid_argument("column holds another type");
+        }
+
+        std::vector<std::int64_t> values(static_cast<std::size_t>(rows()));
+        auto* out = reinterpret_cast<std::uint64_t*>(values.data());
+        const std::span<const chunk_record> chunks = chunk_records();
+        for (std::size_t i = column; i < chunks.size(); i += columns()) {
+            const chunk_record& chunk = chunks[i];
+            const std::byte* data = data_ + chunk.offset;
+            switch (chunk.encoding) {
+            case encoding::plain:
+                std::memcpy(out, data, chunk.row_count * 8);
+                break;
+            case encoding::delta: {
+                auto previous = static_cast<std::uint64_t>(chunk.base);
+                out[0] = previous;
+                undo_deltas(chunk, data, 1, chunk.row_count - 1, previous,
+                            out + 1);
+                break;
+            }
+            case encoding::dictionary: {
+                const auto* dictionary
+                        = reinterpret_cast<const std::uint64_t*>(data);
+                const auto* codes = reinterpret_cast<const std::uint8_t*>(
+                        data + chunk.dictionary_size * 8);
+                for (std::size_t r = 0; r < chunk.row_count; ++r) {
+                    out[r] = dictionary[codes[r]];
+                }
+                break;
+            }
+            }
+            out += chunk.row_count;
+        }
+        return values;
+    }
+
+    auto reader::scan_keys(const std::size_t column, const value_type type,
+                           const std::int64_t min, const std::int64_t max)
+            const -> std::vector<std::uint64_t>
+    {
+        if (this->type(column) != type) {
+            throw std::invalid_argument("column holds another type");
+        }
+
+        std::vector<std::uint64_t> matches;
+        if (min > max) { return matches; }
+
+        const auto low = static_cast<std::uint64_t>(min);
+        const std::uint64_t range = static_cast<std::uint64_t>(max) - low;
+        std::array<std::uint64_t, scan_block> decoded{};
+
+        const std::span<const chunk_record> chunks = chunk_records();
+        std::uint64_t first = 0;
+        for (std::size_t i = column; i < chunks.size();
+             i += columns(), first += chunk_rows) {
+            const chunk_record& chunk = chunks[i];
+            if (chunk.max < min || chunk.min > max) { continue; }
+
+            // Every row of a chunk within the range matches
+            if (chunk.min >= min && chunk.max <= max) {
+                const std::size_t start = matches.size();
+                matches.resize(start + chunk.row_count);
+                for (std::size_t r = 0; r < chunk.row_count; ++r) {
+                    matches[start + r] = first + r;
+                }
+                continue;
+            }
+
+            const std::byte* data = data_ + chunk.offset;
+            switch (chunk.encoding) {
+            case encoding::plain: {
+                const auto* values
+                        = reinterpret_cast<const std::uint64_t*>(data);
+                for (std::size_t r = 0; r < chunk.row_count; r += scan_block) {
+                    const std::size_t n = std::min<std::size_t>(
+                            scan_block, chunk.row_count - r);
+                    filter(values + r, n, low, range, first + r, matches);
+                }
+                break;
+            }
+            case encoding::delta: {
+                auto previous = static_cast<std::uint64_t>(chunk.base);
+                decoded[0] = previous;
+                std::size_t n = std::min<std::size_t>(scan_block,
+                                                      chunk.row_count);
+                undo_deltas(chunk, data, 1, n - 1, previous,
+                            decoded.data() + 1);
+                for (std::size_t r = 0;;) {
+                    filter(decoded.data(), n, low, range, first + r,
+                           matches);
+                    r += n;
+                    if (r >= chunk.row_count) { break; }
+                    n = std::min<std::size_t>(scan_block,
+                                              chunk.row_count - r);
+                    undo_deltas(chunk, data, r, n, previous, decoded.data());
+                }
+                break;
+            }
+            case encoding::dictionary: {
+                // The dictionary is sorted, so the matching values are a run
+                // of codes and the codes can be compared instead
+                const auto* dictionary
+                        = reinterpret_cast<const std::int64_t*>(data);
+                const std::span<const std::int64_t> entries(
+                        dictionary, chunk.dictionary_size);
+                const auto lowest = static_cast<std::uint8_t>(
+                        std::ranges::lower_bound(entries, min)
+                        - entries.begin());
+                const auto past = static_cast<std::size_t>(
+                        std::ranges::upper_bound(entries, max)
+                        - entries.begin());
+                if (past <= lowest) { break; }
+                const auto codes_range
+                        = static_cast<std::uint8_t>(past - 1 - lowest);
+
+                const auto* codes = reinterpret_cast<const std::uint8_t*>(
+                        data + chunk.dictionary_size * 8);
+                for (std::size_t r = 0; r < chunk.row_count; r += scan_block) {
+                    const std::size_t n = std::min<std::size_t>(
+                            scan_block, chunk.row_count - r);
+                    filter(codes + r, n, lowest, codes_range, first + r,
+                           matches);
+                }
+                break;
+            }
+            }
+        }
+        return matches;
+    }
+
+} // namespace potmaker::columns
@@ -0,0 +1,290 @@
+#ifndef COLUMN_FILE_HH
+#define COLUMN_FILE_HH
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace potmaker::columns {
+
+    /*
+     * Column files hold a table of numbers, stored column by column so that
+     * one column can be read without touching the others:
+     *
+     * [header][chunk...][column_record...][chunk_record...][string table]
+     *
+     * Rows are cut into groups of chunk_rows, and each column of a group is
+     * a chunk, encoded whichever of these ways is smallest:
+     *
+     * - plain: the values as they are
+     * - delta: the first value, then the zigzagged difference from the value
+     *   before in 1, 2 or 4 bytes each
+     * - dictionary: the distinct values in ascending order, then one byte
+     *   per row indexing them
+     *
+     * Every chunk also records its smallest and largest value, so scans skip
+     * the chunks that cannot match. Chunks are 8-byte aligned and read in
+     * place through a memory mapping.
+     *
+     * Floating-point values are stored as integers that sort the same way,
+     * so both kinds of column share the encodings and the scans
+     */
+
+    constexpr std::array<char, 8> magic{'P', 'O', 'T', 'M', 'K', 'C', 'O', 'L'};
+    constexpr std::uint32_t format_version = 1;
+    constexpr std::uint32_t chunk_rows = 16384;
+
+    enum class value_type : std::uint32_t { int64, float64 };
+
+    enum class encoding : std::uint8_t { plain, delta, dictionary };
+
+    struct header {
+        std::array<char, 8> magic;
+        std::uint32_t version;
+        std::uint32_t column_count;
+        std::uint64_t row_count;
+        std::uint64_t chunk_count;
+        // Where the column records start, right after the last chunk
+        std::uint64_t directory_offset;
+        std::uint64_t strings_size;
+        std::uint64_t file_size;
+    };
+
+    struct column_record {
+        std::uint32_t name_offset;
+        std::uint32_t name_length;
+        value_type type;
+        std::uint32_t reserved;
+    };
+
+    struct chunk_record {
+        std::uint64_t offset;
+        std::uint32_t size;
+        std::uint32_t row_count;
+        std::uint32_t column;
+        columns::encoding encoding;
+        // Bytes per difference of a delta chunk
+        std::uint8_t width;
+        // Entries in the dictionary of a dictionary chunk
+        std::uint16_t dictionary_size;
+        // The first value of a delta chunk
+        std::int64_t base;
+        std::int64_t min;
+        std::int64_t max;
+    };
+
+    static_assert(std::is_trivially_copyable_v<header>);
+    static_assert(sizeof(header) % 8 == 0);
+    static_assert(sizeof(column_record) % 8 == 0);
+    static_assert(sizeof(chunk_record) % 8 == 0);
+
+    /**
+     * Writes a column file row by row. Chunks go to disk as soon as their
+     * rows are complete, so only one group of rows is held in memory
+     */
+    class writer {
+    public:
+        /**
+         * Starts a column file. Nothing appears at the path until finish
+         * @param path The destination
+         * @throws std::runtime_error If the file could not be created
+         */
+        explicit writer(const std::string& path);
+
+        /**
+         * Abandons the file if it was not finished
+         */
+        ~writer();
+
+        writer(const writer&) = delete;
+        auto operator=(const writer&) -> writer& = delete;
+
+        /**
+         * Adds a column. Columns are added before the first row
+         * @param name The column's name
+         * @param type What the column holds
+         * @return The column's number
+         * @throws std::invalid_argument If rows were already added
+         */
+        auto add_column(std::string_view name, value_type type)
+                -> std::size_t;
+
+        /**
+         * Sets the next column of the row being written
+         * @param value The value
+         * @throws std::invalid_argument If the column does not hold
+         * integers, or the row is already complete
+         */
+        auto push(std::int64_t value) -> void;
+
+        /**
+         * Sets the next column of the row being written
+         * @param value The value
+         * @throws std::invalid_argument If the column does not hold
+         * floating-point values, or the row is already complete
+         */
+        auto push(double value) -> void;
+
+        /**
+         * Completes the row being written
+         * @throws std::invalid_argument If the file has no columns or some
+         * of the row's columns were not set
+         */
+        auto end_row() -> void;
+
+        /**
+         * Writes out the last rows and the directory, and moves the file
+         * into place. A crash before this never leaves a partial file
+         * behind
+         * @throws std::invalid_argument If the file has no columns or the
+         * last row is missing columns
+         * @throws std::runtime_error If the file could not be written
+         */
+        auto finish() -> void;
+
+    private:
+        auto push_key(std::int64_t key, value_type type) -> void;
+
+        /**
+         * Encodes the buffered rows and writes them out
+         */
+        auto flush_group() -> void;
+
+        auto write_bytes(const void* data, std::size_t size) -> void;
+
+        std::string path_;
+        std::string temp_path_;
+        int fd_ = -1;
+        std::uint64_t written_ = 0;
+        std::uint64_t row_count_ = 0;
+        std::size_t next_column_ = 0;
+        std::vector<column_record> columns_;
+        std::vector<chunk_record> chunks_;
+        std::string strings_;
+        // The rows not yet written, one list per column
+        std::vector<std::vector<std::int64_t>> pending_;
+        std::vector<std::byte> encoded_;
+    };
+
+    /**
+     * Maps a column file into memory and scans its columns in place
+     */
+    class reader {
+    public:
+        /**
+         * Opens and validates a column file
+         * @param path The column file
+         * @throws std::runtime_error If the file is missing or malformed
+         */
+        explicit reader(const std::string& path);
+        ~reader();
+
+        reader(const reader&) = delete;
+        auto operator=(const reader&) -> reader& = delete;
+
+        /**
+         * @return How many rows the table has
+         */
+        [[nodiscard]] auto rows() const -> std::uint64_t;
+
+        /**
+         * @return How many columns the table has
+         */
+        [[nodiscard]] auto columns() const -> std::size_t;
+
+        /**
+         * @param column A column's number
+         * @return The column's name
+         */
+        [[nodiscard]] auto name(std::size_t column) const -> std::string_view;
+
+        /**
+         * @param column A column's number
+         * @return What the column holds
+         */
+        [[nodiscard]] auto type(std::size_t column) const -> value_type;
+
+        /**
+         * Looks a column up by name
+         * @param name The column's name
+         * @return The column's number
+         * @throws std::out_of_range If there is no such column
+         */
+        [[nodiscard]] auto find(std::string_view name) const -> std::size_t;
+
+        /**
+         * Decodes a whole integer column
+         * @param column The column's number
+         * @return The values, in row order
+         * @throws std::invalid_argument If the column holds floating-point
+         * values
+         */
+        [[nodiscard]] auto integers(std::size_t column) const
+                -> std::vector<std::int64_t>;
+
+        /**
+         * Decodes a whole floating-point column
+         * @param column The column's number
+         * @return The values, in row order
+         * @throws std::invalid_argument If the column holds integers
+         */
+        [[nodiscard]] auto reals(std::size_t column) const
+                -> std::vector<double>;
+
+        /**
+         * Finds the rows whose value in an integer column is within a range
+         * @param column The column's number
+         * @param min The smallest value that matches
+         * @param max The largest value that matches
+         * @return The matching rows, in ascending order
+         * @throws std::invalid_argument If the column holds floating-point
+         * values
+         */
+        [[nodiscard]] auto scan(std::size_t column, std::int64_t min,
+                                std::int64_t max) const
+                -> std::vector<std::uint64_t>;
+
+        /**
+         * Finds the rows whose value in a floating-point column is within a
+         * range
+         * @param column The column's number
+         * @param min The smallest value that matches
+         * @param max The largest value that matches
+         * @return The matching rows, in ascending order
+         * @throws std::invalid_argument If the column holds integers
+         */
+        [[nodiscard]] auto scan(std::size_t column, double min,
+                                double max) const
+                -> std::vector<std::uint64_t>;
+
+    private:
+        auto unmap() -> void;
+
+        [[nodiscard]] auto header() const -> const columns::header&;
+
+        [[nodiscard]] auto column_records() const
+                -> std::span<const column_record>;
+
+        [[nodiscard]] auto chunk_records() const
+                -> std::span<const chunk_record>;
+
+        [[nodiscard]] auto decode(std::size_t column, value_type type) const
+                -> std::vector<std::int64_t>;
+
+        [[nodiscard]] auto scan_keys(std::size_t column, value_type type,
+                                     std::int64_t min, std::int64_t max) const
+                -> std::vector<std::uint64_t>;
+
+        const std::byte* data_ = nullptr;
+        std::size_t size_ = 0;
+        std::size_t chunks_offset_ = 0;
+        std::size_t strings_offset_ = 0;
+    };
+
+} // namespace potmaker::columns
+
+#endif // COLUMN_FILE_HH
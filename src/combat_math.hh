@@ -0,0 +1,368 @@
+#ifndef COMBAT_MATH_HH
+#define COMBAT_MATH_HH
+#include <array>
+#include <compare>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <limits>
+#include <ostream>
+
+// Compilers without __int128 multiply and divide fixed-point numbers the
+// portable way. Defining POTMK_NO_INT128 does so anyway, so that it can be
+// tested where __int128 is available
+#if defined(__SIZEOF_INT128__) && !defined(POTMK_NO_INT128)
+#define POTMK_INT128
+#endif
+
+namespace potmaker {
+
+    /**
+     * A signed fixed-point number with 16 fractional bits. Every operation
+     * is plain integer arithmetic, so results are the same on every build
+     * no matter how the compiler treats floating point.
+     *
+     * Doubles and ints convert implicitly, rounding to the nearest step;
+     * converting back is explicit. Dividing by zero saturates towards the
+     * dividend's sign, as a double would go to infinity, and 0 / 0 is 0
+     */
+    class fixed_point {
+    public:
+        static constexpr int fraction_bits = 16;
+        static constexpr std::int64_t one = std::int64_t{1} << fraction_bits;
+
+        constexpr fixed_point() = default;
+
+        constexpr fixed_point(const double value)
+            : raw_(round(value * static_cast<double>(one)))
+        {}
+
+        constexpr fixed_point(const int value)
+            : raw_(static_cast<std::int64_t>(value) * one)
+        {}
+
+        /**
+         * @param raw The value times 2^fraction_bits
+         * @return The fixed-point number
+         */
+        [[nodiscard]] static constexpr auto from_raw(const std::int64_t raw)
+                -> fixed_point
+        {
+            fixed_point value;
+            value.raw_ = raw;
+            return value;
+        }
+
+        /**
+         * @return The value times 2^fraction_bits
+         */
+        [[nodiscard]] constexpr auto raw() const -> std::int64_t
+        {
+            return raw_;
+        }
+
+        /**
+         * @return The value as a double. Exact unless the value is huge
+         */
+        [[nodiscard]] constexpr auto to_double() const -> double
+        {
+            return static_cast<double>(raw_) / static_cast<double>(one);
+        }
+
+        constexpr explicit operator double() const { return to_double(); }
+
+        constexpr auto operator-() const -> fixed_point
+        {
+            return from_raw(-raw_);
+        }
+
+        constexpr auto operator+=(const fixed_point other) -> fixed_point&
+        {
+            raw_ += other.raw_;
+            return *this;
+        }
+
+        constexpr auto operator-=(const fixed_point other) -> fixed_point&
+        {
+            raw_ -= other.raw_;
+            return *this;
+        }
+
+        constexpr auto operator*=(const fixed_point other) -> fixed_point&
+        {
+            raw_ = multiply(raw_, other.raw_);
+            return *this;
+        }
+
+        constexpr auto operator/=(const fixed_point other) -> fixed_point&
+        {
+            raw_ = divide(raw_, other.raw_);
+            return *this;
+        }
+
+        friend constexpr auto operator+(fixed_point a, const fixed_point b)
+                -> fixed_point
+        {
+            return a += b;
+        }
+
+        friend constexpr auto operator-(fixed_point a, const fixed_point b)
+                -> fixed_point
+        {
+            return a -= b;
+        }
+
+        friend constexpr auto operator*(fixed_point a, const fixed_point b)
+                -> fixed_point
+        {
+            return a *= b;
+        }
+
+        friend constexpr auto operator/(fixed_point a, const fixed_point b)
+                -> fixed_point
+        {
+            return a /= b;
+        }
+
+        friend auto operator<<(std::ostream& out, const fixed_point value)
+                -> std::ostream&
+        {
+            return out << value.to_double();
+        }
+
+        friend constexpr auto operator==(const fixed_point& a,
+                                         const fixed_point& b) -> bool
+                = default;
+        friend constexpr auto operator<=>(const fixed_point& a,
+                                          const fixed_point& b)
+                = default;
+
+    private:
+        /**
+         * @return (a * b) >> fraction_bits, rounding towards negative
+         * infinity, from the full 128-bit product
+         */
+        [[nodiscard]] static constexpr auto multiply(const std::int64_t a,
+                                                     const std::int64_t b)
+                -> std::int64_t
+        {
+#ifdef POTMK_INT128
+            return static_cast<std::int64_t>(
+                    (static_cast<__int128>(a) * b) >> fraction_bits);
+#else
+            // The product of the magnitudes, in 32-bit halves
+            const std::uint64_t x = magnitude(a);
+            const std::uint64_t y = magnitude(b);
+            const std::uint64_t x_low = x & 0xffffffffU;
+            const std::uint64_t x_high = x >> 32;
+            const std::uint64_t y_low = y & 0xffffffffU;
+            const std::uint64_t y_high = y >> 32;
+
+            const std::uint64_t low_low = x_low * y_low;
+            const std::uint64_t middle = (low_low >> 32)
+                                         + (x_high * y_low & 0xffffffffU)
+                                         + x_low * y_high;
+            const std::uint64_t low
+                    = (middle << 32) | (low_low & 0xffffffffU);
+            const std::uint64_t high = x_high * y_high
+                                       + (x_high * y_low >> 32)
+                                       + (middle >> 32);
+
+            const std::uint64_t shifted
+                    = (high << (64 - fraction_bits)) | (low >> fraction_bits);
+            if ((a < 0) == (b < 0)) {
+                return static_cast<std::int64_t>(shifted);
+            }
+            // Rounding the magnitude up rounds the result down
+            const bool inexact = (low & (one - 1)) != 0;
+            return static_cast<std::int64_t>(0 - (shifted + (inexact ? 1 : 0)));
+#endif
+        }
+
+        /**
+         * @return (a << fraction_bits) / b, rounding towards zero, without
+         * losing the bits shifted out of a
+         */
+        [[nodiscard]] static constexpr auto divide(const std::int64_t a,
+                                                   const std::int64_t b)
+                -> std::int64_t
+        {
+            if (b == 0) {
+                return a < 0   ? std::numeric_limits<std::int64_t>::min()
+                       : a > 0 ? std::numeric_limits<std::int64_t>::max()
+                               : 0;
+            }
+#ifdef POTMK_INT128
+            return static_cast<std::int64_t>(
+                    (static_cast<__int128>(a) << fraction_bits) / b);
+#else
+            // Long division of the shifted magnitude, a bit at a time
+            const std::uint64_t x = magnitude(a);
+            const std::uint64_t y = magnitude(b);
+            std::uint64_t high = x >> (64 - fraction_bits);
+            std::uint64_t low = x << fraction_bits;
+            std::uint64_t remainder = 0;
+            std::uint64_t quotient = 0;
+            for (int bit = 127; bit >= 0; --bit) {
+                const std::uint64_t next
+                        = bit >= 64 ? high >> (bit - 64) & 1
+                                    : low >> bit & 1;
+                const bool overflow = remainder >> 63 != 0;
+                remainder = remainder << 1 | next;
+                quotient <<= 1;
+                if (overflow || remainder >= y) {
+                    remainder -= y;
+                    quotient |= 1;
+                }
+            }
+            return static_cast<std::int64_t>((a < 0) == (b < 0) ? quotient
+                                                                : 0 - quotient);
+#endif
+        }
+
+        /**
+         * @return The absolute value of a raw value, which for the most
+         * negative one does not fit an std::int64_t
+         */
+        [[nodiscard]] static constexpr auto magnitude(const std::int64_t raw)
+                -> std::uint64_t
+        {
+            return raw < 0 ? 0 - static_cast<std::uint64_t>(raw)
+                           : static_cast<std::uint64_t>(raw);
+        }
+
+        [[nodiscard]] static constexpr auto round(const double scaled)
+                -> std::int64_t
+        {
+            return static_cast<std::int64_t>(scaled < 0 ? scaled - 0.5
+                                                        : scaled + 0.5);
+        }
+
+        std::int64_t raw_ = 0;
+    };
+
+    /*
+     * Health, damage, gold and everything derived from them. Building with
+     * POTMK_FIXED_POINT switches all of it to fixed_point, for replays that
+     * must match bit for bit across compilers and build flags.
+     *
+     * The guarantee is about builds of this code, not about std::pow: the
+     * powers in multiplier_table are repeated products, which round
+     * differently from it. Battles do not depend on that today, see
+     * multiplier_table
+     */
+#ifdef POTMK_FIXED_POINT
+    using combat_value = fixed_point;
+#else
+    using combat_value = double;
+#endif
+
+    /**
+     * @param value A combat value
+     * @return The value as a double, for display and for the save file
+     */
+    [[nodiscard]] constexpr auto to_double(const double value) -> double
+    {
+        return value;
+    }
+
+    [[nodiscard]] constexpr auto to_double(const fixed_point value) -> double
+    {
+        return value.to_double();
+    }
+
+    /**
+     * @param value A combat value
+     * @return The value with its fraction dropped, rounding towards zero
+     */
+    [[nodiscard]] constexpr auto whole_part(const double value)
+            -> std::int64_t
+    {
+        return static_cast<std::int64_t>(value);
+    }
+
+    [[nodiscard]] constexpr auto whole_part(const fixed_point value)
+            -> std::int64_t
+    {
+        const std::int64_t raw = value.raw();
+        return raw < 0 ? -(-raw >> fixed_point::fraction_bits)
+                       : raw >> fixed_point::fraction_bits;
+    }
+
+    /**
+     * Raises a combat value to an integer power by repeated squaring, so the
+     * result does not depend on the platform's std::pow
+     * @param base The base
+     * @param exponent The exponent
+     * @return base^exponent
+     */
+    [[nodiscard]] constexpr auto integer_power(const combat_value base,
+                                               const int exponent)
+            -> combat_value
+    {
+        combat_value result = 1;
+        combat_value factor = base;
+        for (int n = exponent < 0 ? -exponent : exponent; n > 0; n /= 2) {
+            if (n % 2 == 1) { result *= factor; }
+            factor *= factor;
+        }
+        return exponent < 0 ? combat_value(1) / result : result;
+    }
+
+    /**
+     * The powers of a multiplier for the potencies effects usually have,
+     * computed once. Other potencies fall back to integer_power.
+     *
+     * Repeated multiplication rounds differently from std::pow: doubles
+     * drift by a few units in the last place, fixed-point values by up to a
+     * step per product. Status effect modifiers made from these are only
+     * compared with the amount they modify, to describe effects, and every
+     * power stays on the same side of one as std::pow's, so battles play as
+     * they did with std::pow. A modifier applied to combat values in
+     * battle would change that, and results would then differ from builds
+     * that used std::pow, though still not from one build to another
+     */
+    class multiplier_table {
+    public:
+        static constexpr std::size_t size = 16;
+
+        explicit constexpr multiplier_table(const combat_value base)
+            : base_(base)
+        {
+            combat_value power = 1;
+            for (auto& entry: powers_) {
+                entry = power;
+                power *= base;
+            }
+        }
+
+        /**
+         * @param exponent The exponent
+         * @return The multiplier raised to it
+         */
+        [[nodiscard]] constexpr auto operator()(const int exponent) const
+                -> combat_value
+        {
+            if (exponent >= 0 && static_cast<std::size_t>(exponent) < size) {
+                return powers_[static_cast<std::size_t>(exponent)];
+            }
+            return integer_power(base_, exponent);
+        }
+
+    private:
+        combat_value base_;
+        std::array<combat_value, size> powers_{};
+    };
+
+} // namespace potmaker
+
+template<>
+struct std::formatter<potmaker::fixed_point> : std::formatter<double> {
+    auto format(const potmaker::fixed_point value,
+                std::format_context& ctx) const
+    {
+        return std::formatter<double>::format(value.to_double(), ctx);
+    }
+};
+
+#endif // COMBAT_MATH_HH
@@ -0,0 +1,667 @@
+#include "content_library.hh"
+#include "effect_program.hh"
+#include "entity.hh"
+#include "ingredient.hh"
+#include "potion_program.hh"
+#include "state_hash.hh"
+#include "status_effect.hh"
+#include <array>
+#include <cctype>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace potmaker {
+
+    namespace {
+
+        using token_list = std::vector<std::string>;
+
+        constexpr std::array<std::string_view, 7> effect_names{
+                "burning",      "freezing",   "poison",  "wither",
+                "regeneration", "protection", "strength"};
+
+        [[noreturn]] auto fail(const std::size_t line, const std::string& what)
+                -> void
+        {
+            throw std::runtime_error(
+                    std::format("content line {}: {}", line, what));
+        }
+
+        /**
+         * Splits a line into words. Quoted text is kept as a single word
+         * (without the quotes) and # starts a comment
+         */
+        auto tokenize(const std::string_view line, const std::size_t number)
+                -> token_list
+        {
+            token_list tokens;
+            std::size_t i = 0;
+
+            while (i < line.size()) {
+                const char c = line[i];
+                if (c == ' ' || c == '\t' || c == '\r') { ++i; }
+                else if (c == '#') {
+                    break;
+                }
+                else if (c == '"') {
+                    const std::size_t close = line.find('"', i + 1);
+                    if (close == std::string_view::npos) {
+                        fail(number, "unterminated string");
+                    }
+                    tokens.emplace_back(line.substr(i + 1, close - i - 1));
+                    i = close + 1;
+                }
+                else {
+                    std::size_t end = i;
+                    while (end < line.size() && line[end] != ' '
+                           && line[end] != '\t' && line[end] != '\r') {
+                        ++end;
+                    }
+                    tokens.emplace_back(line.substr(i, end - i));
+                    i = end;
+                }
+            }
+
+            return tokens;
+        }
+
+        auto parse_number(const std::string_view text, const std::size_t line)
+                -> double
+        {
+            double value = 0.0;
+            const auto [ptr, ec] = std::from_chars(
+                    text.data(), text.data() + text.size(), value);
+            if (ec != std::errc{} || ptr != text.data() + text.size()) {
+                fail(line, std::format("expected a number, got '{}'", text));
+            }
+            return value;
+        }
+
+        auto parse_int(const std::string_view text, const std::size_t line)
+                -> int
+        {
+            int value = 0;
+            const auto [ptr, ec] = std::from_chars(
+                    text.data(), text.data() + text.size(), value);
+            if (ec != std::errc{} || ptr != text.data() + text.size()) {
+                fail(line, std::format("expected an integer, got '{}'", text));
+            }
+            return value;
+        }
+
+        /**
+         * Parses a sum of terms, each either a constant, "scale" or
+         * "<number>*scale"
+         */
+        auto parse_scaled(const std::string_view text, const std::size_t line)
+                -> scaled_value
+        {
+            scaled_value value{0.0, 0.0};
+            std::size_t start = 0;
+
+            while (start <= text.size()) {
+                std::size_t plus = text.find('+', start);
+                if (plus == std::string_view::npos) { plus = text.size(); }
+                const std::string_view term = text.substr(start, plus - start);
+
+                constexpr std::string_view scale_suffix = "*scale";
+                if (term == "scale") { value.factor += 1.0; }
+                else if (term.ends_with(scale_suffix)) {
+                    value.factor += parse_number(
+                            term.substr(0, term.size() - scale_suffix.size()),
+                            line);
+                }
+                else {
+                    value.base += parse_number(term, line);
+                }
+
+                start = plus + 1;
+            }
+
+            return value;
+        }
+
+        auto parse_element(const std::string_view text, const std::size_t line)
+                -> element_type
+        {
+            for (int i = 0; i <= static_cast<int>(element_type::boring); ++i) {
+                const auto element = static_cast<element_type>(i);
+                std::string name(element_type_to_str(element));
+                for (char& c: name) {
+                    c = static_cast<char>(std::tolower(c));
+                }
+                if (name == text) { return element; }
+            }
+            fail(line, std::format("unknown element '{}'", text));
+        }
+
+        auto parse_message(const std::string_view text, const std::size_t line)
+                -> std::vector<message_part>
+        {
+            using part_type = message_part::part_type;
+            std::vector<message_part> parts;
+            std::size_t start = 0;
+
+            while (start < text.size()) {
+                const std::size_t open = text.find('{', start);
+                if (open == std::string_view::npos) {
+                    parts.push_back({part_type::text,
+                                     std::string(text.substr(start))});
+                    break;
+                }
+                if (open > start) {
+                    parts.push_back({part_type::text,
+                                     std::string(text.substr(start,
+                                                             open - start))});
+                }
+
+                const std::size_t close = text.find('}', open);
+                if (close == std::string_view::npos) {
+                    fail(line, "unterminated placeholder");
+                }
+
+                const std::string_view name
+                        = text.substr(open + 1, close - open - 1);
+                if (name == "self") { parts.push_back({part_type::self, {}}); }
+                else if (name == "target") {
+                    parts.push_back({part_type::target, {}});
+                }
+                else if (name == "amount") {
+                    parts.push_back({part_type::amount, {}});
+                }
+                else {
+                    fail(line, std::format("unknown placeholder '{}'", name));
+                }
+
+                start = close + 1;
+            }
+
+            return parts;
+        }
+
+        /**
+         * Translates the statements of one definition into bytecode
+         */
+        class compiler {
+        public:
+            explicit compiler(effect_program& program): program_(program) {}
+
+            /**
+             * Compiles a statement
+             * @return Whether the definition continues after it
+             */
+            auto statement(const token_list& t, std::size_t line) -> bool;
+
+            /**
+             * Finishes the program
+             */
+            auto finish(std::size_t line) -> void;
+
+        private:
+            enum class block_type { if_block, else_block, choose, loop };
+
+            struct block {
+                block_type type;
+                std::size_t start;
+                std::vector<std::size_t> exits;
+                std::vector<std::size_t> skips;
+            };
+
+            auto emit(const op_code op, const std::int32_t index = 0,
+                      const double value = 0.0) -> std::size_t
+            {
+                program_.code.push_back({op, 0, index, value});
+                return program_.code.size() - 1;
+            }
+
+            /**
+             * Points a previously emitted jump at the next instruction
+             */
+            auto land(const std::size_t at) -> void
+            {
+                program_.code[at].jump = static_cast<std::int16_t>(
+                        program_.code.size() - (at + 1));
+            }
+
+            auto condition(const token_list& t, std::size_t& i,
+                           std::size_t line) -> void;
+            auto close_block(std::size_t line) -> void;
+
+            effect_program& program_;
+            std::vector<block> blocks_;
+        };
+
+        auto compiler::condition(const token_list& t, std::size_t& i,
+                                 const std::size_t line) -> void
+        {
+            bool negated = false;
+            if (t[i] == "not") {
+                negated = true;
+                if (++i == t.size()) { fail(line, "expected a condition"); }
+            }
+
+            if (t[i] == "roll") {
+                if (i + 1 == t.size()) { fail(line, "roll needs odds"); }
+                emit(op_code::roll, parse_int(t[++i], line));
+            }
+            else if (t[i] == "found") {
+                emit(op_code::found);
+            }
+            else if (t[i] == "has_effects") {
+                emit(op_code::has_effects);
+            }
+            else if (t[i] == "party") {
+                emit(op_code::has_party);
+            }
+            else {
+                fail(line, std::format("unknown condition '{}'", t[i]));
+            }
+
+            if (negated) { emit(op_code::negate); }
+            ++i;
+        }
+
+        auto compiler::close_block(const std::size_t line) -> void
+        {
+            if (blocks_.empty()) { fail(line, "'end' without a block"); }
+            block b = std::move(blocks_.back());
+            blocks_.pop_back();
+
+            if (b.type == block_type::loop) {
+                const std::size_t next = emit(op_code::for_each_next);
+                program_.code[next].jump = static_cast<std::int16_t>(
+                        static_cast<std::ptrdiff_t>(b.start)
+                        - static_cast<std::ptrdiff_t>(next));
+                land(b.start);
+                return;
+            }
+
+            for (const std::size_t at: b.skips) { land(at); }
+            for (const std::size_t at: b.exits) { land(at); }
+        }
+
+        auto compiler::statement(const token_list& t, const std::size_t line)
+                -> bool
+        {
+            const std::string& word = t[0];
+            const auto arg = [&](const std::size_t i) -> const std::string& {
+                if (i >= t.size()) {
+                    fail(line, std::format("'{}' is missing arguments", word));
+                }
+                return t[i];
+            };
+
+            if (word == "end") {
+                if (blocks_.empty()) { return false; }
+                close_block(line);
+            }
+            else if (word == "say") {
+                program_.messages.push_back(parse_message(arg(1), line));
+                emit(op_code::say,
+                     static_cast<std::int32_t>(program_.messages.size() - 1));
+            }
+            else if (word == "amount") {
+                const std::string& mode = arg(1);
+                if (mode == "max_health") {
+                    const scaled_value fraction = parse_scaled(arg(2), line);
+                    if (fraction.base != 0.0) {
+                        fail(line, "max_health amounts must be a multiple "
+                                   "of scale");
+                    }
+                    emit(op_code::amount_health, 0, fraction.factor);
+                }
+                else if (mode == "random") {
+                    program_.constants.push_back(parse_number(arg(3), line));
+                    emit(op_code::amount_random,
+                         static_cast<std::int32_t>(program_.constants.size()
+                                                   - 1),
+                         parse_number(arg(2), line));
+                }
+                else if (mode == "attack") {
+                    emit(op_code::amount_attack, 0, parse_number(arg(2), line));
+                }
+                else {
+                    const scaled_value value = parse_scaled(mode, line);
+                    program_.constants.push_back(value.base);
+                    emit(op_code::amount,
+                         static_cast<std::int32_t>(program_.constants.size()
+                                                   - 1),
+                         value.factor);
+                }
+            }
+            else if (word == "damage") {
+                emit(op_code::damage);
+            }
+            else if (word == "heal") {
+                emit(op_code::heal);
+            }
+            else if (word == "clear") {
+                emit(op_code::clear_effects);
+            }
+            else if (word == "effect") {
+                std::size_t kind = 0;
+                while (kind < effect_names.size()
+                       && effect_names[kind] != arg(1)) {
+                    ++kind;
+                }
+                if (kind == effect_names.size()) {
+                    fail(line, std::format("unknown effect '{}'", t[1]));
+                }
+                program_.effects.push_back({kind, parse_scaled(arg(2), line),
+                                            parse_scaled(arg(3), line)});
+                emit(op_code::add_effect,
+                     static_cast<std::int32_t>(program_.effects.size() - 1));
+            }
+            else if (word == "target") {
+                if (arg(1) == "player") { emit(op_code::target_player); }
+                else if (t[1] == "random_ally") {
+                    emit(op_code::target_random);
+                }
+                else {
+                    fail(line, std::format("unknown target '{}'", t[1]));
+                }
+            }
+            else if (word == "select") {
+                const std::string& how = arg(1);
+                if (how == "most_wounded") {
+                    emit(op_code::select_wounded, 0,
+                         parse_number(arg(2), line));
+                }
+                else if (how == "least_protected") {
+                    emit(op_code::select_unprotected);
+                }
+                else if (how == "weakest") {
+                    emit(op_code::select_weakest);
+                }
+                else if (how == "most_afflicted") {
+                    emit(op_code::select_afflicted);
+                }
+                else {
+                    fail(line, std::format("unknown selection '{}'", how));
+                }
+            }
+            else if (word == "if") {
+                block b{block_type::if_block, 0, {}, {}};
+                std::size_t i = 1;
+                while (true) {
+                    condition(t, i, line);
+                    b.skips.push_back(emit(op_code::jump_unless));
+                    if (i == t.size()) { break; }
+                    if (t[i] != "and") {
+                        fail(line, std::format("expected 'and', got '{}'",
+                                               t[i]));
+                    }
+                    if (++i == t.size()) { fail(line, "expected a condition"); }
+                }
+                blocks_.push_back(std::move(b));
+            }
+            else if (word == "else") {
+                if (blocks_.empty()
+                    || blocks_.back().type != block_type::if_block) {
+                    fail(line, "'else' without 'if'");
+                }
+                block& b = blocks_.back();
+                b.exits.push_back(emit(op_code::jump));
+                for (const std::size_t at: b.skips) { land(at); }
+                b.skips.clear();
+                b.type = block_type::else_block;
+            }
+            else if (word == "choose") {
+                emit(op_code::choose, parse_int(arg(1), line));
+                blocks_.push_back({block_type::choose, 0, {}, {}});
+            }
+            else if (word == "case") {
+                if (blocks_.empty()
+                    || blocks_.back().type != block_type::choose) {
+                    fail(line, "'case' outside of 'choose'");
+                }
+                block& b = blocks_.back();
+                if (!b.skips.empty()) {
+                    // Leave the previous case and make its skip land here
+                    b.exits.push_back(emit(op_code::jump));
+                    for (const std::size_t at: b.skips) { land(at); }
+                    b.skips.clear();
+                }
+                emit(op_code::is_choice, parse_int(arg(1), line));
+                b.skips.push_back(emit(op_code::jump_unless));
+            }
+            else if (word == "for_each_ally") {
+                for (const auto& b: blocks_) {
+                    if (b.type == block_type::loop) {
+                        fail(line, "loops cannot be nested");
+                    }
+                }
+                blocks_.push_back({block_type::loop,
+                                   emit(op_code::for_each_begin), {}, {}});
+            }
+            else {
+                fail(line, std::format("unknown statement '{}'", word));
+            }
+
+            return true;
+        }
+
+        auto compiler::finish(const std::size_t line) -> void
+        {
+            if (!blocks_.empty()) { fail(line, "unclosed block"); }
+            if (program_.code.size() >= INT16_MAX) {
+                fail(line, "definition is too long");
+            }
+            emit(op_code::end);
+        }
+
+        auto parse_stats(const token_list& t, const std::size_t line)
+                -> enemy_stat_formula
+        {
+            if (t.size() != 9 || t[0] != "stats") {
+                fail(line, "enemies need a 'stats' line with 8 values");
+            }
+            return {parse_int(t[1], line),    parse_int(t[2], line),
+                    parse_number(t[3], line), parse_number(t[4], line),
+                    parse_int(t[5], line),    parse_int(t[6], line),
+                    parse_number(t[7], line), parse_number(t[8], line)};
+        }
+
+        const content_library* active_library = nullptr;
+
+    } // namespace
+
+    auto content_library::load(const std::string& path) -> content_library
+    {
+        std::ifstream file(path);
+        if (!file) {
+            throw std::runtime_error(
+                    std::format("could not open content file {}", path));
+        }
+
+        std::stringstream ss;
+        ss << file.rdbuf();
+        return parse(ss.str());
+    }
+
+    auto content_library::parse(const std::string_view source)
+            -> content_library
+    {
+        content_library library;
+        library.source_hash_ = hash_name(source);
+        effect_program* program = nullptr;
+        std::vector<compiler> current;
+        bool needs_stats = false;
+
+        std::size_t line_number = 0;
+        std::size_t start = 0;
+        while (start <= source.size()) {
+            std::size_t newline = source.find('\n', start);
+            if (newline == std::string_view::npos) { newline = source.size(); }
+            const std::string_view line
+                    = source.substr(start, newline - start);
+            start = newline + 1;
+            ++line_number;
+
+            const token_list t = tokenize(line, line_number);
+            if (t.empty()) { continue; }
+
+            if (program == nullptr) {
+                if (t.size() != 3
+                    || (t[0] != "ingredient" && t[0] != "enemy")) {
+                    fail(line_number, "expected 'ingredient <id> <element>' "
+                                      "or 'enemy <id> <element>'");
+                }
+
+                const element_type element = parse_element(t[2], line_number);
+                if (t[0] == "ingredient") {
+                    library.ingredients_.push_back({t[1], element, {}});
+                    program = &library.ingredients_.back().program;
+                }
+                else {
+                    library.enemies_.push_back({t[1], element, {}, {}});
+                    program = &library.enemies_.back().program;
+                    needs_stats = true;
+                }
+                current.emplace_back(*program);
+                continue;
+            }
+
+            if (needs_stats) {
+                library.enemies_.back().stats = parse_stats(t, line_number);
+                needs_stats = false;
+                continue;
+            }
+
+            if (!current.back().statement(t, line_number)) {
+                current.back().finish(line_number);
+                current.clear();
+                program = nullptr;
+            }
+        }
+
+        if (program != nullptr) {
+            fail(line_number, "definition is missing its 'end'");
+        }
+
+        return library;
+    }
+
+    auto content_library::ingredients() const
+            -> const std::vector<ingredient_definition>&
+    {
+        return ingredients_;
+    }
+
+    auto content_library::enemies() const
+            -> const std::vector<enemy_definition>&
+    {
+        return enemies_;
+    }
+
+    auto content_library::source_hash() const -> std::uint64_t
+    {
+        return source_hash_;
+    }
+
+    auto content_library::create_ingredient(const std::size_t type,
+                                            std::string name,
+                                            const std::int32_t potency) const
+            -> ingredient*
+    {
+        return new scripted_ingredient(std::move(name), potency,
+                                       ingredients_.at(type));
+    }
+
+    auto content_library::create_enemy(const std::size_t type,
+                                       std::string name,
+                                       const std::int32_t level,
+                                       const enemy_rolls rolls) const -> enemy*
+    {
+        return new scripted_enemy(std::move(name), level, rolls,
+                                  enemies_.at(type));
+    }
+
+    scripted_ingredient::scripted_ingredient(
+            std::string name, const std::int32_t potency,
+            const ingredient_definition& definition)
+        : ingredient(std::move(name), definition.element, potency),
+          definition_(&definition)
+    {}
+
+    auto scripted_ingredient::on_applied(entity& e) -> void
+    {
+        run_effect_program(definition_->program,
+                           {name_, potency_, nullptr, &e, &e, nullptr});
+    }
+
+    auto scripted_ingredient::compile(potion_program& program) -> void
+    {
+        program.compile_script(definition_->program, name_,
+                               program.potency(potency_));
+    }
+
+    auto scripted_ingredient::expected_value() const -> double
+    {
+        potion_program program;
+        program.compile_script(definition_->program, name_, potency_);
+        return program.expected_damage(reference_max_health)
+                .value_or(ingredient::expected_value());
+    }
+
+    auto scripted_ingredient::definition() const
+            -> const ingredient_definition&
+    {
+        return *definition_;
+    }
+
+    scripted_enemy::scripted_enemy(std::string name, const std::int32_t level,
+                                   const enemy_rolls rolls,
+                                   const enemy_definition& definition)
+        : enemy(std::move(name), definition.element, level,
+                definition.stats.max_health(level, rolls.health),
+                definition.stats.damage(level, rolls.damage)),
+          definition_(&definition),
+          reads_state_(reads_battle_state(definition.program))
+    {}
+
+    auto scripted_enemy::act(player& p, enemy_party& party) -> void
+    {
+        run_effect_program(definition_->program,
+                           {name_, level_, this, &p, &p, &party});
+    }
+
+    auto scripted_enemy::plan(player& p,
+                              const enemy_party& party) const
+            -> enemy_intent
+    {
+        enemy_intent intent;
+        if (reads_state_) {
+            intent.deferred = true;
+            return intent;
+        }
+        plan_effect_program(definition_->program,
+                            {name_, level_, this, &p, &p, &party}, intent);
+        return intent;
+    }
+
+    auto scripted_enemy::definition() const -> const enemy_definition&
+    {
+        return *definition_;
+    }
+
+    auto set_active_content(const content_library* library) -> void
+    {
+        active_library = library;
+    }
+
+    auto active_content() -> const content_library*
+    {
+        return active_library;
+    }
+
+} // namespace potmaker
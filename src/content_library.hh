@@ -0,0 +1,175 @@
+#ifndef CONTENT_LIBRARY_HH
+#define CONTENT_LIBRARY_HH
+#include "effect_program.hh"
+#include "element_type.hh"
+#include "entity.hh"
+#include "ingredient.hh"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace potmaker {
+
+    /**
+     * An ingredient type loaded from a content file
+     */
+    struct ingredient_definition {
+        std::string id;
+        element_type element;
+        effect_program program;
+    };
+
+    /**
+     * An enemy type loaded from a content file
+     */
+    struct enemy_definition {
+        std::string id;
+        element_type element;
+        enemy_stat_formula stats;
+        effect_program program;
+    };
+
+    /**
+     * A set of ingredient and enemy types described in a text file and
+     * compiled to effect programs when loaded. See resources/content.potmk
+     * for the format and the built-in types written in it
+     */
+    class content_library {
+    public:
+        /**
+         * Reads and compiles a content file
+         * @param path The file's location
+         * @return The compiled library
+         * @throws std::runtime_error If the file is missing or malformed
+         */
+        static auto load(const std::string& path) -> content_library;
+
+        /**
+         * Compiles content definitions
+         * @param source The definitions
+         * @return The compiled library
+         * @throws std::runtime_error If the definitions are malformed
+         */
+        static auto parse(std::string_view source) -> content_library;
+
+        /**
+         * @return The ingredient types in this library
+         */
+        [[nodiscard]] auto ingredients() const
+                -> const std::vector<ingredient_definition>&;
+
+        /**
+         * @return The enemy types in this library
+         */
+        [[nodiscard]] auto enemies() const
+                -> const std::vector<enemy_definition>&;
+
+        /**
+         * @return A hash of the definitions this library was compiled from,
+         * the same on every build
+         */
+        [[nodiscard]] auto source_hash() const -> std::uint64_t;
+
+        /**
+         * Allocates an ingredient of one of this library's types
+         * @param type The index of the type within ingredients()
+         * @param name The name of the ingredient
+         * @param potency The potency of the ingredient
+         * @return The new ingredient
+         */
+        [[nodiscard]] auto create_ingredient(std::size_t type,
+                                             std::string name,
+                                             std::int32_t potency) const
+                -> ingredient*;
+
+        /**
+         * Allocates an enemy of one of this library's types
+         * @param type The index of the type within enemies()
+         * @param name The name of the enemy
+         * @param level The level of the enemy
+         * @param rolls Where the enemy's stats land within their ranges
+         * @return The new enemy
+         */
+        [[nodiscard]] auto create_enemy(std::size_t type, std::string name,
+                                        std::int32_t level,
+                                        enemy_rolls rolls) const -> enemy*;
+
+    private:
+        std::vector<ingredient_definition> ingredients_;
+        std::vector<enemy_definition> enemies_;
+        std::uint64_t source_hash_ = 0;
+    };
+
+    /**
+     * An ingredient whose behaviour is an effect program
+     */
+    class scripted_ingredient final : public ingredient {
+    public:
+        scripted_ingredient(std::string name, std::int32_t potency,
+                            const ingredient_definition& definition);
+        auto on_applied(entity& e) -> void override;
+        auto compile(potion_program& program) -> void override;
+
+        /**
+         * Values the ingredient the way the built-in ones are valued, by
+         * what its compiled program does on average. Programs that cannot
+         * be compiled to plain operations are valued like any ingredient
+         */
+        [[nodiscard]] auto expected_value() const -> double override;
+
+        /**
+         * @return The type this ingredient was created from
+         */
+        [[nodiscard]] auto definition() const -> const ingredient_definition&;
+
+    private:
+        const ingredient_definition* definition_;
+    };
+
+    /**
+     * An enemy whose behaviour is an effect program
+     */
+    class scripted_enemy final : public enemy {
+    public:
+        scripted_enemy(std::string name, std::int32_t level,
+                       enemy_rolls rolls, const enemy_definition& definition);
+        auto act(player& p, enemy_party& party) -> void override;
+
+        /**
+         * Plans like a built-in enemy, unless the enemy's program reads
+         * state that others change during the turn. Such enemies defer to
+         * act, which runs the program against the battle as it is then
+         */
+        [[nodiscard]] auto plan(player& p,
+                                const enemy_party& party) const
+                -> enemy_intent override;
+
+        /**
+         * @return The type this enemy was created from
+         */
+        [[nodiscard]] auto definition() const -> const enemy_definition&;
+
+    private:
+        const enemy_definition* definition_;
+        // Whether the program reads_battle_state
+        bool reads_state_;
+    };
+
+    /**
+     * Makes the game's factories create types from a content library instead
+     * of the built-in ones
+     * @param library The library, or nullptr to go back to the built-in
+     * types. Must outlive its use
+     */
+    auto set_active_content(const content_library* library) -> void;
+
+    /**
+     * @return The library the game's factories draw from, if any
+     */
+    [[nodiscard]] auto active_content() -> const content_library*;
+
+} // namespace potmaker
+
+#endif // CONTENT_LIBRARY_HH
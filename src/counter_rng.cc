@@ -0,0 +1,83 @@
+#include "counter_rng.hh"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace potmaker {
+
+    namespace {
+
+        constexpr std::uint32_t philox_m0 = 0xD2511F53;
+        constexpr std::uint32_t philox_m1 = 0xCD9E8D57;
+        constexpr std::uint32_t philox_w0 = 0x9E3779B9;
+        constexpr std::uint32_t philox_w1 = 0xBB67AE85;
+
+        constexpr auto mulhilo(const std::uint32_t a, const std::uint32_t b,
+                               std::uint32_t& hi) -> std::uint32_t
+        {
+            const std::uint64_t product = static_cast<std::uint64_t>(a) * b;
+            hi = static_cast<std::uint32_t>(product >> 32);
+            return static_cast<std::uint32_t>(product);
+        }
+
+    } // namespace
+
+    auto philox4x32(std::array<std::uint32_t, 4> counter,
+                    std::array<std::uint32_t, 2> key)
+            -> std::array<std::uint32_t, 4>
+    {
+        for (int round = 0; round < 10; ++round) {
+            std::uint32_t hi0 = 0;
+            std::uint32_t hi1 = 0;
+            const std::uint32_t lo0 = mulhilo(philox_m0, counter[0], hi0);
+            const std::uint32_t lo1 = mulhilo(philox_m1, counter[2], hi1);
+
+            counter = {hi1 ^ counter[1] ^ key[0], lo1,
+                       hi0 ^ counter[3] ^ key[1], lo0};
+
+            key[0] += philox_w0;
+            key[1] += philox_w1;
+        }
+        return counter;
+    }
+
+    counter_stream::counter_stream(const stream_key& key)
+        : key_{static_cast<std::uint32_t>(key.run),
+               static_cast<std::uint32_t>(key.run >> 32)},
+          counter_{0, key.slot, key.turn, key.stage}
+    {}
+
+    auto counter_stream::next() -> std::uint64_t
+    {
+        // Each block yields two values; the first word of the counter is the
+        // block index within this stream
+        if (draws_ % 2 == 0) {
+            counter_[0] = static_cast<std::uint32_t>(draws_ / 2);
+            block_ = philox4x32(counter_, key_);
+        }
+
+        const std::size_t half = (draws_ % 2) * 2;
+        ++draws_;
+        return (static_cast<std::uint64_t>(block_[half]) << 32)
+               | block_[half + 1];
+    }
+
+    auto counter_stream::fill_ints(const std::span<int> out, const int min,
+                                   const int max) -> void
+    {
+        for (int& value: out) { value = int_in(min, max); }
+    }
+
+    auto counter_stream::draws() const -> std::uint64_t
+    {
+        return draws_;
+    }
+
+    auto counter_stream::key() const -> stream_key
+    {
+        return {key_[0] | static_cast<std::uint64_t>(key_[1]) << 32,
+                counter_[3], counter_[2], counter_[1]};
+    }
+
+} // namespace potmaker
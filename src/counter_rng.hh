@@ -0,0 +1,106 @@
+#ifndef COUNTER_RNG_HH
+#define COUNTER_RNG_HH
+#include "random_buffer.hh"
+#include <array>
+#include <cstdint>
+#include <span>
+
+namespace potmaker {
+
+    /**
+     * Identifies an independent random stream within a run. Every draw is a
+     * pure function of this key and the draw's index, so the values one
+     * entity sees never depend on what other entities rolled before it
+     */
+    struct stream_key {
+        std::uint64_t run;
+        std::uint32_t stage;
+        std::uint32_t turn;
+        std::uint32_t slot;
+    };
+
+    /**
+     * Philox4x32-10 block function
+     * @param counter The 128-bit counter
+     * @param key The 64-bit key
+     * @return Four random words
+     */
+    [[nodiscard]] auto philox4x32(std::array<std::uint32_t, 4> counter,
+                                  std::array<std::uint32_t, 2> key)
+            -> std::array<std::uint32_t, 4>;
+
+    /**
+     * A counter-based random stream. The run id is the Philox key and the
+     * stage, turn, slot and draw index make up the counter
+     */
+    class counter_stream {
+    public:
+        /**
+         * Opens the stream for a key, starting at its first draw
+         * @param key The key
+         */
+        explicit counter_stream(const stream_key& key);
+
+        /**
+         * @return The next raw 64-bit value
+         */
+        auto next() -> std::uint64_t;
+
+        /**
+         * Generates a random int in the [min, max] range
+         * @param min The min value
+         * @param max The max value
+         * @return A random int in [min, max]
+         */
+        auto int_in(const int min, const int max) -> int
+        {
+            return detail::int_in(*this, min, max);
+        }
+
+        /**
+         * Generates a random double in the [min, max) range
+         * @param min The min value
+         * @param max The max value
+         * @return A random double in [min, max)
+         */
+        auto double_in(const double min, const double max) -> double
+        {
+            return min + (max - min) * detail::to_unit_double(next());
+        }
+
+        /**
+         * Random chance generation. Like a die roll
+         * @param odds The denominator of the odds
+         * @return If a 1/odds chance lands
+         */
+        auto roll(const int odds) -> bool { return int_in(1, odds) == 1; }
+
+        /**
+         * Fills a range with random ints in the [min, max] range, drawing
+         * exactly what as many int_in calls would
+         * @param out The destination
+         * @param min The min value
+         * @param max The max value
+         */
+        auto fill_ints(std::span<int> out, int min, int max) -> void;
+
+        /**
+         * @return How many raw values have been drawn from this stream
+         */
+        [[nodiscard]] auto draws() const -> std::uint64_t;
+
+        /**
+         * @return The key the stream was opened with
+         */
+        [[nodiscard]] auto key() const -> stream_key;
+
+    private:
+        std::array<std::uint32_t, 2> key_;
+        std::array<std::uint32_t, 4> counter_;
+        std::array<std::uint32_t, 4> block_{};
+        std::uint64_t draws_ = 0;
+    };
+
+} // namespace potmaker
+
+#endif // COUNTER_RNG_HH
@@ -0,0 +1,303 @@
+#include "effect_program.hh"
+#include "entity.hh"
+#include "status_effect.hh"
+#include "util.hh"
+#include <algorithm>
+#include <climits>
+#include <cstddef>
+#include <format>
+#include <string>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace potmaker {
+
+    namespace {
+
+        auto render(const std::vector<message_part>& parts,
+                    const effect_context& ctx, const combat_value amount)
+                -> std::string
+        {
+            std::string out;
+            for (const auto& part: parts) {
+                switch (part.type) {
+                case message_part::part_type::text:
+                    out += part.text;
+                    break;
+                case message_part::part_type::self:
+                    out += ctx.self_name;
+                    break;
+                case message_part::part_type::target:
+                    out += ctx.target->name();
+                    break;
+                case message_part::part_type::amount:
+                    out += std::format("{:.1f}", amount);
+                    break;
+                }
+            }
+            return out;
+        }
+
+        template<typename effect_t>
+        auto total_potency(entity& e) -> int
+        {
+            int total = 0;
+            for (auto& effect: e.status_effects()) {
+                if (std::holds_alternative<effect_t>(effect)) {
+                    total += std::get<effect_t>(effect).potency();
+                }
+            }
+            return total;
+        }
+
+        auto negative_effects(entity& e) -> int
+        {
+            int count = 0;
+            for (auto& effect: e.status_effects()) {
+                if (std::holds_alternative<burning>(effect)
+                    || std::holds_alternative<freezing>(effect)
+                    || std::holds_alternative<poison>(effect)
+                    || std::holds_alternative<wither>(effect)) {
+                    count++;
+                }
+            }
+            return count;
+        }
+
+        /**
+         * Picks the ally (anyone in the party but self) with the lowest
+         * score. Ties keep the earliest ally
+         */
+        template<typename score_fn>
+        auto select_min(const effect_context& ctx, int best, score_fn&& score)
+                -> enemy*
+        {
+            enemy* selected = nullptr;
+            for (auto* ally: *ctx.party) {
+                if (ally == ctx.self) { continue; }
+                const int value = score(*ally);
+                if (value < best) {
+                    best = value;
+                    selected = ally;
+                }
+            }
+            return selected;
+        }
+
+        /**
+         * Makes a program's changes to the battle as it asks for them. It
+         * has the interface of enemy_intent, which records them instead
+         */
+        struct battle_changes {
+            static auto say(const std::string& message) -> void
+            {
+                print_action(message);
+            }
+
+            static auto modify_health(entity* target,
+                                      const combat_value amount) -> void
+            {
+                target->modify_health(amount);
+            }
+
+            static auto add_effect(entity* target,
+                                   status_effect_variant&& effect) -> void
+            {
+                target->add_status_effect(std::move(effect));
+            }
+
+            static auto clear_effects(entity* target) -> void
+            {
+                target->clear_status_effects();
+            }
+        };
+
+        /**
+         * Runs a program to completion, handing each change it makes to
+         * changes
+         */
+        template<typename changes_t>
+        auto run(const effect_program& program, effect_context ctx,
+                 changes_t& changes) -> void
+        {
+            combat_value amount = 0.0;
+            bool flag = false;
+            bool found = false;
+            int choice = 0;
+            std::size_t loop_index = 0;
+
+            const instruction* pc = program.code.data();
+            while (true) {
+                const instruction& in = *pc++;
+
+                switch (in.op) {
+                case op_code::end:
+                    return;
+                case op_code::say:
+                    // Nothing would print the message
+                    if (output_quiet()) { break; }
+                    changes.say(render(program.messages[in.index], ctx,
+                                       amount));
+                    break;
+                case op_code::amount:
+                    amount = program.constants[in.index]
+                             + combat_value(in.value) * ctx.scale;
+                    break;
+                case op_code::amount_health:
+                    amount = (combat_value(in.value) * ctx.scale)
+                             * ctx.target->max_health();
+                    break;
+                case op_code::amount_random:
+                    amount = combat_value(random_double(
+                                     in.value, program.constants[in.index]))
+                             * ctx.scale;
+                    break;
+                case op_code::amount_attack:
+                    amount = ctx.self->damage() * in.value;
+                    break;
+                case op_code::damage:
+                    changes.modify_health(ctx.target, -amount);
+                    break;
+                case op_code::heal:
+                    changes.modify_health(ctx.target, amount);
+                    break;
+                case op_code::add_effect: {
+                    const effect_spec& spec = program.effects[in.index];
+                    changes.add_effect(
+                            ctx.target,
+                            make_status_effect(
+                                    spec.kind,
+                                    static_cast<int>(spec.turns.at(ctx.scale)),
+                                    static_cast<int>(
+                                            spec.potency.at(ctx.scale))));
+                } break;
+                case op_code::clear_effects:
+                    changes.clear_effects(ctx.target);
+                    break;
+                case op_code::roll:
+                    flag = roll_chances(in.index);
+                    break;
+                case op_code::negate:
+                    flag = !flag;
+                    break;
+                case op_code::has_effects:
+                    flag = !ctx.target->status_effects().empty();
+                    break;
+                case op_code::has_party:
+                    flag = !ctx.party->empty();
+                    break;
+                case op_code::found:
+                    flag = found;
+                    break;
+                case op_code::choose:
+                    choice = random_int(1, in.index);
+                    break;
+                case op_code::is_choice:
+                    flag = choice == in.index;
+                    break;
+                case op_code::jump:
+                    pc += in.jump;
+                    break;
+                case op_code::jump_unless:
+                    if (!flag) { pc += in.jump; }
+                    break;
+                case op_code::target_player:
+                    ctx.target = ctx.opponent;
+                    break;
+                case op_code::target_random: {
+                    // With no one to pick, the target stays as it was
+                    if (ctx.party->empty()) { break; }
+                    const int last = static_cast<int>(ctx.party->size()) - 1;
+                    ctx.target = (*ctx.party)[random_int(0, last)];
+                } break;
+                case op_code::select_wounded: {
+                    // Health ratios are fractions, so this one does not go
+                    // through select_min
+                    enemy* most_wounded = nullptr;
+                    combat_value lowest_health = 1.0;
+                    for (auto* ally: *ctx.party) {
+                        if (ally == ctx.self) { continue; }
+                        const combat_value health_percent
+                                = ally->health_fraction();
+                        if (health_percent < lowest_health) {
+                            lowest_health = health_percent;
+                            most_wounded = ally;
+                        }
+                    }
+                    found = flag = most_wounded != nullptr
+                                   && lowest_health < in.value;
+                    if (found) { ctx.target = most_wounded; }
+                } break;
+                case op_code::select_unprotected: {
+                    enemy* selected = select_min(ctx, INT_MAX, [](entity& e) {
+                        return total_potency<protection>(e);
+                    });
+                    found = flag = selected != nullptr;
+                    if (found) { ctx.target = selected; }
+                } break;
+                case op_code::select_weakest: {
+                    enemy* selected = select_min(ctx, INT_MAX, [](entity& e) {
+                        return total_potency<strength>(e);
+                    });
+                    found = flag = selected != nullptr;
+                    if (found) { ctx.target = selected; }
+                } break;
+                case op_code::select_afflicted: {
+                    // The most afflicted ally has the lowest negated count
+                    enemy* selected = select_min(ctx, 0, [](entity& e) {
+                        return -negative_effects(e);
+                    });
+                    found = flag = selected != nullptr;
+                    if (found) { ctx.target = selected; }
+                } break;
+                case op_code::for_each_begin:
+                    if (ctx.party->empty()) { pc += in.jump; }
+                    else {
+                        loop_index = 0;
+                        ctx.target = (*ctx.party)[0];
+                    }
+                    break;
+                case op_code::for_each_next:
+                    if (++loop_index < ctx.party->size()) {
+                        ctx.target = (*ctx.party)[loop_index];
+                        pc += in.jump;
+                    }
+                    break;
+                }
+            }
+        }
+
+    } // namespace
+
+    auto run_effect_program(const effect_program& program,
+                            const effect_context ctx) -> void
+    {
+        battle_changes changes;
+        run(program, ctx, changes);
+    }
+
+    auto plan_effect_program(const effect_program& program,
+                             const effect_context ctx, enemy_intent& intent)
+            -> void
+    {
+        run(program, ctx, intent);
+    }
+
+    auto reads_battle_state(const effect_program& program) -> bool
+    {
+        return std::ranges::any_of(program.code, [](const instruction& in) {
+            switch (in.op) {
+            case op_code::has_effects:
+            case op_code::select_wounded:
+            case op_code::select_unprotected:
+            case op_code::select_weakest:
+            case op_code::select_afflicted:
+                return true;
+            default:
+                return false;
+            }
+        });
+    }
+
+} // namespace potmaker
@@ -0,0 +1,151 @@
+#ifndef EFFECT_PROGRAM_HH
+#define EFFECT_PROGRAM_HH
+#include "small_vector.hh"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace potmaker {
+
+    class entity;
+    class enemy;
+    struct enemy_intent;
+
+    using enemy_party = small_vector<enemy*, 8>;
+
+    /**
+     * The operations understood by the effect interpreter. Most of them work
+     * on three registers: the current target, the amount and a condition flag
+     */
+    enum class op_code : std::uint8_t {
+        end,
+        say, // Print messages[index]
+        amount, // amount = constants[index] + value * scale
+        amount_health, // amount = (value * scale) * target's max health
+        amount_random, // amount = random(value, constants[index]) * scale
+        amount_attack, // amount = self's damage * value
+        damage, // target loses amount
+        heal, // target gains amount
+        add_effect, // target gains effects[index]
+        clear_effects, // target loses all of its effects
+        roll, // flag = whether a 1/index chance lands
+        negate, // flag = !flag
+        has_effects, // flag = whether target has any effect
+        has_party, // flag = whether the party is not empty
+        found, // flag = whether the last selection found an ally
+        choose, // choice = random int in [1, index]
+        is_choice, // flag = choice == index
+        jump, // pc += jump
+        jump_unless, // if !flag, pc += jump
+        target_player, // target = the opponent
+        target_random, // target = random party member, if there is one
+        select_wounded, // target = most wounded ally below value, flag = found
+        select_unprotected, // target = least protected ally, flag = found
+        select_weakest, // target = ally with least strength, flag = found
+        select_afflicted, // target = most afflicted ally, flag = found
+        for_each_begin, // target = first party member, or skip the loop
+        for_each_next // target = next party member, or leave the loop
+    };
+
+    /**
+     * A single bytecode instruction. Operands that do not fit are stored in
+     * the program's side tables and referenced by index
+     */
+    struct instruction {
+        op_code op;
+        std::int16_t jump;
+        std::int32_t index;
+        double value;
+    };
+
+    static_assert(sizeof(instruction) == 16);
+
+    /**
+     * A linear function of the program's scale (an ingredient's potency or
+     * an enemy's level)
+     */
+    struct scaled_value {
+        double base;
+        double factor;
+
+        [[nodiscard]] constexpr auto at(const int scale) const -> double
+        {
+            return base + factor * scale;
+        }
+    };
+
+    /**
+     * A status effect to construct, with turns and potency that depend on
+     * the program's scale
+     */
+    struct effect_spec {
+        std::size_t kind;
+        scaled_value turns;
+        scaled_value potency;
+    };
+
+    /**
+     * A piece of a message template. Either literal text or one of the
+     * {self}, {target} and {amount} placeholders
+     */
+    struct message_part {
+        enum class part_type : std::uint8_t { text, self, target, amount };
+        part_type type;
+        std::string text;
+    };
+
+    /**
+     * A compiled effect script
+     */
+    struct effect_program {
+        std::vector<instruction> code;
+        std::vector<effect_spec> effects;
+        std::vector<std::vector<message_part>> messages;
+        std::vector<double> constants;
+    };
+
+    /**
+     * Everything an effect program can read and modify while it runs
+     */
+    struct effect_context {
+        std::string_view self_name;
+        int scale;
+        const entity* self;
+        entity* target;
+        entity* opponent;
+        const enemy_party* party;
+    };
+
+    /**
+     * Runs a compiled effect program to completion
+     * @param program The program
+     * @param ctx The entities the program acts upon
+     */
+    auto run_effect_program(const effect_program& program, effect_context ctx)
+            -> void;
+
+    /**
+     * Runs a compiled effect program without touching the battle, recording
+     * the changes it would make instead. Carrying them out later has the
+     * same result as running the program then, unless it reads_battle_state
+     * @param program The program
+     * @param ctx The entities the program acts upon
+     * @param intent Where the changes are added
+     */
+    auto plan_effect_program(const effect_program& program,
+                             effect_context ctx, enemy_intent& intent)
+            -> void;
+
+    /**
+     * @param program A compiled effect program
+     * @return Whether the program looks at status effects or at its allies'
+     * health, which change while a turn is played
+     */
+    [[nodiscard]] auto reads_battle_state(const effect_program& program)
+            -> bool;
+
+} // namespace potmaker
+
+#endif // EFFECT_PROGRAM_HH
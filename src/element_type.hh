@@ -39,6 +39,8 @@ element_type_to_str(const element_type type) noexcept -> std::string_view
         return "Strengthening";
     case element_type::purifying:
         return "Purifying";
+    case element_type::chaotic:
+        return "Chaotic";
     case element_type::boring:
         return "Boring";
     default:;
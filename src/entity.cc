@@ -1,83 +1,175 @@
 #include "entity.hh"
+#include "balance.hh"
 #include "status_effect.hh"
 #include "util.hh"
+#include <algorithm>
+#include <bit>
 #include <climits>
 #include <cmath>
+#include <cstddef>
 #include <cstdint>
 #include <format>
 #include <string>
+#include <type_traits>
 #include <utility>
 #include <variant>
 #include <vector>
 
 namespace potmaker {
     entity::entity(std::string name, const element_type element,
-                   const double max_health, const double damage)
-        : named(std::move(name)), element_(element), max_health_(max_health),
-          health_(max_health), damage_(damage), skips_turn_(false)
+                   const combat_value max_health, const combat_value damage)
+        : named(std::move(name)),
+          identity_hash_(hash_key(
+                  hash_part::identity,
+                  hash_name(this->name()) ^ static_cast<std::uint64_t>(element),
+                  static_cast<std::uint64_t>(whole_part(max_health)) << 32
+                          ^ static_cast<std::uint64_t>(whole_part(damage)))),
+          element_(element), max_health_(max_health), health_(max_health),
+          damage_(damage), skips_turn_(false)
     {}
 
     auto entity::tick() -> void
     {
-        for (auto it = status_effects_.begin(); it != status_effects_.end();) {
-            try {
-                if (it->valueless_by_exception()) {
-                    it = status_effects_.erase(it);
-                    continue;
-                }
+        const auto expired = effect_timers_.advance();
 
-                std::visit(
-                        [this](auto&& effect) {
-                            const double damage
-                                    = effect.total_damage_per_turn();
-                            this->modify_health(damage);
-                            effect.tick();
-                        },
-                        *it);
-
-                const bool should_remove = std::visit(
-                        [](const auto& effect) {
-                            return effect.turns_left() <= 0;
-                        },
-                        *it);
+        // Effects apply their damage in the order they were received
+        for (std::size_t i = 0; i < damage_count_; ++i) {
+            modify_health(damage_per_turn_[damage_order_[i]]);
+        }
 
-                if (should_remove) { it = status_effects_.erase(it); }
-                else {
-                    ++it;
-                }
+        if (expired != 0) {
+            erase_if(status_effects_, [expired](const auto& effect) {
+                return (expired >> effect.index() & 1) != 0;
+            });
+            if ((damaging_effects_ & expired) != 0) {
+                damaging_effects_ &= ~expired;
+                order_damage();
             }
-            catch (const std::bad_variant_access& e) {
-                it = status_effects_.erase(it);
+            for (auto pending = expired; pending != 0; pending &= pending - 1) {
+                const auto kind
+                        = static_cast<std::size_t>(std::countr_zero(pending));
+                effects_hash_ ^= effect_hashes_[kind];
+                effect_hashes_[kind] = 0;
             }
         }
     }
 
-    auto entity::modify_health(const double amount) -> void
+    auto entity::sync_effect(status_effect_variant& effect) -> void
+    {
+        const std::size_t kind = effect.index();
+        const std::uint32_t now = effect_timers_.now();
+        const auto elapsed = static_cast<int>(now - synced_at_[kind]);
+        if (elapsed != 0) {
+            std::visit([elapsed](auto& e) { e.tick(elapsed); }, effect);
+        }
+        synced_at_[kind] = now;
+    }
+
+    auto entity::schedule_effect(const status_effect_variant& effect) -> void
+    {
+        const std::size_t kind = effect.index();
+
+        // An effect goes away on the first tick that leaves it with no
+        // turns, and every effect sees at least one tick
+        const int turns = std::visit(
+                [](const auto& e) { return e.turns_left(); }, effect);
+        const std::uint32_t expiry
+                = synced_at_[kind]
+                  + static_cast<std::uint32_t>(std::max(turns, 1));
+        effect_timers_.schedule(kind, expiry);
+
+        const int potency = std::visit(
+                [](const auto& e) { return e.potency(); }, effect);
+        effects_hash_ ^= effect_hashes_[kind];
+        effect_hashes_[kind]
+                = hash_key(hash_part::effect,
+                           kind << 32 | static_cast<std::uint32_t>(potency),
+                           expiry);
+        effects_hash_ ^= effect_hashes_[kind];
+
+        damage_per_turn_[kind] = std::visit(
+                [](const auto& e) { return e.total_damage_per_turn(); },
+                effect);
+        if (damage_per_turn_[kind] != 0) {
+            damaging_effects_ |= std::uint32_t{1} << kind;
+        }
+        else {
+            damaging_effects_ &= ~(std::uint32_t{1} << kind);
+        }
+    }
+
+    auto entity::order_damage() -> void
+    {
+        damage_count_ = 0;
+        for (const auto& effect: status_effects_) {
+            if ((damaging_effects_ >> effect.index() & 1) != 0) {
+                damage_order_[damage_count_++]
+                        = static_cast<std::uint8_t>(effect.index());
+            }
+        }
+    }
+
+    auto entity::modify_health(const combat_value amount) -> void
     {
         health_ += amount;
     }
 
     auto entity::add_status_effect(status_effect_variant&& effect) -> void
     {
-        if (!effect.valueless_by_exception()) {
-            status_effects_.emplace_back(std::move(effect));
+        if (effect.valueless_by_exception()) { return; }
+        const std::uint32_t was_damaging = damaging_effects_;
+
+        // Keep a single effect per kind so that the list stays bounded
+        for (auto& existing: status_effects_) {
+            if (existing.index() == effect.index()) {
+                const stacking_policy policy
+                        = stacking_policy_of(effect.index());
+                sync_effect(existing);
+                std::visit(
+                        [&effect, policy](auto& current) {
+                            using effect_t = std::decay_t<decltype(current)>;
+                            current.stack(std::get<effect_t>(effect), policy);
+                        },
+                        existing);
+                schedule_effect(existing);
+                if (damaging_effects_ != was_damaging) { order_damage(); }
+                return;
+            }
         }
+
+        synced_at_[effect.index()] = effect_timers_.now();
+        schedule_effect(effect);
+        status_effects_.emplace_back(std::move(effect));
+        if (damaging_effects_ != was_damaging) { order_damage(); }
     }
 
     auto entity::clear_status_effects() -> void
     {
         status_effects_.clear();
+        effect_timers_.cancel_all();
+        damaging_effects_ = 0;
+        damage_count_ = 0;
+        effect_hashes_.fill(0);
+        effects_hash_ = 0;
     }
 
-    [[nodiscard]] auto entity::max_health() const -> double
+    [[nodiscard]] auto entity::max_health() const -> combat_value
     {
         return max_health_;
     }
-    [[nodiscard]] auto entity::health() const -> double
+    [[nodiscard]] auto entity::health() const -> combat_value
     {
         return health_;
     }
-    [[nodiscard]] auto entity::damage() const -> double
+    [[nodiscard]] auto entity::health_fraction() const -> combat_value
+    {
+        // Doubles would give NaN, which compares as unwounded, and
+        // fixed-point division by zero would saturate; both builds agree
+        // on 1
+        if (max_health_ <= 0) { return 1; }
+        return health_ / max_health_;
+    }
+    [[nodiscard]] auto entity::damage() const -> combat_value
     {
         return damage_;
     }
@@ -87,6 +179,11 @@ namespace potmaker {
         return health_ <= 0;
     }
 
+    [[nodiscard]] auto entity::element() const -> element_type
+    {
+        return element_;
+    }
+
     [[nodiscard]] auto entity::is_frozen() const -> bool
     {
         for (const auto& effect_variant: status_effects_) {
@@ -108,49 +205,94 @@ namespace potmaker {
         return false;
     }
 
-    auto entity::status_effects() -> std::vector<status_effect_variant>&
+    auto entity::status_effects() -> effect_list&
     {
         return status_effects_;
     }
 
+    auto entity::turns_left(const status_effect_variant& effect) const -> int
+    {
+        const auto elapsed = static_cast<int>(
+                effect_timers_.now() - synced_at_[effect.index()]);
+        return std::visit([](const auto& e) { return e.turns_left(); },
+                          effect)
+               - elapsed;
+    }
+
+    auto entity::battle_slot() const -> std::uint32_t
+    {
+        return battle_slot_;
+    }
+
+    auto entity::set_battle_slot(const std::uint32_t slot) -> void
+    {
+        battle_slot_ = slot;
+    }
+
+    auto entity::state_hash() const -> std::uint64_t
+    {
+        const auto bucket = whole_part(health_) / health_bucket_;
+        return identity_hash_ ^ effects_hash_
+               ^ hash_key(hash_part::health, static_cast<std::uint64_t>(bucket))
+               ^ hash_key(hash_part::tick, effect_timers_.now());
+    }
+
     // PLAYER
 
-    player::player(std::string name, const double max_health,
-                   const double damage, double const gold)
+    player::player(std::string name, const combat_value max_health,
+                   const combat_value damage, const combat_value gold)
         : entity(std::move(name), element_type::boring, max_health, damage),
           gold_(gold)
-    {}
+    {
+        health_bucket_ = player_health_bucket;
+    }
 
-    auto player::add_gold(const double gold) -> void
+    auto player::add_gold(const combat_value gold) -> void
     {
         gold_ += gold;
     }
 
-    auto player::remove_gold(const double gold) -> void
+    auto player::remove_gold(const combat_value gold) -> void
     {
         gold_ -= gold;
     }
 
     auto player::store_ingredient(ingredient* ing) -> void
     {
-        stored_ingredients_.push_back(ing);
+        stored_ingredients_.add(ing);
     }
 
-    auto player::stored_ingredients() -> std::vector<ingredient*>&
+    auto player::stored_ingredients() -> inventory&
     {
         return stored_ingredients_;
     }
 
-    auto player::gold() const -> double
+    auto player::stored_ingredients() const -> const inventory&
+    {
+        return stored_ingredients_;
+    }
+
+    auto player::recipes() -> recipe_book&
+    {
+        return recipes_;
+    }
+
+    auto player::gold() const -> combat_value
     {
         return gold_;
     }
 
+    auto player::state_hash() const -> std::uint64_t
+    {
+        return entity::state_hash()
+               ^ mix_hash(stored_ingredients_.state_hash());
+    }
+
     // ENEMY
 
     enemy::enemy(std::string name, const element_type element,
-                 const std::int32_t level, const double max_health,
-                 const double damage)
+                 const std::int32_t level, const combat_value max_health,
+                 const combat_value damage)
         : entity(std::move(name), element, max_health, damage), level_(level)
     {}
 
@@ -159,171 +301,214 @@ namespace potmaker {
         return level_;
     }
 
-#define POTMK_ENEMY_CONSTRUCTOR(ctor_name, type, MAXHP, DMG)                   \
+    auto enemy::act(player& p, enemy_party& party) -> void
+    {
+        plan(p, party).apply();
+    }
+
+    auto enemy_intent::say(std::string message) -> void
+    {
+        using enum intent_step::step_type;
+        steps.push_back({say, nullptr, 0.0, std::nullopt, std::move(message)});
+    }
+
+    auto enemy_intent::modify_health(entity* target,
+                                     const combat_value amount) -> void
+    {
+        using enum intent_step::step_type;
+        steps.push_back({modify_health, target, amount, std::nullopt, {}});
+    }
+
+    auto enemy_intent::add_effect(entity* target,
+                                  status_effect_variant&& effect) -> void
+    {
+        using enum intent_step::step_type;
+        steps.push_back({add_effect, target, 0.0, std::move(effect), {}});
+    }
+
+    auto enemy_intent::clear_effects(entity* target) -> void
+    {
+        using enum intent_step::step_type;
+        steps.push_back({clear_effects, target, 0.0, std::nullopt, {}});
+    }
+
+    auto enemy_intent::apply() -> void
+    {
+        for (auto& step: steps) {
+            switch (step.type) {
+            case intent_step::step_type::say:
+                print_action(step.message);
+                break;
+            case intent_step::step_type::modify_health:
+                step.target->modify_health(step.amount);
+                break;
+            case intent_step::step_type::add_effect:
+                step.target->add_status_effect(std::move(*step.effect));
+                break;
+            case intent_step::step_type::clear_effects:
+                step.target->clear_status_effects();
+                break;
+            }
+        }
+    }
+
+    auto enemy_rolls::draw() -> enemy_rolls
+    {
+        random_buffer& rng = random_source();
+        const double health = rng.unit_double();
+        const double damage = rng.unit_double();
+        if (antithetic_draws()) { return {1.0 - health, 1.0 - damage}; }
+        return {health, damage};
+    }
+
+    // The stats come from the active balance, by create_enemy_by_type type
+#define POTMK_ENEMY_CONSTRUCTOR(ctor_name, type, index)                        \
     ctor_name::ctor_name(std::string name, const std::int32_t level)           \
-        : enemy(std::move(name), type, level, MAXHP, DMG)                      \
+        : ctor_name(std::move(name), level, enemy_rolls::draw())               \
+    {}                                                                         \
+    ctor_name::ctor_name(std::string name, const std::int32_t level,           \
+                         const enemy_rolls rolls)                              \
+        : enemy(std::move(name), type, level,                                  \
+                active_balance().enemy_stats[index].max_health(                \
+                        level, rolls.health),                                  \
+                active_balance().enemy_stats[index].damage(level,              \
+                                                           rolls.damage))      \
     {}
 
-    // Flaming: Medium HP (80-120 range), Medium DMG (8-12 range)
-    POTMK_ENEMY_CONSTRUCTOR(
-            flaming_enemy, element_type::fire,
-            static_cast<uint16_t>(80 + (level * 4) * random_double(0.9, 1.1)),
-            static_cast<uint16_t>((8 + (level / 3))
-                                  * random_double(0.85, 1.15)));
-
-    // Chilling: Low HP (50-80 range), Low DMG (4-7 range)
-    POTMK_ENEMY_CONSTRUCTOR(
-            chilling_enemy, element_type::ice,
-            static_cast<uint16_t>(50 + (level * 3) * random_double(0.85, 1.15)),
-            static_cast<uint16_t>((4 + (level / 4)) * random_double(0.8, 1.2)));
-
-    // Poison: Medium HP (70-100 range), Low DMG (5-8 range)
-    POTMK_ENEMY_CONSTRUCTOR(
-            poisonous_enemy, element_type::nature,
-            static_cast<uint16_t>(70 + (level * 3) * random_double(0.9, 1.1)),
-            static_cast<uint16_t>((5 + (level / 5))
-                                  * random_double(0.8, 1.15)));
-
-    // Wither: Low HP (40-70 range), High DMG (12-18 range)
-    POTMK_ENEMY_CONSTRUCTOR(
-            withering_enemy, element_type::underworld,
-            static_cast<uint16_t>(40 + (level * 3) * random_double(0.8, 1.2)),
-            static_cast<uint16_t>((12 + (level / 2))
-                                  * random_double(0.9, 1.15)));
-
-    // Healing: Low HP (50-80 range), Low DMG (3-6 range)
-    POTMK_ENEMY_CONSTRUCTOR(
-            healing_enemy, element_type::regenerating,
-            static_cast<uint16_t>(50 + (level * 3) * random_double(0.85, 1.15)),
-            static_cast<uint16_t>((3 + (level / 5))
-                                  * random_double(0.75, 1.25)));
-
-    // Regenerative: Low HP (50-80 range), Low DMG (3-6 range)
-    POTMK_ENEMY_CONSTRUCTOR(
-            regenerative_enemy, element_type::healing,
-            static_cast<uint16_t>(50 + (level * 3) * random_double(0.85, 1.15)),
-            static_cast<uint16_t>((3 + (level / 5))
-                                  * random_double(0.75, 1.25)));
-
-    // Protective: High HP (120-180 range), Medium DMG (7-10 range)
-    POTMK_ENEMY_CONSTRUCTOR(
-            protective_enemy, element_type::protective,
-            static_cast<uint16_t>(120 + (level * 6) * random_double(0.85, 1.1)),
-            static_cast<uint16_t>((7 + (level / 4)) * random_double(0.9, 1.1)));
-
-    // Strengthening: Low HP (40-60 range), High DMG (12-16 range)
-    POTMK_ENEMY_CONSTRUCTOR(
-            strengthening_enemy, element_type::strengthening,
-            static_cast<uint16_t>(40 + (level * 2) * random_double(0.8, 1.2)),
-            static_cast<uint16_t>((12 + (level / 3))
-                                  * random_double(0.85, 1.15)));
-
-    // Cleansing: Low HP (50-80 range), Low DMG (3-6 range)
-    POTMK_ENEMY_CONSTRUCTOR(
-            cleansing_enemy, element_type::purifying,
-            static_cast<uint16_t>(50 + (level * 3) * random_double(0.85, 1.15)),
-            static_cast<uint16_t>((3 + (level / 5))
-                                  * random_double(0.75, 1.25)));
-
-    auto flaming_enemy::act(player& p, std::vector<enemy*>& party) -> void
+    POTMK_ENEMY_CONSTRUCTOR(flaming_enemy, element_type::fire, 0);
+    POTMK_ENEMY_CONSTRUCTOR(chilling_enemy, element_type::ice, 1);
+    POTMK_ENEMY_CONSTRUCTOR(poisonous_enemy, element_type::nature, 2);
+    POTMK_ENEMY_CONSTRUCTOR(withering_enemy, element_type::underworld, 3);
+    POTMK_ENEMY_CONSTRUCTOR(healing_enemy, element_type::regenerating, 4);
+    POTMK_ENEMY_CONSTRUCTOR(regenerative_enemy, element_type::healing, 5);
+    POTMK_ENEMY_CONSTRUCTOR(protective_enemy, element_type::protective, 6);
+    POTMK_ENEMY_CONSTRUCTOR(strengthening_enemy, element_type::strengthening,
+                            7);
+    POTMK_ENEMY_CONSTRUCTOR(cleansing_enemy, element_type::purifying, 8);
+
+    auto flaming_enemy::plan(player& p, const enemy_party& party) const
+            -> enemy_intent
     {
+        enemy_intent intent;
+
         // 40% chance to attempt burning (slightly more aggressive than the
         // example)
         if (roll_chances(5)) { // 20% chance for special behavior
             // Sometimes spreads fire to multiple targets
             if (roll_chances(3)) {
-                print_action(
-                        std::format("{} engulfs everyone in flames!", name_));
+                intent.say("{} engulfs everyone in flames!", name_);
                 for (auto& target: party) {
                     if (roll_chances(2)) { // 50% chance to affect each ally
-                        target->add_status_effect(
-                                burning(1 * level_, level_ / 2));
+                        intent.add_effect(target,
+                                          burning(1 * level_, level_ / 2));
                     }
                 }
-                p.add_status_effect(burning(2 * level_, level_));
+                intent.add_effect(&p, burning(2 * level_, level_));
             } // Sometimes does a powerful burn
             else {
-                print_action(std::format("{} unleashes a searing blaze on {}!",
-                                         name_, p.name()));
-                p.add_status_effect(burning(3 * level_, level_ * 1.5));
+                intent.say("{} unleashes a searing blaze on {}!", name_,
+                           p.name());
+                intent.add_effect(&p, burning(3 * level_, level_ * 1.5));
             }
         }
         else if (roll_chances(2)) { // 50% chance for standard burn
-            print_action(std::format("{} scorches {}", name_, p.name()));
-            p.add_status_effect(burning(2 * level_, level_));
+            intent.say("{} scorches {}", name_, p.name());
+            intent.add_effect(&p, burning(2 * level_, level_));
             // Small chance to chain burn to adjacent enemies
             if (roll_chances(5) && !party.empty()) {
                 size_t random_index = random_int(0, party.size() - 1);
-                print_action(std::format("The flames spread to {}!",
-                                         party[random_index]->name()));
-                party[random_index]->add_status_effect(
-                        burning(1 * level_, level_ / 2));
+                intent.say("The flames spread to {}!",
+                           party[random_index]->name());
+                intent.add_effect(party[random_index],
+                                  burning(1 * level_, level_ / 2));
             }
         }
         else { // Default attack (with fiery flavor)
-            print_action(std::format("{} attacks {} with burning fury!", name_,
-                                     p.name()));
+            intent.say("{} attacks {} with burning fury!", name_, p.name());
             // Burning enemies deal slightly more damage when not applying
             // status
-            p.modify_health(damage_ * 1.2);
+            intent.modify_health(&p, damage_ * 1.2);
         }
+
+        return intent;
     }
 
     // CHILLING ENEMY - Freezes often but can miss
-    auto chilling_enemy::act(player& p, std::vector<enemy*>& party) -> void
+    auto chilling_enemy::plan(player& p, const enemy_party& party) const
+            -> enemy_intent
     {
+        enemy_intent intent;
+
         if (roll_chances(2)) { // 50% chance to try freezing
             if (roll_chances(4)) { // 25% chance to actually hit
-                print_action(std::format("{} freezes {}", name_, p.name()));
-                p.add_status_effect(freezing(2 * level_, level_));
+                intent.say("{} freezes {}", name_, p.name());
+                intent.add_effect(&p, freezing(2 * level_, level_));
             }
             else {
-                print_action(std::format("{} attempts to freeze {} but misses!",
-                                         name_, p.name()));
+                intent.say("{} attempts to freeze {} but misses!", name_,
+                           p.name());
             }
         }
         else {
-            print_action(std::format("{} attacks {}", name_, p.name()));
-            p.modify_health(damage_);
+            intent.say("{} attacks {}", name_, p.name());
+            intent.modify_health(&p, damage_);
         }
+
+        return intent;
     }
 
     // POISONOUS ENEMY - Seeks to poison frequently
-    auto poisonous_enemy::act(player& p, std::vector<enemy*>& party) -> void
+    auto poisonous_enemy::plan(player& p,
+                               const enemy_party& party) const
+            -> enemy_intent
     {
+        enemy_intent intent;
+
         if (roll_chances(3)) { // 33% chance to poison
-            print_action(std::format("{} poisons {}", name_, p.name()));
-            p.add_status_effect(poison(3 * level_, level_));
+            intent.say("{} poisons {}", name_, p.name());
+            intent.add_effect(&p, poison(3 * level_, level_));
         }
         else {
-            print_action(std::format("{} attacks {}", name_, p.name()));
-            p.modify_health(damage_);
+            intent.say("{} attacks {}", name_, p.name());
+            intent.modify_health(&p, damage_);
         }
+
+        return intent;
     }
 
     // WITHERING ENEMY - Occasionally withers
-    auto withering_enemy::act(player& p, std::vector<enemy*>& party) -> void
+    auto withering_enemy::plan(player& p,
+                               const enemy_party& party) const
+            -> enemy_intent
     {
+        enemy_intent intent;
+
         if (roll_chances(5)) { // 20% chance to wither
-            print_action(std::format("{} withers {}", name_, p.name()));
-            p.add_status_effect(wither(2 * level_, level_));
+            intent.say("{} withers {}", name_, p.name());
+            intent.add_effect(&p, wither(2 * level_, level_));
         }
         else {
-            print_action(std::format("{} attacks {}", name_, p.name()));
-            p.modify_health(damage_);
+            intent.say("{} attacks {}", name_, p.name());
+            intent.modify_health(&p, damage_);
         }
+
+        return intent;
     }
 
     // HEALING ENEMY - Focuses on healing most wounded ally
-    auto healing_enemy::act(player& p, std::vector<enemy*>& party) -> void
+    auto healing_enemy::plan(player& p, const enemy_party& party) const
+            -> enemy_intent
     {
+        enemy_intent intent;
+        intent.reads_allies = true;
+
         // Find most wounded ally
         enemy* most_wounded = nullptr;
-        double lowest_health = 1.0;
+        combat_value lowest_health = 1.0;
 
         for (auto& ally: party) {
             if (ally != this) {
-                double health_percent = ally->health() / ally->max_health();
+                const combat_value health_percent = ally->health_fraction();
                 if (health_percent < lowest_health) {
                     lowest_health = health_percent;
                     most_wounded = ally;
@@ -333,28 +518,34 @@ namespace potmaker {
 
         // Heal if ally is below 50% health
         if (most_wounded && lowest_health < 0.5 && !roll_chances(4)) {
-            double heal_amount = 10 + (level_ * 2);
-            print_action(std::format("{} heals {} for {:.1f} HP", name_,
-                                     most_wounded->name(), heal_amount));
-            most_wounded->modify_health(heal_amount);
+            combat_value heal_amount = 10 + (level_ * 2);
+            intent.say("{} heals {} for {:.1f} HP", name_, most_wounded->name(),
+                       heal_amount);
+            intent.modify_health(most_wounded, heal_amount);
         }
         else {
-            print_action(std::format("{} attacks {}", name_, p.name()));
-            p.modify_health(damage_);
+            intent.say("{} attacks {}", name_, p.name());
+            intent.modify_health(&p, damage_);
         }
+
+        return intent;
     }
 
     // REGENERATIVE ENEMY - Applies regeneration
-    auto regenerative_enemy::act(player& p, std::vector<enemy*>& party) -> void
+    auto regenerative_enemy::plan(player& p,
+                                  const enemy_party& party) const
+            -> enemy_intent
     {
+        enemy_intent intent;
+        intent.reads_allies = true;
+
         // Find most wounded ally
         enemy* most_wounded = nullptr;
-        double lowest_health = 1.0;
+        combat_value lowest_health = 1.0;
 
         for (auto& ally: party) {
             if (ally != this) {
-                const double health_percent
-                        = ally->health() / ally->max_health();
+                const combat_value health_percent = ally->health_fraction();
                 if (health_percent < lowest_health) {
                     lowest_health = health_percent;
                     most_wounded = ally;
@@ -363,19 +554,25 @@ namespace potmaker {
         }
 
         if (most_wounded && lowest_health < 0.75 && !roll_chances(3)) {
-            print_action(std::format("{} regenerates {}", name_,
-                                     most_wounded->name()));
-            most_wounded->add_status_effect(regeneration(3 * level_, level_));
+            intent.say("{} regenerates {}", name_, most_wounded->name());
+            intent.add_effect(most_wounded, regeneration(3 * level_, level_));
         }
         else {
-            print_action(std::format("{} attacks {}", name_, p.name()));
-            p.modify_health(damage_);
+            intent.say("{} attacks {}", name_, p.name());
+            intent.modify_health(&p, damage_);
         }
+
+        return intent;
     }
 
     // PROTECTIVE ENEMY - Frequently protects allies
-    auto protective_enemy::act(player& p, std::vector<enemy*>& party) -> void
+    auto protective_enemy::plan(player& p,
+                                const enemy_party& party) const
+            -> enemy_intent
     {
+        enemy_intent intent;
+        intent.reads_allies = true;
+
         if (roll_chances(2)) { // 50% chance to protect
             // Find least protected ally
             enemy* least_protected = nullptr;
@@ -397,25 +594,31 @@ namespace potmaker {
             }
 
             if (least_protected) {
-                print_action(std::format("{} protects {}", name_,
-                                         least_protected->name()));
-                least_protected->add_status_effect(
-                        protection(2 * level_, level_));
+                intent.say("{} protects {}", name_, least_protected->name());
+                intent.add_effect(least_protected,
+                                  protection(2 * level_, level_));
             }
             else {
-                print_action(std::format("{} attacks {}", name_, p.name()));
-                p.modify_health(damage_);
+                intent.say("{} attacks {}", name_, p.name());
+                intent.modify_health(&p, damage_);
             }
         }
         else {
-            print_action(std::format("{} attacks {}", name_, p.name()));
-            p.modify_health(damage_);
+            intent.say("{} attacks {}", name_, p.name());
+            intent.modify_health(&p, damage_);
         }
+
+        return intent;
     }
 
     // STRENGTHENING ENEMY - Occasionally strengthens allies
-    auto strengthening_enemy::act(player& p, std::vector<enemy*>& party) -> void
+    auto strengthening_enemy::plan(player& p,
+                                   const enemy_party& party) const
+            -> enemy_intent
     {
+        enemy_intent intent;
+        intent.reads_allies = true;
+
         if (roll_chances(4)) { // 25% chance to strengthen
             // Find ally with lowest strength
             enemy* weakest = nullptr;
@@ -437,24 +640,30 @@ namespace potmaker {
             }
 
             if (weakest) {
-                print_action(std::format("{} strengthens {}", name_,
-                                         weakest->name()));
-                weakest->add_status_effect(strength(3 * level_, level_));
+                intent.say("{} strengthens {}", name_, weakest->name());
+                intent.add_effect(weakest, strength(3 * level_, level_));
             }
             else {
-                print_action(std::format("{} attacks {}", name_, p.name()));
-                p.modify_health(damage_);
+                intent.say("{} attacks {}", name_, p.name());
+                intent.modify_health(&p, damage_);
             }
         }
         else {
-            print_action(std::format("{} attacks {}", name_, p.name()));
-            p.modify_health(damage_);
+            intent.say("{} attacks {}", name_, p.name());
+            intent.modify_health(&p, damage_);
         }
+
+        return intent;
     }
 
     // CLEANSING ENEMY - Purifies negative effects
-    auto cleansing_enemy::act(player& p, std::vector<enemy*>& party) -> void
+    auto cleansing_enemy::plan(player& p,
+                               const enemy_party& party) const
+            -> enemy_intent
     {
+        enemy_intent intent;
+        intent.reads_allies = true;
+
         // Find ally with most negative effects
         enemy* most_afflicted = nullptr;
         int max_negative = 0;
@@ -478,13 +687,14 @@ namespace potmaker {
         }
 
         if (most_afflicted && max_negative > 0 && !roll_chances(3)) {
-            print_action(std::format("{} cleanses {}", name_,
-                                     most_afflicted->name()));
-            most_afflicted->clear_status_effects();
+            intent.say("{} cleanses {}", name_, most_afflicted->name());
+            intent.clear_effects(most_afflicted);
         }
         else {
-            print_action(std::format("{} attacks {}", name_, p.name()));
-            p.modify_health(damage_);
+            intent.say("{} attacks {}", name_, p.name());
+            intent.modify_health(&p, damage_);
         }
+
+        return intent;
     }
 } // namespace potmaker
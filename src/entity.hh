@@ -1,17 +1,38 @@
 #ifndef ENTITY_HH
 #define ENTITY_HH
+#include "combat_math.hh"
 #include "element_type.hh"
+#include "inventory.hh"
+#include "recipe_book.hh"
+#include "small_vector.hh"
+#include "state_hash.hh"
 #include "status_effect.hh"
+#include "timer_wheel.hh"
 #include "util.hh"
+#include <array>
+#include <cstddef>
 #include <cstdint>
+#include <format>
+#include <optional>
 #include <string>
 #include <string_view>
+#include <utility>
+#include <variant>
 #include <vector>
 
 namespace potmaker {
 
     template<element_type element_t> class status_effect;
     class ingredient;
+    class enemy;
+
+    // Entities hold at most one effect per kind, so this never allocates
+    using effect_list
+            = small_vector<status_effect_variant,
+                           std::variant_size_v<status_effect_variant>>;
+
+    // Parties rarely outgrow this until the late stages
+    using enemy_party = small_vector<enemy*, 8>;
 
     /**
      * A generic entity which interacts in the game world. Can kill and be
@@ -27,10 +48,11 @@ namespace potmaker {
          * @param damage The base damage this entity deals
          */
         explicit entity(std::string name, element_type element,
-                        double max_health, double damage);
+                        combat_value max_health, combat_value damage);
 
         /**
-         * Ticks active status effects
+         * Ticks active status effects. Only effects that deal damage or
+         * expire this turn are visited
          */
         auto tick() -> void;
 
@@ -38,10 +60,12 @@ namespace potmaker {
          * Induces a change in health
          * @param amount The amount that health will change by
          */
-        auto modify_health(const double amount) -> void;
+        auto modify_health(combat_value amount) -> void;
 
         /**
-         * Adds a new status effect to this entity
+         * Adds a new status effect to this entity. An effect of a kind the
+         * entity already has is combined with it according to the kind's
+         * stacking policy
          * @param effect The effect to add
          */
         auto add_status_effect(status_effect_variant&& effect) -> void;
@@ -54,17 +78,28 @@ namespace potmaker {
         /**
          * @return The max health
          */
-        [[nodiscard]] auto max_health() const -> double;
+        [[nodiscard]] auto max_health() const -> combat_value;
 
         /**
          * @return The current health
          */
-        [[nodiscard]] auto health() const -> double;
+        [[nodiscard]] auto health() const -> combat_value;
+
+        /**
+         * @return The current health over the max health, or 1 for an
+         * entity without any max health, which cannot be wounded
+         */
+        [[nodiscard]] auto health_fraction() const -> combat_value;
 
         /**
          * @return The damage this creature inflicts
          */
-        [[nodiscard]] auto damage() const -> double;
+        [[nodiscard]] auto damage() const -> combat_value;
+
+        /**
+         * @return The element of this creature
+         */
+        [[nodiscard]] auto element() const -> element_type;
 
         /**
          * @return Whether this creature is dead
@@ -77,18 +112,90 @@ namespace potmaker {
         [[nodiscard]] auto is_frozen() const -> bool;
 
         /**
-         * @return The list of active status effects in the entity
+         * @return The list of active status effects in the entity. Effects
+         * are not ticked down one turn at a time, so their own turns_left is
+         * as of when they were last received; ask turns_left below instead
          */
         [[nodiscard]] auto status_effects()
-                -> std::vector<status_effect_variant>&;
+                -> effect_list&;
+
+        /**
+         * @param effect One of this entity's status effects
+         * @return How many turns the effect has left
+         */
+        [[nodiscard]] auto turns_left(const status_effect_variant& effect) const
+                -> int;
+
+        /**
+         * @return The entity's slot in its battle: 0 for the player, and for
+         * an enemy one more than how many enemies were spawned before it in
+         * the same battle. It stays the same however the party changes
+         */
+        [[nodiscard]] auto battle_slot() const -> std::uint32_t;
+
+        /**
+         * @param slot The entity's slot in its battle
+         */
+        auto set_battle_slot(std::uint32_t slot) -> void;
+
+        /**
+         * Hashes what this entity is and the state it is in: its health,
+         * bucketed, its effects and how many times it has ticked. The parts
+         * that change are kept up to date as they change, so this is cheap
+         * @return The hash
+         */
+        [[nodiscard]] virtual auto state_hash() const -> std::uint64_t;
 
     protected:
-        std::vector<status_effect_variant> status_effects_;
+        static constexpr std::size_t effect_kind_count
+                = std::variant_size_v<status_effect_variant>;
+
+        /**
+         * Brings an effect's own turns left up to date
+         */
+        auto sync_effect(status_effect_variant& effect) -> void;
+
+        /**
+         * Schedules the expiry of an effect that was just synced, and notes
+         * how much damage it deals each turn
+         */
+        auto schedule_effect(const status_effect_variant& effect) -> void;
+
+        /**
+         * Lists the kinds of effects that deal damage each turn in the
+         * order they were received, after that set changed
+         */
+        auto order_damage() -> void;
+
+        effect_list status_effects_;
+        // Expiry of each kind of effect, in this entity's ticks. Entities
+        // keep their own clocks: enemies tick before the player in a turn,
+        // and not at all once dead, and the state hash counts an entity's
+        // ticks from its spawn. With one timer per kind, a few slots keep
+        // advancing cheap whatever the durations
+        timer_wheel<effect_kind_count, 8> effect_timers_;
+        // The tick on which each kind of effect's turns were last synced
+        std::array<std::uint32_t, effect_kind_count> synced_at_{};
+        // The kinds of effects that deal damage or heal each turn, as a
+        // mask and in the order they were received, and what each deals.
+        // Ticking walks only these, not every effect
+        std::uint32_t damaging_effects_ = 0;
+        std::array<std::uint8_t, effect_kind_count> damage_order_{};
+        std::size_t damage_count_ = 0;
+        std::array<combat_value, effect_kind_count> damage_per_turn_{};
+        // The state hash key of each kind of effect, zero if absent, and
+        // all of them combined
+        std::array<std::uint64_t, effect_kind_count> effect_hashes_{};
+        std::uint64_t effects_hash_ = 0;
+        std::uint64_t identity_hash_;
+        // How many points of health the state hash tells apart
+        std::int64_t health_bucket_ = 1;
         element_type element_;
         std::string_view name_;
-        double max_health_;
-        double health_;
-        double damage_;
+        combat_value max_health_;
+        combat_value health_;
+        combat_value damage_;
+        std::uint32_t battle_slot_ = 0;
         bool skips_turn_;
     };
 
@@ -101,19 +208,20 @@ namespace potmaker {
          * @param damage Base damage dealt by the player
          * @param gold Starting amount of gold
          */
-        player(std::string name, double max_health, double damage, double gold);
+        player(std::string name, combat_value max_health, combat_value damage,
+               combat_value gold);
 
         /**
          * Adds gold to the player's account
          * @param gold The amount of gold
          */
-        auto add_gold(double gold) -> void;
+        auto add_gold(combat_value gold) -> void;
 
         /**
          * Removes gold from the player's account
          * @param gold The amount of gold
          */
-        auto remove_gold(double gold) -> void;
+        auto remove_gold(combat_value gold) -> void;
 
         /**
          * Adds an ingredient to the player's inventory
@@ -124,18 +232,159 @@ namespace potmaker {
         /**
          * @return The player's inventory of ingredients
          */
-        [[nodiscard]] auto stored_ingredients() -> std::vector<ingredient*>&;
+        [[nodiscard]] auto stored_ingredients() -> inventory&;
+        [[nodiscard]] auto stored_ingredients() const -> const inventory&;
+
+        /**
+         * @return The player's saved potion recipes
+         */
+        [[nodiscard]] auto recipes() -> recipe_book&;
 
         /**
          * @return The player's available gold
          */
-        [[nodiscard]] auto gold() const -> double;
+        [[nodiscard]] auto gold() const -> combat_value;
+
+        /**
+         * @return The entity's state hash, including the inventory
+         */
+        [[nodiscard]] auto state_hash() const -> std::uint64_t override;
 
     private:
-        std::vector<ingredient*> stored_ingredients_;
-        double gold_;
+        // Player health is hashed in buckets this wide, so that states a
+        // few points apart count as the same
+        static constexpr std::int64_t player_health_bucket = 5;
+
+        inventory stored_ingredients_;
+        recipe_book recipes_;
+        combat_value gold_;
     };
 
+    /**
+     * Describes how an enemy type's stats scale with its level. Both stats
+     * are multiplied by a random variance picked from their range. Each
+     * built-in type's stats member only sets its default balance; enemies
+     * are made with the active balance_params
+     */
+    struct enemy_stat_formula {
+        std::int32_t base_health;
+        std::int32_t health_per_level;
+        combat_value health_variance_min;
+        combat_value health_variance_max;
+        std::int32_t base_damage;
+        std::int32_t damage_level_divisor;
+        combat_value damage_variance_min;
+        combat_value damage_variance_max;
+
+        /**
+         * @param level The enemy's level
+         * @param roll A uniform roll in [0, 1)
+         * @return The max health of an enemy of the given level
+         */
+        [[nodiscard]] constexpr auto max_health(const std::int32_t level,
+                                                const double roll) const
+                -> combat_value
+        {
+            const combat_value variance
+                    = health_variance_min
+                      + (health_variance_max - health_variance_min) * roll;
+            return static_cast<std::uint16_t>(whole_part(
+                    base_health + (level * health_per_level) * variance));
+        }
+
+        /**
+         * @param level The enemy's level
+         * @param roll A uniform roll in [0, 1)
+         * @return The base damage of an enemy of the given level
+         */
+        [[nodiscard]] constexpr auto damage(const std::int32_t level,
+                                            const double roll) const
+                -> combat_value
+        {
+            const combat_value variance
+                    = damage_variance_min
+                      + (damage_variance_max - damage_variance_min) * roll;
+            return static_cast<std::uint16_t>(whole_part(
+                    (base_damage + (level / damage_level_divisor))
+                    * variance));
+        }
+    };
+
+    /**
+     * The uniform rolls that decide where an enemy's stats land within their
+     * variance ranges
+     */
+    struct enemy_rolls {
+        double health;
+        double damage;
+
+        /**
+         * @return A pair of rolls drawn from the game's random number
+         * generator, health first. Antithetic draws flip them like
+         * random_double
+         */
+        static auto draw() -> enemy_rolls;
+    };
+
+    /**
+     * A single change an enemy wants to make to the battle
+     */
+    struct intent_step {
+        enum class step_type : std::uint8_t {
+            say,
+            modify_health,
+            add_effect,
+            clear_effects
+        };
+
+        step_type type;
+        entity* target;
+        combat_value amount;
+        std::optional<status_effect_variant> effect;
+        std::string message;
+    };
+
+    /**
+     * What an enemy decided to do on its turn, worked out without touching
+     * the battle. Carrying it out has the same result as acting directly
+     */
+    struct enemy_intent {
+        small_vector<intent_step, 4> steps;
+
+        // Whether the decision depends on the state of the enemy's allies,
+        // and must be made again if any of them changed in the meantime
+        bool reads_allies = false;
+
+        // Whether the enemy cannot plan ahead and must act directly
+        bool deferred = false;
+
+        auto say(std::string message) -> void;
+
+        /**
+         * Formats a message to say. While output is silenced nothing would
+         * print it, so it is not formatted or added
+         */
+        template<typename... args_t>
+        auto say(std::format_string<args_t...> format, args_t&&... args)
+                -> void
+        {
+            if (output_quiet()) { return; }
+            say(std::format(format, std::forward<args_t>(args)...));
+        }
+        auto modify_health(entity* target, combat_value amount) -> void;
+        auto add_effect(entity* target, status_effect_variant&& effect)
+                -> void;
+        auto clear_effects(entity* target) -> void;
+
+        /**
+         * Carries out every step in order. Effects are moved out of the
+         * steps, so an intent can only be applied once
+         */
+        auto apply() -> void;
+    };
+
+    using intent_list = small_vector<enemy_intent, 8>;
+
     class enemy : public entity {
     public:
         /**
@@ -147,14 +396,27 @@ namespace potmaker {
          * @param damage The enemy's base damage
          */
         explicit enemy(std::string name, element_type element,
-                       std::int32_t level, double max_health, double damage);
+                       std::int32_t level, combat_value max_health,
+                       combat_value damage);
 
         /**
          * Determines what the creature will do once it is its turn
          * @param p The player
          * @param party The enemy party
          */
-        virtual auto act(player& p, std::vector<enemy*>& party) -> void = 0;
+        virtual auto act(player& p, enemy_party& party) -> void;
+
+        /**
+         * Decides what the creature will do on its turn without changing any
+         * entity. Safe to call for several enemies at once
+         * @param p The player
+         * @param party The enemy party
+         * @return The steps act would carry out with the same random numbers
+         */
+        [[nodiscard]] virtual auto plan(player& p,
+                                        const enemy_party& party) const
+                -> enemy_intent
+                = 0;
 
         [[nodiscard]] auto level() const -> std::int32_t;
 
@@ -164,56 +426,125 @@ namespace potmaker {
 
     class flaming_enemy final : public enemy {
     public:
+        // Medium HP (80-120 range), Medium DMG (8-12 range)
+        static constexpr enemy_stat_formula stats{
+                80, 4, 0.9, 1.1, 8, 3, 0.85, 1.15};
+
         explicit flaming_enemy(std::string name, std::int32_t level);
-        auto act(player& p, std::vector<enemy*>& party) -> void override;
+        flaming_enemy(std::string name, std::int32_t level, enemy_rolls rolls);
+        [[nodiscard]] auto plan(player& p,
+                                const enemy_party& party) const
+                -> enemy_intent override;
     };
 
     class chilling_enemy final : public enemy {
     public:
+        // Low HP (50-80 range), Low DMG (4-7 range)
+        static constexpr enemy_stat_formula stats{
+                50, 3, 0.85, 1.15, 4, 4, 0.8, 1.2};
+
         explicit chilling_enemy(std::string name, std::int32_t level);
-        auto act(player& p, std::vector<enemy*>& party) -> void override;
+        chilling_enemy(std::string name, std::int32_t level, enemy_rolls rolls);
+        [[nodiscard]] auto plan(player& p,
+                                const enemy_party& party) const
+                -> enemy_intent override;
     };
 
     class poisonous_enemy final : public enemy {
     public:
+        // Medium HP (70-100 range), Low DMG (5-8 range)
+        static constexpr enemy_stat_formula stats{
+                70, 3, 0.9, 1.1, 5, 5, 0.8, 1.15};
+
         explicit poisonous_enemy(std::string name, std::int32_t level);
-        auto act(player& p, std::vector<enemy*>& party) -> void override;
+        poisonous_enemy(std::string name, std::int32_t level,
+                        enemy_rolls rolls);
+        [[nodiscard]] auto plan(player& p,
+                                const enemy_party& party) const
+                -> enemy_intent override;
     };
 
     class withering_enemy final : public enemy {
     public:
+        // Low HP (40-70 range), High DMG (12-18 range)
+        static constexpr enemy_stat_formula stats{
+                40, 3, 0.8, 1.2, 12, 2, 0.9, 1.15};
+
         explicit withering_enemy(std::string name, std::int32_t level);
-        auto act(player& p, std::vector<enemy*>& party) -> void override;
+        withering_enemy(std::string name, std::int32_t level,
+                        enemy_rolls rolls);
+        [[nodiscard]] auto plan(player& p,
+                                const enemy_party& party) const
+                -> enemy_intent override;
     };
 
     class healing_enemy final : public enemy {
     public:
+        // Low HP (50-80 range), Low DMG (3-6 range)
+        static constexpr enemy_stat_formula stats{
+                50, 3, 0.85, 1.15, 3, 5, 0.75, 1.25};
+
         explicit healing_enemy(std::string name, std::int32_t level);
-        auto act(player& p, std::vector<enemy*>& party) -> void override;
+        healing_enemy(std::string name, std::int32_t level, enemy_rolls rolls);
+        [[nodiscard]] auto plan(player& p,
+                                const enemy_party& party) const
+                -> enemy_intent override;
     };
 
     class regenerative_enemy final : public enemy {
     public:
+        // Low HP (50-80 range), Low DMG (3-6 range)
+        static constexpr enemy_stat_formula stats{
+                50, 3, 0.85, 1.15, 3, 5, 0.75, 1.25};
+
         explicit regenerative_enemy(std::string name, std::int32_t level);
-        auto act(player& p, std::vector<enemy*>& party) -> void override;
+        regenerative_enemy(std::string name, std::int32_t level,
+                           enemy_rolls rolls);
+        [[nodiscard]] auto plan(player& p,
+                                const enemy_party& party) const
+                -> enemy_intent override;
     };
 
     class protective_enemy final : public enemy {
     public:
+        // High HP (120-180 range), Medium DMG (7-10 range)
+        static constexpr enemy_stat_formula stats{
+                120, 6, 0.85, 1.1, 7, 4, 0.9, 1.1};
+
         explicit protective_enemy(std::string name, std::int32_t level);
-        auto act(player& p, std::vector<enemy*>& party) -> void override;
+        protective_enemy(std::string name, std::int32_t level,
+                         enemy_rolls rolls);
+        [[nodiscard]] auto plan(player& p,
+                                const enemy_party& party) const
+                -> enemy_intent override;
     };
 
     class strengthening_enemy final : public enemy {
     public:
+        // Low HP (40-60 range), High DMG (12-16 range)
+        static constexpr enemy_stat_formula stats{
+                40, 2, 0.8, 1.2, 12, 3, 0.85, 1.15};
+
         explicit strengthening_enemy(std::string name, std::int32_t level);
-        auto act(player& p, std::vector<enemy*>& party) -> void override;
+        strengthening_enemy(std::string name, std::int32_t level,
+                            enemy_rolls rolls);
+        [[nodiscard]] auto plan(player& p,
+                                const enemy_party& party) const
+                -> enemy_intent override;
     };
 
     class cleansing_enemy final : public enemy {
     public:
+        // Low HP (50-80 range), Low DMG (3-6 range)
+        static constexpr enemy_stat_formula stats{
+                50, 3, 0.85, 1.15, 3, 5, 0.75, 1.25};
+
         explicit cleansing_enemy(std::string name, std::int32_t level);
-        auto act(player& p, std::vector<enemy*>& party) -> void override;
+        cleansing_enemy(std::string name, std::int32_t level,
+                        enemy_rolls rolls);
+        [[nodiscard]] auto plan(player& p,
+                                const enemy_party& party) const
+                -> enemy_intent override;
     };
 
 } // namespace potmaker
@@ -0,0 +1,679 @@
+#include "event_log.hh"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <tuple>
+#include <unistd.h>
+#include <vector>
+
+namespace potmaker::events {
+
+    namespace {
+
+        // Repeats shorter than this are stored as literals
+        constexpr std::size_t min_match = 4;
+        constexpr std::size_t max_offset = 0xffff;
+        constexpr int hash_bits = 13;
+
+        // Bits of the tag byte. The two lowest hold the kind, and the three
+        // highest the entity's zigzagged difference from the event before,
+        // or entity_escape if it follows as a varint
+        constexpr std::uint8_t run_changed = 1 << 2;
+        constexpr std::uint8_t stage_changed = 1 << 3;
+        constexpr std::uint8_t turn_changed = 1 << 4;
+        constexpr int entity_shift = 5;
+        constexpr std::uint8_t entity_escape = 7;
+
+        // No event encodes to more than this many bytes
+        constexpr std::size_t max_event_size = 1 + 6 * 10;
+
+        auto load32(const std::byte* p) -> std::uint32_t
+        {
+            std::uint32_t value;
+            std::memcpy(&value, p, sizeof(value));
+            return value;
+        }
+
+        auto hash32(const std::uint32_t value) -> std::size_t
+        {
+            return (value * 2654435761U) >> (32 - hash_bits);
+        }
+
+        /**
+         * Writes the part of a length that does not fit in its token
+         * nibble, 255 at a time
+         */
+        auto put_length(std::size_t length, std::vector<std::byte>& out)
+                -> void
+        {
+            while (length >= 255) {
+                out.push_back(std::byte{255});
+                length -= 255;
+            }
+            out.push_back(static_cast<std::byte>(length));
+        }
+
+        auto put_sequence(const std::span<const std::byte> literals,
+                          const std::size_t offset, const std::size_t length,
+                          std::vector<std::byte>& out) -> void
+        {
+            const std::size_t match = length == 0 ? 0 : length - min_match;
+            const auto literal_nibble = std::min<std::size_t>(literals.size(),
+                                                              15);
+            const auto match_nibble = std::min<std::size_t>(match, 15);
+            out.push_back(static_cast<std::byte>(literal_nibble << 4
+                                                 | match_nibble));
+            if (literal_nibble == 15) { put_length(literals.size() - 15, out); }
+            out.insert(out.end(), literals.begin(), literals.end());
+
+            // The last sequence has no match and ends the data
+            if (length == 0) { return; }
+            out.push_back(static_cast<std::byte>(offset & 0xff));
+            out.push_back(static_cast<std::byte>(offset >> 8));
+            if (match_nibble == 15) { put_length(match - 15, out); }
+        }
+
+        auto put_varint(std::uint64_t value, std::vector<std::byte>& out)
+                -> void
+        {
+            while (value >= 0x80) {
+                out.push_back(static_cast<std::byte>(value | 0x80));
+                value >>= 7;
+            }
+            out.push_back(static_cast<std::byte>(value));
+        }
+
+        auto zigzag(const std::int64_t value) -> std::uint64_t
+        {
+            return (static_cast<std::uint64_t>(value) << 1)
+                   ^ static_cast<std::uint64_t>(value >> 63);
+        }
+
+        auto unzigzag(const std::uint64_t value) -> std::int64_t
+        {
+            return static_cast<std::int64_t>((value >> 1) ^ (0 - (value & 1)));
+        }
+
+        auto corrupted() -> std::runtime_error
+        {
+            return std::runtime_error("event log is corrupted");
+        }
+
+        auto place_of(const event& e)
+        {
+            return std::tuple(e.run, e.stage, e.turn);
+        }
+
+        auto place_of(const block_record& b)
+        {
+            return std::tuple(b.run, b.stage, b.turn);
+        }
+
+        auto has_detail(const kind k) -> bool
+        {
+            return k == kind::spawn || k == kind::action;
+        }
+
+        auto has_health(const kind k) -> bool
+        {
+            return k == kind::spawn || k == kind::health;
+        }
+
+        /**
+         * Reads varints from a decompressed block, checking every byte
+         */
+        class varint_reader {
+        public:
+            varint_reader(const std::span<const std::byte> data,
+                          std::size_t& cursor)
+                : data_(data), cursor_(cursor)
+            {}
+
+            auto byte() -> std::uint8_t
+            {
+                if (cursor_ >= data_.size()) { throw corrupted(); }
+                return static_cast<std::uint8_t>(data_[cursor_++]);
+            }
+
+            auto varint() -> std::uint64_t
+            {
+                std::uint64_t value = 0;
+                for (int shift = 0; shift < 64; shift += 7) {
+                    const std::uint8_t b = byte();
+                    value |= static_cast<std::uint64_t>(b & 0x7f) << shift;
+                    if ((b & 0x80) == 0) { return value; }
+                }
+                throw corrupted();
+            }
+
+        private:
+            std::span<const std::byte> data_;
+            std::size_t& cursor_;
+        };
+
+        /**
+         * Reads varints from a block that has at least max_event_size bytes
+         * left, which no event can overrun, so only the varints' lengths
+         * are checked. Almost every varint is a single byte, which is
+         * handled first
+         */
+        class unchecked_reader {
+        public:
+            explicit unchecked_reader(const std::byte* data) : data_(data) {}
+
+            auto byte() -> std::uint8_t
+            {
+                return static_cast<std::uint8_t>(*data_++);
+            }
+
+            auto varint() -> std::uint64_t
+            {
+                std::uint8_t b = byte();
+                if (b < 0x80) { return b; }
+
+                std::uint64_t value = b & 0x7f;
+                for (int shift = 7; shift < 64; shift += 7) {
+                    b = byte();
+                    value |= static_cast<std::uint64_t>(b & 0x7f) << shift;
+                    if (b < 0x80) { return value; }
+                }
+                throw corrupted();
+            }
+
+            [[nodiscard]] auto position() const -> const std::byte*
+            {
+                return data_;
+            }
+
+        private:
+            const std::byte* data_;
+        };
+
+        /**
+         * Decodes the event after another
+         * @param in The block, at the event's tag byte
+         * @param e The event before, which becomes the decoded event
+         */
+        template<typename reader_t>
+        auto decode(reader_t& in, event& e) -> void
+        {
+            const std::uint8_t tag = in.byte();
+            e.kind = static_cast<events::kind>(tag & 0x03);
+            if ((tag & run_changed) != 0) { e.run += in.varint(); }
+            if ((tag & stage_changed) != 0) {
+                e.stage = static_cast<std::int32_t>(e.stage
+                                                    + unzigzag(in.varint()));
+            }
+            if ((tag & turn_changed) != 0) {
+                e.turn = static_cast<std::uint32_t>(e.turn
+                                                    + unzigzag(in.varint()));
+            }
+
+            std::uint64_t entity = tag >> entity_shift;
+            if (entity == entity_escape) { entity += in.varint(); }
+            e.entity = static_cast<std::uint32_t>(e.entity + unzigzag(entity));
+            e.detail = has_detail(e.kind)
+                               ? static_cast<std::int32_t>(
+                                         unzigzag(in.varint()))
+                               : 0;
+            e.health = has_health(e.kind)
+                               ? static_cast<double>(unzigzag(in.varint()))
+                                         * health_quantum
+                               : 0.0;
+        }
+
+    } // namespace
+
+    auto compress(const std::span<const std::byte> in,
+                  std::vector<std::byte>& out) -> void
+    {
+        out.clear();
+        out.reserve(in.size() + in.size() / 255 + 16);
+
+        // Positions plus one of the last four bytes seen with each hash
+        std::array<std::uint32_t, std::size_t{1} << hash_bits> table{};
+        std::size_t anchor = 0;
+        std::size_t i = 0;
+        while (in.size() >= min_match && i <= in.size() - min_match) {
+            const std::uint32_t next = load32(in.data() + i);
+            std::uint32_t& slot = table[hash32(next)];
+            const std::size_t candidate = slot;
+            slot = static_cast<std::uint32_t>(i + 1);
+
+            if (candidate == 0 || i - (candidate - 1) > max_offset
+                || load32(in.data() + candidate - 1) != next) {
+                ++i;
+                continue;
+            }
+
+            const std::size_t from = candidate - 1;
+            std::size_t length = min_match;
+            while (i + length < in.size()
+                   && in[from + length] == in[i + length]) {
+                ++length;
+            }
+            put_sequence(in.subspan(anchor, i - anchor), i - from, length,
+                         out);
+            i += length;
+            anchor = i;
+        }
+        put_sequence(in.subspan(anchor), 0, 0, out);
+    }
+
+    auto decompress(const std::span<const std::byte> in,
+                    const std::span<std::byte> out) -> void
+    {
+        std::size_t ip = 0;
+        std::size_t op = 0;
+        const auto get_length = [&](std::size_t length) {
+            for (;;) {
+                if (ip >= in.size()) { throw corrupted(); }
+                const auto b = static_cast<std::uint8_t>(in[ip++]);
+                length += b;
+                if (b != 255) { return length; }
+            }
+        };
+
+        for (;;) {
+            if (ip >= in.size()) { throw corrupted(); }
+            const auto token = static_cast<std::uint8_t>(in[ip++]);
+
+            std::size_t literals = token >> 4;
+            if (literals == 15) { literals = get_length(literals); }
+            if (literals > in.size() - ip || literals > out.size() - op) {
+                throw corrupted();
+            }
+            std::memcpy(out.data() + op, in.data() + ip, literals);
+            ip += literals;
+            op += literals;
+
+            if (ip == in.size()) { break; }
+            if (in.size() - ip < 2) { throw corrupted(); }
+            const std::size_t offset = static_cast<std::size_t>(in[ip])
+                                       | static_cast<std::size_t>(in[ip + 1])
+                                                 << 8;
+            ip += 2;
+            std::size_t length = (token & 0x0f) + min_match;
+            if ((token & 0x0f) == 15) { length = get_length(length); }
+            if (offset == 0 || offset > op || length > out.size() - op) {
+                throw corrupted();
+            }
+
+            // A repeat may run into the bytes it is producing
+            std::byte* to = out.data() + op;
+            const std::byte* from = to - offset;
+            if (offset >= length) {
+                std::memcpy(to, from, length);
+            }
+            else {
+                for (std::size_t k = 0; k < length; ++k) { to[k] = from[k]; }
+            }
+            op += length;
+        }
+
+        if (op != out.size()) { throw corrupted(); }
+    }
+
+    writer::writer(const std::string& path)
+        : path_(path), temp_path_(path + ".tmp")
+    {
+        fd_ = ::open(temp_path_.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd_ < 0) {
+            throw std::runtime_error("could not open event log for writing");
+        }
+        block_.reserve(block_size + max_event_size);
+
+        // The header is filled in once everything else is written
+        const events::header blank{};
+        write_bytes(&blank, sizeof(blank));
+    }
+
+    writer::~writer()
+    {
+        if (fd_ >= 0) {
+            ::close(fd_);
+            ::unlink(temp_path_.c_str());
+        }
+    }
+
+    auto writer::add(const event& e) -> void
+    {
+        if (event_count_ != 0 && place_of(e) < place_of(last_)) {
+            throw std::invalid_argument("events must be in order");
+        }
+
+        // A block's first event is coded against the place the index gives
+        // for the block, so it takes no more than any other event
+        if (block_events_ == 0) {
+            blocks_.push_back({written_, 0, 0, 0, e.stage, e.run, e.turn, 0});
+            previous_ = event{};
+            previous_.run = e.run;
+            previous_.stage = e.stage;
+            previous_.turn = e.turn;
+        }
+
+        std::uint8_t tag = static_cast<std::uint8_t>(e.kind) & 0x03;
+        if (e.run != previous_.run) { tag |= run_changed; }
+        if (e.stage != previous_.stage) { tag |= stage_changed; }
+        if (e.turn != previous_.turn) { tag |= turn_changed; }
+        const std::uint64_t entity = zigzag(
+                static_cast<std::int64_t>(e.entity)
+                - static_cast<std::int64_t>(previous_.entity));
+        tag |= static_cast<std::uint8_t>(
+                std::min<std::uint64_t>(entity, entity_escape)
+                << entity_shift);
+
+        block_.push_back(static_cast<std::byte>(tag));
+        if ((tag & run_changed) != 0) {
+            put_varint(e.run - previous_.run, block_);
+        }
+        if ((tag & stage_changed) != 0) {
+            put_varint(zigzag(std::int64_t{e.stage} - previous_.stage),
+                       block_);
+        }
+        if ((tag & turn_changed) != 0) {
+            put_varint(zigzag(std::int64_t{e.turn} - previous_.turn), block_);
+        }
+        if (entity >= entity_escape) {
+            put_varint(entity - entity_escape, block_);
+        }
+        if (has_detail(e.kind)) { put_varint(zigzag(e.detail), block_); }
+        if (has_health(e.kind)) {
+            put_varint(zigzag(std::llround(e.health / health_quantum)),
+                       block_);
+        }
+
+        previous_ = e;
+        last_ = e;
+        ++block_events_;
+        ++event_count_;
+        if (block_.size() >= block_size) { flush_block(); }
+    }
+
+    auto writer::flush_block() -> void
+    {
+        block_record& block = blocks_.back();
+        block.raw_size = static_cast<std::uint32_t>(block_.size());
+        block.event_count = block_events_;
+
+        compress(block_, compressed_);
+        if (compressed_.size() < block_.size()) {
+            block.size = static_cast<std::uint32_t>(compressed_.size());
+            write_bytes(compressed_.data(), compressed_.size());
+        }
+        else {
+            block.size = block.raw_size;
+            write_bytes(block_.data(), block_.size());
+        }
+
+        block_.clear();
+        block_events_ = 0;
+    }
+
+    auto writer::write_bytes(const void* data, const std::size_t size) -> void
+    {
+        const auto* bytes = static_cast<const std::byte*>(data);
+        std::size_t done = 0;
+        while (done < size) {
+            const ::ssize_t n = ::write(fd_, bytes + done, size - done);
+            if (n <= 0) {
+                throw std::runtime_error("could not write event log");
+            }
+            done += static_cast<std::size_t>(n);
+        }
+        written_ += size;
+    }
+
+    auto writer::finish() -> void
+    {
+        if (fd_ < 0) { throw std::runtime_error("event log is finished"); }
+        if (block_events_ != 0) { flush_block(); }
+
+        // Blocks are written back to back, so the index starts 8-aligned
+        // only after padding
+        const std::size_t padding = (8 - written_ % 8) % 8;
+        const std::array<std::byte, 8> zeros{};
+        write_bytes(zeros.data(), padding);
+
+        events::header h{};
+        h.magic = magic;
+        h.version = format_version;
+        h.health_quantum = health_quantum;
+        h.event_count = event_count_;
+        h.block_count = blocks_.size();
+        h.index_offset = written_;
+        write_bytes(blocks_.data(), std::span(blocks_).size_bytes());
+        h.file_size = written_;
+
+        if (::pwrite(fd_, &h, sizeof(h), 0)
+            != static_cast<::ssize_t>(sizeof(h))) {
+            throw std::runtime_error("could not write event log");
+        }
+        ::close(fd_);
+        fd_ = -1;
+
+        if (std::rename(temp_path_.c_str(), path_.c_str()) != 0) {
+            ::unlink(temp_path_.c_str());
+            throw std::runtime_error("could not replace event log");
+        }
+    }
+
+    reader::reader(const std::string& path)
+    {
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) { throw std::runtime_error("event log not found"); }
+
+        struct stat info{};
+        if (::fstat(fd, &info) != 0
+            || static_cast<std::size_t>(info.st_size)
+                       < sizeof(events::header)) {
+            ::close(fd);
+            throw std::runtime_error("event log is truncated");
+        }
+
+        size_ = static_cast<std::size_t>(info.st_size);
+        void* mapping = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+
+        if (mapping == MAP_FAILED) {
+            throw std::runtime_error("could not map event log");
+        }
+        data_ = static_cast<const std::byte*>(mapping);
+
+        const events::header& h = header();
+        if (h.magic != magic) {
+            unmap();
+            throw std::runtime_error("not a potionmaker event log");
+        }
+        if (h.version != format_version || h.health_quantum != health_quantum) {
+            unmap();
+            throw std::runtime_error("unsupported event log version");
+        }
+        if (h.file_size != size_ || h.index_offset % 8 != 0
+            || h.index_offset > size_
+            || h.block_count != (size_ - h.index_offset) / sizeof(block_record)
+            || (size_ - h.index_offset) % sizeof(block_record) != 0) {
+            unmap();
+            throw std::runtime_error("event log is corrupted");
+        }
+
+        std::uint64_t events = 0;
+        for (const block_record& block: blocks()) {
+            if (block.offset < sizeof(events::header)
+                || block.offset + block.size > h.index_offset
+                || block.raw_size > block_size + max_event_size
+                || block.size > block.raw_size) {
+                unmap();
+                throw std::runtime_error("event log is corrupted");
+            }
+            events += block.event_count;
+        }
+        if (events != h.event_count) {
+            unmap();
+            throw std::runtime_error("event log is corrupted");
+        }
+
+        if (!blocks().empty()) { load_block(0); }
+    }
+
+    reader::~reader()
+    {
+        unmap();
+    }
+
+    auto reader::unmap() -> void
+    {
+        if (data_ != nullptr) {
+            ::munmap(const_cast<std::byte*>(data_), size_);
+            data_ = nullptr;
+        }
+    }
+
+    auto reader::header() const -> const events::header&
+    {
+        return *reinterpret_cast<const events::header*>(data_);
+    }
+
+    auto reader::blocks() const -> std::span<const block_record>
+    {
+        return {reinterpret_cast<const block_record*>(data_
+                                                      + header().index_offset),
+                static_cast<std::size_t>(header().block_count)};
+    }
+
+    auto reader::size() const -> std::uint64_t
+    {
+        return header().event_count;
+    }
+
+    auto reader::load_block(const std::size_t block) -> void
+    {
+        const block_record& record = blocks()[block];
+        const std::span<const std::byte> stored(data_ + record.offset,
+                                                record.size);
+
+        // Blocks that did not shrink are read straight from the mapping
+        if (record.size == record.raw_size) {
+            raw_ = stored;
+        }
+        else {
+            buffer_.resize(record.raw_size);
+            decompress(stored, buffer_);
+            raw_ = buffer_;
+        }
+
+        block_ = block;
+        cursor_ = 0;
+        remaining_ = record.event_count;
+        previous_ = event{};
+        previous_.run = record.run;
+        previous_.stage = record.stage;
+        previous_.turn = record.turn;
+    }
+
+    auto reader::seek(const std::uint64_t run, const std::int32_t stage,
+                      const std::uint32_t turn) -> void
+    {
+        const std::span<const block_record> index = blocks();
+        if (index.empty()) { return; }
+
+        // Events of one place may spill over from the block before the
+        // first block that starts there
+        const auto target = std::tuple(run, stage, turn);
+        const auto first = std::ranges::lower_bound(
+                index, target, {},
+                [](const block_record& b) { return place_of(b); });
+        load_block(first == index.begin()
+                           ? 0
+                           : static_cast<std::size_t>(first - index.begin()
+                                                      - 1));
+
+        event e;
+        for (;;) {
+            const std::size_t cursor = cursor_;
+            const std::uint32_t remaining = remaining_;
+            const std::size_t block = block_;
+            const event previous = previous_;
+            if (!next(e)) { return; }
+            if (place_of(e) >= target) {
+                if (block != block_) {
+                    load_block(block_);
+                    return;
+                }
+                cursor_ = cursor;
+                remaining_ = remaining;
+                previous_ = previous;
+                return;
+            }
+        }
+    }
+
+    auto reader::next(event& out) -> bool
+    {
+        while (remaining_ == 0) {
+            if (block_ + 1 >= blocks().size()) { return false; }
+            load_block(block_ + 1);
+        }
+
+        if (raw_.size() - cursor_ >= max_event_size) {
+            unchecked_reader in(raw_.data() + cursor_);
+            decode(in, previous_);
+            cursor_ = static_cast<std::size_t>(in.position() - raw_.data());
+        }
+        else {
+            varint_reader in(raw_, cursor_);
+            decode(in, previous_);
+        }
+
+        --remaining_;
+        out = previous_;
+        return true;
+    }
+
+    auto reader::next(const std::span<event> out) -> std::size_t
+    {
+        std::size_t count = 0;
+        while (count < out.size()) {
+            while (remaining_ == 0) {
+                if (block_ + 1 >= blocks().size()) { return count; }
+                load_block(block_ + 1);
+            }
+
+            // Events far enough from the end of the block skip the bounds
+            // checks, the rest of the block is read carefully
+            event e = previous_;
+            const std::size_t batch
+                    = std::min<std::size_t>(out.size() - count, remaining_);
+            std::size_t decoded = 0;
+            while (decoded < batch
+                   && raw_.size() - cursor_ >= max_event_size) {
+                unchecked_reader in(raw_.data() + cursor_);
+                decode(in, e);
+                cursor_ = static_cast<std::size_t>(in.position()
+                                                   - raw_.data());
+                out[count + decoded++] = e;
+            }
+            while (decoded < batch) {
+                varint_reader in(raw_, cursor_);
+                decode(in, e);
+                out[count + decoded++] = e;
+            }
+
+            remaining_ -= static_cast<std::uint32_t>(decoded);
+            previous_ = e;
+            count += decoded;
+        }
+        return count;
+    }
+
+} // namespace potmaker::events
@@ -0,0 +1,258 @@
+#ifndef EVENT_LOG_HH
+#define EVENT_LOG_HH
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace potmaker::events {
+
+    /*
+     * Event logs hold the combat events of many runs, sorted by run, stage
+     * and turn:
+     *
+     * [header][block...][block_record...]
+     *
+     * Events are packed into blocks of about block_size bytes. Within a
+     * block each event starts with a tag byte holding its kind and which of
+     * run, stage and turn changed since the event before. Changed fields,
+     * the entity and the detail follow as zigzagged differences or values
+     * in variable-length integers, and health as a whole number of
+     * health_quantum. Every block starts from zero, so it decodes on its
+     * own, and is then compressed with a small LZ77 coder.
+     *
+     * The block records index the blocks by their first event, so a reader
+     * can jump to any (run, stage, turn) and decode from there.
+     *
+     * Each event's fields are found only by decoding the ones before it, so
+     * reading is one long chain of dependent loads and branches on the tag.
+     * That holds it to a few tens of millions of events per second, well
+     * short of what memory could deliver; getting closer would take a
+     * format with fixed-width or grouped fields
+     */
+
+    constexpr std::array<char, 8> magic{'P', 'O', 'T', 'M', 'K', 'E', 'V', 'T'};
+    constexpr std::uint32_t format_version = 1;
+    constexpr std::size_t block_size = 64 * 1024;
+    // Health changes are stored to the nearest tenth of a point
+    constexpr double health_quantum = 0.1;
+
+    /**
+     * What an event records
+     */
+    enum class kind : std::uint8_t {
+        spawn, // An enemy joined the battle: detail is its type, health its
+               // health
+        action, // The player acted on the entity: detail is the
+                // battle_action kind
+        health, // The entity's health changed by health over the turn
+        death // The entity fell
+    };
+
+    /**
+     * Something that happened in a battle
+     */
+    struct event {
+        // The run's seed
+        std::uint64_t run = 0;
+        std::int32_t stage = 0;
+        // The turn, from 1. Events before the first turn have turn 0
+        std::uint32_t turn = 0;
+        events::kind kind = kind::health;
+        // 0 for the player, otherwise 1 + the enemy's place in the party the
+        // battle started with
+        std::uint32_t entity = 0;
+        std::int32_t detail = 0;
+        double health = 0.0;
+
+        auto operator==(const event&) const -> bool = default;
+    };
+
+    struct header {
+        std::array<char, 8> magic;
+        std::uint32_t version;
+        std::uint32_t reserved;
+        double health_quantum;
+        std::uint64_t event_count;
+        std::uint64_t block_count;
+        // Where the block records start, right after the last block
+        std::uint64_t index_offset;
+        std::uint64_t file_size;
+    };
+
+    struct block_record {
+        std::uint64_t offset;
+        // The size of the block in the file, and decompressed. A block that
+        // would not shrink is stored as it is, with both sizes equal
+        std::uint32_t size;
+        std::uint32_t raw_size;
+        std::uint32_t event_count;
+        // The first event's place
+        std::int32_t stage;
+        std::uint64_t run;
+        std::uint32_t turn;
+        std::uint32_t reserved;
+    };
+
+    static_assert(std::is_trivially_copyable_v<header>);
+    static_assert(sizeof(header) % 8 == 0);
+    static_assert(sizeof(block_record) % 8 == 0);
+
+    /**
+     * Compresses bytes with a byte-oriented LZ77 coder. Repeats are found
+     * through a hash of the next four bytes, so compressing takes one pass
+     * @param in The bytes
+     * @param out Receives the compressed bytes
+     */
+    auto compress(std::span<const std::byte> in, std::vector<std::byte>& out)
+            -> void;
+
+    /**
+     * Undoes compress
+     * @param in The compressed bytes
+     * @param out Receives the bytes. Its size must be exactly what was
+     * compressed
+     * @throws std::runtime_error If the bytes are malformed
+     */
+    auto decompress(std::span<const std::byte> in, std::span<std::byte> out)
+            -> void;
+
+    /**
+     * Writes an event log event by event. Blocks go to disk as soon as they
+     * fill up
+     */
+    class writer {
+    public:
+        /**
+         * Starts an event log. Nothing appears at the path until finish
+         * @param path The destination
+         * @throws std::runtime_error If the file could not be created
+         */
+        explicit writer(const std::string& path);
+
+        /**
+         * Abandons the log if it was not finished
+         */
+        ~writer();
+
+        writer(const writer&) = delete;
+        auto operator=(const writer&) -> writer& = delete;
+
+        /**
+         * Appends an event
+         * @param e The event
+         * @throws std::invalid_argument If the event comes before the last
+         * one in run, stage and turn order
+         */
+        auto add(const event& e) -> void;
+
+        /**
+         * Writes out the last block and the index, and moves the file into
+         * place
+         * @throws std::runtime_error If the file could not be written
+         */
+        auto finish() -> void;
+
+    private:
+        /**
+         * Compresses the block being built and writes it out
+         */
+        auto flush_block() -> void;
+
+        auto write_bytes(const void* data, std::size_t size) -> void;
+
+        std::string path_;
+        std::string temp_path_;
+        int fd_ = -1;
+        std::uint64_t written_ = 0;
+        std::uint64_t event_count_ = 0;
+        std::vector<block_record> blocks_;
+        // The block being built, and the event before in it
+        std::vector<std::byte> block_;
+        std::uint32_t block_events_ = 0;
+        event previous_;
+        // The last event added, which the next may not come before
+        event last_;
+        std::vector<std::byte> compressed_;
+    };
+
+    /**
+     * Maps an event log into memory and decodes it one event at a time,
+     * one block at a time
+     */
+    class reader {
+    public:
+        /**
+         * Opens and validates an event log. Reading starts at the first
+         * event
+         * @param path The event log
+         * @throws std::runtime_error If the file is missing or malformed
+         */
+        explicit reader(const std::string& path);
+        ~reader();
+
+        reader(const reader&) = delete;
+        auto operator=(const reader&) -> reader& = delete;
+
+        /**
+         * @return How many events the log holds
+         */
+        [[nodiscard]] auto size() const -> std::uint64_t;
+
+        /**
+         * Moves to the first event at or after a place. Only the block that
+         * holds it is decoded to get there
+         * @param run The run
+         * @param stage The stage
+         * @param turn The turn
+         */
+        auto seek(std::uint64_t run, std::int32_t stage, std::uint32_t turn)
+                -> void;
+
+        /**
+         * Decodes the next event
+         * @param out Receives the event
+         * @return False if there are no more events
+         * @throws std::runtime_error If the log is corrupted
+         */
+        auto next(event& out) -> bool;
+
+        /**
+         * Decodes the next events, as many as fit. Decoding in batches
+         * saves the per-call overhead of next(event&)
+         * @param out Receives the events
+         * @return How many were decoded, fewer than fit only at the end of
+         * the log
+         * @throws std::runtime_error If the log is corrupted
+         */
+        auto next(std::span<event> out) -> std::size_t;
+
+    private:
+        auto unmap() -> void;
+
+        [[nodiscard]] auto header() const -> const events::header&;
+
+        [[nodiscard]] auto blocks() const -> std::span<const block_record>;
+
+        /**
+         * Decompresses a block and starts reading it
+         */
+        auto load_block(std::size_t block) -> void;
+
+        const std::byte* data_ = nullptr;
+        std::size_t size_ = 0;
+        // The block being read: its number, its bytes, and how far in
+        std::size_t block_ = 0;
+        std::span<const std::byte> raw_;
+        std::size_t cursor_ = 0;
+        std::uint32_t remaining_ = 0;
+        event previous_;
+        std::vector<std::byte> buffer_;
+    };
+
+} // namespace potmaker::events
+
+#endif // EVENT_LOG_HH
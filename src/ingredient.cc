@@ -1,7 +1,10 @@
 #include "ingredient.hh"
+#include "balance.hh"
 #include "entity.hh"
+#include "potion_program.hh"
 #include "status_effect.hh"
 #include "util.hh"
+#include <cstddef>
 #include <cstdint>
 #include <format>
 #include <sstream>
@@ -10,150 +13,347 @@
 
 namespace potmaker {
 
-    ingredient::ingredient(std::string name, const std::int32_t potency)
-        : named(std::move(name)), potency_(potency)
+    namespace {
+
+        /**
+         * @return The health a status effect takes from its bearer over its
+         * whole duration, negative if it gives health instead
+         */
+        template<typename effect_t>
+        auto effect_value(const int turns, const int potency) -> double
+        {
+            return -to_double(effect_t(turns, potency).total_damage_per_turn())
+                   * turns;
+        }
+
+    } // namespace
+
+    ingredient::ingredient(std::string name, const element_type element,
+                           const std::int32_t potency)
+        : named(std::move(name)), element_(element), potency_(potency)
     {}
 
+    auto ingredient::compile(potion_program& program) -> void
+    {
+        program.apply_ingredient(*this);
+    }
+
+    auto ingredient::expected_value() const -> double
+    {
+        return 10.0 * potency_;
+    }
+
     auto ingredient::potency() const -> std::int32_t
     {
         return potency_;
     }
 
-#define POTMK_INGREDIENT_CONSTRUCTOR(ctor_name)                                \
+    auto ingredient::element() const -> element_type
+    {
+        return element_;
+    }
+
+#define POTMK_INGREDIENT_CONSTRUCTOR(ctor_name, type)                          \
     ctor_name::ctor_name(std::string name, const std::int32_t potency)         \
-        : ingredient(std::move(name), potency)                                 \
+        : ingredient(std::move(name), type, potency)                           \
     {}
 
-    POTMK_INGREDIENT_CONSTRUCTOR(flaming_ingredient);
-    POTMK_INGREDIENT_CONSTRUCTOR(chilling_ingredient);
-    POTMK_INGREDIENT_CONSTRUCTOR(poisonous_ingredient);
-    POTMK_INGREDIENT_CONSTRUCTOR(withering_ingredient);
-    POTMK_INGREDIENT_CONSTRUCTOR(healing_ingredient);
-    POTMK_INGREDIENT_CONSTRUCTOR(regenerative_ingredient);
-    POTMK_INGREDIENT_CONSTRUCTOR(protective_ingredient);
-    POTMK_INGREDIENT_CONSTRUCTOR(strengthening_ingredient);
-    POTMK_INGREDIENT_CONSTRUCTOR(cleansing_ingredient);
-    POTMK_INGREDIENT_CONSTRUCTOR(joker_ingredient);
+    POTMK_INGREDIENT_CONSTRUCTOR(flaming_ingredient, element_type::fire);
+    POTMK_INGREDIENT_CONSTRUCTOR(chilling_ingredient, element_type::ice);
+    POTMK_INGREDIENT_CONSTRUCTOR(poisonous_ingredient, element_type::nature);
+    POTMK_INGREDIENT_CONSTRUCTOR(withering_ingredient,
+                                 element_type::underworld);
+    POTMK_INGREDIENT_CONSTRUCTOR(healing_ingredient, element_type::healing);
+    POTMK_INGREDIENT_CONSTRUCTOR(regenerative_ingredient,
+                                 element_type::regenerating);
+    POTMK_INGREDIENT_CONSTRUCTOR(protective_ingredient,
+                                 element_type::protective);
+    POTMK_INGREDIENT_CONSTRUCTOR(strengthening_ingredient,
+                                 element_type::strengthening);
+    POTMK_INGREDIENT_CONSTRUCTOR(cleansing_ingredient, element_type::purifying);
+    POTMK_INGREDIENT_CONSTRUCTOR(joker_ingredient, element_type::chaotic);
 
     // FLAMING - High damage burst with chance to burn
     auto flaming_ingredient::on_applied(entity& e) -> void
     {
         // Always deal immediate fire damage (scaled with potency)
-        const double fire_dmg = 15.0 * potency_;
-        print_action(std::format("{} explodes in flames on {}! (-{:.1f} HP)",
-                                 name_, e.name(), fire_dmg));
+        const double fire_dmg = active_balance().fire_damage * potency_;
+        print_action("{} explodes in flames on {}! (-{:.1f} HP)", name_,
+                     e.name(), fire_dmg);
         e.modify_health(-fire_dmg);
 
         // 30% chance to apply powerful burn
         if (roll_chances(3)) {
-            print_action(std::format("{} is burning!", e.name()));
+            print_action("{} is burning!", e.name());
             e.add_status_effect(burning(3 * potency_, potency_ * 1.5));
         }
     }
 
+    auto flaming_ingredient::compile(potion_program& program) -> void
+    {
+        const std::int32_t potency = program.potency(potency_);
+        const double fire_dmg = active_balance().fire_damage * potency;
+        program.say(std::format("{} explodes in flames on ", name_),
+                    std::format("! (-{:.1f} HP)", fire_dmg));
+        program.modify_health(-fire_dmg);
+
+        const std::size_t miss = program.skip_on_roll(3, false);
+        program.say("", " is burning!");
+        program.add_effect(burning(3 * potency, potency * 1.5));
+        program.land(miss);
+    }
+
+    auto flaming_ingredient::expected_value() const -> double
+    {
+        return active_balance().fire_damage * potency_
+               + effect_value<burning>(3 * potency_,
+                                       static_cast<int>(potency_ * 1.5))
+                         / 3;
+    }
+
     // CHILLING - Freeze chance with slowing effect
     auto chilling_ingredient::on_applied(entity& e) -> void
     {
         // Small immediate damage
-        const double chill_dmg = 5.0 * potency_;
-        print_action(std::format("{} chills {}! (-{:.1f} HP)", name_, e.name(),
-                                 chill_dmg));
+        const double chill_dmg = active_balance().chill_damage * potency_;
+        print_action("{} chills {}! (-{:.1f} HP)", name_, e.name(), chill_dmg);
         e.modify_health(-chill_dmg);
 
         // 40% chance to freeze (shorter duration but strong effect)
         if (roll_chances(5)) {
-            print_action(std::format("{} is frozen solid!", e.name()));
+            print_action("{} is frozen solid!", e.name());
             e.add_status_effect(freezing(1 * potency_, potency_));
         }
         else if (roll_chances(2)) { // 50% chance for minor slow
-            print_action(std::format("{} is slowed!", e.name()));
+            print_action("{} is slowed!", e.name());
             e.add_status_effect(freezing(1, 1)); // Weak version
         }
     }
 
+    auto chilling_ingredient::compile(potion_program& program) -> void
+    {
+        const std::int32_t potency = program.potency(potency_);
+        const double chill_dmg = active_balance().chill_damage * potency;
+        program.say(std::format("{} chills ", name_),
+                    std::format("! (-{:.1f} HP)", chill_dmg));
+        program.modify_health(-chill_dmg);
+
+        const std::size_t no_freeze = program.skip_on_roll(5, false);
+        program.say("", " is frozen solid!");
+        program.add_effect(freezing(1 * potency, potency));
+        const std::size_t frozen = program.skip();
+
+        program.land(no_freeze);
+        const std::size_t no_slow = program.skip_on_roll(2, false);
+        program.say("", " is slowed!");
+        program.add_effect(freezing(1, 1));
+
+        program.land(no_slow);
+        program.land(frozen);
+    }
+
+    auto chilling_ingredient::expected_value() const -> double
+    {
+        return active_balance().chill_damage * potency_
+               + effect_value<freezing>(1 * potency_, potency_) / 5
+               + effect_value<freezing>(1, 1) * 4 / 5 / 2;
+    }
+
     // POISONOUS - Reliable poison application
     auto poisonous_ingredient::on_applied(entity& e) -> void
     {
         // Moderate initial damage
-        const double poison_dmg = 8.0 * potency_;
-        print_action(std::format("{} poisons {}! (-{:.1f} HP)", name_, e.name(),
-                                 poison_dmg));
+        const double poison_dmg = active_balance().poison_damage * potency_;
+        print_action("{} poisons {}! (-{:.1f} HP)", name_, e.name(),
+                     poison_dmg);
         e.modify_health(-poison_dmg);
 
         // 75% chance to poison (high success rate)
         if (!roll_chances(4)) { // 3 in 4 chance
-            print_action(std::format("{} is poisoned!", e.name()));
+            print_action("{} is poisoned!", e.name());
             e.add_status_effect(poison(4 * potency_, potency_));
         }
     }
 
+    auto poisonous_ingredient::compile(potion_program& program) -> void
+    {
+        const std::int32_t potency = program.potency(potency_);
+        const double poison_dmg = active_balance().poison_damage * potency;
+        program.say(std::format("{} poisons ", name_),
+                    std::format("! (-{:.1f} HP)", poison_dmg));
+        program.modify_health(-poison_dmg);
+
+        const std::size_t resisted = program.skip_on_roll(4, true);
+        program.say("", " is poisoned!");
+        program.add_effect(poison(4 * potency, potency));
+        program.land(resisted);
+    }
+
+    auto poisonous_ingredient::expected_value() const -> double
+    {
+        return active_balance().poison_damage * potency_
+               + effect_value<poison>(4 * potency_, potency_) * 3 / 4;
+    }
+
     // WITHERING - Chance for strong debuff
     auto withering_ingredient::on_applied(entity& e) -> void
     {
         // Moderate initial damage
-        const double wither_dmg = 10.0 * potency_;
-        print_action(std::format("{} withers {}! (-{:.1f} HP)", name_, e.name(),
-                                 wither_dmg));
+        const double wither_dmg = active_balance().wither_damage * potency_;
+        print_action("{} withers {}! (-{:.1f} HP)", name_, e.name(),
+                     wither_dmg);
         e.modify_health(-wither_dmg);
 
         // 33% chance for strong wither
         if (roll_chances(3)) {
-            print_action(std::format("{} is withered!", e.name()));
+            print_action("{} is withered!", e.name());
             e.add_status_effect(wither(2 * potency_, potency_ * 2));
         }
     }
 
+    auto withering_ingredient::compile(potion_program& program) -> void
+    {
+        const std::int32_t potency = program.potency(potency_);
+        const double wither_dmg = active_balance().wither_damage * potency;
+        program.say(std::format("{} withers ", name_),
+                    std::format("! (-{:.1f} HP)", wither_dmg));
+        program.modify_health(-wither_dmg);
+
+        const std::size_t miss = program.skip_on_roll(3, false);
+        program.say("", " is withered!");
+        program.add_effect(wither(2 * potency, potency * 2));
+        program.land(miss);
+    }
+
+    auto withering_ingredient::expected_value() const -> double
+    {
+        return active_balance().wither_damage * potency_
+               + effect_value<wither>(2 * potency_, potency_ * 2) / 3;
+    }
+
     // HEALING - Direct healing (no chance to fail)
     auto healing_ingredient::on_applied(entity& e) -> void
     {
-        const double heal_amt = 20.0 * potency_;
-        print_action(std::format("{} heals {}! (+{:.1f} HP)", name_, e.name(),
-                                 heal_amt));
+        const double heal_amt = active_balance().heal_amount * potency_;
+        print_action("{} heals {}! (+{:.1f} HP)", name_, e.name(), heal_amt);
         e.modify_health(heal_amt);
     }
 
+    auto healing_ingredient::compile(potion_program& program) -> void
+    {
+        const std::int32_t potency = program.potency(potency_);
+        const double heal_amt = active_balance().heal_amount * potency;
+        program.say(std::format("{} heals ", name_),
+                    std::format("! (+{:.1f} HP)", heal_amt));
+        program.modify_health(heal_amt);
+    }
+
+    auto healing_ingredient::expected_value() const -> double
+    {
+        return -active_balance().heal_amount * potency_;
+    }
+
     // REGENERATIVE - Guaranteed regeneration
     auto regenerative_ingredient::on_applied(entity& e) -> void
     {
-        print_action(std::format("{} regenerates {}!", name_, e.name()));
+        print_action("{} regenerates {}!", name_, e.name());
         e.add_status_effect(regeneration(3 * potency_, potency_));
 
         // Small initial heal as well
-        const double initial_heal = 5.0 * potency_;
+        const double initial_heal = active_balance().regen_heal * potency_;
         e.modify_health(initial_heal);
     }
 
+    auto regenerative_ingredient::compile(potion_program& program) -> void
+    {
+        const std::int32_t potency = program.potency(potency_);
+        program.say(std::format("{} regenerates ", name_), "!");
+        program.add_effect(regeneration(3 * potency, potency));
+        program.modify_health(active_balance().regen_heal * potency);
+    }
+
+    auto regenerative_ingredient::expected_value() const -> double
+    {
+        return -active_balance().regen_heal * potency_
+               + effect_value<regeneration>(3 * potency_, potency_);
+    }
+
     // PROTECTIVE - Guaranteed protection
     auto protective_ingredient::on_applied(entity& e) -> void
     {
-        print_action(std::format("{} protects {}!", name_, e.name()));
+        print_action("{} protects {}!", name_, e.name());
         e.add_status_effect(protection(3 * potency_, potency_));
 
         // Small damage reduction immediately
-        const double damage_reduction = 0.1 * potency_;
+        const double damage_reduction
+                = active_balance().protect_fraction * potency_;
         e.modify_health(damage_reduction * e.max_health());
     }
 
+    auto protective_ingredient::compile(potion_program& program) -> void
+    {
+        const std::int32_t potency = program.potency(potency_);
+        program.say(std::format("{} protects ", name_), "!");
+        program.add_effect(protection(3 * potency, potency));
+        program.modify_health_fraction(active_balance().protect_fraction
+                                       * potency);
+    }
+
+    auto protective_ingredient::expected_value() const -> double
+    {
+        return -active_balance().protect_fraction * potency_
+               * reference_max_health;
+    }
+
     // STRENGTHENING - Guaranteed strength boost
     auto strengthening_ingredient::on_applied(entity& e) -> void
     {
-        print_action(std::format("{} strengthens {}!", name_, e.name()));
+        print_action("{} strengthens {}!", name_, e.name());
         e.add_status_effect(strength(2 * potency_, potency_));
     }
 
+    auto strengthening_ingredient::compile(potion_program& program) -> void
+    {
+        const std::int32_t potency = program.potency(potency_);
+        program.say(std::format("{} strengthens ", name_), "!");
+        program.add_effect(strength(2 * potency, potency));
+    }
+
+    auto strengthening_ingredient::expected_value() const -> double
+    {
+        // Strength changes no health by itself
+        return 0.0;
+    }
+
     // CLEANSING - Guaranteed cleanse
     auto cleansing_ingredient::on_applied(entity& e) -> void
     {
-        print_action(std::format("{} cleanses {}!", name_, e.name()));
+        print_action("{} cleanses {}!", name_, e.name());
         e.clear_status_effects();
 
         // Small heal if cleansing was needed
         if (!e.status_effects().empty()) {
-            const double cleanse_heal = 5.0 * potency_;
+            const double cleanse_heal
+                    = active_balance().cleanse_heal * potency_;
             e.modify_health(cleanse_heal);
         }
     }
 
+    auto cleansing_ingredient::compile(potion_program& program) -> void
+    {
+        program.say(std::format("{} cleanses ", name_), "!");
+        program.clear_effects();
+
+        // on_applied only heals if effects remain after clearing them, which
+        // never happens
+    }
+
+    auto cleansing_ingredient::expected_value() const -> double
+    {
+        // Cleansing never heals, see compile
+        return 0.0;
+    }
+
     // JOKER - Random powerful effect
     auto joker_ingredient::on_applied(entity& e) -> void
     {
@@ -161,31 +361,76 @@ namespace potmaker {
 
         switch (effect) {
         case 1: // Mega burn
-            print_action(std::format("{} spontaneously combusts!", e.name()));
+            print_action("{} spontaneously combusts!", e.name());
             e.add_status_effect(burning(5 * potency_, potency_ * 2));
             break;
         case 2: // Deep freeze
-            print_action(std::format("{} is flash frozen!", e.name()));
+            print_action("{} is flash frozen!", e.name());
             e.add_status_effect(freezing(3 * potency_, potency_ * 2));
             break;
         case 3: // Super heal
-            print_action(
-                    std::format("{} is supercharged with health!", e.name()));
-            e.modify_health(30 * potency_);
+            print_action("{} is supercharged with health!", e.name());
+            e.modify_health(active_balance().joker_heal * potency_);
             break;
         case 4: // Stat flip
-            print_action(std::format("{}'s stats go wild!", e.name()));
-            e.modify_health(random_double(-20, 20) * potency_);
+            print_action("{}'s stats go wild!", e.name());
+            e.modify_health(combat_value(random_double(-20, 20)) * potency_);
             break;
         case 5: // Lucky strike
-            print_action(std::format("{} gets a lucky break!", e.name()));
-            e.modify_health(-25 * potency_);
+            print_action("{} gets a lucky break!", e.name());
+            e.modify_health(-active_balance().joker_damage * potency_);
             break;
         default:
             throw std::invalid_argument("invalid chaos effect generation");
         }
     }
 
+    auto joker_ingredient::compile(potion_program& program) -> void
+    {
+        const std::int32_t potency = program.potency(potency_);
+        const std::size_t branch = program.choose(5);
+        std::size_t done[4];
+
+        program.land(branch);
+        program.say("", " spontaneously combusts!");
+        program.add_effect(burning(5 * potency, potency * 2));
+        done[0] = program.skip();
+
+        program.land(branch + 1);
+        program.say("", " is flash frozen!");
+        program.add_effect(freezing(3 * potency, potency * 2));
+        done[1] = program.skip();
+
+        program.land(branch + 2);
+        program.say("", " is supercharged with health!");
+        program.modify_health(active_balance().joker_heal * potency);
+        done[2] = program.skip();
+
+        program.land(branch + 3);
+        program.say("", "'s stats go wild!");
+        program.modify_health_random(-20, 20, potency);
+        done[3] = program.skip();
+
+        program.land(branch + 4);
+        program.say("", " gets a lucky break!");
+        program.modify_health(-active_balance().joker_damage * potency);
+
+        for (const std::size_t skip: done) { program.land(skip); }
+    }
+
+    auto joker_ingredient::expected_value() const -> double
+    {
+        // Each of the five outcomes is equally likely. The stat flip's
+        // random_double(-20, 20) changes nothing on average. Each outcome
+        // is divided on its own, the way potion_program::expected_damage
+        // weighs them, so content file jokers are valued the same
+        const balance_params& balance = active_balance();
+        return effect_value<burning>(5 * potency_, potency_ * 2) / 5
+               + effect_value<freezing>(3 * potency_, potency_ * 2) / 5
+               - balance.joker_heal * potency_ / 5
+               + balance.joker_damage * potency_ / 5;
+    }
+
     auto to_description(ingredient const& ing) -> std::string
     {
         std::stringstream ss;
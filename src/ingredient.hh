@@ -12,6 +12,7 @@ namespace potmaker {
 
     template<element_type element_t> class status_effect;
     class entity;
+    class potion_program;
 
     /**
      * Can be mixed into a potion to inflict special status effects on entities
@@ -21,9 +22,11 @@ namespace potmaker {
         /**
          * Constructs a new ingredient
          * @param name The name of the ingredient
+         * @param element The element of the ingredient
          * @param potency The potency of the ingredient
          */
-        explicit ingredient(std::string name, std::int32_t potency);
+        explicit ingredient(std::string name, element_type element,
+                            std::int32_t potency);
 
         /**
          * Determines what happens to an entity when they are affected by a
@@ -32,13 +35,42 @@ namespace potmaker {
          */
         virtual auto on_applied(entity& e) -> void = 0;
 
+        /**
+         * Appends what on_applied does to a compiled potion. Ingredients
+         * that do not override this are compiled into a call to on_applied
+         * @param program The potion being compiled
+         */
+        virtual auto compile(potion_program& program) -> void;
+
+        /**
+         * Estimates how much health a potion with this ingredient takes
+         * from the enemy it is thrown at, counting its effects over their
+         * whole duration and weighing chances by their odds. Healing,
+         * regeneration and protection give the enemy health, so they are
+         * worth less than nothing. Used to judge what is worth buying and
+         * throwing. Ingredients that do not override this are worth 10 per
+         * point of potency
+         * @return The expected health taken, negative if health is given
+         */
+        [[nodiscard]] virtual auto expected_value() const -> double;
+
+        // Fractions of max health are valued against the player's starting
+        // max health
+        static constexpr double reference_max_health = 100.0;
+
         /**
          * @return The numerical potency of this ingredient
          */
         [[nodiscard]] auto potency() const -> std::int32_t;
 
+        /**
+         * @return The element of this ingredient
+         */
+        [[nodiscard]] auto element() const -> element_type;
+
     protected:
         std::string name_;
+        element_type element_;
         std::int32_t potency_;
     };
 
@@ -46,30 +78,45 @@ namespace potmaker {
     public:
         explicit flaming_ingredient(std::string name, std::int32_t potency);
         auto on_applied(entity& e) -> void override;
+        auto compile(potion_program& program) -> void override;
+
+        [[nodiscard]] auto expected_value() const -> double override;
     };
 
     class chilling_ingredient final : public ingredient {
     public:
         explicit chilling_ingredient(std::string name, std::int32_t potency);
         auto on_applied(entity& e) -> void override;
+        auto compile(potion_program& program) -> void override;
+
+        [[nodiscard]] auto expected_value() const -> double override;
     };
 
     class poisonous_ingredient final : public ingredient {
     public:
         explicit poisonous_ingredient(std::string name, std::int32_t potency);
         auto on_applied(entity& e) -> void override;
+        auto compile(potion_program& program) -> void override;
+
+        [[nodiscard]] auto expected_value() const -> double override;
     };
 
     class withering_ingredient final : public ingredient {
     public:
         explicit withering_ingredient(std::string name, std::int32_t potency);
         auto on_applied(entity& e) -> void override;
+        auto compile(potion_program& program) -> void override;
+
+        [[nodiscard]] auto expected_value() const -> double override;
     };
 
     class healing_ingredient final : public ingredient {
     public:
         explicit healing_ingredient(std::string name, std::int32_t potency);
         auto on_applied(entity& e) -> void override;
+        auto compile(potion_program& program) -> void override;
+
+        [[nodiscard]] auto expected_value() const -> double override;
     };
 
     class regenerative_ingredient final : public ingredient {
@@ -77,12 +124,18 @@ namespace potmaker {
         explicit regenerative_ingredient(std::string name,
                                          std::int32_t potency);
         auto on_applied(entity& e) -> void override;
+        auto compile(potion_program& program) -> void override;
+
+        [[nodiscard]] auto expected_value() const -> double override;
     };
 
     class protective_ingredient final : public ingredient {
     public:
         explicit protective_ingredient(std::string name, std::int32_t potency);
         auto on_applied(entity& e) -> void override;
+        auto compile(potion_program& program) -> void override;
+
+        [[nodiscard]] auto expected_value() const -> double override;
     };
 
     class strengthening_ingredient final : public ingredient {
@@ -90,6 +143,9 @@ namespace potmaker {
         explicit strengthening_ingredient(std::string name,
                                           std::int32_t potency);
         auto on_applied(entity& e) -> void override;
+        auto compile(potion_program& program) -> void override;
+
+        [[nodiscard]] auto expected_value() const -> double override;
     };
 
     class cleansing_ingredient final : public ingredient {
@@ -97,6 +153,10 @@ namespace potmaker {
         explicit cleansing_ingredient(std::string name, std::int32_t potency);
 
         auto on_applied(entity& e) -> void override;
+
+        auto compile(potion_program& program) -> void override;
+
+        [[nodiscard]] auto expected_value() const -> double override;
     };
 
     class joker_ingredient final : public ingredient {
@@ -104,6 +164,10 @@ namespace potmaker {
         explicit joker_ingredient(std::string name, std::int32_t potency);
 
         auto on_applied(entity& e) -> void override;
+
+        auto compile(potion_program& program) -> void override;
+
+        [[nodiscard]] auto expected_value() const -> double override;
     };
 
     [[nodiscard]] auto to_description(ingredient const& ing) -> std::string;
@@ -0,0 +1,182 @@
+#include "inventory.hh"
+#include "ingredient.hh"
+#include "state_hash.hh"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+#include <typeindex>
+#include <typeinfo>
+#include <utility>
+#include <vector>
+
+namespace potmaker {
+
+    auto inventory::add(ingredient* ing) -> std::size_t
+    {
+        const std::type_index type(typeid(*ing));
+        const std::size_t key
+                = key_of(type, ing->element(), ing->potency(), ing->name());
+
+        const auto [first, last] = by_key_.equal_range(key);
+        for (auto it = first; it != last; ++it) {
+            stack& s = stacks_[it->second];
+            if (fits(s, type, *ing)) {
+                if (s.units.empty()) { --empty_stacks_; }
+                s.units.push_back(ing);
+                ++size_;
+                state_hash_ += s.hash;
+                return it->second;
+            }
+        }
+
+        const std::uint64_t hash
+                = hash_key(hash_part::ingredient,
+                           hash_name(ing->name()) ^ type.hash_code(),
+                           potency_key(ing->element(), ing->potency()));
+        stacks_.push_back({type, ing->element(), ing->potency(),
+                           std::string(ing->name()), hash, {ing}});
+        ++size_;
+        state_hash_ += hash;
+        index(stacks_.size() - 1);
+        return stacks_.size() - 1;
+    }
+
+    auto inventory::take(const std::size_t stack) -> ingredient*
+    {
+        auto& s = stacks_.at(stack);
+        if (s.units.empty()) { return nullptr; }
+
+        ingredient* ing = s.units.back();
+        s.units.pop_back();
+        if (s.units.empty()) { ++empty_stacks_; }
+        --size_;
+        state_hash_ -= s.hash;
+        return ing;
+    }
+
+    auto inventory::take(const std::span<const std::size_t> picks)
+            -> ingredient_list
+    {
+        ingredient_list taken;
+        taken.reserve(picks.size());
+
+        for (const std::size_t pick: picks) {
+            if (ingredient* ing = take(pick)) { taken.push_back(ing); }
+        }
+
+        return taken;
+    }
+
+    auto inventory::put_back(const std::size_t stack, ingredient* ing) -> void
+    {
+        auto& s = stacks_.at(stack);
+        if (!fits(s, std::type_index(typeid(*ing)), *ing)) {
+            throw std::invalid_argument(
+                    "the ingredient does not belong on the stack");
+        }
+
+        if (s.units.empty()) { --empty_stacks_; }
+        s.units.push_back(ing);
+        ++size_;
+        state_hash_ += s.hash;
+    }
+
+    auto inventory::compact() -> void
+    {
+        if (empty_stacks_ == 0) { return; }
+        std::erase_if(stacks_, [](const stack& s) { return s.units.empty(); });
+        empty_stacks_ = 0;
+
+        by_key_.clear();
+        for (auto& stacks: by_element_) { stacks.clear(); }
+        by_potency_.clear();
+
+        for (std::size_t i = 0; i < stacks_.size(); ++i) { index(i); }
+    }
+
+    auto inventory::compact_if_sparse() -> bool
+    {
+        if (empty_stacks_ < min_sparse_stacks
+            || empty_stacks_ * 4 < stacks_.size()) {
+            return false;
+        }
+        compact();
+        return true;
+    }
+
+    auto inventory::stacks() const -> const std::vector<stack>&
+    {
+        return stacks_;
+    }
+
+    auto inventory::stacks_with(const element_type element) const
+            -> std::span<const std::size_t>
+    {
+        return by_element_.at(static_cast<std::size_t>(element));
+    }
+
+    auto inventory::stacks_with(const element_type element,
+                                const std::int32_t potency) const
+            -> std::span<const std::size_t>
+    {
+        const auto it = by_potency_.find(potency_key(element, potency));
+        if (it == by_potency_.end()) { return {}; }
+        return it->second;
+    }
+
+    auto inventory::size() const -> std::size_t
+    {
+        return size_;
+    }
+
+    auto inventory::empty() const -> bool
+    {
+        return size_ == 0;
+    }
+
+    auto inventory::state_hash() const -> std::uint64_t
+    {
+        return state_hash_;
+    }
+
+    auto inventory::key_of(const std::type_index type,
+                           const element_type element,
+                           const std::int32_t potency,
+                           const std::string_view name) -> std::size_t
+    {
+        std::size_t key = type.hash_code();
+        const auto mix = [&key](const std::size_t value) {
+            key ^= value + 0x9e3779b97f4a7c15 + (key << 6) + (key >> 2);
+        };
+        mix(static_cast<std::size_t>(element));
+        mix(static_cast<std::size_t>(potency));
+        mix(std::hash<std::string_view>{}(name));
+        return key;
+    }
+
+    auto inventory::fits(const stack& s, const std::type_index type,
+                         const ingredient& ing) -> bool
+    {
+        return s.type == type && s.element == ing.element()
+               && s.potency == ing.potency() && s.name == ing.name();
+    }
+
+    auto inventory::potency_key(const element_type element,
+                                const std::int32_t potency) -> std::uint64_t
+    {
+        return static_cast<std::uint64_t>(element) << 32
+               | static_cast<std::uint32_t>(potency);
+    }
+
+    auto inventory::index(const std::size_t stack) -> void
+    {
+        const auto& s = stacks_[stack];
+        by_key_.emplace(key_of(s.type, s.element, s.potency, s.name), stack);
+        by_element_.at(static_cast<std::size_t>(s.element)).push_back(stack);
+        by_potency_[potency_key(s.element, s.potency)].push_back(stack);
+    }
+
+} // namespace potmaker
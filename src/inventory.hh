@@ -0,0 +1,177 @@
+#ifndef INVENTORY_HH
+#define INVENTORY_HH
+#include "element_type.hh"
+#include "small_vector.hh"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <typeindex>
+#include <unordered_map>
+#include <vector>
+
+namespace potmaker {
+
+    class ingredient;
+
+    using ingredient_list = small_vector<ingredient*, 16>;
+
+    /**
+     * The player's ingredients. Interchangeable ingredients (same type,
+     * element, potency and name) share a stack, and stacks are indexed by
+     * element and by element and potency.
+     *
+     * Stacks are numbered in the order they were first filled. A stack that
+     * runs out keeps its number until the inventory is compacted, so that
+     * picks made while brewing stay valid. Compacting renumbers every stack
+     * after the first empty one, so callers compact once enough stacks ran
+     * out to be worth it rather than after every potion
+     */
+    class inventory {
+    public:
+        /**
+         * A group of interchangeable ingredients
+         */
+        struct stack {
+            std::type_index type;
+            element_type element;
+            std::int32_t potency;
+            std::string name;
+            // The state hash key of one of its ingredients
+            std::uint64_t hash;
+            small_vector<ingredient*, 4> units;
+        };
+
+        /**
+         * Stores an ingredient on the stack it belongs to
+         * @param ing The ingredient
+         * @return The number of its stack
+         */
+        auto add(ingredient* ing) -> std::size_t;
+
+        /**
+         * Takes one ingredient from a stack
+         * @param stack The number of the stack
+         * @return The ingredient, or nullptr if the stack is empty
+         * @throws std::out_of_range If there is no such stack
+         */
+        auto take(std::size_t stack) -> ingredient*;
+
+        /**
+         * Takes one ingredient from each of several stacks. A stack may be
+         * listed more than once, and empty stacks are skipped
+         * @param picks The numbers of the stacks
+         * @return The ingredients, in the order they were picked
+         * @throws std::out_of_range If there is no such stack
+         */
+        auto take(std::span<const std::size_t> picks) -> ingredient_list;
+
+        /**
+         * Returns an ingredient to the stack it was taken from, which keeps
+         * its number until the inventory is compacted
+         * @param stack The number of the stack
+         * @param ing The ingredient
+         * @throws std::out_of_range If there is no such stack
+         * @throws std::invalid_argument If the ingredient does not belong on
+         * the stack
+         */
+        auto put_back(std::size_t stack, ingredient* ing) -> void;
+
+        /**
+         * Drops the stacks that ran out and renumbers the rest, keeping
+         * their order
+         */
+        auto compact() -> void;
+
+        /**
+         * Compacts the inventory if at least a quarter of its stacks, and
+         * more than a few, ran out
+         * @return Whether it was compacted
+         */
+        auto compact_if_sparse() -> bool;
+
+        /**
+         * @return The stacks, including the ones that ran out since the last
+         * compact
+         */
+        [[nodiscard]] auto stacks() const -> const std::vector<stack>&;
+
+        /**
+         * @param element An element
+         * @return The numbers of the stacks with that element
+         */
+        [[nodiscard]] auto stacks_with(element_type element) const
+                -> std::span<const std::size_t>;
+
+        /**
+         * @param element An element
+         * @param potency A potency
+         * @return The numbers of the stacks with that element and potency
+         */
+        [[nodiscard]] auto stacks_with(element_type element,
+                                       std::int32_t potency) const
+                -> std::span<const std::size_t>;
+
+        /**
+         * @return How many ingredients are stored
+         */
+        [[nodiscard]] auto size() const -> std::size_t;
+
+        /**
+         * @return Whether no ingredient is stored
+         */
+        [[nodiscard]] auto empty() const -> bool;
+
+        /**
+         * @return A hash of the stored ingredients, kept up to date as they
+         * come and go. Inventories holding the same ingredients hash the
+         * same, whatever order they were stored in
+         */
+        [[nodiscard]] auto state_hash() const -> std::uint64_t;
+
+    private:
+        // Sparse inventories keep at least this many empty stacks
+        static constexpr std::size_t min_sparse_stacks = 8;
+
+        static constexpr std::size_t element_count
+                = static_cast<std::size_t>(element_type::boring) + 1;
+
+        [[nodiscard]] static auto key_of(std::type_index type,
+                                         element_type element,
+                                         std::int32_t potency,
+                                         std::string_view name)
+                -> std::size_t;
+
+        /**
+         * @return Whether an ingredient belongs on a stack
+         */
+        [[nodiscard]] static auto fits(const stack& s, std::type_index type,
+                                       const ingredient& ing) -> bool;
+
+        [[nodiscard]] static auto potency_key(element_type element,
+                                              std::int32_t potency)
+                -> std::uint64_t;
+
+        /**
+         * Adds a stack to the lookup tables
+         */
+        auto index(std::size_t stack) -> void;
+
+        std::vector<stack> stacks_;
+        std::size_t size_ = 0;
+        // Stacks that ran out since the last compact
+        std::size_t empty_stacks_ = 0;
+        std::uint64_t state_hash_ = 0;
+
+        // Stacks by a hash of what makes ingredients interchangeable
+        std::unordered_multimap<std::size_t, std::size_t> by_key_;
+        std::array<std::vector<std::size_t>, element_count> by_element_;
+        std::unordered_map<std::uint64_t, std::vector<std::size_t>>
+                by_potency_;
+    };
+
+} // namespace potmaker
+
+#endif // INVENTORY_HH
@@ -1,23 +1,529 @@
+#include "balance.hh"
+#include "battle_env.hh"
+#include "column_file.hh"
+#include "content_library.hh"
+#include "event_log.hh"
 #include "potionmaker_game.hh"
+#include "shm_channel.hh"
+#include "simulation.hh"
+#include "sweep.hh"
+#include "tuner.hh"
+#include <array>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <format>
 #include <iostream>
+#include <optional>
+#include <stdexcept>
 #include <string>
+#include <string_view>
+#include <vector>
 
-auto main() -> int
-{
-    // Name prompt
-    std::cout << "=== WELCOME TO POTIONMAKER ===\n";
-    std::cout << "Enter your name: ";
-    std::string player_name;
+namespace {
+
+    /**
+     * What the command line asks for. Without any of the modes below the
+     * game is played
+     */
+    struct command_line {
+        // Optional content file replacing the built-in ingredients and
+        // enemies
+        std::optional<potmaker::content_library> content;
+        // Optional balance file replacing the built-in difficulty
+        std::optional<potmaker::balance_params> balance;
+        // Search for the balance with these win rates per stage instead of
+        // playing
+        std::optional<std::vector<double>> tune_target;
+        // Measure every balance of a grid instead of playing, keeping a
+        // checkpoint to resume from
+        std::optional<std::string> sweep_path;
+        potmaker::sweep_grid sweep_grid;
+        // Serve battles to a trainer over shared memory instead of playing
+        std::optional<std::string> channel_name;
+        std::size_t env_count = 64;
+        // Simulate this many runs and print a summary instead of playing
+        std::optional<std::uint64_t> simulated_runs;
+        std::uint64_t first_seed = 1;
+        // Draw the simulated runs with variance reduction and print
+        // estimates of their means instead of a summary
+        potmaker::variance_reduction reduction;
+        bool estimate = false;
+        // Or estimate how much this balance's means differ from the active
+        // one's
+        std::optional<potmaker::balance_params> compare_balance;
+        // Or draw the simulated runs with a bias towards reaching this stage
+        // and print how likely plain runs are to reach and win each stage
+        std::optional<std::int32_t> deep_stage;
+        // Also write one row per simulated run to this column file
+        std::optional<std::string> export_path;
+        // Count the rows of a column file with a column's value in a range
+        std::optional<std::string> scan_path;
+        std::string scan_column;
+        std::string scan_min;
+        std::string scan_max;
+        // Or write every combat event of every simulated run to this event
+        // log
+        std::optional<std::string> trace_path;
+        // Print the events of one run from an event log
+        std::optional<std::string> replay_path;
+        std::uint64_t replay_run = 0;
+    };
+
+    /**
+     * Reads a whole argument as a number of value's type
+     * @throws std::invalid_argument If the argument is not such a number
+     */
+    template<typename value_t>
+    auto parse_number(const std::string_view text, value_t& value) -> void
+    {
+        const auto [ptr, ec] = std::from_chars(
+                text.data(), text.data() + text.size(), value);
+        if (ec != std::errc{} || ptr != text.data() + text.size()) {
+            throw std::invalid_argument(
+                    std::format("expected a number, got '{}'", text));
+        }
+    }
+
+    /**
+     * Reads comma-separated numbers, as --tune and the sweep's knobs take
+     * them
+     * @throws std::invalid_argument If one is not a number
+     */
+    template<typename list_t>
+    auto parse_list(const std::string_view list, list_t& values) -> void
+    {
+        values.clear();
+        std::size_t start = 0;
+        while (start <= list.size()) {
+            std::size_t comma = list.find(',', start);
+            if (comma == std::string_view::npos) { comma = list.size(); }
+            parse_number(list.substr(start, comma - start),
+                         values.emplace_back());
+            start = comma + 1;
+        }
+    }
+
+    auto print_usage(const char* program) -> void
+    {
+        std::cerr << "Usage: " << program
+                  << " [--content <path>] [--balance <path>] "
+                     "[--tune <rate,...> [--seed <seed>]] "
+                     "[--sweep <checkpoint> [--health <x,...>] "
+                     "[--damage <x,...>] [--power <x,...>] "
+                     "[--pace <stages,...>] [--simulate <runs>] "
+                     "[--seed <seed>]] "
+                     "[--serve <channel> "
+                     "[--envs <count>]] [--simulate <runs> "
+                     "[--seed <seed>] [--export <path> "
+                     "| --trace <path> "
+                     "| [--crn] [--antithetic] [--stratify <enemies>] "
+                     "[--compare <balance>] | --deep <stage>]] "
+                     "[--scan <path> <column> <min> <max>] "
+                     "[--replay <path> <run>]\n";
+    }
+
+    /**
+     * Reads the command line. Problems are reported on standard error
+     * @return What it asks for, or nothing if it could not be read
+     */
+    auto parse_command_line(const int argc, char* argv[])
+            -> std::optional<command_line>
+    {
+        command_line cl;
+        for (int i = 1; i < argc; ++i) {
+            const std::string_view option = argv[i];
+            // Options taking numbers stop at the first that is not one
+            try {
+                if (option == "--content" && i + 1 < argc) {
+                    try {
+                        cl.content = potmaker::content_library::load(argv[++i]);
+                    }
+                    catch (const std::exception& e) {
+                        std::cerr << e.what() << "\n";
+                        return std::nullopt;
+                    }
+                }
+                else if (option == "--balance" && i + 1 < argc) {
+                    try {
+                        cl.balance = potmaker::balance_params::load(argv[++i]);
+                    }
+                    catch (const std::exception& e) {
+                        std::cerr << e.what() << "\n";
+                        return std::nullopt;
+                    }
+                }
+                else if (option == "--tune" && i + 1 < argc) {
+                    // From the first stage
+                    parse_list(argv[++i], cl.tune_target.emplace());
+                }
+                else if (option == "--sweep" && i + 1 < argc) {
+                    cl.sweep_path = argv[++i];
+                }
+                else if (option == "--health" && i + 1 < argc) {
+                    parse_list(argv[++i], cl.sweep_grid.enemy_health);
+                }
+                else if (option == "--damage" && i + 1 < argc) {
+                    parse_list(argv[++i], cl.sweep_grid.enemy_damage);
+                }
+                else if (option == "--power" && i + 1 < argc) {
+                    parse_list(argv[++i], cl.sweep_grid.ingredient_power);
+                }
+                else if (option == "--pace" && i + 1 < argc) {
+                    parse_list(argv[++i], cl.sweep_grid.stages_per_enemy);
+                }
+                else if (option == "--serve" && i + 1 < argc) {
+                    cl.channel_name = argv[++i];
+                }
+                else if (option == "--envs" && i + 1 < argc) {
+                    parse_number(argv[++i], cl.env_count);
+                }
+                else if (option == "--simulate" && i + 1 < argc) {
+                    parse_number(argv[++i], cl.simulated_runs.emplace());
+                }
+                else if (option == "--seed" && i + 1 < argc) {
+                    parse_number(argv[++i], cl.first_seed);
+                }
+                else if (option == "--crn") {
+                    cl.reduction.common_random_numbers = true;
+                    cl.estimate = true;
+                }
+                else if (option == "--antithetic") {
+                    cl.reduction.antithetic = true;
+                    cl.estimate = true;
+                }
+                else if (option == "--stratify" && i + 1 < argc) {
+                    parse_number(argv[++i],
+                                 cl.reduction.stratified_enemies);
+                    cl.estimate = true;
+                }
+                else if (option == "--compare" && i + 1 < argc) {
+                    try {
+                        cl.compare_balance
+                                = potmaker::balance_params::load(argv[++i]);
+                    }
+                    catch (const std::exception& e) {
+                        std::cerr << e.what() << "\n";
+                        return std::nullopt;
+                    }
+                }
+                else if (option == "--deep" && i + 1 < argc) {
+                    parse_number(argv[++i], cl.deep_stage.emplace());
+                }
+                else if (option == "--export" && i + 1 < argc) {
+                    cl.export_path = argv[++i];
+                }
+                else if (option == "--scan" && i + 4 < argc) {
+                    cl.scan_path = argv[++i];
+                    cl.scan_column = argv[++i];
+                    cl.scan_min = argv[++i];
+                    cl.scan_max = argv[++i];
+                }
+                else if (option == "--trace" && i + 1 < argc) {
+                    cl.trace_path = argv[++i];
+                }
+                else if (option == "--replay" && i + 2 < argc) {
+                    cl.replay_path = argv[++i];
+                    parse_number(argv[++i], cl.replay_run);
+                }
+                else {
+                    print_usage(argv[0]);
+                    return std::nullopt;
+                }
+            }
+            catch (const std::invalid_argument& e) {
+                std::cerr << std::format("{}: {}\n", option, e.what());
+                return std::nullopt;
+            }
+        }
+        return cl;
+    }
+
+    /**
+     * --tune: prints the tuned balance as a balance file, with the
+     * measurements as comments
+     */
+    auto tune(const command_line& cl) -> int
+    {
+        const potmaker::tuning_result tuned = potmaker::tune_balance(
+                potmaker::active_balance(), *cl.tune_target,
+                {.first_seed = cl.first_seed});
+        std::cout << std::format(
+                "# Tuned over {} runs, {} comparisons and {} moves\n"
+                "# Enemy health x{:.3f}, enemy damage x{:.3f}, "
+                "ingredient power x{:.3f}\n"
+                "# Loss {:.5f}\n",
+                tuned.runs, tuned.comparisons, tuned.moves,
+                tuned.knobs.enemy_health, tuned.knobs.enemy_damage,
+                tuned.knobs.ingredient_power, tuned.loss);
+        for (std::size_t s = 0; s < cl.tune_target->size(); ++s) {
+            std::cout << std::format(
+                    "# Stage {}: target {:.3f}, win rate {:.3f} over {} "
+                    "battles\n",
+                    s + 1, (*cl.tune_target)[s], tuned.win_rates[s],
+                    tuned.battles[s]);
+        }
+        std::cout << tuned.params.to_string();
+        return 0;
+    }
+
+    /**
+     * --sweep: prints every point of the grid
+     */
+    auto sweep(const command_line& cl) -> int
+    {
+        potmaker::sweep_options options;
+        options.first_seed = cl.first_seed;
+        if (cl.simulated_runs) { options.runs_per_point = *cl.simulated_runs; }
+        const potmaker::sweep_result result = potmaker::run_sweep(
+                potmaker::active_balance(), cl.sweep_grid, *cl.sweep_path,
+                options);
+        std::cout << std::format("Units: {}, {} resumed from the checkpoint\n",
+                                 result.units, result.resumed_units);
+        std::cout << "health damage  power pace   runs  win rate  "
+                     "stage reached      turns         gold\n";
+        for (const potmaker::sweep_point& point: result.points) {
+            const double win_rate
+                    = point.battles != 0
+                              ? static_cast<double>(point.wins)
+                                        / static_cast<double>(point.battles)
+                              : 0.0;
+            std::cout << std::format(
+                    "{:6.3f} {:6.3f} {:6.3f} {:4} {:6} {:9.4f} "
+                    "{:6.3f}+/-{:5.3f} {:7.2f}+/-{:4.2f} "
+                    "{:7.1f}+/-{:4.1f}\n",
+                    point.knobs.enemy_health, point.knobs.enemy_damage,
+                    point.knobs.ingredient_power, point.knobs.stages_per_enemy,
+                    point.runs, win_rate, point.stage_reached.mean,
+                    point.stage_reached.standard_error, point.turns.mean,
+                    point.turns.standard_error, point.gold.mean,
+                    point.gold.standard_error);
+        }
+        return 0;
+    }
+
+    /**
+     * --scan: counts the rows of a column file in a range
+     */
+    auto scan(const command_line& cl) -> int
+    {
+        const potmaker::columns::reader table(*cl.scan_path);
+        const std::size_t column = table.find(cl.scan_column);
+        const auto rows
+                = table.type(column) == potmaker::columns::value_type::int64
+                          ? table.scan(column,
+                                       std::int64_t{std::stoll(cl.scan_min)},
+                                       std::int64_t{std::stoll(cl.scan_max)})
+                          : table.scan(column, std::stod(cl.scan_min),
+                                       std::stod(cl.scan_max));
+        std::cout << std::format("{} of {} rows match\n", rows.size(),
+                                 table.rows());
+        return 0;
+    }
+
+    /**
+     * --replay: prints the events of one run
+     */
+    auto replay(const command_line& cl) -> int
+    {
+        potmaker::events::reader log(*cl.replay_path);
+        log.seek(cl.replay_run, 0, 0);
+        constexpr std::array<const char*, 4> kinds{"spawn", "action",
+                                                   "health", "death"};
+        potmaker::events::event e;
+        while (log.next(e) && e.run == cl.replay_run) {
+            std::cout << std::format(
+                    "stage {} turn {} {} entity {} detail {} "
+                    "health {:.1f}\n",
+                    e.stage, e.turn, kinds[static_cast<std::size_t>(e.kind)],
+                    e.entity, e.detail, e.health);
+        }
+        return 0;
+    }
+
+    /**
+     * --simulate with --deep: prints how likely plain runs are to reach and
+     * win each stage
+     */
+    auto estimate_depth(const command_line& cl) -> int
+    {
+        // The bias is fitted on runs other than the ones measured
+        const potmaker::importance_bias bias = potmaker::fit_importance_bias(
+                *cl.deep_stage,
+                {.first_seed = cl.first_seed + *cl.simulated_runs});
+        const potmaker::depth_estimates depth = potmaker::estimate_depth(
+                cl.first_seed, *cl.simulated_runs, bias, 0,
+                {.max_stage = *cl.deep_stage});
+
+        std::cout << std::format("Runs: {}, worth {:.0f} plain runs\n",
+                                 depth.runs, depth.effective_runs);
+        std::cout << std::format("Tilts: player {:.3f}, enemies {:.3f}\n",
+                                 bias.tilts[0], bias.tilts[1]);
+        std::cout << "Enemy weights:";
+        for (const double weight: bias.enemy_weights) {
+            std::cout << std::format(" {:.3f}", weight);
+        }
+        std::cout << "\n";
+        for (const potmaker::stage_estimate& stage: depth.stages) {
+            std::cout << std::format(
+                    "Stage {:3}: reached {:.3e} [{:.3e}, {:.3e}]  "
+                    "won {:.4f} [{:.4f}, {:.4f}]  runs {}\n",
+                    stage.stage, stage.reached.value, stage.reached.low,
+                    stage.reached.high, stage.win_rate.value,
+                    stage.win_rate.low, stage.win_rate.high,
+                    stage.runs_reached);
+        }
+        return 0;
+    }
 
-    // We don't use cin because we want to allow spaces in the player's name
-    // which also prevents input getting stuck elsewhere
-    std::getline(std::cin, player_name);
+    /**
+     * --simulate with variance reduction or --compare: prints estimates of
+     * the runs' means, or of how much another balance changes them
+     */
+    auto estimate_means(const command_line& cl) -> int
+    {
+        const potmaker::run_estimates estimates
+                = cl.compare_balance
+                          ? potmaker::compare_balances(
+                                    potmaker::active_balance(),
+                                    *cl.compare_balance, cl.first_seed,
+                                    *cl.simulated_runs, 0, {}, cl.reduction)
+                          : potmaker::estimate_runs(cl.first_seed,
+                                                    *cl.simulated_runs, 0, {},
+                                                    cl.reduction);
 
-    if (player_name.empty()) { player_name = "Anonymous"; }
+        const auto print = [](const char* what, const potmaker::estimate& e) {
+            std::cout << std::format("{:<18} {:10.4f} +/- {:8.4f}  "
+                                     "effective runs {:.0f}\n",
+                                     what, e.mean, e.standard_error,
+                                     e.effective_samples);
+        };
+        std::cout << std::format("Runs: {}{}\n", *cl.simulated_runs,
+                                 cl.compare_balance ? ", difference" : "");
+        print("Stage reached", estimates.stage_reached);
+        print("Turns", estimates.turns);
+        print("Gold", estimates.gold);
+        return 0;
+    }
+
+    /**
+     * --simulate: prints a summary of the runs, traced or exported if asked
+     */
+    auto summarize_runs(const command_line& cl) -> int
+    {
+        const potmaker::run_stats stats
+                = cl.trace_path ? potmaker::trace_runs(*cl.trace_path,
+                                                       cl.first_seed,
+                                                       *cl.simulated_runs)
+                  : cl.export_path
+                          ? potmaker::export_runs(*cl.export_path,
+                                                  cl.first_seed,
+                                                  *cl.simulated_runs)
+                          : potmaker::simulate_runs(cl.first_seed,
+                                                    *cl.simulated_runs);
+
+        const auto print = [](const char* what, const potmaker::t_digest& d) {
+            std::cout << std::format(
+                    "{:<18} mean {:8.2f}  p10 {:8.2f}  p50 {:8.2f}  "
+                    "p90 {:8.2f}  max {:8.2f}\n",
+                    what, d.mean(), d.quantile(0.1), d.quantile(0.5),
+                    d.quantile(0.9), d.max());
+        };
+        std::cout << std::format("Runs: {}\n", stats.runs());
+        print("Stage reached", stats.stages_reached());
+        print("Turns per battle", stats.turns_per_battle());
+        print("Gold per battle", stats.gold_per_battle());
+        std::cout << std::format("Distinct parties: ~{:.0f}\n",
+                                 stats.compositions().estimate());
+        for (std::size_t type = 0; type < stats.enemies_by_type().size();
+             ++type) {
+            std::cout << std::format("Enemy type {}: {}\n", type,
+                                     stats.enemies_by_type()[type]);
+        }
+        return 0;
+    }
+
+    /**
+     * --serve: serves battles until the trainer hangs up
+     */
+    auto serve(const command_line& cl) -> int
+    {
+        potmaker::battle_env env({.env_count = cl.env_count});
+        potmaker::shm_channel channel(
+                *cl.channel_name,
+                {.outbound_record_size = static_cast<std::uint32_t>(
+                         potmaker::env_record_size(env)),
+                 .inbound_record_size = sizeof(potmaker::env_action)});
+        std::cerr << "Serving " << cl.env_count << " battles on "
+                  << *cl.channel_name << "\n";
+        const std::size_t steps = potmaker::serve_env(env, channel);
+        std::cerr << "Served " << steps << " steps\n";
+        return 0;
+    }
+
+    /**
+     * Plays the game on the console
+     */
+    auto play() -> int
+    {
+        // Name prompt
+        std::cout << "=== WELCOME TO POTIONMAKER ===\n";
+        std::cout << "Enter your name: ";
+        std::string player_name;
+
+        // We don't use cin because we want to allow spaces in the player's
+        // name which also prevents input getting stuck elsewhere
+        std::getline(std::cin, player_name);
+
+        if (player_name.empty()) { player_name = "Anonymous"; }
+
+        // Start game
+        potmaker::game_state game(player_name);
+        game.main_menu();
+
+        return 0;
+    }
+
+    /**
+     * Runs the mode the command line asks for, if any
+     * @return The exit status, or nothing if no mode was asked for
+     */
+    auto run_mode(const command_line& cl) -> std::optional<int>
+    {
+        if (cl.tune_target) { return tune(cl); }
+        if (cl.sweep_path) { return sweep(cl); }
+        if (cl.scan_path) { return scan(cl); }
+        if (cl.replay_path) { return replay(cl); }
+        if (cl.simulated_runs && cl.deep_stage) { return estimate_depth(cl); }
+        if (cl.simulated_runs && (cl.estimate || cl.compare_balance)) {
+            return estimate_means(cl);
+        }
+        if (cl.simulated_runs) { return summarize_runs(cl); }
+        if (cl.channel_name) { return serve(cl); }
+        return std::nullopt;
+    }
+
+} // namespace
+
+auto main(const int argc, char* argv[]) -> int
+{
+    const std::optional<command_line> cl = parse_command_line(argc, argv);
+    if (!cl) { return 1; }
+    if (cl->content) { potmaker::set_active_content(&*cl->content); }
 
-    // Start game
-    potmaker::game_state game(player_name);
-    game.main_menu();
+    // Everything played from here on, on any thread, uses the balance
+    std::optional<potmaker::scoped_balance> balance_scope;
+    if (cl->balance) { balance_scope.emplace(*cl->balance); }
 
-    return 0;
-}
\ No newline at end of file
+    try {
+        if (const std::optional<int> status = run_mode(*cl)) {
+            return *status;
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+    return play();
+}
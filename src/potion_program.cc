@@ -0,0 +1,741 @@
+#include "potion_program.hh"
+#include "effect_program.hh"
+#include "entity.hh"
+#include "ingredient.hh"
+#include "util.hh"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <iostream>
+#include <numeric>
+#include <optional>
+#include <string>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace potmaker {
+
+    namespace {
+
+        auto run(const potion_script& script, entity& target) -> void
+        {
+            run_effect_program(*script.program, {script.self_name,
+                                                 script.scale, nullptr,
+                                                 &target, &target, nullptr});
+        }
+
+        /**
+         * The odds of reaching an operation, as a fraction
+         */
+        struct odds {
+            std::uint64_t num = 0;
+            std::uint64_t den = 1;
+
+            [[nodiscard]] auto times(const std::uint64_t n,
+                                     const std::uint64_t d) const -> odds
+            {
+                return reduced(num * n, den * d);
+            }
+
+            [[nodiscard]] auto plus(const odds& other) const -> odds
+            {
+                return reduced(num * other.den + other.num * den,
+                               den * other.den);
+            }
+
+            /**
+             * @return x weighed by these odds, multiplied before dividing
+             * like the built-in ingredients' estimates are
+             */
+            [[nodiscard]] auto weigh(const double x) const -> double
+            {
+                return x * static_cast<double>(num) / static_cast<double>(den);
+            }
+
+            static auto reduced(const std::uint64_t n, const std::uint64_t d)
+                    -> odds
+            {
+                const std::uint64_t divisor = std::gcd(n, d);
+                return divisor == 0 ? odds{0, 1}
+                                    : odds{n / divisor, d / divisor};
+            }
+        };
+
+        /**
+         * Takes the place of a potion program to check that a script can be
+         * lowered, without emitting anything
+         */
+        struct dry_run {
+            static auto say(const std::string&, const std::string&)
+                    -> std::size_t
+            {
+                return 0;
+            }
+            static auto modify_health(double) -> std::size_t { return 0; }
+            static auto modify_health_fraction(double) -> std::size_t
+            {
+                return 0;
+            }
+            static auto modify_health_random(double, double, std::int32_t)
+                    -> std::size_t
+            {
+                return 0;
+            }
+            static auto add_effect(const status_effect_variant&)
+                    -> std::size_t
+            {
+                return 0;
+            }
+            static auto clear_effects() -> std::size_t { return 0; }
+            static auto skip_on_roll(int, bool) -> std::size_t { return 0; }
+            static auto skip() -> std::size_t { return 0; }
+            static auto choose(int) -> std::size_t { return 0; }
+            static auto land(std::size_t) -> void {}
+        };
+
+        /**
+         * What lowering a script knows at one of its instructions
+         */
+        struct lowering_state {
+            enum class amount_type : std::uint8_t {
+                fixed, // amount
+                fraction, // amount times the target's max health
+                random, // random_double(amount, max) times the scale
+                unknown
+            };
+
+            amount_type type = amount_type::fixed;
+            double amount = 0.0;
+            double max = 0.0;
+            // Whether the target surely has no status effects
+            bool cleared = false;
+
+            auto operator==(const lowering_state&) const -> bool = default;
+        };
+
+        /**
+         * Emits the potion operations that do what a script does to its
+         * target. Only scripts that act on the target alone, and whose
+         * amounts and conditions are known or rolled, can be lowered
+         * @param program Where to emit the operations
+         * @return Whether the script could be lowered. If not, what was
+         * emitted is incomplete
+         */
+        template<typename program_t>
+        auto lower(const effect_program& script, const std::string& self_name,
+                   const int scale, program_t& program) -> bool
+        {
+            using amount_type = lowering_state::amount_type;
+            const std::vector<instruction>& code = script.code;
+
+            // The jumps to each instruction, and the state they carry there
+            std::vector<std::vector<std::pair<std::size_t, lowering_state>>>
+                    landings(code.size());
+            const auto jump_to = [&](const std::size_t pc,
+                                     const instruction& in,
+                                     const std::size_t op,
+                                     const lowering_state& state) {
+                const std::ptrdiff_t target
+                        = static_cast<std::ptrdiff_t>(pc) + 1 + in.jump;
+                if (target <= static_cast<std::ptrdiff_t>(pc)
+                    || target >= static_cast<std::ptrdiff_t>(code.size())) {
+                    return false;
+                }
+                landings[static_cast<std::size_t>(target)].emplace_back(
+                        op, state);
+                return true;
+            };
+
+            // A condition waiting for its jump_unless: either a roll's odds
+            // or a flag known up front
+            struct condition {
+                int odds;
+                bool known;
+                bool negated;
+            };
+            std::optional<condition> pending;
+
+            // The choose block being lowered: its jump table, which cases
+            // were seen and the state each case starts in
+            struct choice {
+                std::size_t first;
+                int count;
+                int seen_count;
+                std::uint32_t seen;
+                lowering_state state;
+            };
+            std::optional<choice> choosing;
+
+            lowering_state state;
+            bool reachable = true;
+            for (std::size_t pc = 0; pc < code.size(); ++pc) {
+                for (const auto& [op, carried]: landings[pc]) {
+                    program.land(op);
+                    if (!reachable) { state = carried; }
+                    else if (!(state == carried)) {
+                        state.type = amount_type::unknown;
+                        state.cleared = false;
+                    }
+                    reachable = true;
+                }
+
+                const instruction& in = code[pc];
+                if (pending && in.op != op_code::negate
+                    && in.op != op_code::jump_unless) {
+                    return false;
+                }
+
+                switch (in.op) {
+                case op_code::end:
+                    return !choosing;
+                case op_code::say: {
+                    std::string before;
+                    std::string after;
+                    bool named = false;
+                    for (const message_part& part:
+                         script.messages[in.index]) {
+                        std::string& text = named ? after : before;
+                        switch (part.type) {
+                        case message_part::part_type::text:
+                            text += part.text;
+                            break;
+                        case message_part::part_type::self:
+                            text += self_name;
+                            break;
+                        case message_part::part_type::target:
+                            if (named) { return false; }
+                            named = true;
+                            break;
+                        case message_part::part_type::amount:
+                            if (state.type != amount_type::fixed) {
+                                return false;
+                            }
+                            text += std::format("{:.1f}", state.amount);
+                            break;
+                        }
+                    }
+                    // Potion messages always name the target
+                    if (!named) { return false; }
+                    program.say(std::move(before), std::move(after));
+                } break;
+                case op_code::amount:
+                    state.type = amount_type::fixed;
+                    state.amount = script.constants[in.index]
+                                   + in.value * scale;
+                    break;
+                case op_code::amount_health:
+                    state.type = amount_type::fraction;
+                    state.amount = in.value * scale;
+                    break;
+                case op_code::amount_random:
+                    state.type = amount_type::random;
+                    state.amount = in.value;
+                    state.max = script.constants[in.index];
+                    break;
+                case op_code::damage:
+                case op_code::heal: {
+                    const bool heal = in.op == op_code::heal;
+                    const double amount = heal ? state.amount : -state.amount;
+                    if (state.type == amount_type::fixed) {
+                        program.modify_health(amount);
+                    }
+                    else if (state.type == amount_type::fraction) {
+                        program.modify_health_fraction(amount);
+                    }
+                    else if (state.type == amount_type::random && heal) {
+                        program.modify_health_random(state.amount, state.max,
+                                                     scale);
+                    }
+                    else {
+                        return false;
+                    }
+                } break;
+                case op_code::add_effect: {
+                    const effect_spec& spec = script.effects[in.index];
+                    program.add_effect(make_status_effect(
+                            spec.kind, static_cast<int>(spec.turns.at(scale)),
+                            static_cast<int>(spec.potency.at(scale))));
+                    state.cleared = false;
+                } break;
+                case op_code::clear_effects:
+                    program.clear_effects();
+                    state.cleared = true;
+                    break;
+                case op_code::roll:
+                    pending = condition{in.index, false, false};
+                    break;
+                case op_code::has_effects:
+                    // Only known right after the target was cleared
+                    if (!state.cleared) { return false; }
+                    pending = condition{0, true, false};
+                    break;
+                case op_code::negate:
+                    if (!pending) { return false; }
+                    pending->negated = !pending->negated;
+                    break;
+                case op_code::jump_unless: {
+                    if (!pending) { return false; }
+                    const condition taken = *pending;
+                    pending.reset();
+                    if (!taken.known) {
+                        // Jumps when the flag is false: when the roll
+                        // misses, or lands if negated
+                        if (!jump_to(pc, in,
+                                     program.skip_on_roll(taken.odds,
+                                                          taken.negated),
+                                     state)) {
+                            return false;
+                        }
+                    }
+                    else if (!taken.negated) {
+                        // A flag known to be false always jumps
+                        if (!jump_to(pc, in, program.skip(), state)) {
+                            return false;
+                        }
+                        reachable = false;
+                    }
+                } break;
+                case op_code::jump:
+                    if (!jump_to(pc, in, program.skip(), state)) {
+                        return false;
+                    }
+                    reachable = false;
+                    break;
+                case op_code::choose:
+                    if (choosing || in.index < 1 || in.index > 32) {
+                        return false;
+                    }
+                    choosing = choice{program.choose(in.index), in.index, 0,
+                                      0, state};
+                    reachable = false;
+                    break;
+                case op_code::is_choice: {
+                    // Each case starts with is_choice and a jump_unless to
+                    // the next one, which the jump table replaces
+                    if (!choosing || pc + 1 >= code.size()
+                        || code[pc + 1].op != op_code::jump_unless
+                        || !landings[pc + 1].empty() || in.index < 1
+                        || in.index > choosing->count) {
+                        return false;
+                    }
+                    const std::uint32_t bit = 1U << (in.index - 1);
+                    if ((choosing->seen & bit) != 0) { return false; }
+                    program.land(choosing->first
+                                 + static_cast<std::size_t>(in.index) - 1);
+                    state = choosing->state;
+                    reachable = true;
+                    choosing->seen |= bit;
+                    if (++choosing->seen_count == choosing->count) {
+                        choosing.reset();
+                    }
+                    ++pc;
+                } break;
+                case op_code::target_player:
+                    // An ingredient's opponent is its target
+                    break;
+                default:
+                    // Allies, selections and the attack of a script's
+                    // enemy do not exist in a potion
+                    return false;
+                }
+            }
+            return false;
+        }
+
+    } // namespace
+
+    auto potion_program::compile(const ingredient_list& potion)
+            -> potion_program
+    {
+        return compile_with(potion, 1);
+    }
+
+    auto potion_program::compile_splash(const ingredient_list& potion)
+            -> potion_program
+    {
+        return compile_with(potion, splash_potency_divisor);
+    }
+
+    auto potion_program::compile_with(const ingredient_list& potion,
+                                      const std::int32_t potency_divisor)
+            -> potion_program
+    {
+        potion_program program;
+        program.ingredient_count_ = potion.size();
+        program.potency_divisor_ = potency_divisor;
+
+        for (auto* ingredient: potion) {
+            // An ingredient only acts if the ones before it left the target
+            // alive, so each starts with a check that skips the rest of it
+            program.texts_.push_back(
+                    {"\n" + std::string(ingredient->name()) + " activates!\n",
+                     ""});
+            const std::size_t announce = program.emit(
+                    {potion_op_code::announce, 0,
+                     static_cast<std::int32_t>(program.texts_.size() - 1), 0,
+                     0});
+
+            ingredient->compile(program);
+            program.land(announce);
+        }
+
+        return program;
+    }
+
+    auto potion_program::apply(entity& target) const -> void
+    {
+        std::size_t pc = 0;
+        while (pc < code_.size()) {
+            const potion_op& op = code_[pc++];
+
+            switch (op.op) {
+            case potion_op_code::announce:
+                if (!output_quiet()) { std::cout << texts_[op.index].before; }
+                if (target.is_dead()) { pc = op.jump; }
+                break;
+            case potion_op_code::say: {
+                const potion_text& text = texts_[op.index];
+                std::string message;
+                message.reserve(text.before.size() + target.name().size()
+                                + text.after.size());
+                message.append(text.before);
+                message.append(target.name());
+                message.append(text.after);
+                print_action(message);
+                break;
+            }
+            case potion_op_code::modify_health:
+                target.modify_health(op.value);
+                break;
+            case potion_op_code::modify_health_fraction:
+                target.modify_health(op.value * target.max_health());
+                break;
+            case potion_op_code::modify_health_random:
+                target.modify_health(
+                        combat_value(random_double(op.value, op.value2))
+                        * op.index);
+                break;
+            case potion_op_code::add_effect:
+                target.add_status_effect(
+                        status_effect_variant(effects_[op.index]));
+                break;
+            case potion_op_code::clear_effects:
+                target.clear_status_effects();
+                break;
+            case potion_op_code::skip_if_roll:
+                if (roll_chances(op.index)) { pc = op.jump; }
+                break;
+            case potion_op_code::skip_unless_roll:
+                if (!roll_chances(op.index)) { pc = op.jump; }
+                break;
+            case potion_op_code::jump:
+                pc = op.jump;
+                break;
+            case potion_op_code::choose:
+                pc += static_cast<std::size_t>(random_int(1, op.index)) - 1;
+                break;
+            case potion_op_code::run_script:
+                run(scripts_[op.index], target);
+                break;
+            case potion_op_code::apply_ingredient:
+                ingredients_[op.index]->on_applied(target);
+                break;
+            }
+        }
+    }
+
+    auto potion_program::apply_all(const enemy_party& targets) const -> void
+    {
+        // Where each target is in the program. Jumps only go forward, so
+        // walking the operations in order visits every target's path
+        small_vector<std::size_t, 8> pcs;
+        pcs.resize(targets.size());
+
+        // The targets that reached the current operation
+        small_vector<std::size_t, 8> here;
+        small_vector<int, 8> draws;
+
+        for (std::size_t pc = 0; pc < code_.size(); ++pc) {
+            here.clear();
+            for (std::size_t t = 0; t < targets.size(); ++t) {
+                if (pcs[t] == pc) {
+                    here.push_back(t);
+                    pcs[t] = pc + 1;
+                }
+            }
+            if (here.empty()) { continue; }
+
+            const potion_op& op = code_[pc];
+            switch (op.op) {
+            case potion_op_code::announce:
+                if (!output_quiet()) { std::cout << texts_[op.index].before; }
+                for (const std::size_t t: here) {
+                    if (targets[t]->is_dead()) { pcs[t] = op.jump; }
+                }
+                break;
+            case potion_op_code::say: {
+                const potion_text& text = texts_[op.index];
+                std::string message = text.before;
+                for (std::size_t i = 0; i < here.size(); ++i) {
+                    if (i != 0) { message.append(", "); }
+                    message.append(targets[here[i]]->name());
+                }
+                message.append(text.after);
+                print_action(message);
+                break;
+            }
+            case potion_op_code::modify_health:
+                for (const std::size_t t: here) {
+                    targets[t]->modify_health(op.value);
+                }
+                break;
+            case potion_op_code::modify_health_fraction:
+                for (const std::size_t t: here) {
+                    targets[t]->modify_health(op.value
+                                              * targets[t]->max_health());
+                }
+                break;
+            case potion_op_code::modify_health_random:
+                for (const std::size_t t: here) {
+                    targets[t]->modify_health(
+                            combat_value(random_double(op.value, op.value2))
+                            * op.index);
+                }
+                break;
+            case potion_op_code::add_effect:
+                for (const std::size_t t: here) {
+                    targets[t]->add_status_effect(
+                            status_effect_variant(effects_[op.index]));
+                }
+                break;
+            case potion_op_code::clear_effects:
+                for (const std::size_t t: here) {
+                    targets[t]->clear_status_effects();
+                }
+                break;
+            case potion_op_code::skip_if_roll:
+            case potion_op_code::skip_unless_roll: {
+                const bool skip_on_land = op.op == potion_op_code::skip_if_roll;
+                draws.resize(here.size());
+                fill_random_ints(draws, 1, op.index);
+                for (std::size_t i = 0; i < here.size(); ++i) {
+                    if ((draws[i] == 1) == skip_on_land) {
+                        pcs[here[i]] = op.jump;
+                    }
+                }
+                break;
+            }
+            case potion_op_code::jump:
+                for (const std::size_t t: here) { pcs[t] = op.jump; }
+                break;
+            case potion_op_code::choose:
+                draws.resize(here.size());
+                fill_random_ints(draws, 1, op.index);
+                for (std::size_t i = 0; i < here.size(); ++i) {
+                    pcs[here[i]] = pc + static_cast<std::size_t>(draws[i]);
+                }
+                break;
+            case potion_op_code::run_script:
+                for (const std::size_t t: here) {
+                    run(scripts_[op.index], *targets[t]);
+                }
+                break;
+            case potion_op_code::apply_ingredient:
+                for (const std::size_t t: here) {
+                    ingredients_[op.index]->on_applied(*targets[t]);
+                }
+                break;
+            }
+        }
+    }
+
+    auto potion_program::ingredient_count() const -> std::size_t
+    {
+        return ingredient_count_;
+    }
+
+    auto potion_program::potency(const std::int32_t base) const
+            -> std::int32_t
+    {
+        // A weakened ingredient still does something, but never more than
+        // at full potency
+        return std::min(base, std::max(base / potency_divisor_, 1));
+    }
+
+    auto potion_program::expected_damage(const double max_health) const
+            -> std::optional<double>
+    {
+        // Jumps only go forward, so the odds of reaching an operation are
+        // all known by the time the walk gets there
+        std::vector<odds> reach(code_.size() + 1);
+        reach[0] = {1, 1};
+        const auto flow = [&](const std::size_t to, const odds& share) {
+            reach[to] = reach[to].plus(share);
+        };
+
+        double damage = 0.0;
+        for (std::size_t pc = 0; pc < code_.size(); ++pc) {
+            const odds here = reach[pc];
+            if (here.num == 0) { continue; }
+            const potion_op& op = code_[pc];
+            const auto index = static_cast<std::uint64_t>(op.index);
+
+            switch (op.op) {
+            case potion_op_code::announce:
+            case potion_op_code::say:
+            case potion_op_code::clear_effects:
+                flow(pc + 1, here);
+                break;
+            case potion_op_code::modify_health:
+                damage += here.weigh(-op.value);
+                flow(pc + 1, here);
+                break;
+            case potion_op_code::modify_health_fraction:
+                damage += here.weigh(-op.value * max_health);
+                flow(pc + 1, here);
+                break;
+            case potion_op_code::modify_health_random:
+                damage += here.weigh(-((op.value + op.value2) / 2 * op.index));
+                flow(pc + 1, here);
+                break;
+            case potion_op_code::add_effect:
+                damage += here.weigh(std::visit(
+                        [](const auto& effect) {
+                            return -to_double(effect.total_damage_per_turn())
+                                   * effect.turns_left();
+                        },
+                        effects_[op.index]));
+                flow(pc + 1, here);
+                break;
+            case potion_op_code::skip_if_roll:
+                flow(op.jump, here.times(1, index));
+                flow(pc + 1, here.times(index - 1, index));
+                break;
+            case potion_op_code::skip_unless_roll:
+                flow(op.jump, here.times(index - 1, index));
+                flow(pc + 1, here.times(1, index));
+                break;
+            case potion_op_code::jump:
+                flow(op.jump, here);
+                break;
+            case potion_op_code::choose:
+                for (std::uint64_t branch = 1; branch <= index; ++branch) {
+                    flow(pc + branch, here.times(1, index));
+                }
+                break;
+            case potion_op_code::run_script:
+            case potion_op_code::apply_ingredient:
+                return std::nullopt;
+            }
+        }
+        return damage;
+    }
+
+    auto potion_program::say(std::string before, std::string after)
+            -> std::size_t
+    {
+        texts_.push_back({std::move(before), std::move(after)});
+        return emit({potion_op_code::say, 0,
+                     static_cast<std::int32_t>(texts_.size() - 1), 0, 0});
+    }
+
+    auto potion_program::modify_health(const double amount) -> std::size_t
+    {
+        return emit({potion_op_code::modify_health, 0, 0, amount, 0});
+    }
+
+    auto potion_program::modify_health_fraction(const double fraction)
+            -> std::size_t
+    {
+        return emit({potion_op_code::modify_health_fraction, 0, 0, fraction,
+                     0});
+    }
+
+    auto potion_program::modify_health_random(const double min,
+                                              const double max,
+                                              const std::int32_t scale)
+            -> std::size_t
+    {
+        return emit({potion_op_code::modify_health_random, 0, scale, min, max});
+    }
+
+    auto potion_program::add_effect(status_effect_variant effect)
+            -> std::size_t
+    {
+        effects_.push_back(std::move(effect));
+        return emit({potion_op_code::add_effect, 0,
+                     static_cast<std::int32_t>(effects_.size() - 1), 0, 0});
+    }
+
+    auto potion_program::clear_effects() -> std::size_t
+    {
+        return emit({potion_op_code::clear_effects, 0, 0, 0, 0});
+    }
+
+    auto potion_program::skip_on_roll(const int odds, const bool when_lands)
+            -> std::size_t
+    {
+        return emit({when_lands ? potion_op_code::skip_if_roll
+                                : potion_op_code::skip_unless_roll,
+                     0, odds, 0, 0});
+    }
+
+    auto potion_program::skip() -> std::size_t
+    {
+        return emit({potion_op_code::jump, 0, 0, 0, 0});
+    }
+
+    auto potion_program::choose(const int count) -> std::size_t
+    {
+        emit({potion_op_code::choose, 0, count, 0, 0});
+
+        // The jump table that choose lands in
+        const std::size_t first = code_.size();
+        for (int i = 0; i < count; ++i) { skip(); }
+        return first;
+    }
+
+    auto potion_program::land(const std::size_t op) -> void
+    {
+        code_.at(op).jump = static_cast<std::int32_t>(code_.size());
+    }
+
+    auto potion_program::run_script(const effect_program& program,
+                                    std::string self_name, const int scale)
+            -> std::size_t
+    {
+        scripts_.push_back({&program, std::move(self_name), scale});
+        return emit({potion_op_code::run_script, 0,
+                     static_cast<std::int32_t>(scripts_.size() - 1), 0, 0});
+    }
+
+    auto potion_program::compile_script(const effect_program& program,
+                                        std::string self_name,
+                                        const int scale) -> std::size_t
+    {
+        dry_run dry;
+        if (!lower(program, self_name, scale, dry)) {
+            return run_script(program, std::move(self_name), scale);
+        }
+        const std::size_t first = code_.size();
+        lower(program, self_name, scale, *this);
+        return first;
+    }
+
+    auto potion_program::apply_ingredient(ingredient& ing) -> std::size_t
+    {
+        ingredients_.push_back(&ing);
+        return emit({potion_op_code::apply_ingredient, 0,
+                     static_cast<std::int32_t>(ingredients_.size() - 1), 0,
+                     0});
+    }
+
+    auto potion_program::emit(const potion_op op) -> std::size_t
+    {
+        code_.push_back(op);
+        return code_.size() - 1;
+    }
+
+} // namespace potmaker
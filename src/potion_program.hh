@@ -0,0 +1,253 @@
+#ifndef POTION_PROGRAM_HH
+#define POTION_PROGRAM_HH
+#include "inventory.hh"
+#include "status_effect.hh"
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace potmaker {
+
+    class enemy;
+    class entity;
+    class ingredient;
+    struct effect_program;
+
+    using enemy_party = small_vector<enemy*, 8>;
+
+    /**
+     * The operations of a compiled potion. They act on the potion's target
+     */
+    enum class potion_op_code : std::uint8_t {
+        announce, // Print texts[index].before, then go to jump if target died
+        say, // Print texts[index] around the target's name
+        modify_health, // Target gains value
+        modify_health_fraction, // Target gains value times its max health
+        modify_health_random, // Target gains random(value, value2) * index
+        add_effect, // Target gains a copy of effects[index]
+        clear_effects, // Target loses all of its effects
+        skip_if_roll, // If a 1/index chance lands, go to jump
+        skip_unless_roll, // If a 1/index chance misses, go to jump
+        jump, // Go to jump
+        choose, // Go to the (random int in [1, index])th following op
+        run_script, // Run scripts[index] on the target
+        apply_ingredient // Call on_applied of ingredients[index]
+    };
+
+    /**
+     * A single potion operation. Jumps are absolute
+     */
+    struct potion_op {
+        potion_op_code op;
+        std::int32_t jump;
+        std::int32_t index;
+        double value;
+        double value2;
+    };
+
+    /**
+     * A message rendered ahead of time, except for the target's name which
+     * goes between the two halves
+     */
+    struct potion_text {
+        std::string before;
+        std::string after;
+    };
+
+    /**
+     * A content file effect program, with what it needs besides the target
+     */
+    struct potion_script {
+        const effect_program* program;
+        std::string self_name;
+        int scale;
+    };
+
+    /**
+     * A potion compiled once after brewing. Every ingredient's messages are
+     * formatted, its amounts computed and its status effects constructed up
+     * front, so applying the potion is a single pass over a flat list of
+     * operations without virtual calls.
+     *
+     * Applying a compiled potion draws the same random numbers, prints the
+     * same text and leaves the target in the same state as calling
+     * on_applied on each ingredient in turn. The program does not own the
+     * ingredients it was compiled from, and can be applied any number of
+     * times
+     */
+    class potion_program {
+    public:
+        /**
+         * Compiles a potion
+         * @param potion The ingredients, in the order they apply
+         * @return The compiled potion
+         */
+        [[nodiscard]] static auto compile(const ingredient_list& potion)
+                -> potion_program;
+
+        // Splash potions act at this fraction of their ingredients' potency,
+        // rounded down but at least 1
+        static constexpr std::int32_t splash_potency_divisor = 2;
+
+        /**
+         * Compiles a splash potion, whose ingredients act at reduced potency.
+         * Ingredients that defer to on_applied act at full potency
+         * @param potion The ingredients, in the order they apply
+         * @return The compiled potion
+         */
+        [[nodiscard]] static auto compile_splash(const ingredient_list& potion)
+                -> potion_program;
+
+        /**
+         * Applies the potion
+         * @param target The entity the potion was thrown at
+         */
+        auto apply(entity& target) const -> void;
+
+        /**
+         * Applies the potion to several targets at once. Every operation is
+         * carried out for all the targets that reach it before moving on to
+         * the next, so damage lands on the whole party in one pass and the
+         * rolls of an operation are drawn in one go. Messages name all the
+         * targets they concern
+         * @param targets The entities the potion splashed
+         */
+        auto apply_all(const enemy_party& targets) const -> void;
+
+        /**
+         * @return How many ingredients the potion was compiled from
+         */
+        [[nodiscard]] auto ingredient_count() const -> std::size_t;
+
+        /**
+         * @param base An ingredient's potency
+         * @return The potency the ingredient acts at in this potion: the
+         * base divided by the potion's divisor and rounded down, but at
+         * least 1 unless the base is lower
+         */
+        [[nodiscard]] auto potency(std::int32_t base) const -> std::int32_t;
+
+        /**
+         * Works out how much health the potion takes from its target on
+         * average, counting effects over their whole duration and weighing
+         * every operation by the odds of reaching it. Targets are assumed
+         * to survive the whole potion
+         * @param max_health The target's max health, for fractions of it
+         * @return The expected health taken, negative if health is given,
+         * or nothing if the potion calls scripts or ingredients, whose
+         * operations are not known
+         */
+        [[nodiscard]] auto expected_damage(double max_health) const
+                -> std::optional<double>;
+
+        /*
+         * The rest is used by the ingredients to compile themselves. Each
+         * returns the number of the operation it emitted, which the jump
+         * of a later operation may refer to
+         */
+
+        /**
+         * Prints a message around the target's name
+         */
+        auto say(std::string before, std::string after) -> std::size_t;
+
+        /**
+         * Changes the target's health by a fixed amount
+         */
+        auto modify_health(double amount) -> std::size_t;
+
+        /**
+         * Changes the target's health by a fraction of its max health
+         */
+        auto modify_health_fraction(double fraction) -> std::size_t;
+
+        /**
+         * Changes the target's health by random_double(min, max) * scale
+         */
+        auto modify_health_random(double min, double max, std::int32_t scale)
+                -> std::size_t;
+
+        /**
+         * Gives the target a copy of an effect
+         */
+        auto add_effect(status_effect_variant effect) -> std::size_t;
+
+        /**
+         * Removes the target's effects
+         */
+        auto clear_effects() -> std::size_t;
+
+        /**
+         * Rolls a 1/odds chance and skips ahead if it lands (or, if
+         * when_lands is false, if it misses). Land the skip with land
+         */
+        auto skip_on_roll(int odds, bool when_lands) -> std::size_t;
+
+        /**
+         * Skips ahead unconditionally. Land the skip with land
+         */
+        auto skip() -> std::size_t;
+
+        /**
+         * Picks one of count branches at random like random_int(1, count).
+         * Each branch starts where land(first + branch - 1) is called
+         * @return The number of the first branch's jump
+         */
+        auto choose(int count) -> std::size_t;
+
+        /**
+         * Makes a skip, roll or branch continue at the next operation
+         * emitted
+         * @param op The number of the operation that jumps
+         */
+        auto land(std::size_t op) -> void;
+
+        /**
+         * Runs a content file effect program on the target
+         * @param program The program. Must outlive this potion
+         * @param self_name What the program calls the ingredient
+         * @param scale The program's scale
+         */
+        auto run_script(const effect_program& program, std::string self_name,
+                        int scale) -> std::size_t;
+
+        /**
+         * Compiles a content file effect program to operations like those
+         * of the built-in ingredients, so it applies the same way as the
+         * built-in ingredient it describes, splashes included. Programs
+         * that look at allies, at an attack or at effects the target may
+         * have are run with run_script instead
+         * @param program The program. Must outlive this potion
+         * @param self_name What the program calls the ingredient
+         * @param scale The program's scale
+         */
+        auto compile_script(const effect_program& program,
+                            std::string self_name, int scale) -> std::size_t;
+
+        /**
+         * Defers to an ingredient's on_applied, for ingredients that cannot
+         * be compiled. The ingredient must outlive the program
+         */
+        auto apply_ingredient(ingredient& ing) -> std::size_t;
+
+    private:
+        static auto compile_with(const ingredient_list& potion,
+                                 std::int32_t potency_divisor)
+                -> potion_program;
+
+        auto emit(potion_op op) -> std::size_t;
+
+        std::vector<potion_op> code_;
+        std::vector<potion_text> texts_;
+        std::vector<status_effect_variant> effects_;
+        std::vector<potion_script> scripts_;
+        std::vector<ingredient*> ingredients_;
+        std::size_t ingredient_count_ = 0;
+        std::int32_t potency_divisor_ = 1;
+    };
+
+} // namespace potmaker
+
+#endif // POTION_PROGRAM_HH
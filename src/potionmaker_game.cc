@@ -1,25 +1,45 @@
 #include "potionmaker_game.hh"
+#include "balance.hh"
+#include "content_library.hh"
 #include "entity_names.hh"
 #include "ingredient_names.hh"
+#include "potion_program.hh"
+#include "save_file.hh"
+#include "state_hash.hh"
+#include "status_effect.hh"
 #include "util.hh"
 #include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
 #include <format>
+#include <functional>
 #include <iostream>
 #include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <ranges>
+#include <span>
+#include <stdexcept>
+#include <stop_token>
 #include <string>
+#include <thread>
 #include <utility>
+#include <variant>
 #include <vector>
 
 namespace potmaker {
 
-    shop_item::shop_item(ingredient* ing, const double cost)
+    shop_item::shop_item(ingredient* ing, const combat_value cost)
         : item(ing), price(cost)
     {}
 
     game_state::game_state(std::string player_name)
         : player_(new player(std::move(player_name), 100.0, 15.0, 50.0)),
-          current_stage_(1), game_running_(true)
+          current_stage_(1), game_running_(true),
+          run_id_(random_source().next()), turn_(0),
+          defeat_(defeat_cause::none)
     {
         generate_shop_items();
     }
@@ -61,20 +81,31 @@ namespace potmaker {
     {
         std::cout << "\n=== MAIN MENU ===\n";
         std::cout << "1. Start Game\n";
-        std::cout << "2. Credits\n";
-        std::cout << "3. Quit\n";
+        std::cout << "2. Load Game\n";
+        std::cout << "3. Credits\n";
+        std::cout << "4. Quit\n";
         std::cout << "Choose an option: ";
 
-        const int choice = get_user_choice(1, 3);
+        const int choice = get_user_choice(1, 4);
 
         switch (choice) {
         case 1:
             start_game();
             break;
         case 2:
-            credits();
+            try {
+                load_game(std::string(save::default_path));
+                print_action("Game loaded!");
+                start_game();
+            }
+            catch (const std::runtime_error& e) {
+                print_action("Could not load game: {}", e.what());
+            }
             break;
         case 3:
+            credits();
+            break;
+        case 4:
             std::cout << "Thanks for playing!\n";
             game_running_ = false;
             break;
@@ -94,10 +125,11 @@ namespace potmaker {
             std::cout << "1. Fight (Stage " << current_stage_ << ")\n";
             std::cout << "2. Shop\n";
             std::cout << "3. View Inventory\n";
-            std::cout << "4. Return to Main Menu\n";
+            std::cout << "4. Save Game\n";
+            std::cout << "5. Return to Main Menu\n";
             std::cout << "Choose an option: ";
 
-            const int choice = get_user_choice(1, 4);
+            const int choice = get_user_choice(1, 5);
 
             switch (choice) {
             case 1:
@@ -110,6 +142,15 @@ namespace potmaker {
                 display_inventory();
                 break;
             case 4:
+                try {
+                    save_game(std::string(save::default_path));
+                    print_action("Game saved!");
+                }
+                catch (const std::runtime_error& e) {
+                    print_action("Could not save game: {}", e.what());
+                }
+                break;
+            case 5:
                 in_game = false;
                 break;
             default:
@@ -120,9 +161,9 @@ namespace potmaker {
 
     auto game_state::fight_menu() -> void
     {
-        print_divider(std::format("STAGE {} BATTLE", current_stage_));
+        print_divider("STAGE {} BATTLE", current_stage_);
 
-        std::vector<enemy*> enemies = generate_enemies();
+        enemy_party enemies = begin_battle();
 
         std::cout << "You encounter:\n";
         display_enemies(enemies);
@@ -130,9 +171,10 @@ namespace potmaker {
         std::cout << "\n1. Attack with Potion\n";
         std::cout << "2. Basic Attack\n";
         std::cout << "3. Surrender\n";
+        std::cout << "4. Throw a Splash Potion\n";
         std::cout << "Choose an action: ";
 
-        const int choice = get_user_choice(1, 3);
+        const int choice = get_user_choice(1, 4);
 
         bool surrendered = false;
         if (choice == 3) {
@@ -143,13 +185,26 @@ namespace potmaker {
 
         const bool battle_won
                 = surrendered ? false : fight_round(enemies, choice);
+        end_battle(battle_won);
+    }
+
+    auto game_state::begin_battle() -> enemy_party
+    {
+        turn_ = 0;
+        defeat_ = defeat_cause::none;
+        return generate_enemies();
+    }
 
-        if (battle_won) {
-            double gold_reward = calculate_gold_reward(enemies);
+    auto game_state::end_battle(const bool won) -> combat_value
+    {
+        combat_value gold_reward = 0;
+        if (won) {
+            // Every enemy of the battle, not just the ones still standing
+            // when it ended
+            gold_reward = calculate_gold_reward(owned_enemies_);
             player_->add_gold(gold_reward);
 
-            print_action(std::format("Victory! You earned {:.1f} gold!",
-                                     gold_reward));
+            print_action("Victory! You earned {:.1f} gold!", gold_reward);
             current_stage_++;
 
             // Little reward
@@ -160,11 +215,14 @@ namespace potmaker {
         }
         else {
             print_action("DEFEAT");
-            std::cout << "You reached stage " << current_stage_ << "\n";
+            if (!output_quiet()) {
+                std::cout << "You reached stage " << current_stage_ << "\n";
+            }
             game_running_ = false;
         }
 
         cleanup_enemies();
+        return gold_reward;
     }
 
     auto game_state::shop_menu() -> void
@@ -178,11 +236,28 @@ namespace potmaker {
 
             display_shop();
 
+            const shop_plan plan = plan_purchases();
+            const int item_count = static_cast<int>(shop_items_.size());
+            if (!plan.picks.empty()) {
+                std::string basket;
+                for (const std::size_t pick: plan.picks | std::views::reverse) {
+                    if (!basket.empty()) { basket.append(", "); }
+                    basket.append(std::to_string(pick + 1));
+                }
+                std::cout << std::format(
+                        "{}. Buy the recommended basket: items {} ({:.1f} "
+                        "gold)\n",
+                        item_count + 1, basket, plan.cost);
+            }
+
             std::cout << "\nEnter item number to buy (0 to return): ";
-            const int choice
-                    = get_user_choice(0, static_cast<int>(shop_items_.size()));
+            const int choice = get_user_choice(
+                    0, plan.picks.empty() ? item_count : item_count + 1);
 
             if (choice == 0) { in_shop = false; }
+            else if (choice == item_count + 1) {
+                print_action("Bought {} items!", buy_planned());
+            }
             else {
                 if (buy_item(choice - 1)) {
                     print_action("Purchase successful!");
@@ -194,6 +269,160 @@ namespace potmaker {
         }
     }
 
+    auto game_state::save_game(const std::string& path) const -> void
+    {
+        save::writer out;
+        save::header& h = out.header();
+
+        h.stage = current_stage_;
+        h.max_health = to_double(player_->max_health());
+        h.health = to_double(player_->health());
+        h.damage = to_double(player_->damage());
+        h.gold = to_double(player_->gold());
+        h.rng = current_random_state();
+        h.run_id = run_id_;
+
+        const auto [name_offset, name_length] = out.add_string(player_->name());
+        h.player_name_offset = name_offset;
+        h.player_name_length = name_length;
+
+        for (const auto& stack: player_->stored_ingredients().stacks()) {
+            for (const auto* ing: stack.units) {
+                out.add_ingredient(ingredient_type_of(*ing), ing->potency(),
+                                   ing->name());
+            }
+        }
+
+        for (const auto& item: shop_items_) {
+            out.add_shop_item(ingredient_type_of(*item.item),
+                              item.item->potency(), item.item->name(),
+                              to_double(item.price));
+        }
+
+        for (const auto& r: player_->recipes().recipes()) {
+            out.add_recipe(r.name);
+            for (const auto& slot: r.slots) {
+                out.add_recipe_slot(slot.type, static_cast<int>(slot.element),
+                                    slot.potency);
+            }
+        }
+
+        for (const auto& effect: player_->status_effects()) {
+            if (effect.valueless_by_exception()) { continue; }
+            std::visit(
+                    [this, &out, &effect](const auto& e) {
+                        out.add_effect(effect.index(),
+                                       player_->turns_left(effect),
+                                       e.potency());
+                    },
+                    effect);
+        }
+
+        out.write(path);
+    }
+
+    auto game_state::load_game(const std::string& path) -> void
+    {
+        // The whole file is validated before we touch the current run
+        const save::reader in(path);
+        const save::header& h = in.header();
+
+        if (h.rng.cursor > random_buffer::block_size || h.stage <= 0) {
+            throw std::runtime_error("save file is corrupted");
+        }
+        const auto known_type = [](const int type) {
+            return type >= 0 && type < ingredient_type_count();
+        };
+        for (const auto& record: in.effects()) {
+            if (record.kind >= std::variant_size_v<status_effect_variant>) {
+                throw std::runtime_error("save file is corrupted");
+            }
+        }
+        for (const auto& record: in.ingredients()) {
+            if (!known_type(record.type)) {
+                throw std::runtime_error("save file is corrupted");
+            }
+            (void) in.string_at(record.name_offset, record.name_length);
+        }
+        for (const auto& record: in.shop_items()) {
+            if (!known_type(record.ingredient.type)) {
+                throw std::runtime_error("save file is corrupted");
+            }
+            (void) in.string_at(record.ingredient.name_offset,
+                                record.ingredient.name_length);
+        }
+        for (const auto& record: in.recipes()) {
+            (void) in.string_at(record.name_offset, record.name_length);
+            if (static_cast<std::uint64_t>(record.first_slot)
+                        + record.slot_count
+                > in.recipe_slots().size()) {
+                throw std::runtime_error("save file is corrupted");
+            }
+        }
+        for (const auto& record: in.recipe_slots()) {
+            if (record.element < 0
+                || record.element > static_cast<int>(element_type::boring)) {
+                throw std::runtime_error("save file is corrupted");
+            }
+        }
+
+        auto* loaded = new player(
+                std::string(in.string_at(h.player_name_offset,
+                                         h.player_name_length)),
+                h.max_health, h.damage, h.gold);
+        loaded->modify_health(h.health - h.max_health);
+
+        for (const auto& record: in.effects()) {
+            loaded->add_status_effect(make_status_effect(
+                    record.kind, record.turns, record.potency));
+        }
+
+        for (const auto& record: in.recipes()) {
+            recipe r{std::string(in.string_at(record.name_offset,
+                                              record.name_length)),
+                     {}};
+            for (const auto& slot: in.recipe_slots().subspan(
+                         record.first_slot, record.slot_count)) {
+                r.slots.push_back({slot.type,
+                                   static_cast<element_type>(slot.element),
+                                   slot.potency});
+            }
+            loaded->recipes().add(std::move(r));
+        }
+
+        cleanup_ingredients();
+        cleanup_enemies();
+        delete player_;
+        player_ = loaded;
+
+        for (const auto& record: in.ingredients()) {
+            ingredient* ing = create_ingredient_by_type(
+                    record.type,
+                    std::string(in.string_at(record.name_offset,
+                                             record.name_length)),
+                    record.potency);
+            owned_ingredients_.push_back(ing);
+            player_->store_ingredient(ing);
+        }
+
+        for (const auto& record: in.shop_items()) {
+            const save::ingredient_record& ing = record.ingredient;
+            shop_items_.emplace_back(
+                    create_ingredient_by_type(
+                            ing.type,
+                            std::string(in.string_at(ing.name_offset,
+                                                     ing.name_length)),
+                            ing.potency),
+                    record.price);
+        }
+
+        current_stage_ = h.stage;
+        game_running_ = true;
+        run_id_ = h.run_id;
+        turn_ = 0;
+        restore_random_state(h.rng);
+    }
+
     auto game_state::credits() -> void
     {
         print_divider("CREDITS");
@@ -211,25 +440,25 @@ namespace potmaker {
         std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
     }
 
-    auto game_state::generate_enemies() -> std::vector<enemy*>
+    auto game_state::generate_enemies() -> enemy_party
     {
-        std::vector<enemy*> enemies;
-
         // Stage Increases -> Enemies Increase
-        const int enemy_count = 1 + (current_stage_ - 1) / 2;
+        const int enemy_count = active_balance().enemy_count(current_stage_);
 
-        for (int i = 0; i < enemy_count; ++i) {
-            enemy* new_enemy = create_random_enemy(current_stage_);
-            enemies.push_back(new_enemy);
-            owned_enemies_.push_back(new_enemy);
+        enemy_party enemies
+                = create_random_enemies(current_stage_, enemy_count);
+        for (std::size_t i = 0; i < enemies.size(); ++i) {
+            enemies[i]->set_battle_slot(static_cast<std::uint32_t>(i + 1));
         }
+        owned_enemies_.insert(owned_enemies_.end(), enemies.begin(),
+                              enemies.end());
 
         // Cleanup happens elsewhere.
         // We delegate cleanup responsibility to cleanup methods in this class
         return enemies;
     }
 
-    auto game_state::display_enemies(const std::vector<enemy*>& enemies) -> void
+    auto game_state::display_enemies(const enemy_party& enemies) -> void
     {
         for (size_t i = 0; i < enemies.size(); ++i) {
             auto* enemy = enemies[i];
@@ -239,13 +468,12 @@ namespace potmaker {
         }
     }
 
-    auto game_state::create_potion() -> std::vector<ingredient*>
+    auto game_state::create_potion() -> ingredient_list
     {
-        std::vector<ingredient*> potion;
-        std::vector<ingredient*>& inventory = player_->stored_ingredients();
-        std::vector<int> selected_indices;
+        ingredient_list potion;
+        inventory& stock = player_->stored_ingredients();
 
-        if (inventory.empty()) {
+        if (stock.empty()) {
             std::cout << "You have no ingredients to make a potion!\n";
             return potion;
         }
@@ -253,47 +481,96 @@ namespace potmaker {
         std::cout << "\n=== POTION CRAFTING ===\n";
         display_inventory();
 
+        if (!player_->recipes().empty()) {
+            if (auto brewed = quick_brew()) {
+                stock.compact_if_sparse();
+                return std::move(*brewed);
+            }
+        }
+
         std::cout << "Select ingredients for your potion (0 to finish):\n";
 
+        // Stacks keep their numbers until the potion is done, even if they
+        // run out along the way
         while (true) {
             std::cout << "Add ingredient (0 to finish): ";
-            const int choice
-                    = get_user_choice(0, static_cast<int>(inventory.size()));
+            const int choice = get_user_choice(
+                    0, static_cast<int>(stock.stacks().size()));
 
             if (choice == 0) break;
 
-            int actual_index = choice - 1;
-            if (std::ranges::find(selected_indices, actual_index)
-                != selected_indices.end()) {
-                std::cout << "You already selected that ingredient!\n";
+            ingredient* selected = stock.take(choice - 1);
+            if (selected == nullptr) {
+                std::cout << "You have no more of that ingredient!\n";
                 continue;
             }
 
-            ingredient* selected = inventory[actual_index];
             potion.push_back(selected);
-            selected_indices.push_back(actual_index);
-
             std::cout << "Added " << selected->name() << " to potion!\n";
 
-            if (selected_indices.size() == inventory.size()) {
+            if (stock.empty()) {
                 std::cout << "No more ingredients available!\n";
                 break;
             }
         }
 
-        // Remove ingredients
-        std::sort(selected_indices.rbegin(), selected_indices.rend());
-        for (const int index: selected_indices) {
-            inventory.erase(inventory.begin() + index);
+        stock.compact_if_sparse();
+        if (potion.size() > 1) { offer_recipe(potion); }
+        return potion;
+    }
+
+    auto game_state::quick_brew() -> std::optional<ingredient_list>
+    {
+        const recipe_book& book = player_->recipes();
+        inventory& stock = player_->stored_ingredients();
+
+        std::cout << "\nRecipes:\n";
+        for (std::size_t i = 0; i < book.recipes().size(); ++i) {
+            const recipe& r = book.recipes()[i];
+            std::cout << std::format(
+                    "{}. {} ({} ingredients){}\n", i + 1, r.name,
+                    r.slots.size(),
+                    book.match(i, stock) ? "" : " - missing ingredients");
+        }
+
+        std::cout << "Brew a recipe (0 to pick ingredients yourself): ";
+        const int choice
+                = get_user_choice(0, static_cast<int>(book.recipes().size()));
+        if (choice == 0) { return std::nullopt; }
+
+        auto potion = book.brew(choice - 1, stock);
+        if (!potion) {
+            std::cout << "You lack the ingredients for that recipe!\n";
+            return std::nullopt;
         }
 
+        std::cout << "Brewed " << book.recipes()[choice - 1].name << "!\n";
         return potion;
     }
 
-    auto game_state::apply_potion(const std::vector<ingredient*>& potion,
-                                  const std::vector<enemy*>& enemies) -> void
+    auto game_state::offer_recipe(const ingredient_list& potion) -> void
+    {
+        recipe_book& book = player_->recipes();
+        if (book.find_potion(potion)) { return; }
+
+        std::cout << "Save this potion as a recipe? (1. Yes, 2. No): ";
+        if (get_user_choice(1, 2) != 1) { return; }
+
+        std::cout << "Recipe name: ";
+        std::string name;
+        std::getline(std::cin, name);
+        if (name.empty()) {
+            name = std::format("Recipe {}", book.recipes().size() + 1);
+        }
+
+        book.add(recipe_book::from_potion(name, potion));
+        print_action("Saved recipe {}!", name);
+    }
+
+    auto game_state::apply_potion(const potion_program& potion,
+                                  const enemy_party& enemies) -> void
     {
-        if (potion.empty()) {
+        if (potion.ingredient_count() == 0) {
             std::cout << "You throw an empty bottle! Nothing happens. Consider "
                          "doing a basic attack.\n";
             return;
@@ -308,28 +585,34 @@ namespace potmaker {
                 = get_user_choice(1, static_cast<int>(enemies.size()));
         enemy* target = enemies[target_choice - 1];
 
-        print_action(
-                std::format("You throw your potion at {}!", target->name()));
+        print_action("You throw your potion at {}!", target->name());
 
         // Every ingredient applies an effect on the target
-        for (auto* ingredient: potion) {
-            std::cout << "\n" << ingredient->name() << " activates!\n";
-            if (!target->is_dead()) { ingredient->on_applied(*target); }
-        }
+        potion.apply(*target);
     }
 
-    auto game_state::player_turn(std::vector<enemy*>& enemies, int attack_type)
+    auto game_state::player_turn(enemy_party& enemies, int attack_type)
             -> bool
     {
         std::cout << "\n=== YOUR TURN ===\n";
 
-        // The player uses a potion but mr has-no-ingredients has no ingredients
-        if (attack_type == 1) {
-            const std::vector<ingredient*>& inventory
-                    = player_->stored_ingredients();
+        counter_stream stream(battle_stream(0));
+        const scoped_random_stream scope(stream);
 
-            if (inventory.empty()) {
-                std::cout << "You have no ingredients to make a potion!\n";
+        // The player uses a potion but mr has-no-ingredients has no ingredients
+        const bool splash = attack_type == 4;
+        if (attack_type == 1 || splash) {
+            const std::size_t needed = splash ? min_splash_ingredients : 1;
+            if (player_->stored_ingredients().size() < needed) {
+                if (splash) {
+                    std::cout << std::format(
+                            "You need at least {} ingredients to make a "
+                            "splash potion!\n",
+                            min_splash_ingredients);
+                }
+                else {
+                    std::cout << "You have no ingredients to make a potion!\n";
+                }
                 std::cout << "1. Basic Attack\n";
                 std::cout << "2. Do nothing\n";
                 std::cout << "Choose an action: ";
@@ -341,8 +624,11 @@ namespace potmaker {
                 }
                 basic_attack(enemies);
             }
+            else if (splash) {
+                splash_potion(create_potion(), enemies);
+            }
             else {
-                const std::vector<ingredient*> potion = create_potion();
+                const auto potion = potion_program::compile(create_potion());
                 apply_potion(potion, enemies);
             }
         }
@@ -355,24 +641,251 @@ namespace potmaker {
         return enemies.empty();
     }
 
-    auto game_state::enemy_turn(std::vector<enemy*>& enemies) const -> void
+    auto game_state::enemy_turn(enemy_party& enemies) const -> void
     {
-        std::cout << "\n=== ENEMY TURN ===\n";
+        if (!output_quiet()) { std::cout << "\n=== ENEMY TURN ===\n"; }
+
+        // Every enemy rolls from its own stream, so what one enemy rolls
+        // never depends on how many rolls the enemies before it made. That
+        // lets all enemies decide at once, after which the decisions are
+        // carried out in party order
+        intent_list& intents = intents_;
+        plan_enemy_turns(enemies, intents);
+
+        // An enemy that looks at its allies decided based on how they were
+        // before anyone moved. If one of them has changed since, it decides
+        // again, which gives the same result as acting one after another.
+        // Changes are kept by battle slot, which finds an enemy without
+        // searching the party
+        std::uint32_t last_slot = 0;
+        for (const enemy* enemy: enemies) {
+            last_slot = std::max(last_slot, enemy->battle_slot());
+        }
+        small_vector<bool, 8>& changed = changed_;
+        changed.clear();
+        changed.resize(std::size_t{last_slot} + 1);
+        std::size_t changed_count = 0;
+        bool all_changed = false;
+        const auto mark_changed = [&](const entity* e) {
+            // Messages have no target, and the player has slot 0 and is
+            // not an ally
+            if (e == nullptr) { return; }
+            const std::uint32_t slot = e->battle_slot();
+            if (slot == 0 || slot > last_slot) { return; }
+            if (!changed[slot]) {
+                changed[slot] = true;
+                ++changed_count;
+            }
+        };
 
-        for (auto* enemy: enemies) {
-            if (!enemy->is_dead()) {
-                enemy->tick();
-                // Skip turn if dead or frozen
-                if (!enemy->is_dead() && !enemy->is_frozen()) {
-                    enemy->act(*player_, enemies);
-                }
+        for (std::size_t slot = 0; slot < enemies.size(); ++slot) {
+            enemy* enemy = enemies[slot];
+            if (enemy->is_dead()) { continue; }
+
+            counter_stream stream(battle_stream(enemy->battle_slot()));
+            const scoped_random_stream scope(stream);
+
+            if (!enemy->status_effects().empty()) { mark_changed(enemy); }
+            enemy->tick();
+
+            // Skip turn if dead or frozen
+            if (enemy->is_dead() || enemy->is_frozen()) { continue; }
+
+            enemy_intent& intent = intents[slot];
+            if (intent.deferred) {
+                enemy->act(*player_, enemies);
+                all_changed = true;
+                continue;
             }
+
+            const std::size_t others_changed
+                    = changed_count
+                      - (changed[enemy->battle_slot()] ? 1 : 0);
+            if (intent.reads_allies && (all_changed || others_changed > 0)) {
+                intent = enemy->plan(*player_, enemies);
+            }
+
+            for (const auto& step: intent.steps) { mark_changed(step.target); }
+            intent.apply();
         }
 
         cleanup_dead_enemies(enemies);
     }
 
-    auto game_state::basic_attack(const std::vector<enemy*>& enemies) -> void
+    namespace {
+
+        /**
+         * Threads kept alive between turns to plan large parties. The
+         * threads of a battle would otherwise be started and joined on
+         * every enemy turn. One party is planned at a time
+         */
+        class planning_pool {
+        public:
+            using task = std::function<void(std::size_t)>;
+
+            /**
+             * Calls work with every number below count, spread over the
+             * pool's threads and the calling one, and waits for them all
+             * @param count How many calls to make
+             * @param thread_count How many threads to spread them over,
+             * counting the calling one. The pool grows to fit
+             * @param work The work
+             * @return False, without calling work, if another thread is
+             * using the pool
+             * @throws The first exception work threw, once every call has
+             * finished
+             */
+            auto try_run(const std::size_t count,
+                         const std::size_t thread_count, const task& work)
+                    -> bool
+            {
+                const std::unique_lock busy(busy_, std::try_to_lock);
+                if (!busy.owns_lock()) { return false; }
+
+                while (workers_.size() + 1 < thread_count) {
+                    workers_.emplace_back(
+                            [this](const std::stop_token& stop) {
+                                serve(stop);
+                            });
+                }
+
+                {
+                    const std::scoped_lock lock(mutex_);
+                    work_ = &work;
+                    count_ = count;
+                    next_ = 0;
+                    running_ = workers_.size();
+                    error_ = nullptr;
+                    ++generation_;
+                }
+                wake_.notify_all();
+                take_calls();
+
+                std::unique_lock lock(mutex_);
+                done_.wait(lock, [this] { return running_ == 0; });
+                if (error_) { std::rethrow_exception(error_); }
+                return true;
+            }
+
+        private:
+            /**
+             * Makes calls until none are left
+             */
+            auto take_calls() -> void
+            {
+                for (std::size_t i = next_++; i < count_; i = next_++) {
+                    try {
+                        (*work_)(i);
+                    }
+                    catch (...) {
+                        const std::scoped_lock lock(mutex_);
+                        if (!error_) { error_ = std::current_exception(); }
+                    }
+                }
+            }
+
+            /**
+             * The loop of a pool thread: waits for work and helps with it,
+             * until the pool is destroyed
+             */
+            auto serve(const std::stop_token& stop) -> void
+            {
+                std::uint64_t seen = 0;
+                while (true) {
+                    {
+                        std::unique_lock lock(mutex_);
+                        if (!wake_.wait(lock, stop, [&] {
+                                return generation_ != seen;
+                            })) {
+                            return;
+                        }
+                        seen = generation_;
+                    }
+                    take_calls();
+                    {
+                        const std::scoped_lock lock(mutex_);
+                        --running_;
+                    }
+                    done_.notify_one();
+                }
+            }
+
+            std::mutex busy_;
+            std::mutex mutex_;
+            std::condition_variable_any wake_;
+            std::condition_variable done_;
+            const task* work_ = nullptr;
+            std::size_t count_ = 0;
+            std::atomic<std::size_t> next_ = 0;
+            std::size_t running_ = 0;
+            std::uint64_t generation_ = 0;
+            std::exception_ptr error_;
+            // Last, so the threads stop before what they use is destroyed
+            std::vector<std::jthread> workers_;
+        };
+
+    } // namespace
+
+    auto game_state::plan_enemy_turns(const enemy_party& enemies,
+                                      intent_list& intents,
+                                      std::size_t thread_count) const -> void
+    {
+        intents.clear();
+        intents.resize(enemies.size());
+
+        // Pool threads do not share the calling thread's settings, so each
+        // part of the party is planned under them
+        const bool quiet = output_quiet();
+        const bool antithetic = antithetic_draws();
+        const balance_params& balance = active_balance();
+        const stacking_table& stacking = stacking_policies();
+        const auto plan_range = [&](const std::size_t begin,
+                                    const std::size_t end) {
+            std::optional<scoped_quiet_output> quiet_scope;
+            if (quiet) { quiet_scope.emplace(); }
+            std::optional<scoped_antithetic_draws> antithetic_scope;
+            if (antithetic) { antithetic_scope.emplace(); }
+            const scoped_balance balance_scope(balance);
+            const scoped_stacking stacking_scope(stacking);
+
+            for (std::size_t slot = begin; slot < end; ++slot) {
+                counter_stream stream(
+                        battle_stream(enemies[slot]->battle_slot()));
+                const scoped_random_stream scope(stream);
+                intents[slot] = enemies[slot]->plan(*player_, enemies);
+            }
+        };
+
+        // The importance sampler belongs to the calling thread, which
+        // weighs every draw it hands out
+        if (thread_count == 0) {
+            thread_count = std::thread::hardware_concurrency();
+        }
+        thread_count = std::min(thread_count,
+                                enemies.size() / min_enemies_per_thread);
+        if (thread_count <= 1 || importance_sampling() != nullptr) {
+            plan_range(0, enemies.size());
+            return;
+        }
+
+        // Each part writes its own slots of intents and only reads the
+        // battle, so no synchronization is needed besides waiting for them.
+        // A pool busy with another battle's party leaves this one to the
+        // calling thread
+        static planning_pool pool;
+        const std::size_t chunk
+                = (enemies.size() + thread_count - 1) / thread_count;
+        const std::size_t chunk_count
+                = (enemies.size() + chunk - 1) / chunk;
+        const bool planned = pool.try_run(
+                chunk_count, thread_count, [&](const std::size_t part) {
+                    plan_range(part * chunk,
+                               std::min((part + 1) * chunk, enemies.size()));
+                });
+        if (!planned) { plan_range(0, enemies.size()); }
+    }
+
+    auto game_state::basic_attack(const enemy_party& enemies) -> void
     {
         // Probably should have abstracted this out
         std::cout << "\nChoose your target:\n";
@@ -381,20 +894,41 @@ namespace potmaker {
 
         const int target_choice
                 = get_user_choice(1, static_cast<int>(enemies.size()));
-        enemy* target = enemies[target_choice - 1];
+        attack(*enemies[target_choice - 1]);
+    }
+
+    auto game_state::attack(enemy& target) -> void
+    {
+        const combat_value damage
+                = player_->damage() * random_double(0.8, 1.2);
+        print_action("You attack {} for {:.1f} damage!", target.name(), damage);
+        target.modify_health(-damage);
+    }
+
+    auto game_state::splash_potion(const ingredient_list& potion,
+                                   const enemy_party& enemies) -> void
+    {
+        if (potion.size() < min_splash_ingredients) {
+            if (!output_quiet()) {
+                std::cout << std::format("A splash potion needs at least {} "
+                                         "ingredients! You put them back.\n",
+                                         min_splash_ingredients);
+            }
+            for (auto* ing: potion) { player_->store_ingredient(ing); }
+            return;
+        }
 
-        double damage = player_->damage() * random_double(0.8, 1.2);
-        print_action(std::format("You attack {} for {:.1f} damage!",
-                                 target->name(), damage));
-        target->modify_health(-damage);
+        print_action("You hurl a splash potion at your enemies!");
+        potion_program::compile_splash(potion).apply_all(enemies);
     }
 
-    auto game_state::fight_round(std::vector<enemy*>& enemies,
+    auto game_state::fight_round(enemy_party& enemies,
                                  int initial_attack_type) -> bool
     {
         bool player_surrendered = false;
         while (!enemies.empty() && !player_->is_dead() && !player_surrendered) {
             // Simple battle loop: Player -> Enemy -> Tick Effects -> Restart
+            ++turn_;
             const bool player_won = player_turn(enemies, initial_attack_type);
             if (player_won) { return true; }
             if (enemies.empty()) { return true; }
@@ -418,9 +952,10 @@ namespace potmaker {
                 std::cout << "1. Attack with Potion\n";
                 std::cout << "2. Basic Attack\n";
                 std::cout << "3. Surrender\n";
+                std::cout << "4. Throw a Splash Potion\n";
                 std::cout << "Choose an action: ";
 
-                const int choice = get_user_choice(1, 3);
+                const int choice = get_user_choice(1, 4);
 
                 if (choice == 3) {
                     std::cout << "You surrender before your enemies.\n";
@@ -435,9 +970,72 @@ namespace potmaker {
         return !player_->is_dead() && !player_surrendered;
     }
 
-    auto game_state::cleanup_dead_enemies(std::vector<enemy*>& enemies) -> void
+    auto game_state::play_turn(enemy_party& enemies,
+                               const battle_action& action) -> battle_outcome
+    {
+        if (action.type == battle_action::kind::surrender) {
+            defeat_ = defeat_cause::surrender;
+            return battle_outcome::lost;
+        }
+
+        // The same order as fight_round: player, enemies, player effects
+        ++turn_;
+        {
+            counter_stream stream(battle_stream(0));
+            const scoped_random_stream scope(stream);
+
+            const std::size_t target
+                    = std::min(action.target, enemies.size() - 1);
+            switch (action.type) {
+            case battle_action::kind::basic_attack:
+                attack(*enemies[target]);
+                break;
+            case battle_action::kind::potion: {
+                inventory& stock = player_->stored_ingredients();
+                const ingredient_list potion = stock.take(action.picks);
+                stock.compact_if_sparse();
+                if (!potion.empty()) {
+                    potion_program::compile(potion).apply(*enemies[target]);
+                }
+                break;
+            }
+            case battle_action::kind::splash_potion: {
+                inventory& stock = player_->stored_ingredients();
+                const ingredient_list potion = stock.take(action.picks);
+                stock.compact_if_sparse();
+                splash_potion(potion, enemies);
+                break;
+            }
+            case battle_action::kind::surrender:
+                break;
+            }
+        }
+
+        cleanup_dead_enemies(enemies);
+        if (enemies.empty()) { return battle_outcome::won; }
+
+        enemy_turn(enemies);
+        const bool struck_down = player_->is_dead();
+        player_->tick();
+
+        if (player_->is_dead()) {
+            defeat_ = struck_down ? defeat_cause::enemies
+                                  : defeat_cause::effects;
+            return battle_outcome::lost;
+        }
+        return enemies.empty() ? battle_outcome::won : battle_outcome::ongoing;
+    }
+
+    auto game_state::battle_stream(const std::uint32_t slot) const
+            -> stream_key
+    {
+        return {run_id_, static_cast<std::uint32_t>(current_stage_), turn_,
+                slot};
+    }
+
+    auto game_state::cleanup_dead_enemies(enemy_party& enemies) -> void
     {
-        std::erase_if(enemies, [](const enemy* e) { return e->is_dead(); });
+        erase_if(enemies, [](const enemy* e) { return e->is_dead(); });
     }
 
     auto game_state::generate_shop_items() -> void
@@ -451,7 +1049,11 @@ namespace potmaker {
 
         for (int i = 0; i < item_count; ++i) {
             ingredient* ing = create_random_ingredient(1, current_stage_ + 1);
-            double price = 10.0 + (ing->potency() * random_double(8.0, 15.0));
+            const combat_value price
+                    = base_price
+                      + (ing->potency()
+                         * random_double(min_price_per_potency,
+                                         max_price_per_potency));
             shop_items_.emplace_back(ing, price);
         }
     }
@@ -478,15 +1080,18 @@ namespace potmaker {
         if (player_->gold() >= item.price) {
             player_->remove_gold(item.price);
             player_->store_ingredient(item.item);
+            owned_ingredients_.push_back(item.item);
 
             // Replace bought item
             shop_items_.erase(shop_items_.begin() + index);
 
             ingredient* new_ingredient
                     = create_random_ingredient(1, current_stage_ + 1);
-            double price
-                    = 10.0
-                      + (new_ingredient->potency() * random_double(8.0, 15.0));
+            const combat_value price
+                    = base_price
+                      + (new_ingredient->potency()
+                         * random_double(min_price_per_potency,
+                                         max_price_per_potency));
             shop_items_.emplace_back(new_ingredient, price);
 
             return true;
@@ -495,6 +1100,35 @@ namespace potmaker {
         return false;
     }
 
+    auto game_state::plan_purchases() const -> shop_plan
+    {
+        std::vector<shop_offer> offers;
+        offers.reserve(shop_items_.size());
+        for (const auto& item: shop_items_) {
+            offers.push_back(
+                    {to_double(item.price), item.item->expected_value()});
+        }
+
+        const double gold = to_double(player_->gold());
+        const std::vector<restock_outcome> restock = restock_outcomes();
+        return shop_planner(restock, gold).plan(offers, gold);
+    }
+
+    auto game_state::buy_planned() -> std::size_t
+    {
+        // The plan counts on buying restocked items as they appear, so
+        // each purchase is followed by a new plan that sees the restock
+        std::size_t bought = 0;
+        while (true) {
+            const shop_plan plan = plan_purchases();
+            if (plan.picks.empty()
+                || !buy_item(static_cast<int>(plan.picks.front()))) {
+                return bought;
+            }
+            ++bought;
+        }
+    }
+
     auto game_state::display_player_status() -> void
     {
         std::cout << "\n=== PLAYER STATUS ===\n";
@@ -510,17 +1144,18 @@ namespace potmaker {
     auto game_state::display_inventory() const -> void
     {
         std::cout << "\n=== INVENTORY ===\n";
-        const auto& ingredients = player_->stored_ingredients();
+        const auto& stacks = player_->stored_ingredients().stacks();
 
-        if (ingredients.empty()) {
+        if (player_->stored_ingredients().empty()) {
             std::cout << "No ingredients in inventory.\n";
             return;
         }
 
-        for (size_t i = 0; i < ingredients.size(); ++i) {
-            std::cout << std::format("{}. {} (Potency: {})\n", i + 1,
-                                     ingredients[i]->name(),
-                                     ingredients[i]->potency());
+        for (size_t i = 0; i < stacks.size(); ++i) {
+            const auto& stack = stacks[i];
+            std::cout << std::format("{}. {} (Potency: {}) x{}\n", i + 1,
+                                     stack.name, stack.potency,
+                                     stack.units.size());
         }
     }
 
@@ -546,16 +1181,17 @@ namespace potmaker {
     }
 
     auto game_state::calculate_gold_reward(
-            const std::vector<enemy*>& defeated_enemies) const -> double
+            const std::span<enemy* const> defeated_enemies) const
+            -> combat_value
     {
-        double total_reward = 0.0;
+        combat_value total_reward = 0;
 
         for (const auto* enemy: defeated_enemies) {
             // Base reward
-            const double base_reward = 5.0 + (enemy->level() * 3.0);
+            const combat_value base_reward = 5 + (enemy->level() * 3);
 
             // Bonus
-            const double stage_bonus = current_stage_ * 2.0;
+            const combat_value stage_bonus = current_stage_ * 2;
 
             total_reward += base_reward + stage_bonus;
         }
@@ -563,28 +1199,213 @@ namespace potmaker {
         return total_reward * random_double(0.8, 1.2); // Add some variation
     }
 
+    auto game_state::current_player() -> player&
+    {
+        return *player_;
+    }
+
+    auto game_state::stage() const -> int
+    {
+        return current_stage_;
+    }
+
+    auto game_state::defeated_by() const -> defeat_cause
+    {
+        return defeat_;
+    }
+
+    auto game_state::running() const -> bool
+    {
+        return game_running_;
+    }
+
+    auto game_state::state_hash(const enemy_party& enemies) const
+            -> std::uint64_t
+    {
+        std::uint64_t hash
+                = hash_key(hash_part::stage,
+                           static_cast<std::uint64_t>(current_stage_))
+                  ^ player_->state_hash();
+        for (std::size_t i = 0; i < enemies.size(); ++i) {
+            hash += hash_key(hash_part::enemy, i, enemies[i]->state_hash());
+        }
+        return hash;
+    }
+
+    auto ingredient_type_count() -> int
+    {
+        const content_library* content = active_content();
+        return content ? static_cast<int>(content->ingredients().size())
+                       : 10;
+    }
+
+    auto enemy_type_count() -> int
+    {
+        const content_library* content = active_content();
+        return content ? static_cast<int>(content->enemies().size()) : 9;
+    }
+
+    namespace {
+
+        /**
+         * Maps a content library ingredient type to the built-in type that
+         * shares its element, which is where its names are taken from
+         */
+        auto builtin_ingredient_type(const int type) -> int
+        {
+            const content_library* content = active_content();
+            if (!content) { return type; }
+
+            const auto& definitions = content->ingredients();
+            if (type < 0 || type >= static_cast<int>(definitions.size())) {
+                return type;
+            }
+            return ingredient_type_of(definitions[type].element);
+        }
+
+        /**
+         * Maps a content library enemy type to the built-in type that shares
+         * its element. Built-in enemy types are numbered like their elements
+         */
+        auto builtin_enemy_type(const int type) -> int
+        {
+            const content_library* content = active_content();
+            if (!content) { return type; }
+
+            const auto& definitions = content->enemies();
+            if (type < 0 || type >= static_cast<int>(definitions.size())) {
+                return type;
+            }
+            const int element = static_cast<int>(definitions[type].element);
+            return element < 9 ? element : 0;
+        }
+
+        thread_local scoped_enemy_types* active_types = nullptr;
+
+    } // namespace
+
     // Factories and Creation
+    auto game_state::restock_outcomes() const -> std::vector<restock_outcome>
+    {
+        // Restocks are made like create_random_ingredient(1, stage + 1)
+        constexpr int price_steps = 4;
+        const int types = ingredient_type_count();
+        const int max_potency = current_stage_ + 1;
+        const double probability
+                = 1.0 / (types * max_potency * price_steps);
+
+        std::vector<restock_outcome> outcomes;
+        outcomes.reserve(static_cast<std::size_t>(types * max_potency
+                                                  * price_steps));
+        for (int type = 0; type < types; ++type) {
+            for (int potency = 1; potency <= max_potency; ++potency) {
+                const std::unique_ptr<ingredient> sample(
+                        create_ingredient_by_type(type, "", potency));
+                const double value = sample->expected_value();
+
+                for (int step = 0; step < price_steps; ++step) {
+                    const double per_potency
+                            = min_price_per_potency
+                              + (max_price_per_potency - min_price_per_potency)
+                                        * (step + 0.5) / price_steps;
+                    outcomes.push_back({probability,
+                                        to_double(base_price)
+                                                + potency * per_potency,
+                                        value});
+                }
+            }
+        }
+        return outcomes;
+    }
+
     auto create_random_ingredient(int min_potency, int max_potency)
             -> ingredient*
     {
-        const int type = random_int(0, 9); // 10 types of ingredients
+        const int type = random_int(0, ingredient_type_count() - 1);
         const int potency = random_int(min_potency, max_potency);
         const std::string name = get_random_ingredient_name(type);
 
         return create_ingredient_by_type(type, name, potency);
     }
 
+    scoped_enemy_types::scoped_enemy_types(std::vector<int> types)
+        : types_(std::move(types)), previous_(active_types)
+    {
+        for (const int type: types_) {
+            if (type < 0 || type >= enemy_type_count()) {
+                throw std::out_of_range("no such enemy type");
+            }
+        }
+        active_types = this;
+    }
+
+    scoped_enemy_types::~scoped_enemy_types()
+    {
+        active_types = previous_;
+    }
+
+    auto scoped_enemy_types::next(const int drawn) -> int
+    {
+        return next_ < types_.size() ? types_[next_++] : drawn;
+    }
+
     auto create_random_enemy(const int level) -> enemy*
     {
-        const int type = random_int(0, 8);
+        int type = random_int(0, enemy_type_count() - 1);
+        if (scoped_importance_sampling* sampler = importance_sampling()) {
+            type = sampler->enemy_type(type, enemy_type_count());
+        }
+        if (active_types != nullptr) { type = active_types->next(type); }
         const std::string name = get_random_enemy_name(type);
 
         return create_enemy_by_type(type, name, level);
     }
 
+    auto create_random_enemies(const int level, const int count)
+            -> enemy_party
+    {
+        std::vector<int> types(count);
+        std::vector<int> names(count);
+        std::vector<double> rolls(2 * static_cast<std::size_t>(count));
+
+        random_buffer& rng = random_source();
+        rng.fill_ints(types, 0, enemy_type_count() - 1);
+        if (scoped_importance_sampling* sampler = importance_sampling()) {
+            for (int& type: types) {
+                type = sampler->enemy_type(type, enemy_type_count());
+            }
+        }
+        if (active_types != nullptr) {
+            for (int& type: types) { type = active_types->next(type); }
+        }
+        rng.fill_ints(names, 0, 9);
+        rng.fill_unit_doubles(rolls);
+        if (antithetic_draws()) {
+            for (double& roll: rolls) { roll = 1.0 - roll; }
+        }
+
+        enemy_party enemies;
+        enemies.reserve(count);
+
+        for (int i = 0; i < count; ++i) {
+            const enemy_rolls stat_rolls{rolls[2 * i], rolls[2 * i + 1]};
+            enemies.push_back(create_enemy_by_type(
+                    types[i], get_enemy_name(types[i], names[i]), level,
+                    stat_rolls));
+        }
+
+        return enemies;
+    }
+
     auto create_ingredient_by_type(const int type, const std::string& name,
                                    const int potency) -> ingredient*
     {
+        if (const content_library* content = active_content()) {
+            const bool known = type >= 0 && type < ingredient_type_count();
+            return content->create_ingredient(known ? type : 0, name,
+                                              potency);
+        }
+
         switch (type) {
         case 0:
             return new flaming_ingredient(name, potency);
@@ -614,29 +1435,115 @@ namespace potmaker {
     auto create_enemy_by_type(const int type, const std::string& name,
                               const int level) -> enemy*
     {
+        return create_enemy_by_type(type, name, level, enemy_rolls::draw());
+    }
+
+    auto create_enemy_by_type(const int type, const std::string& name,
+                              const int level, const enemy_rolls rolls)
+            -> enemy*
+    {
+        if (const content_library* content = active_content()) {
+            const bool known = type >= 0 && type < enemy_type_count();
+            return content->create_enemy(known ? type : 0, name, level, rolls);
+        }
+
         // Cleanup is delegated to another method
         // The freeing responsibility is being delegated
         switch (type) {
         case 0:
-            return new flaming_enemy(name, level);
+            return new flaming_enemy(name, level, rolls);
         case 1:
-            return new chilling_enemy(name, level);
+            return new chilling_enemy(name, level, rolls);
         case 2:
-            return new poisonous_enemy(name, level);
+            return new poisonous_enemy(name, level, rolls);
         case 3:
-            return new withering_enemy(name, level);
+            return new withering_enemy(name, level, rolls);
         case 4:
-            return new healing_enemy(name, level);
+            return new healing_enemy(name, level, rolls);
         case 5:
-            return new regenerative_enemy(name, level);
+            return new regenerative_enemy(name, level, rolls);
         case 6:
-            return new protective_enemy(name, level);
+            return new protective_enemy(name, level, rolls);
         case 7:
-            return new strengthening_enemy(name, level);
+            return new strengthening_enemy(name, level, rolls);
         case 8:
-            return new cleansing_enemy(name, level);
+            return new cleansing_enemy(name, level, rolls);
         default:
-            return new flaming_enemy(name, level);
+            return new flaming_enemy(name, level, rolls);
+        }
+    }
+
+    auto ingredient_type_of(const ingredient& ing) -> int
+    {
+        const content_library* content = active_content();
+        const auto* scripted = dynamic_cast<const scripted_ingredient*>(&ing);
+        if (content && scripted) {
+            return static_cast<int>(&scripted->definition()
+                                    - content->ingredients().data());
+        }
+
+        return ingredient_type_of(ing.element());
+    }
+
+    auto ingredient_type_of(const element_type element) -> int
+    {
+        switch (element) {
+        case element_type::fire:
+            return 0;
+        case element_type::ice:
+            return 1;
+        case element_type::nature:
+            return 2;
+        case element_type::underworld:
+            return 3;
+        case element_type::healing:
+            return 4;
+        case element_type::regenerating:
+            return 5;
+        case element_type::protective:
+            return 6;
+        case element_type::strengthening:
+            return 7;
+        case element_type::purifying:
+            return 8;
+        case element_type::chaotic:
+            return 9;
+        default:
+            return 0;
+        }
+    }
+
+    auto enemy_type_of(const enemy& e) -> int
+    {
+        const content_library* content = active_content();
+        const auto* scripted = dynamic_cast<const scripted_enemy*>(&e);
+        if (content && scripted) {
+            return static_cast<int>(&scripted->definition()
+                                    - content->enemies().data());
+        }
+
+        // Built-in enemies are told apart by their element
+        switch (e.element()) {
+        case element_type::fire:
+            return 0;
+        case element_type::ice:
+            return 1;
+        case element_type::nature:
+            return 2;
+        case element_type::underworld:
+            return 3;
+        case element_type::regenerating:
+            return 4;
+        case element_type::healing:
+            return 5;
+        case element_type::protective:
+            return 6;
+        case element_type::strengthening:
+            return 7;
+        case element_type::purifying:
+            return 8;
+        default:
+            return 0;
         }
     }
 
@@ -644,7 +1551,7 @@ namespace potmaker {
     {
         using namespace constants;
 
-        switch (type) {
+        switch (builtin_ingredient_type(type)) {
         case 0:
             return std::string(flaming_ingredient_names[random_int(0, 9)]);
         case 1:
@@ -672,30 +1579,35 @@ namespace potmaker {
     }
 
     auto get_random_enemy_name(const int type) -> std::string
+    {
+        return get_enemy_name(type, random_int(0, 9));
+    }
+
+    auto get_enemy_name(const int type, const int index) -> std::string
     {
         using namespace constants;
 
-        switch (type) {
+        switch (builtin_enemy_type(type)) {
         case 0:
-            return std::string(flaming_enemy_names[random_int(0, 9)]);
+            return std::string(flaming_enemy_names[index]);
         case 1:
-            return std::string(chilling_enemy_names[random_int(0, 9)]);
+            return std::string(chilling_enemy_names[index]);
         case 2:
-            return std::string(poisonous_enemy_names[random_int(0, 9)]);
+            return std::string(poisonous_enemy_names[index]);
         case 3:
-            return std::string(withering_enemy_names[random_int(0, 9)]);
+            return std::string(withering_enemy_names[index]);
         case 4:
-            return std::string(healing_enemy_names[random_int(0, 9)]);
+            return std::string(healing_enemy_names[index]);
         case 5:
-            return std::string(regenerative_enemy_names[random_int(0, 9)]);
+            return std::string(regenerative_enemy_names[index]);
         case 6:
-            return std::string(protective_enemy_names[random_int(0, 9)]);
+            return std::string(protective_enemy_names[index]);
         case 7:
-            return std::string(strengthening_enemy_names[random_int(0, 9)]);
+            return std::string(strengthening_enemy_names[index]);
         case 8:
-            return std::string(cleansing_enemy_names[random_int(0, 9)]);
+            return std::string(cleansing_enemy_names[index]);
         default:
-            return std::string(flaming_enemy_names[random_int(0, 9)]);
+            return std::string(flaming_enemy_names[index]);
         }
     }
 
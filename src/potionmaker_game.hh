@@ -1,8 +1,15 @@
 #ifndef POTIONMAKER_HH
 #define POTIONMAKER_HH
+#include "counter_rng.hh"
 #include "entity.hh"
 #include "ingredient.hh"
+#include "potion_program.hh"
+#include "shop_planner.hh"
+#include <cstddef>
+#include <cstdint>
 #include <memory>
+#include <optional>
+#include <span>
 #include <string>
 #include <vector>
 
@@ -13,8 +20,41 @@ namespace potmaker {
      */
     struct shop_item {
         ingredient* item;
-        double price;
-        shop_item(ingredient* ing, double cost);
+        combat_value price;
+        shop_item(ingredient* ing, combat_value cost);
+    };
+
+    /**
+     * A player's move in a battle, for battles played without menus
+     */
+    struct battle_action {
+        enum class kind : std::uint8_t {
+            potion, // Throw a potion brewed from picks at the target
+            basic_attack, // Attack the target
+            surrender,
+            splash_potion // Splash every enemy with a potion of picks
+        };
+
+        kind type = kind::basic_attack;
+        // The enemy's place in the party. Out of range picks the last one
+        std::size_t target = 0;
+        // Numbers of the inventory stacks to take one ingredient from each
+        small_vector<std::size_t, 8> picks;
+    };
+
+    /**
+     * Where a battle stands after a turn
+     */
+    enum class battle_outcome : std::uint8_t { ongoing, won, lost };
+
+    /**
+     * What lost a battle played with game_state::play_turn
+     */
+    enum class defeat_cause : std::uint8_t {
+        none, // The battle was not lost
+        enemies, // An enemy's attack brought the player down
+        effects, // A status effect finished the player off
+        surrender
     };
 
     /**
@@ -58,6 +98,20 @@ namespace potmaker {
          */
         auto shop_menu() -> void;
 
+        /**
+         * Writes the current run to a save file
+         * @param path The save file's location
+         * @throws std::runtime_error If the file could not be written
+         */
+        auto save_game(const std::string& path) const -> void;
+
+        /**
+         * Replaces the current run with the one stored in a save file
+         * @param path The save file's location
+         * @throws std::runtime_error If the file is missing or malformed
+         */
+        auto load_game(const std::string& path) -> void;
+
         /**
          * Displays the game's credits
          */
@@ -67,29 +121,52 @@ namespace potmaker {
          * Creates a list of enemies for the player to fight
          * @return The enemies that the player must fight
          */
-        auto generate_enemies() -> std::vector<enemy*>;
+        auto generate_enemies() -> enemy_party;
 
         /**
          * Displays the name and HO of the enemies in the given vector of
          * enemies
          * @param enemies The enemies o display
          */
-        static auto display_enemies(const std::vector<enemy*>& enemies) -> void;
+        static auto display_enemies(const enemy_party& enemies) -> void;
 
         /**
          * Displays a menu where the user can build a potion
          * @return The ingredients that the custom potion contains
          */
-        auto create_potion() -> std::vector<ingredient*>;
+        auto create_potion() -> ingredient_list;
+
+        /**
+         * Displays the player's recipes and brews the one they pick
+         * @return The ingredients of the brewed potion, or nothing if the
+         * player would rather pick ingredients themselves
+         */
+        auto quick_brew() -> std::optional<ingredient_list>;
+
+        /**
+         * Asks the player whether to save a hand-made potion as a recipe,
+         * unless a saved recipe already brews it
+         * @param potion The ingredients of the potion
+         */
+        auto offer_recipe(const ingredient_list& potion) -> void;
 
         /**
          * Displays a menu where the user can choose which enemy to apply the
          * potion to
-         * @param potion The potion to throw
+         * @param potion The compiled potion to throw
          * @param enemies The enemies to choose from
          */
-        auto apply_potion(const std::vector<ingredient*>& potion,
-                          const std::vector<enemy*>& enemies) -> void;
+        auto apply_potion(const potion_program& potion,
+                          const enemy_party& enemies) -> void;
+
+        /**
+         * Throws a splash potion, which hits every enemy at reduced potency.
+         * A potion with too few ingredients is put back into the inventory
+         * @param potion The ingredients of the potion
+         * @param enemies The enemies to splash
+         */
+        auto splash_potion(const ingredient_list& potion,
+                           const enemy_party& enemies) -> void;
 
         /**
          * Displays the menu corresponding to an ongoing fight
@@ -97,14 +174,39 @@ namespace potmaker {
          * @param initial_attack_type The attack type to perform
          * @return If the user won or not
          */
-        auto fight_round(std::vector<enemy*>& enemies, int initial_attack_type)
+        auto fight_round(enemy_party& enemies, int initial_attack_type)
                 -> bool;
 
+        /**
+         * Starts the battle of the current stage
+         * @return The enemies to fight
+         */
+        auto begin_battle() -> enemy_party;
+
+        /**
+         * Plays one turn of a battle without asking for input: the player's
+         * action, then the enemies' turn and the player's effects. This is
+         * what fight_round does on each pass, with the action given up front
+         * @param enemies The enemies in the battle
+         * @param action What the player does
+         * @return Where the battle stands afterwards
+         */
+        auto play_turn(enemy_party& enemies, const battle_action& action)
+                -> battle_outcome;
+
+        /**
+         * Settles a finished battle. A win pays gold for every enemy of the
+         * battle and moves on to the next stage, a loss ends the run
+         * @param won Whether the player won
+         * @return The gold earned
+         */
+        auto end_battle(bool won) -> combat_value;
+
         /**
          * Handles an enemy's actions as well as updating their per-turn state
          * @param enemies The enemies to that will perform an action this round
          */
-        auto enemy_turn(std::vector<enemy*>& enemies) const -> void;
+        auto enemy_turn(enemy_party& enemies) const -> void;
 
         /**
          * Handles the player's attack choice and it's effects based on their
@@ -113,20 +215,26 @@ namespace potmaker {
          * @param attack_type The attack type chosen
          * @return If this action resulted in a win
          */
-        auto player_turn(std::vector<enemy*>& enemies, int attack_type) -> bool;
+        auto player_turn(enemy_party& enemies, int attack_type) -> bool;
 
         /**
          * Displays a menu where the user can choose to perform a basic attack
          * on an enemy
          * @param enemies The available enemies to pick from
          */
-        auto basic_attack(const std::vector<enemy*>& enemies) -> void;
+        auto basic_attack(const enemy_party& enemies) -> void;
+
+        /**
+         * Attacks an enemy with the player's base damage
+         * @param target The enemy
+         */
+        auto attack(enemy& target) -> void;
 
         /**
          * Handles emptying the enemy vector and free-ing the entities
          * @param enemies The entities to dispose of
          */
-        static auto cleanup_dead_enemies(std::vector<enemy*>& enemies) -> void;
+        static auto cleanup_dead_enemies(enemy_party& enemies) -> void;
 
         /**
          * Helps repopulate the shop items
@@ -146,6 +254,22 @@ namespace potmaker {
          */
         auto buy_item(int index) -> bool;
 
+        /**
+         * Works out the best basket to buy from the shop with the player's
+         * gold, valuing ingredients by the health they are expected to take
+         * from an enemy
+         * @return The basket
+         */
+        [[nodiscard]] auto plan_purchases() const -> shop_plan;
+
+        /**
+         * Buys what plan_purchases recommends one item at a time, planning
+         * again after each purchase so the item restocked in its place is
+         * weighed too. This is how simulated players shop
+         * @return How many items were bought
+         */
+        auto buy_planned() -> std::size_t;
+
         /**
          * Prints the player's state
          */
@@ -169,15 +293,104 @@ namespace potmaker {
          * @param defeated_enemies The enemies that the user has defeated
          * @return The gold reward
          */
-        auto
-        calculate_gold_reward(const std::vector<enemy*>& defeated_enemies) const
-                -> double;
+        auto calculate_gold_reward(
+                std::span<enemy* const> defeated_enemies) const
+                -> combat_value;
+
+        /**
+         * @return The player
+         */
+        [[nodiscard]] auto current_player() -> player&;
+
+        /**
+         * @return The stage being played
+         */
+        [[nodiscard]] auto stage() const -> int;
+
+        /**
+         * @return What lost the battle being played, or none if it has not
+         * been lost
+         */
+        [[nodiscard]] auto defeated_by() const -> defeat_cause;
+
+        /**
+         * @return Whether the run is still going
+         */
+        [[nodiscard]] auto running() const -> bool;
+
+        /**
+         * Works out what every enemy intends to do this turn against the
+         * battle as it is now. Large parties are split across threads kept
+         * for the purpose, which plan under the calling thread's output,
+         * draw, balance and stacking settings, so the intents are the same
+         * however many threads plan them
+         * @param enemies The enemies that will act this round
+         * @param intents Replaced by the intent of each enemy, in party
+         * order. Its storage is reused
+         * @param thread_count At most how many threads to plan with. 0 uses
+         * one per hardware thread. Each plans at least
+         * min_enemies_per_thread enemies
+         */
+        auto plan_enemy_turns(const enemy_party& enemies,
+                              intent_list& intents,
+                              std::size_t thread_count = 0) const -> void;
+
+        /**
+         * Hashes the state of a battle: the stage, the player (health,
+         * effects and inventory) and each enemy in its place in the party.
+         * Every part keeps its own hash up to date as it changes, so this
+         * only combines one hash per participant. Battles reached through
+         * different orders of the same actions hash the same
+         * @param enemies The enemies in the battle
+         * @return The hash
+         */
+        [[nodiscard]] auto state_hash(const enemy_party& enemies) const
+                -> std::uint64_t;
+
+        // Parties smaller than this are planned on the calling thread
+        static constexpr std::size_t min_enemies_per_thread = 64;
 
     private:
+        /**
+         * Builds the key of a battle participant's random stream for the
+         * current turn. The player uses slot 0 and each enemy its
+         * battle_slot, so an enemy's draws never depend on who fell before
+         * it
+         * @param slot The participant's slot
+         * @return The stream key
+         */
+        [[nodiscard]] auto battle_stream(std::uint32_t slot) const
+                -> stream_key;
+
+        /**
+         * Lists what the shop may restock after a purchase at the current
+         * stage. Each random price is split into a few equally likely
+         * prices
+         * @return The possible restocks
+         */
+        [[nodiscard]] auto restock_outcomes() const
+                -> std::vector<restock_outcome>;
+
+        // Shop items cost this much plus a random price per point of
+        // potency in this range
+        static constexpr combat_value base_price = 10;
+        static constexpr double min_price_per_potency = 8.0;
+        static constexpr double max_price_per_potency = 15.0;
+
+        // Splash potions need at least this many ingredients
+        static constexpr std::size_t min_splash_ingredients = 2;
+
         player* player_;
         std::vector<shop_item> shop_items_;
         int current_stage_;
         bool game_running_;
+        std::uint64_t run_id_;
+        std::uint32_t turn_;
+        defeat_cause defeat_;
+        // Scratch space of enemy_turn, kept so turns do not allocate once
+        // the largest party has been seen
+        mutable intent_list intents_;
+        mutable small_vector<bool, 8> changed_;
         // Memory management helpers
         std::vector<ingredient*> owned_ingredients_;
         std::vector<enemy*> owned_enemies_;
@@ -201,6 +414,50 @@ namespace potmaker {
      */
     auto create_random_enemy(int level) -> enemy*;
 
+    /**
+     * Allocates several enemies at once. Types, names and stat rolls are
+     * drawn from the random number generator in bulk. An importance sampler
+     * on the current thread picks the types with its bias instead
+     * @param level The level of the enemies
+     * @param count How many enemies to create
+     * @return The enemies
+     */
+    auto create_random_enemies(int level, int count) -> enemy_party;
+
+    /**
+     * Makes the next enemies that create_random_enemy and
+     * create_random_enemies make on the current thread take given types,
+     * for as long as it is alive. Everything else about them, and the
+     * random numbers drawn to make them, stays the same. Scopes nest; the
+     * previous types are restored on destruction
+     */
+    class scoped_enemy_types {
+    public:
+        /**
+         * Starts handing out types
+         * @param types The types of the next enemies, in the order they are
+         * made
+         * @throws std::out_of_range If a type does not exist
+         */
+        explicit scoped_enemy_types(std::vector<int> types);
+        ~scoped_enemy_types();
+
+        scoped_enemy_types(const scoped_enemy_types&) = delete;
+        auto operator=(const scoped_enemy_types&)
+                -> scoped_enemy_types& = delete;
+
+        /**
+         * @param drawn The type drawn for the next enemy
+         * @return The type it takes
+         */
+        auto next(int drawn) -> int;
+
+    private:
+        std::vector<int> types_;
+        std::size_t next_ = 0;
+        scoped_enemy_types* previous_;
+    };
+
     /**
      * Dynamically creates an ingredient based on a type index
      * @param type The type of the ingredient as a number
@@ -220,6 +477,51 @@ namespace potmaker {
     auto create_enemy_by_type(int type, const std::string& name, int level)
             -> enemy*;
 
+    /**
+     * Dynamically creates an enemy based on a type index, with pre-drawn
+     * stat rolls
+     * @param type The type of the enemy as a number
+     * @param name The name of the enemy
+     * @param level The level of the enemy
+     * @param rolls Where the enemy's stats land within their ranges
+     * @return The new enemy
+     */
+    auto create_enemy_by_type(int type, const std::string& name, int level,
+                              enemy_rolls rolls) -> enemy*;
+
+    /**
+     * @return How many ingredient types create_ingredient_by_type accepts
+     */
+    auto ingredient_type_count() -> int;
+
+    /**
+     * @return How many enemy types create_enemy_by_type accepts
+     */
+    auto enemy_type_count() -> int;
+
+    /**
+     * Obtains the type index of an ingredient, as accepted by
+     * create_ingredient_by_type
+     * @param ing The ingredient
+     * @return The type of the ingredient as a number
+     */
+    auto ingredient_type_of(const ingredient& ing) -> int;
+
+    /**
+     * Obtains the built-in ingredient type of an element
+     * @param element The element
+     * @return The type of the built-in ingredient with that element
+     */
+    auto ingredient_type_of(element_type element) -> int;
+
+    /**
+     * Obtains the type index of an enemy, as accepted by
+     * create_enemy_by_type
+     * @param e The enemy
+     * @return The type of the enemy as a number
+     */
+    auto enemy_type_of(const enemy& e) -> int;
+
     /**
      * Obtains a random ingredient name based on its type
      * @param type The type
@@ -234,6 +536,14 @@ namespace potmaker {
      */
     auto get_random_enemy_name(int type) -> std::string;
 
+    /**
+     * Obtains a specific enemy name based on its type
+     * @param type The type
+     * @param index The index of the name within the type's names
+     * @return The name
+     */
+    auto get_enemy_name(int type, int index) -> std::string;
+
 } // namespace potmaker
 
 #endif // POTIONMAKER_HH
\ No newline at end of file
@@ -0,0 +1,295 @@
+#include "potmaker_c.h"
+#include "potionmaker_game.hh"
+#include "util.hh"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+
+struct potmk_session {
+    std::unique_ptr<potmaker::game_state> game;
+    potmaker::enemy_party enemies;
+    std::string player_name;
+    std::uint32_t turn = 0;
+    bool over = false;
+};
+
+namespace {
+
+    using namespace potmaker;
+
+    thread_local std::string last_error;
+
+    auto fail(const int status, const char* what) -> int
+    {
+        last_error = what;
+        return status;
+    }
+
+    /**
+     * Runs an entry point's body, turning exceptions into statuses so that
+     * none escape into C
+     */
+    template<typename body_t>
+    auto guarded(body_t&& body) -> int
+    {
+        try {
+            const scoped_quiet_output quiet;
+            return body();
+        }
+        catch (const std::invalid_argument& e) {
+            return fail(POTMK_INVALID_ARGUMENT, e.what());
+        }
+        catch (const std::out_of_range& e) {
+            return fail(POTMK_INVALID_ARGUMENT, e.what());
+        }
+        catch (const std::bad_alloc&) {
+            return fail(POTMK_ERROR, "out of memory");
+        }
+        catch (const std::exception& e) {
+            return fail(POTMK_ERROR, e.what());
+        }
+        catch (...) {
+            return fail(POTMK_ERROR, "unknown error");
+        }
+    }
+
+    auto restart(potmk_session& session) -> void
+    {
+        // The old run's enemies go with its game
+        session.enemies.clear();
+        session.game = std::make_unique<game_state>(session.player_name);
+        session.enemies = session.game->begin_battle();
+        session.turn = 0;
+        session.over = false;
+    }
+
+    auto to_action(potmk_session& session, const potmk_action& action)
+            -> battle_action
+    {
+        if (action.type < POTMK_ACTION_POTION
+            || action.type > POTMK_ACTION_SPLASH_POTION) {
+            throw std::invalid_argument("unknown action type");
+        }
+        if (action.target < 0) {
+            throw std::invalid_argument("target must not be negative");
+        }
+        if (action.pick_count < 0 || action.pick_count > POTMK_MAX_PICKS) {
+            throw std::invalid_argument("too many picks");
+        }
+
+        const std::size_t stacks = session.game->current_player()
+                                           .stored_ingredients()
+                                           .stacks()
+                                           .size();
+        battle_action translated;
+        translated.type = static_cast<battle_action::kind>(action.type);
+        translated.target = static_cast<std::size_t>(action.target);
+        for (std::int32_t i = 0; i < action.pick_count; ++i) {
+            const std::int32_t pick = action.picks[i];
+            if (pick < 0 || static_cast<std::size_t>(pick) >= stacks) {
+                throw std::out_of_range("no such inventory stack");
+            }
+            translated.picks.push_back(static_cast<std::size_t>(pick));
+        }
+        return translated;
+    }
+
+} // namespace
+
+extern "C" {
+
+auto potmk_abi_version() -> std::uint32_t
+{
+    return POTMK_ABI_VERSION;
+}
+
+auto potmk_create(const char* player_name) -> potmk_session*
+{
+    potmk_session* created = nullptr;
+    guarded([&] {
+        auto session = std::make_unique<potmk_session>();
+        session->player_name = player_name ? player_name : "Anonymous";
+        restart(*session);
+        created = session.release();
+        return POTMK_OK;
+    });
+    return created;
+}
+
+auto potmk_destroy(potmk_session* session) -> void
+{
+    delete session;
+}
+
+auto potmk_seed(potmk_session* session, const std::uint64_t seed) -> int
+{
+    if (session == nullptr) {
+        return fail(POTMK_INVALID_ARGUMENT, "no session");
+    }
+    return guarded([&] {
+        seed_random(seed);
+        restart(*session);
+        return POTMK_OK;
+    });
+}
+
+auto potmk_step(potmk_session* session, const potmk_action* action,
+                std::int32_t* outcome) -> int
+{
+    if (session == nullptr || action == nullptr || outcome == nullptr) {
+        return fail(POTMK_INVALID_ARGUMENT, "null argument");
+    }
+    if (session->over) { return fail(POTMK_RUN_OVER, "the run is over"); }
+
+    return guarded([&] {
+        game_state& game = *session->game;
+        const battle_action translated = to_action(*session, *action);
+
+        const battle_outcome result
+                = game.play_turn(session->enemies, translated);
+        ++session->turn;
+
+        switch (result) {
+        case battle_outcome::ongoing:
+            *outcome = POTMK_ONGOING;
+            break;
+        case battle_outcome::won:
+            game.end_battle(true);
+            game.buy_planned();
+            session->enemies = game.begin_battle();
+            session->turn = 0;
+            *outcome = POTMK_WON;
+            break;
+        case battle_outcome::lost:
+            game.end_battle(false);
+            session->enemies.clear();
+            session->over = true;
+            *outcome = POTMK_LOST;
+            break;
+        }
+        return POTMK_OK;
+    });
+}
+
+auto potmk_read_state(potmk_session* session, potmk_state* state) -> int
+{
+    if (session == nullptr || state == nullptr) {
+        return fail(POTMK_INVALID_ARGUMENT, "null argument");
+    }
+
+    return guarded([&] {
+        game_state& game = *session->game;
+        player& p = game.current_player();
+
+        *state = {};
+        state->stage = game.stage();
+        state->turn = session->turn;
+        state->running = session->over ? 0 : 1;
+        state->enemy_count
+                = static_cast<std::uint32_t>(session->enemies.size());
+        state->stack_count = static_cast<std::uint32_t>(
+                p.stored_ingredients().stacks().size());
+        state->health = to_double(p.health());
+        state->max_health = to_double(p.max_health());
+        state->damage = to_double(p.damage());
+        state->gold = to_double(p.gold());
+        state->state_hash = game.state_hash(session->enemies);
+        return POTMK_OK;
+    });
+}
+
+auto potmk_read_enemies(potmk_session* session, potmk_enemy* enemies,
+                        const std::size_t capacity, std::size_t* count) -> int
+{
+    if (session == nullptr || count == nullptr
+        || (enemies == nullptr && capacity > 0)) {
+        return fail(POTMK_INVALID_ARGUMENT, "null argument");
+    }
+
+    return guarded([&] {
+        const enemy_party& party = session->enemies;
+        *count = party.size();
+
+        const std::size_t written = std::min(capacity, party.size());
+        for (std::size_t i = 0; i < written; ++i) {
+            const enemy& e = *party[i];
+            enemies[i] = {e.level(), static_cast<std::int32_t>(e.element()),
+                          to_double(e.health()), to_double(e.max_health()),
+                          to_double(e.damage())};
+        }
+        return written < party.size()
+                       ? fail(POTMK_BUFFER_TOO_SMALL, "too many enemies")
+                       : POTMK_OK;
+    });
+}
+
+auto potmk_read_inventory(potmk_session* session, potmk_stack* stacks,
+                          const std::size_t capacity, std::size_t* count)
+        -> int
+{
+    if (session == nullptr || count == nullptr
+        || (stacks == nullptr && capacity > 0)) {
+        return fail(POTMK_INVALID_ARGUMENT, "null argument");
+    }
+
+    return guarded([&] {
+        const auto& all = session->game->current_player()
+                                  .stored_ingredients()
+                                  .stacks();
+        *count = all.size();
+
+        const std::size_t written = std::min(capacity, all.size());
+        for (std::size_t i = 0; i < written; ++i) {
+            const inventory::stack& stack = all[i];
+            // A stack that ran out has no ingredient left to ask its type
+            const std::int32_t type
+                    = stack.units.empty()
+                              ? ingredient_type_of(stack.element)
+                              : ingredient_type_of(*stack.units.front());
+            stacks[i] = {type, static_cast<std::int32_t>(stack.element),
+                         stack.potency,
+                         static_cast<std::uint32_t>(stack.units.size())};
+        }
+        return written < all.size()
+                       ? fail(POTMK_BUFFER_TOO_SMALL, "too many stacks")
+                       : POTMK_OK;
+    });
+}
+
+auto potmk_save(potmk_session* session, const char* path) -> int
+{
+    if (session == nullptr || path == nullptr) {
+        return fail(POTMK_INVALID_ARGUMENT, "null argument");
+    }
+    return guarded([&] {
+        session->game->save_game(path);
+        return POTMK_OK;
+    });
+}
+
+auto potmk_load(potmk_session* session, const char* path) -> int
+{
+    if (session == nullptr || path == nullptr) {
+        return fail(POTMK_INVALID_ARGUMENT, "null argument");
+    }
+    return guarded([&] {
+        // A failed load leaves the run as it was
+        session->game->load_game(path);
+        session->enemies = session->game->begin_battle();
+        session->turn = 0;
+        session->over = false;
+        return POTMK_OK;
+    });
+}
+
+auto potmk_last_error() -> const char*
+{
+    return last_error.c_str();
+}
+
+} // extern "C"
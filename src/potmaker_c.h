@@ -0,0 +1,149 @@
+#ifndef POTMAKER_C_H
+#define POTMAKER_C_H
+/*
+ * A C interface to the game engine, for embedding it in other programs.
+ * Sessions play one run each without printing anything; every call
+ * returns a status and leaves the details of a failure in potmk_last_error.
+ * Callers own every buffer they pass in, and nothing is allocated on their
+ * behalf except the session itself.
+ *
+ * Each thread has its own random number generator, and potmk_seed seeds
+ * the calling thread's. Sessions that must be reproducible should be
+ * seeded and stepped on the same thread, one at a time.
+ */
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__GNUC__)
+#define POTMK_API __attribute__((visibility("default")))
+#else
+#define POTMK_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Bumped whenever a struct or function below changes incompatibly */
+#define POTMK_ABI_VERSION 1
+
+#define POTMK_MAX_PICKS 8
+
+typedef struct potmk_session potmk_session;
+
+typedef enum potmk_status {
+    POTMK_OK = 0,
+    POTMK_ERROR = -1, /* See potmk_last_error */
+    POTMK_INVALID_ARGUMENT = -2,
+    POTMK_BUFFER_TOO_SMALL = -3, /* What fit was written */
+    POTMK_RUN_OVER = -4 /* The run was lost; seed or load to go on */
+} potmk_status;
+
+typedef enum potmk_action_type {
+    POTMK_ACTION_POTION = 0,
+    POTMK_ACTION_BASIC_ATTACK = 1,
+    POTMK_ACTION_SURRENDER = 2,
+    POTMK_ACTION_SPLASH_POTION = 3
+} potmk_action_type;
+
+typedef enum potmk_outcome {
+    POTMK_ONGOING = 0,
+    POTMK_WON = 1, /* The next stage's battle has already begun */
+    POTMK_LOST = 2
+} potmk_outcome;
+
+typedef struct potmk_action {
+    int32_t type; /* A potmk_action_type */
+    int32_t target; /* The enemy's place, as potmk_read_enemies lists them */
+    int32_t pick_count;
+    /* Inventory stacks, as potmk_read_inventory lists them, to take one
+       ingredient from each */
+    int32_t picks[POTMK_MAX_PICKS];
+} potmk_action;
+
+typedef struct potmk_state {
+    int32_t stage;
+    uint32_t turn; /* Turns played in the current battle */
+    int32_t running; /* Zero once the run is lost */
+    uint32_t enemy_count;
+    uint32_t stack_count;
+    double health;
+    double max_health;
+    double damage;
+    double gold;
+    uint64_t state_hash;
+} potmk_state;
+
+typedef struct potmk_enemy {
+    int32_t level;
+    int32_t element;
+    double health;
+    double max_health;
+    double damage;
+} potmk_enemy;
+
+typedef struct potmk_stack {
+    int32_t type; /* As create_ingredient_by_type numbers them */
+    int32_t element;
+    int32_t potency;
+    uint32_t count; /* Zero for a stack that ran out */
+} potmk_stack;
+
+/* @return POTMK_ABI_VERSION as the library was built */
+POTMK_API uint32_t potmk_abi_version(void);
+
+/*
+ * Starts a run and its first battle
+ * @return The session, or NULL on failure
+ */
+POTMK_API potmk_session* potmk_create(const char* player_name);
+
+POTMK_API void potmk_destroy(potmk_session* session);
+
+/* Reseeds the random number generator and starts the session's run over */
+POTMK_API int potmk_seed(potmk_session* session, uint64_t seed);
+
+/*
+ * Plays one turn. After a win the player shops for the recommended basket
+ * and the next battle begins
+ * @param outcome Receives a potmk_outcome
+ */
+POTMK_API int potmk_step(potmk_session* session, const potmk_action* action,
+                         int32_t* outcome);
+
+POTMK_API int potmk_read_state(potmk_session* session, potmk_state* state);
+
+/*
+ * @param count Receives how many enemies there are, even if they did not
+ * all fit
+ */
+POTMK_API int potmk_read_enemies(potmk_session* session, potmk_enemy* enemies,
+                                 size_t capacity, size_t* count);
+
+/*
+ * @param count Receives how many stacks there are, even if they did not
+ * all fit
+ */
+POTMK_API int potmk_read_inventory(potmk_session* session,
+                                   potmk_stack* stacks, size_t capacity,
+                                   size_t* count);
+
+/*
+ * Saves the run. A battle in progress is not saved; loading starts the
+ * saved stage's battle from the beginning
+ */
+POTMK_API int potmk_save(potmk_session* session, const char* path);
+
+POTMK_API int potmk_load(potmk_session* session, const char* path);
+
+/*
+ * @return What went wrong in the last failed call on this thread. Valid
+ * until the next failing call on this thread
+ */
+POTMK_API const char* potmk_last_error(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* POTMAKER_C_H */
@@ -0,0 +1,118 @@
+#include "random_buffer.hh"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+
+namespace potmaker {
+
+    namespace {
+
+        constexpr auto rotl(const std::uint64_t x, const int k) -> std::uint64_t
+        {
+            return (x << k) | (x >> (64 - k));
+        }
+
+    } // namespace
+
+    random_buffer::random_buffer(const std::uint64_t seed)
+    {
+        reseed(seed);
+    }
+
+    auto random_buffer::reseed(std::uint64_t seed) -> void
+    {
+        // splitmix64 expands the seed so that similar seeds still produce
+        // unrelated lanes
+        for (auto& word: lanes_) {
+            for (auto& lane: word) {
+                seed += 0x9e3779b97f4a7c15ULL;
+                std::uint64_t z = seed;
+                z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+                z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+                lane = z ^ (z >> 31);
+            }
+        }
+        refill();
+    }
+
+    auto random_buffer::refill() -> void
+    {
+        block_start_ = lanes_;
+
+        auto& [s0, s1, s2, s3] = lanes_;
+        for (std::size_t i = 0; i < block_size; i += lane_count) {
+            // The multiplications by 5 and 9 are spelled as shifts so that
+            // the loop vectorizes without 64-bit vector multiplies
+            for (std::size_t l = 0; l < lane_count; ++l) {
+                const std::uint64_t x = (s1[l] << 2) + s1[l];
+                const std::uint64_t r = rotl(x, 7);
+                block_[i + l] = (r << 3) + r;
+
+                const std::uint64_t t = s1[l] << 17;
+                s2[l] ^= s0[l];
+                s3[l] ^= s1[l];
+                s1[l] ^= s2[l];
+                s0[l] ^= s3[l];
+                s2[l] ^= t;
+                s3[l] = rotl(s3[l], 45);
+            }
+        }
+
+        cursor_ = 0;
+    }
+
+    auto random_buffer::fill_ints(const std::span<int> out, const int min,
+                                  const int max) -> void
+    {
+        for (int& value: out) { value = int_in(min, max); }
+    }
+
+    auto random_buffer::fill_unit_doubles(const std::span<double> out) -> void
+    {
+        std::size_t done = 0;
+        while (done < out.size()) {
+            if (cursor_ == block_size) { refill(); }
+
+            // Convert straight out of the block, one contiguous run at a time
+            const std::size_t run
+                    = std::min(out.size() - done, block_size - cursor_);
+            for (std::size_t i = 0; i < run; ++i) {
+                out[done + i] = detail::to_unit_double(block_[cursor_ + i]);
+            }
+
+            cursor_ += run;
+            done += run;
+        }
+    }
+
+    auto random_buffer::state() const -> random_state
+    {
+        random_state state{};
+        for (std::size_t w = 0; w < 4; ++w) {
+            for (std::size_t l = 0; l < lane_count; ++l) {
+                state.lanes[w * lane_count + l] = block_start_[w][l];
+            }
+        }
+        state.cursor = cursor_;
+        return state;
+    }
+
+    auto random_buffer::restore(const random_state& state) -> void
+    {
+        if (state.cursor > block_size) {
+            throw std::invalid_argument("invalid random state cursor");
+        }
+
+        for (std::size_t w = 0; w < 4; ++w) {
+            for (std::size_t l = 0; l < lane_count; ++l) {
+                lanes_[w][l] = state.lanes[w * lane_count + l];
+            }
+        }
+
+        refill();
+        cursor_ = state.cursor;
+    }
+
+} // namespace potmaker
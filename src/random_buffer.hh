@@ -0,0 +1,208 @@
+#ifndef RANDOM_BUFFER_HH
+#define RANDOM_BUFFER_HH
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace potmaker {
+
+    /**
+     * The complete state of a random_buffer. Restoring a previously captured
+     * state replays the exact same values
+     */
+    struct random_state {
+        std::array<std::uint64_t, 16> lanes;
+        std::uint64_t cursor;
+    };
+
+    namespace detail {
+
+        /**
+         * Generates an unbiased value in the [0, range) range using Lemire's
+         * multiply-shift with rejection, which almost never needs a second
+         * draw
+         * @param gen A generator of raw 64-bit values
+         * @param range The amount of possible values. Must not be 0
+         * @return The value
+         */
+        template<typename generator_t>
+        auto bounded(generator_t& gen, const std::uint32_t range)
+                -> std::uint32_t
+        {
+            std::uint64_t m = (gen.next() >> 32) * range;
+            auto low = static_cast<std::uint32_t>(m);
+
+            if (low < range) {
+                const std::uint32_t threshold = -range % range;
+                while (low < threshold) {
+                    m = (gen.next() >> 32) * range;
+                    low = static_cast<std::uint32_t>(m);
+                }
+            }
+
+            return static_cast<std::uint32_t>(m >> 32);
+        }
+
+        /**
+         * Generates a random int in the [min, max] range
+         * @param gen A generator of raw 64-bit values
+         * @param min The min value
+         * @param max The max value
+         * @return A random int in [min, max]
+         */
+        template<typename generator_t>
+        auto int_in(generator_t& gen, const int min, const int max) -> int
+        {
+            const std::int64_t width = static_cast<std::int64_t>(max)
+                                       - static_cast<std::int64_t>(min);
+            const auto span = static_cast<std::uint64_t>(width);
+
+            if (span >= UINT32_MAX) {
+                return static_cast<int>(
+                        static_cast<std::int64_t>(min)
+                        + static_cast<std::int64_t>(gen.next() >> 32));
+            }
+
+            return static_cast<int>(
+                    static_cast<std::int64_t>(min)
+                    + bounded(gen, static_cast<std::uint32_t>(span + 1)));
+        }
+
+        /**
+         * Converts a raw value into a double in the [0, 1) range
+         * @param bits The raw value
+         * @return The double
+         */
+        constexpr auto to_unit_double(const std::uint64_t bits) -> double
+        {
+            return static_cast<double>(bits >> 11) * 0x1.0p-53;
+        }
+
+    } // namespace detail
+
+    /**
+     * Hands out random numbers from a block that is refilled in bulk.
+     *
+     * The block is produced by four independent xoshiro256** lanes stored
+     * side by side, so a refill is a straight loop the compiler can turn into
+     * vector code. Every value is derived from the seed alone, which keeps
+     * runs reproducible regardless of how the values are consumed
+     */
+    class random_buffer {
+    public:
+        static constexpr std::size_t lane_count = 4;
+        static constexpr std::size_t block_size = 1024;
+
+        /**
+         * Constructs a buffer from a seed
+         * @param seed The seed
+         */
+        explicit random_buffer(std::uint64_t seed);
+
+        /**
+         * Restarts the sequence from a new seed
+         * @param seed The seed
+         */
+        auto reseed(std::uint64_t seed) -> void;
+
+        /**
+         * @return The next raw 64-bit value
+         */
+        auto next() -> std::uint64_t
+        {
+            if (cursor_ == block_size) { refill(); }
+            return block_[cursor_++];
+        }
+
+        /**
+         * Generates an unbiased value in the [0, range) range
+         * @param range The amount of possible values. Must not be 0
+         * @return The value
+         */
+        auto bounded(const std::uint32_t range) -> std::uint32_t
+        {
+            return detail::bounded(*this, range);
+        }
+
+        /**
+         * Generates a random int in the [min, max] range
+         * @param min The min value
+         * @param max The max value
+         * @return A random int in [min, max]
+         */
+        auto int_in(const int min, const int max) -> int
+        {
+            return detail::int_in(*this, min, max);
+        }
+
+        /**
+         * @return A random double in the [0, 1) range
+         */
+        auto unit_double() -> double
+        {
+            return detail::to_unit_double(next());
+        }
+
+        /**
+         * Generates a random double in the [min, max) range
+         * @param min The min value
+         * @param max The max value
+         * @return A random double in [min, max)
+         */
+        auto double_in(const double min, const double max) -> double
+        {
+            return min + (max - min) * unit_double();
+        }
+
+        /**
+         * Random chance generation. Like a die roll
+         * @param odds The denominator of the odds
+         * @return If a 1/odds chance lands
+         */
+        auto roll(const int odds) -> bool { return int_in(1, odds) == 1; }
+
+        /**
+         * Fills a range with random ints in the [min, max] range
+         * @param out The destination
+         * @param min The min value
+         * @param max The max value
+         */
+        auto fill_ints(std::span<int> out, int min, int max) -> void;
+
+        /**
+         * Fills a range with random doubles in the [0, 1) range
+         * @param out The destination
+         */
+        auto fill_unit_doubles(std::span<double> out) -> void;
+
+        /**
+         * @return A snapshot of the buffer's state
+         */
+        [[nodiscard]] auto state() const -> random_state;
+
+        /**
+         * Replaces the buffer's state
+         * @param state A snapshot obtained through state
+         */
+        auto restore(const random_state& state) -> void;
+
+    private:
+        /**
+         * Generates the next block and resets the cursor
+         */
+        auto refill() -> void;
+
+        // Lane state at the start of the current block, word-major so that
+        // each word of all lanes is contiguous
+        alignas(64) std::array<std::array<std::uint64_t, lane_count>, 4>
+                block_start_{};
+        alignas(64) std::array<std::array<std::uint64_t, lane_count>, 4>
+                lanes_{};
+        alignas(64) std::array<std::uint64_t, block_size> block_{};
+        std::size_t cursor_ = block_size;
+    };
+
+} // namespace potmaker
+
+#endif // RANDOM_BUFFER_HH
@@ -0,0 +1,121 @@
+#include "recipe_book.hh"
+#include "ingredient.hh"
+#include "potionmaker_game.hh"
+#include <algorithm>
+#include <cstddef>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace potmaker {
+
+    auto recipe_book::from_potion(std::string name,
+                                  const ingredient_list& potion) -> recipe
+    {
+        recipe r{std::move(name), {}};
+        r.slots.reserve(potion.size());
+        for (const auto* ing: potion) {
+            r.slots.push_back(
+                    {ingredient_type_of(*ing), ing->element(), ing->potency()});
+        }
+        return r;
+    }
+
+    auto recipe_book::add(recipe r) -> std::size_t
+    {
+        if (const auto existing = find(r.name)) {
+            recipes_[*existing] = std::move(r);
+            return *existing;
+        }
+
+        recipes_.push_back(std::move(r));
+        return recipes_.size() - 1;
+    }
+
+    auto recipe_book::remove(const std::size_t index) -> void
+    {
+        if (index >= recipes_.size()) {
+            throw std::out_of_range("no such recipe");
+        }
+        recipes_.erase(recipes_.begin() + static_cast<std::ptrdiff_t>(index));
+    }
+
+    auto recipe_book::recipes() const -> const std::vector<recipe>&
+    {
+        return recipes_;
+    }
+
+    auto recipe_book::find(const std::string_view name) const
+            -> std::optional<std::size_t>
+    {
+        const auto it = std::ranges::find(recipes_, name, &recipe::name);
+        if (it == recipes_.end()) { return std::nullopt; }
+        return static_cast<std::size_t>(it - recipes_.begin());
+    }
+
+    auto recipe_book::find_potion(const ingredient_list& potion) const
+            -> std::optional<std::size_t>
+    {
+        const auto brews = [&potion](const recipe& r) {
+            return std::ranges::equal(
+                    r.slots, potion,
+                    [](const recipe_slot& slot, const ingredient* ing) {
+                        return slot.type == ingredient_type_of(*ing)
+                               && slot.element == ing->element()
+                               && slot.potency == ing->potency();
+                    });
+        };
+        const auto it = std::ranges::find_if(recipes_, brews);
+        if (it == recipes_.end()) { return std::nullopt; }
+        return static_cast<std::size_t>(it - recipes_.begin());
+    }
+
+    auto recipe_book::match(const std::size_t index,
+                            const inventory& stock) const
+            -> std::optional<recipe_picks>
+    {
+        const recipe& r = recipes_.at(index);
+        const auto& stacks = stock.stacks();
+
+        recipe_picks picks;
+        picks.reserve(r.slots.size());
+
+        for (const recipe_slot& slot: r.slots) {
+            const std::span<const std::size_t> candidates
+                    = stock.stacks_with(slot.element, slot.potency);
+
+            // Earlier slots may already have taken units from a stack
+            const auto fits = [&](const std::size_t stack) {
+                const auto& units = stacks[stack].units;
+                const auto taken = static_cast<std::size_t>(
+                        std::ranges::count(picks, stack));
+                return units.size() > taken
+                       && ingredient_type_of(*units.front()) == slot.type;
+            };
+
+            const auto it = std::ranges::find_if(candidates, fits);
+            if (it == candidates.end()) { return std::nullopt; }
+            picks.push_back(*it);
+        }
+
+        return picks;
+    }
+
+    auto recipe_book::brew(const std::size_t index, inventory& stock) const
+            -> std::optional<ingredient_list>
+    {
+        const auto picks = match(index, stock);
+        if (!picks) { return std::nullopt; }
+        return stock.take(std::span<const std::size_t>(*picks));
+    }
+
+    auto recipe_book::empty() const -> bool
+    {
+        return recipes_.empty();
+    }
+
+} // namespace potmaker
@@ -0,0 +1,121 @@
+#ifndef RECIPE_BOOK_HH
+#define RECIPE_BOOK_HH
+#include "element_type.hh"
+#include "inventory.hh"
+#include "small_vector.hh"
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace potmaker {
+
+    /**
+     * One ingredient of a recipe. Any stored ingredient of the same type and
+     * potency fits, whatever its name
+     */
+    struct recipe_slot {
+        int type;
+        element_type element;
+        std::int32_t potency;
+    };
+
+    /**
+     * A named potion the player can brew again in one go
+     */
+    struct recipe {
+        std::string name;
+        small_vector<recipe_slot, 8> slots;
+    };
+
+    // The stacks a recipe takes its ingredients from, one per slot
+    using recipe_picks = small_vector<std::size_t, 16>;
+
+    /**
+     * The player's saved recipes
+     */
+    class recipe_book {
+    public:
+        /**
+         * Describes a brewed potion as a recipe
+         * @param name The name of the recipe
+         * @param potion The ingredients of the potion
+         * @return The recipe
+         */
+        [[nodiscard]] static auto from_potion(std::string name,
+                                              const ingredient_list& potion)
+                -> recipe;
+
+        /**
+         * Saves a recipe, replacing any recipe with the same name
+         * @param r The recipe
+         * @return The number of the recipe
+         */
+        auto add(recipe r) -> std::size_t;
+
+        /**
+         * Forgets a recipe
+         * @param index The number of the recipe
+         * @throws std::out_of_range If there is no such recipe
+         */
+        auto remove(std::size_t index) -> void;
+
+        /**
+         * @return The recipes, in the order they were first saved
+         */
+        [[nodiscard]] auto recipes() const -> const std::vector<recipe>&;
+
+        /**
+         * @param name The name of a recipe
+         * @return The number of the recipe, if it exists
+         */
+        [[nodiscard]] auto find(std::string_view name) const
+                -> std::optional<std::size_t>;
+
+        /**
+         * @param potion The ingredients of a potion
+         * @return The number of a recipe that brews that potion, with the
+         * same slots in the same order, if one is saved
+         */
+        [[nodiscard]] auto find_potion(const ingredient_list& potion) const
+                -> std::optional<std::size_t>;
+
+        /**
+         * Works out which stacks a recipe would take its ingredients from.
+         * Each slot is looked up through the inventory's element and potency
+         * index, so this does not depend on how much is stored
+         * @param index The number of the recipe
+         * @param stock The inventory to brew from
+         * @return The stack of each slot, or nothing if an ingredient is
+         * missing
+         * @throws std::out_of_range If there is no such recipe
+         */
+        [[nodiscard]] auto match(std::size_t index,
+                                 const inventory& stock) const
+                -> std::optional<recipe_picks>;
+
+        /**
+         * Takes the ingredients of a recipe out of an inventory
+         * @param index The number of the recipe
+         * @param stock The inventory to brew from
+         * @return The ingredients in recipe order, or nothing (and the
+         * inventory untouched) if an ingredient is missing
+         * @throws std::out_of_range If there is no such recipe
+         */
+        auto brew(std::size_t index, inventory& stock) const
+                -> std::optional<ingredient_list>;
+
+        /**
+         * @return Whether no recipe is saved
+         */
+        [[nodiscard]] auto empty() const -> bool;
+
+    private:
+        std::vector<recipe> recipes_;
+    };
+
+} // namespace potmaker
+
+#endif // RECIPE_BOOK_HH
@@ -0,0 +1,254 @@
+#include "save_file.hh"
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace potmaker::save {
+
+    auto writer::header() -> save::header&
+    {
+        return header_;
+    }
+
+    auto writer::add_string(const std::string_view str)
+            -> std::pair<std::uint32_t, std::uint32_t>
+    {
+        const auto offset = static_cast<std::uint32_t>(strings_.size());
+        strings_.append(str);
+        return {offset, static_cast<std::uint32_t>(str.size())};
+    }
+
+    auto writer::make_ingredient(const int type, const std::int32_t potency,
+                                 const std::string_view name)
+            -> ingredient_record
+    {
+        const auto [offset, length] = add_string(name);
+        return {type, potency, offset, length};
+    }
+
+    auto writer::add_ingredient(const int type, const std::int32_t potency,
+                                const std::string_view name) -> void
+    {
+        ingredients_.push_back(make_ingredient(type, potency, name));
+    }
+
+    auto writer::add_shop_item(const int type, const std::int32_t potency,
+                               const std::string_view name, const double price)
+            -> void
+    {
+        shop_items_.push_back({make_ingredient(type, potency, name), price});
+    }
+
+    auto writer::add_effect(const std::size_t kind, const int turns,
+                            const int potency) -> void
+    {
+        effects_.push_back(
+                {static_cast<std::uint32_t>(kind), turns, potency, 0});
+    }
+
+    auto writer::add_recipe(const std::string_view name) -> void
+    {
+        const auto [offset, length] = add_string(name);
+        recipes_.push_back(
+                {offset, length,
+                 static_cast<std::uint32_t>(recipe_slots_.size()), 0});
+    }
+
+    auto writer::add_recipe_slot(const int type, const int element,
+                                 const std::int32_t potency) -> void
+    {
+        recipe_slots_.push_back({type, element, potency, 0});
+        ++recipes_.back().slot_count;
+    }
+
+    auto writer::write(const std::string& path) -> void
+    {
+        header_.magic = magic;
+        header_.version = format_version;
+        header_.ingredient_count
+                = static_cast<std::uint32_t>(ingredients_.size());
+        header_.shop_item_count
+                = static_cast<std::uint32_t>(shop_items_.size());
+        header_.effect_count = static_cast<std::uint32_t>(effects_.size());
+        header_.recipe_count = static_cast<std::uint32_t>(recipes_.size());
+        header_.recipe_slot_count
+                = static_cast<std::uint32_t>(recipe_slots_.size());
+        header_.strings_size = static_cast<std::uint32_t>(strings_.size());
+
+        const std::size_t total = sizeof(save::header)
+                                  + std::span(ingredients_).size_bytes()
+                                  + std::span(shop_items_).size_bytes()
+                                  + std::span(effects_).size_bytes()
+                                  + std::span(recipes_).size_bytes()
+                                  + std::span(recipe_slots_).size_bytes()
+                                  + strings_.size();
+        header_.file_size = static_cast<std::uint32_t>(total);
+
+        image_.resize(total);
+        std::byte* out = image_.data();
+        const auto append = [&out](const void* src, const std::size_t bytes) {
+            if (bytes != 0) { std::memcpy(out, src, bytes); }
+            out += bytes;
+        };
+
+        append(&header_, sizeof(save::header));
+        append(ingredients_.data(), std::span(ingredients_).size_bytes());
+        append(shop_items_.data(), std::span(shop_items_).size_bytes());
+        append(effects_.data(), std::span(effects_).size_bytes());
+        append(recipes_.data(), std::span(recipes_).size_bytes());
+        append(recipe_slots_.data(), std::span(recipe_slots_).size_bytes());
+        append(strings_.data(), strings_.size());
+
+        // Write next to the destination and swap it in, so readers only ever
+        // see a complete image
+        const std::string temp_path = path + ".tmp";
+        const int fd = ::open(temp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC,
+                              0644);
+        if (fd < 0) {
+            throw std::runtime_error("could not open save file for writing");
+        }
+
+        std::size_t written = 0;
+        while (written < total) {
+            const ::ssize_t n = ::write(fd, image_.data() + written,
+                                        total - written);
+            if (n <= 0) {
+                ::close(fd);
+                ::unlink(temp_path.c_str());
+                throw std::runtime_error("could not write save file");
+            }
+            written += static_cast<std::size_t>(n);
+        }
+        // The data must be on disk before the rename makes it the save, or
+        // a crash could leave an empty file in its place
+        const bool synced = ::fsync(fd) == 0;
+        ::close(fd);
+        if (!synced) {
+            ::unlink(temp_path.c_str());
+            throw std::runtime_error("could not write save file");
+        }
+
+        if (std::rename(temp_path.c_str(), path.c_str()) != 0) {
+            ::unlink(temp_path.c_str());
+            throw std::runtime_error("could not replace save file");
+        }
+    }
+
+    reader::reader(const std::string& path)
+    {
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) { throw std::runtime_error("save file not found"); }
+
+        struct stat info{};
+        if (::fstat(fd, &info) != 0
+            || static_cast<std::size_t>(info.st_size) < sizeof(save::header)) {
+            ::close(fd);
+            throw std::runtime_error("save file is truncated");
+        }
+
+        size_ = static_cast<std::size_t>(info.st_size);
+        void* mapping = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+
+        if (mapping == MAP_FAILED) {
+            throw std::runtime_error("could not map save file");
+        }
+        data_ = static_cast<const std::byte*>(mapping);
+
+        const save::header& h = header();
+        if (h.magic != magic) {
+            unmap();
+            throw std::runtime_error("not a potionmaker save file");
+        }
+        if (h.version != format_version) {
+            unmap();
+            throw std::runtime_error("unsupported save file version");
+        }
+
+        ingredients_offset_ = sizeof(save::header);
+        shop_items_offset_ = ingredients_offset_
+                             + h.ingredient_count * sizeof(ingredient_record);
+        effects_offset_ = shop_items_offset_
+                          + h.shop_item_count * sizeof(shop_item_record);
+        recipes_offset_ = effects_offset_
+                          + h.effect_count * sizeof(effect_record);
+        recipe_slots_offset_ = recipes_offset_
+                               + h.recipe_count * sizeof(recipe_record);
+        strings_offset_ = recipe_slots_offset_
+                          + h.recipe_slot_count * sizeof(recipe_slot_record);
+
+        if (h.file_size != size_ || strings_offset_ + h.strings_size != size_
+            || static_cast<std::uint64_t>(h.player_name_offset)
+                               + h.player_name_length
+                       > h.strings_size) {
+            unmap();
+            throw std::runtime_error("save file is corrupted");
+        }
+    }
+
+    reader::~reader()
+    {
+        unmap();
+    }
+
+    auto reader::unmap() -> void
+    {
+        if (data_ != nullptr) {
+            ::munmap(const_cast<std::byte*>(data_), size_);
+            data_ = nullptr;
+        }
+    }
+
+    auto reader::header() const -> const save::header&
+    {
+        return *reinterpret_cast<const save::header*>(data_);
+    }
+
+    auto reader::ingredients() const -> std::span<const ingredient_record>
+    {
+        return section<ingredient_record>(ingredients_offset_,
+                                          header().ingredient_count);
+    }
+
+    auto reader::shop_items() const -> std::span<const shop_item_record>
+    {
+        return section<shop_item_record>(shop_items_offset_,
+                                         header().shop_item_count);
+    }
+
+    auto reader::effects() const -> std::span<const effect_record>
+    {
+        return section<effect_record>(effects_offset_, header().effect_count);
+    }
+
+    auto reader::recipes() const -> std::span<const recipe_record>
+    {
+        return section<recipe_record>(recipes_offset_, header().recipe_count);
+    }
+
+    auto reader::recipe_slots() const -> std::span<const recipe_slot_record>
+    {
+        return section<recipe_slot_record>(recipe_slots_offset_,
+                                           header().recipe_slot_count);
+    }
+
+    auto reader::string_at(const std::uint32_t offset,
+                           const std::uint32_t length) const -> std::string_view
+    {
+        if (static_cast<std::uint64_t>(offset) + length
+            > header().strings_size) {
+            throw std::runtime_error("save file string out of range");
+        }
+        return {reinterpret_cast<const char*>(data_ + strings_offset_ + offset),
+                length};
+    }
+
+} // namespace potmaker::save
@@ -0,0 +1,232 @@
+#ifndef SAVE_FILE_HH
+#define SAVE_FILE_HH
+#include "util.hh"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace potmaker::save {
+
+    /*
+     * Save files are a flat image of the records below, written in one go
+     * and read back through a memory mapping without any parsing:
+     *
+     * [header][ingredient_record...][shop_item_record...][effect_record...]
+     * [recipe_record...][recipe_slot_record...][string table]
+     *
+     * Every record is trivially copyable and 8-byte aligned, so the sections
+     * can be viewed in place. Names are stored once in the string table and
+     * referenced by offset and length.
+     */
+
+    constexpr std::array<char, 8> magic{'P', 'O', 'T', 'M', 'K', 'S', 'A', 'V'};
+    constexpr std::uint32_t format_version = 4;
+    constexpr std::string_view default_path = "potionmaker.sav";
+
+    struct header {
+        std::array<char, 8> magic;
+        std::uint32_t version;
+        std::uint32_t file_size;
+        std::int32_t stage;
+        std::uint32_t ingredient_count;
+        std::uint32_t shop_item_count;
+        std::uint32_t effect_count;
+        std::uint32_t strings_size;
+        std::uint32_t player_name_offset;
+        std::uint32_t player_name_length;
+        std::uint32_t recipe_count;
+        std::uint32_t recipe_slot_count;
+        std::uint32_t reserved;
+        double max_health;
+        double health;
+        double damage;
+        double gold;
+        std::uint64_t run_id;
+        random_state rng;
+    };
+
+    struct ingredient_record {
+        std::int32_t type;
+        std::int32_t potency;
+        std::uint32_t name_offset;
+        std::uint32_t name_length;
+    };
+
+    struct shop_item_record {
+        ingredient_record ingredient;
+        double price;
+    };
+
+    struct effect_record {
+        std::uint32_t kind;
+        std::int32_t turns;
+        std::int32_t potency;
+        std::uint32_t reserved;
+    };
+
+    struct recipe_record {
+        std::uint32_t name_offset;
+        std::uint32_t name_length;
+        std::uint32_t first_slot;
+        std::uint32_t slot_count;
+    };
+
+    struct recipe_slot_record {
+        std::int32_t type;
+        std::int32_t element;
+        std::int32_t potency;
+        std::uint32_t reserved;
+    };
+
+    static_assert(std::is_trivially_copyable_v<header>);
+    static_assert(sizeof(header) % 8 == 0);
+    static_assert(sizeof(ingredient_record) % 8 == 0);
+    static_assert(sizeof(shop_item_record) % 8 == 0);
+    static_assert(sizeof(effect_record) % 8 == 0);
+    static_assert(sizeof(recipe_record) % 8 == 0);
+    static_assert(sizeof(recipe_slot_record) % 8 == 0);
+
+    /**
+     * Accumulates the records of a save file and writes them out as a single
+     * image
+     */
+    class writer {
+    public:
+        /**
+         * @return The header to fill in. Counts and sizes are set on write
+         */
+        [[nodiscard]] auto header() -> save::header&;
+
+        /**
+         * Stores a name in the string table
+         * @param str The name
+         * @return The offset and length to reference it by
+         */
+        auto add_string(std::string_view str)
+                -> std::pair<std::uint32_t, std::uint32_t>;
+
+        /**
+         * Appends an inventory ingredient
+         * @param type The ingredient's type index
+         * @param potency The ingredient's potency
+         * @param name The ingredient's name
+         */
+        auto add_ingredient(int type, std::int32_t potency,
+                            std::string_view name) -> void;
+
+        /**
+         * Appends an item on sale in the shop
+         * @param type The ingredient's type index
+         * @param potency The ingredient's potency
+         * @param name The ingredient's name
+         * @param price The price of the item
+         */
+        auto add_shop_item(int type, std::int32_t potency,
+                           std::string_view name, double price) -> void;
+
+        /**
+         * Appends a status effect afflicting the player
+         * @param kind The effect's index within status_effect_variant
+         * @param turns How many turns the effect has left
+         * @param potency The effect's potency
+         */
+        auto add_effect(std::size_t kind, int turns, int potency) -> void;
+
+        /**
+         * Starts a saved recipe. Its slots are the ones added after it
+         * @param name The recipe's name
+         */
+        auto add_recipe(std::string_view name) -> void;
+
+        /**
+         * Appends a slot to the last recipe added
+         * @param type The ingredient's type index
+         * @param element The ingredient's element
+         * @param potency The ingredient's potency
+         */
+        auto add_recipe_slot(int type, int element, std::int32_t potency)
+                -> void;
+
+        /**
+         * Writes the image to disk. The file is replaced atomically, so a
+         * crash mid-write never leaves a truncated save behind
+         * @param path The destination
+         */
+        auto write(const std::string& path) -> void;
+
+    private:
+        auto make_ingredient(int type, std::int32_t potency,
+                             std::string_view name) -> ingredient_record;
+
+        save::header header_{};
+        std::vector<ingredient_record> ingredients_;
+        std::vector<shop_item_record> shop_items_;
+        std::vector<effect_record> effects_;
+        std::vector<recipe_record> recipes_;
+        std::vector<recipe_slot_record> recipe_slots_;
+        std::string strings_;
+        std::vector<std::byte> image_;
+    };
+
+    /**
+     * Maps a save file into memory and exposes its sections in place
+     */
+    class reader {
+    public:
+        /**
+         * Opens and validates a save file
+         * @param path The save file
+         * @throws std::runtime_error If the file is missing or malformed
+         */
+        explicit reader(const std::string& path);
+        ~reader();
+
+        reader(const reader&) = delete;
+        auto operator=(const reader&) -> reader& = delete;
+
+        [[nodiscard]] auto header() const -> const save::header&;
+        [[nodiscard]] auto ingredients() const
+                -> std::span<const ingredient_record>;
+        [[nodiscard]] auto shop_items() const
+                -> std::span<const shop_item_record>;
+        [[nodiscard]] auto effects() const -> std::span<const effect_record>;
+        [[nodiscard]] auto recipes() const -> std::span<const recipe_record>;
+        [[nodiscard]] auto recipe_slots() const
+                -> std::span<const recipe_slot_record>;
+
+        /**
+         * @return A view of a name within the mapping
+         */
+        [[nodiscard]] auto string_at(std::uint32_t offset,
+                                     std::uint32_t length) const
+                -> std::string_view;
+
+    private:
+        auto unmap() -> void;
+
+        template<typename record_t>
+        [[nodiscard]] auto section(std::size_t offset, std::size_t count) const
+                -> std::span<const record_t>
+        {
+            return {reinterpret_cast<const record_t*>(data_ + offset), count};
+        }
+
+        const std::byte* data_ = nullptr;
+        std::size_t size_ = 0;
+        std::size_t ingredients_offset_ = 0;
+        std::size_t shop_items_offset_ = 0;
+        std::size_t effects_offset_ = 0;
+        std::size_t recipes_offset_ = 0;
+        std::size_t recipe_slots_offset_ = 0;
+        std::size_t strings_offset_ = 0;
+    };
+
+} // namespace potmaker::save
+
+#endif // SAVE_FILE_HH
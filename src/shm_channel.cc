@@ -0,0 +1,413 @@
+#include "shm_channel.hh"
+#include "battle_env.hh"
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <new>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#ifdef __linux__
+#include <ctime>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+namespace potmaker {
+
+    namespace {
+
+        static_assert(std::atomic<std::uint64_t>::is_always_lock_free);
+        static_assert(std::atomic<std::uint32_t>::is_always_lock_free);
+        static_assert(sizeof(std::atomic<std::uint32_t>)
+                      == sizeof(std::uint32_t));
+
+        constexpr std::uint64_t channel_magic = 0x4c4e4843544f50ULL; // POTCHNL
+        constexpr std::uint32_t channel_version = 1;
+
+        // How many times a side looks for the other before sleeping. A
+        // round trip with a trainer that answers quickly never sleeps
+        constexpr int spin_count = 4096;
+
+        // Sleepers wake up this often to see whether the channel closed, in
+        // case the other process died without closing it
+        constexpr long wait_timeout_ns = 50'000'000;
+
+        auto round_up(const std::size_t size, const std::size_t alignment)
+                -> std::size_t
+        {
+            return (size + alignment - 1) / alignment * alignment;
+        }
+
+        auto futex_wait(std::atomic<std::uint32_t>& word,
+                        const std::uint32_t seen) -> void
+        {
+#ifdef __linux__
+            // Not FUTEX_PRIVATE_FLAG: the word is shared between processes
+            const timespec timeout{0, wait_timeout_ns};
+            ::syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word),
+                      FUTEX_WAIT, seen, &timeout, nullptr, 0);
+#else
+            static_cast<void>(word);
+            static_cast<void>(seen);
+            std::this_thread::yield();
+#endif
+        }
+
+        auto futex_wake(std::atomic<std::uint32_t>& word) -> void
+        {
+#ifdef __linux__
+            ::syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word),
+                      FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+#else
+            static_cast<void>(word);
+#endif
+        }
+
+        auto cpu_relax() -> void
+        {
+#if defined(__x86_64__) || defined(__i386__)
+            __builtin_ia32_pause();
+#endif
+        }
+
+    } // namespace
+
+    spsc_ring::spsc_ring(ring_header* header, std::byte* records,
+                         const std::atomic<std::uint32_t>* closed)
+        : header_(header), records_(records), closed_(closed)
+    {}
+
+    auto spsc_ring::write(const std::span<const std::byte> records) -> bool
+    {
+        const std::size_t size = header_->record_size;
+        const std::size_t capacity = header_->capacity;
+        const std::size_t count = records.size() / size;
+
+        std::uint64_t head = header_->head.load(std::memory_order_relaxed);
+        std::size_t done = 0;
+        while (done < count) {
+            // Read before tail, so a consume that lands in between still
+            // cuts the wait short
+            const std::uint32_t seen
+                    = header_->consumed.load(std::memory_order_seq_cst);
+            const std::uint64_t tail
+                    = header_->tail.load(std::memory_order_acquire);
+            const auto room = static_cast<std::size_t>(capacity
+                                                       - (head - tail));
+            if (room == 0) {
+                if (closed_->load(std::memory_order_acquire) != 0) {
+                    return false;
+                }
+                wait(header_->consumed, header_->producer_waiting, seen);
+                continue;
+            }
+
+            // The free slots may wrap around the end of the ring
+            const std::size_t batch = std::min(room, count - done);
+            const auto start = static_cast<std::size_t>(head & (capacity - 1));
+            const std::size_t first = std::min(batch, capacity - start);
+            std::memcpy(records_ + start * size, records.data() + done * size,
+                        first * size);
+            std::memcpy(records_, records.data() + (done + first) * size,
+                        (batch - first) * size);
+
+            head += batch;
+            done += batch;
+            header_->head.store(head, std::memory_order_release);
+            header_->published.fetch_add(1, std::memory_order_seq_cst);
+            wake(header_->published, header_->consumer_waiting);
+        }
+        return true;
+    }
+
+    auto spsc_ring::read(const std::span<std::byte> records) -> bool
+    {
+        const std::size_t size = header_->record_size;
+        const std::size_t capacity = header_->capacity;
+        const std::size_t count = records.size() / size;
+
+        std::uint64_t tail = header_->tail.load(std::memory_order_relaxed);
+        std::size_t done = 0;
+        while (done < count) {
+            const std::uint32_t seen
+                    = header_->published.load(std::memory_order_seq_cst);
+            const std::uint64_t head
+                    = header_->head.load(std::memory_order_acquire);
+            const auto ready = static_cast<std::size_t>(head - tail);
+            if (ready == 0) {
+                if (closed_->load(std::memory_order_acquire) != 0) {
+                    return false;
+                }
+                wait(header_->published, header_->consumer_waiting, seen);
+                continue;
+            }
+
+            const std::size_t batch = std::min(ready, count - done);
+            const auto start = static_cast<std::size_t>(tail & (capacity - 1));
+            const std::size_t first = std::min(batch, capacity - start);
+            std::memcpy(records.data() + done * size, records_ + start * size,
+                        first * size);
+            std::memcpy(records.data() + (done + first) * size, records_,
+                        (batch - first) * size);
+
+            tail += batch;
+            done += batch;
+            header_->tail.store(tail, std::memory_order_release);
+            header_->consumed.fetch_add(1, std::memory_order_seq_cst);
+            wake(header_->consumed, header_->producer_waiting);
+        }
+        return true;
+    }
+
+    auto spsc_ring::record_size() const -> std::size_t
+    {
+        return header_->record_size;
+    }
+
+    auto spsc_ring::wake_all() -> void
+    {
+        header_->published.fetch_add(1, std::memory_order_seq_cst);
+        header_->consumed.fetch_add(1, std::memory_order_seq_cst);
+        futex_wake(header_->published);
+        futex_wake(header_->consumed);
+    }
+
+    auto spsc_ring::wait(std::atomic<std::uint32_t>& word,
+                         std::atomic<std::uint32_t>& waiting,
+                         const std::uint32_t seen) -> void
+    {
+        // With a single processor the other side cannot run while this one
+        // spins, so it goes straight to sleep
+        static const int spins
+                = std::thread::hardware_concurrency() > 1 ? spin_count : 0;
+        for (int i = 0; i < spins; ++i) {
+            if (word.load(std::memory_order_acquire) != seen) { return; }
+            cpu_relax();
+        }
+
+        // Announce the sleep before the last look, and the other side
+        // publishes before it looks for sleepers, so one of the two always
+        // sees the other
+        waiting.store(1, std::memory_order_seq_cst);
+        if (word.load(std::memory_order_seq_cst) == seen
+            && closed_->load(std::memory_order_seq_cst) == 0) {
+            futex_wait(word, seen);
+        }
+        waiting.store(0, std::memory_order_relaxed);
+    }
+
+    auto spsc_ring::wake(std::atomic<std::uint32_t>& word,
+                         const std::atomic<std::uint32_t>& waiting) -> void
+    {
+        if (waiting.load(std::memory_order_seq_cst) != 0) { futex_wake(word); }
+    }
+
+    struct shm_channel::layout {
+        std::atomic<std::uint64_t> magic;
+        std::uint32_t version;
+        std::atomic<std::uint32_t> closed;
+        std::uint64_t size;
+        // The creator writes to ring 0 and the opener to ring 1
+        std::uint64_t header_offsets[2];
+        std::uint64_t record_offsets[2];
+    };
+
+    shm_channel::shm_channel(const std::string& name,
+                             const channel_shape& shape)
+        : name_(name), owner_(true)
+    {
+        if (shape.capacity == 0 || shape.outbound_record_size == 0
+            || shape.inbound_record_size == 0) {
+            throw std::runtime_error("channel rings cannot be empty");
+        }
+
+        const std::size_t capacity = std::bit_ceil(shape.capacity);
+        const std::uint32_t record_sizes[2]
+                = {shape.outbound_record_size, shape.inbound_record_size};
+
+        std::uint64_t header_offsets[2];
+        std::uint64_t record_offsets[2];
+        std::size_t size = round_up(sizeof(layout), alignof(ring_header));
+        for (int i = 0; i < 2; ++i) {
+            header_offsets[i] = size;
+            record_offsets[i] = size + round_up(sizeof(ring_header), 64);
+            size = round_up(record_offsets[i] + capacity * record_sizes[i],
+                            alignof(ring_header));
+        }
+
+        const int fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL,
+                                  0600);
+        if (fd < 0) { throw std::runtime_error("could not create channel"); }
+        if (::ftruncate(fd, static_cast<::off_t>(size)) != 0) {
+            ::close(fd);
+            ::shm_unlink(name.c_str());
+            throw std::runtime_error("could not size channel");
+        }
+        try {
+            map(fd, size);
+        }
+        catch (...) {
+            ::shm_unlink(name.c_str());
+            throw;
+        }
+
+        // The object starts out zeroed, which is what every counter needs
+        auto* l = new (data_) layout{};
+        l->version = channel_version;
+        l->size = size;
+        for (int i = 0; i < 2; ++i) {
+            l->header_offsets[i] = header_offsets[i];
+            l->record_offsets[i] = record_offsets[i];
+            auto* header = new (data_ + header_offsets[i]) ring_header{};
+            header->capacity = static_cast<std::uint32_t>(capacity);
+            header->record_size = record_sizes[i];
+        }
+        // Openers only look at a channel once its magic is there
+        l->magic.store(channel_magic, std::memory_order_release);
+
+        outbound_ = ring_at(0);
+        inbound_ = ring_at(1);
+    }
+
+    shm_channel::shm_channel(const std::string& name)
+        : name_(name), owner_(false)
+    {
+        const int fd = ::shm_open(name.c_str(), O_RDWR, 0);
+        if (fd < 0) { throw std::runtime_error("channel not found"); }
+
+        struct stat info{};
+        if (::fstat(fd, &info) != 0
+            || static_cast<std::size_t>(info.st_size) < sizeof(layout)) {
+            ::close(fd);
+            throw std::runtime_error("channel is not ready");
+        }
+        map(fd, static_cast<std::size_t>(info.st_size));
+
+        const auto* l = reinterpret_cast<const layout*>(data_);
+        if (l->magic.load(std::memory_order_acquire) != channel_magic
+            || l->version != channel_version || l->size != size_) {
+            unmap();
+            throw std::runtime_error("not a potionmaker channel");
+        }
+
+        outbound_ = ring_at(1);
+        inbound_ = ring_at(0);
+    }
+
+    shm_channel::~shm_channel()
+    {
+        if (data_ != nullptr) { close(); }
+        unmap();
+        if (owner_) { ::shm_unlink(name_.c_str()); }
+    }
+
+    auto shm_channel::outbound() -> spsc_ring&
+    {
+        return outbound_;
+    }
+
+    auto shm_channel::inbound() -> spsc_ring&
+    {
+        return inbound_;
+    }
+
+    auto shm_channel::close() -> void
+    {
+        auto* l = reinterpret_cast<layout*>(data_);
+        l->closed.store(1, std::memory_order_seq_cst);
+        outbound_.wake_all();
+        inbound_.wake_all();
+    }
+
+    auto shm_channel::closed() const -> bool
+    {
+        const auto* l = reinterpret_cast<const layout*>(data_);
+        return l->closed.load(std::memory_order_acquire) != 0;
+    }
+
+    auto shm_channel::map(const int fd, const std::size_t size) -> void
+    {
+        void* mapping = ::mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                               MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (mapping == MAP_FAILED) {
+            throw std::runtime_error("could not map channel");
+        }
+        data_ = static_cast<std::byte*>(mapping);
+        size_ = size;
+    }
+
+    auto shm_channel::unmap() -> void
+    {
+        if (data_ != nullptr) {
+            ::munmap(data_, size_);
+            data_ = nullptr;
+        }
+    }
+
+    auto shm_channel::ring_at(const std::size_t index) -> spsc_ring
+    {
+        auto* l = reinterpret_cast<layout*>(data_);
+        return {reinterpret_cast<ring_header*>(data_
+                                               + l->header_offsets[index]),
+                data_ + l->record_offsets[index], &l->closed};
+    }
+
+    auto env_record_size(const battle_env& env) -> std::size_t
+    {
+        // Reward and done flag, then the observation
+        return (2 + env.observation_size()) * sizeof(float);
+    }
+
+    auto serve_env(battle_env& env, shm_channel& channel) -> std::size_t
+    {
+        if (channel.outbound().record_size() != env_record_size(env)
+            || channel.inbound().record_size() != sizeof(env_action)) {
+            throw std::invalid_argument(
+                    "Channel records do not match the environment");
+        }
+
+        const std::size_t runs = env.size();
+        const std::size_t width = env.observation_size();
+        std::vector<float> observations(runs * width);
+        std::vector<float> rewards(runs);
+        std::vector<std::uint8_t> dones(runs);
+        std::vector<env_action> actions(runs);
+        std::vector<float> records(runs * (2 + width));
+
+        const auto send = [&] {
+            for (std::size_t i = 0; i < runs; ++i) {
+                float* record = &records[i * (2 + width)];
+                record[0] = rewards[i];
+                record[1] = dones[i] != 0 ? 1.0f : 0.0f;
+                std::copy_n(&observations[i * width], width, record + 2);
+            }
+            return channel.outbound().write(
+                    std::as_bytes(std::span(records)));
+        };
+
+        env.reset(observations);
+        if (!send()) { return 0; }
+
+        std::size_t steps = 0;
+        while (channel.inbound().read(
+                std::as_writable_bytes(std::span(actions)))) {
+            env.step(actions, observations, rewards, dones);
+            ++steps;
+            if (!send()) { break; }
+        }
+        return steps;
+    }
+
+} // namespace potmaker
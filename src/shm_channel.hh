@@ -0,0 +1,195 @@
+#ifndef SHM_CHANNEL_HH
+#define SHM_CHANNEL_HH
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+
+namespace potmaker {
+
+    class battle_env;
+
+    /**
+     * The control block of a ring. It lives in shared memory, so it holds
+     * only lock-free atomics and plain numbers. Head, tail and each side's
+     * wakeup word sit on their own cache lines so the two processes do not
+     * fight over them
+     */
+    struct ring_header {
+        // Records written so far, only advanced by the producer
+        alignas(64) std::atomic<std::uint64_t> head;
+        // Records read so far, only advanced by the consumer
+        alignas(64) std::atomic<std::uint64_t> tail;
+        // Bumped whenever records are published, waited on by the consumer
+        alignas(64) std::atomic<std::uint32_t> published;
+        std::atomic<std::uint32_t> consumer_waiting;
+        // Bumped whenever records are consumed, waited on by the producer
+        alignas(64) std::atomic<std::uint32_t> consumed;
+        std::atomic<std::uint32_t> producer_waiting;
+        std::uint32_t capacity;
+        std::uint32_t record_size;
+    };
+
+    /**
+     * A single-producer, single-consumer queue of fixed-size records in
+     * memory shared with another process. Neither side ever takes a lock.
+     * Records are handed over in batches: the producer copies as many as fit
+     * and makes them visible with one store, and a side that has to wait
+     * spins briefly and then sleeps on a futex until the other side wakes it
+     */
+    class spsc_ring {
+    public:
+        /**
+         * Views a ring that is already laid out
+         * @param header The ring's control block
+         * @param records The ring's records, capacity * record_size bytes
+         * @param closed Set when either side closes the channel
+         */
+        spsc_ring(ring_header* header, std::byte* records,
+                  const std::atomic<std::uint32_t>* closed);
+
+        /**
+         * Writes records, waiting for room as needed. Records that fit are
+         * published together
+         * @param records The records, a whole number of them
+         * @return False if the channel was closed before all were written
+         */
+        auto write(std::span<const std::byte> records) -> bool;
+
+        /**
+         * Reads records, waiting for them as needed
+         * @param records Where to put them, a whole number of them
+         * @return False if the channel was closed before all were read
+         */
+        auto read(std::span<std::byte> records) -> bool;
+
+        /**
+         * @return The size of one record in bytes
+         */
+        [[nodiscard]] auto record_size() const -> std::size_t;
+
+        /**
+         * Wakes both sides so they notice the channel closing
+         */
+        auto wake_all() -> void;
+
+    private:
+        /**
+         * Waits for a wakeup word to move on from a value it had
+         */
+        auto wait(std::atomic<std::uint32_t>& word,
+                  std::atomic<std::uint32_t>& waiting, std::uint32_t seen)
+                -> void;
+
+        static auto wake(std::atomic<std::uint32_t>& word,
+                         const std::atomic<std::uint32_t>& waiting) -> void;
+
+        ring_header* header_;
+        std::byte* records_;
+        const std::atomic<std::uint32_t>* closed_;
+    };
+
+    /**
+     * The sizes a shm_channel is created with
+     */
+    struct channel_shape {
+        // Records each ring holds, rounded up to a power of two
+        std::uint32_t capacity = 1024;
+        // Bytes in each record sent by the creator
+        std::uint32_t outbound_record_size = 0;
+        // Bytes in each record sent back to the creator
+        std::uint32_t inbound_record_size = 0;
+    };
+
+    /**
+     * A two-way channel between two processes on the same machine, made of
+     * two spsc_rings in a POSIX shared memory object. The process that
+     * creates the channel owns its name and removes it when done; the other
+     * process opens it by name, and its outbound ring is the creator's
+     * inbound one
+     */
+    class shm_channel {
+    public:
+        /**
+         * Creates a channel
+         * @param name The shared memory object's name, starting with '/'
+         * @param shape The rings' sizes
+         * @throws std::runtime_error If the object could not be created
+         */
+        shm_channel(const std::string& name, const channel_shape& shape);
+
+        /**
+         * Opens a channel another process created
+         * @param name The shared memory object's name
+         * @throws std::runtime_error If the object is missing or is not a
+         * channel
+         */
+        explicit shm_channel(const std::string& name);
+
+        ~shm_channel();
+
+        shm_channel(const shm_channel&) = delete;
+        auto operator=(const shm_channel&) -> shm_channel& = delete;
+
+        /**
+         * @return The ring this process writes to
+         */
+        [[nodiscard]] auto outbound() -> spsc_ring&;
+
+        /**
+         * @return The ring this process reads from
+         */
+        [[nodiscard]] auto inbound() -> spsc_ring&;
+
+        /**
+         * Closes the channel for both sides. Waiting reads and writes on
+         * either side return false
+         */
+        auto close() -> void;
+
+        /**
+         * @return Whether either side closed the channel
+         */
+        [[nodiscard]] auto closed() const -> bool;
+
+    private:
+        struct layout;
+
+        auto map(int fd, std::size_t size) -> void;
+        auto unmap() -> void;
+
+        [[nodiscard]] auto ring_at(std::size_t index) -> spsc_ring;
+
+        std::string name_;
+        bool owner_;
+        std::byte* data_ = nullptr;
+        std::size_t size_ = 0;
+        spsc_ring outbound_{nullptr, nullptr, nullptr};
+        spsc_ring inbound_{nullptr, nullptr, nullptr};
+    };
+
+    /**
+     * Drives a battle_env from another process. Every batch of records sent
+     * out holds one record per run: its reward as a float, its done flag as
+     * a float, then its observation. The first batch is the reset
+     * observations, with zero rewards. Every batch read back holds one
+     * env_action per run, after which the runs are stepped and the next
+     * batch goes out
+     * @param env The environment
+     * @param channel A channel created with env_record_size outbound and
+     * sizeof(env_action) inbound records
+     * @return How many steps were played before the channel closed
+     * @throws std::invalid_argument If the channel's records do not match
+     */
+    auto serve_env(battle_env& env, shm_channel& channel) -> std::size_t;
+
+    /**
+     * @param env An environment
+     * @return The size of the records serve_env sends for it
+     */
+    [[nodiscard]] auto env_record_size(const battle_env& env) -> std::size_t;
+
+} // namespace potmaker
+
+#endif // SHM_CHANNEL_HH
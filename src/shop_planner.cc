@@ -0,0 +1,121 @@
+#include "shop_planner.hh"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <functional>
+#include <span>
+#include <vector>
+
+namespace potmaker {
+
+    shop_planner::shop_planner(const std::span<const restock_outcome> restock,
+                               const double max_gold)
+    {
+        const auto size
+                = static_cast<std::size_t>(std::max(0.0, std::floor(max_gold)))
+                  + 1;
+        continuation_.resize(size);
+
+        // With g gold, the restocked item is bought if it is affordable and
+        // not harmful, which restocks another. Only purchases restock, so
+        // passing on it ends the chain. Every price is at least one gold
+        // piece, so each entry only depends on earlier ones
+        for (std::size_t g = 0; g < size; ++g) {
+            double expected = 0.0;
+            for (const auto& outcome: restock) {
+                const double price = std::max(outcome.price, 1.0);
+                if (price > static_cast<double>(g)) { continue; }
+
+                const double bought
+                        = outcome.value + continuation_value(g - price);
+                expected += outcome.probability * std::max(0.0, bought);
+            }
+            continuation_[g] = expected;
+        }
+    }
+
+    auto shop_planner::continuation_value(const double gold) const -> double
+    {
+        if (gold < 0.0 || continuation_.empty()) { return 0.0; }
+        const auto index = std::min(static_cast<std::size_t>(gold),
+                                    continuation_.size() - 1);
+        return continuation_[index];
+    }
+
+    auto shop_planner::plan(const std::span<const shop_offer> offers,
+                            const double gold) const -> shop_plan
+    {
+        // Even an item worth nothing restocks one that might be, so only
+        // harmful and unaffordable items are left out. Looking at the
+        // densest first makes the fractional bound tight early
+        std::vector<std::size_t> order;
+        for (std::size_t i = 0; i < offers.size(); ++i) {
+            if (offers[i].value >= 0.0 && offers[i].price <= gold) {
+                order.push_back(i);
+            }
+        }
+        std::ranges::sort(order, [&offers](const auto a, const auto b) {
+            return offers[a].value * offers[b].price
+                   > offers[b].value * offers[a].price;
+        });
+
+        // Buying nothing restocks nothing
+        shop_plan best;
+        double best_score = 0.0;
+
+        std::vector<std::size_t> chosen;
+
+        // The most the items from position i on could add with the gold
+        // left, if they could be bought in fractions
+        const auto bound = [&](std::size_t i, double left) {
+            double added = 0.0;
+            for (; i < order.size(); ++i) {
+                const shop_offer& offer = offers[order[i]];
+                if (offer.price <= left) {
+                    added += offer.value;
+                    left -= offer.price;
+                }
+                else {
+                    return added + offer.value * (left / offer.price);
+                }
+            }
+            return added;
+        };
+
+        const std::function<void(std::size_t, double, double)> search
+                = [&](const std::size_t i, const double left,
+                      const double value) {
+                      const double continuation
+                              = chosen.empty() ? 0.0
+                                               : continuation_value(left);
+                      if (value + continuation > best_score) {
+                          best_score = value + continuation;
+                          best.picks = chosen;
+                          best.cost = gold - left;
+                          best.value = value;
+                          best.continuation = continuation;
+                      }
+                      if (i == order.size()) { return; }
+
+                      // Gold left can only be worth less after spending
+                      if (value + bound(i, left) + continuation_value(left)
+                          <= best_score) {
+                          return;
+                      }
+
+                      const shop_offer& offer = offers[order[i]];
+                      if (offer.price <= left) {
+                          chosen.push_back(order[i]);
+                          search(i + 1, left - offer.price,
+                                 value + offer.value);
+                          chosen.pop_back();
+                      }
+                      search(i + 1, left, value);
+                  };
+        search(0, gold, 0.0);
+
+        std::ranges::sort(best.picks, std::greater<>());
+        return best;
+    }
+
+} // namespace potmaker
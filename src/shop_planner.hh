@@ -0,0 +1,82 @@
+#ifndef SHOP_PLANNER_HH
+#define SHOP_PLANNER_HH
+#include <cstddef>
+#include <span>
+#include <vector>
+
+namespace potmaker {
+
+    /**
+     * An item on sale, as the planner sees it
+     */
+    struct shop_offer {
+        double price;
+        double value;
+    };
+
+    /**
+     * One of the items the shop may restock after a purchase, with the
+     * chance that it is the one
+     */
+    struct restock_outcome {
+        double probability;
+        double price;
+        double value;
+    };
+
+    /**
+     * The items worth buying
+     */
+    struct shop_plan {
+        // Indices into the offers, highest first so that buying them in
+        // order leaves the remaining indices valid
+        std::vector<std::size_t> picks;
+        double cost = 0.0;
+        double value = 0.0;
+        // What the gold left over is expected to buy from restocked items
+        double continuation = 0.0;
+    };
+
+    /**
+     * Works out which items to buy for the most value. Every purchase makes
+     * the shop restock a random item, so after buying something the gold
+     * left over is worth what buying restocked items as they appear is
+     * expected to bring. The basket is searched with branch and bound,
+     * pruning with the fractional knapsack bound plus the worth of the gold
+     * left
+     */
+    class shop_planner {
+    public:
+        /**
+         * Prepares a planner
+         * @param restock What the shop may restock, with probabilities that
+         * add up to one
+         * @param max_gold The most gold the planner will be asked about
+         */
+        shop_planner(std::span<const restock_outcome> restock,
+                     double max_gold);
+
+        /**
+         * Plans a basket
+         * @param offers The items on sale
+         * @param gold The gold available
+         * @return The best basket
+         */
+        [[nodiscard]] auto plan(std::span<const shop_offer> offers,
+                                double gold) const -> shop_plan;
+
+        /**
+         * @param gold Gold left after buying
+         * @return The value restocked items are expected to bring for it,
+         * buying each one as it appears for as long as the gold lasts
+         */
+        [[nodiscard]] auto continuation_value(double gold) const -> double;
+
+    private:
+        // Indexed by whole gold pieces
+        std::vector<double> continuation_;
+    };
+
+} // namespace potmaker
+
+#endif // SHOP_PLANNER_HH
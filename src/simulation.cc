@@ -0,0 +1,1088 @@
+#include "simulation.hh"
+#include "balance.hh"
+#include "column_file.hh"
+#include "event_log.hh"
+#include "inventory.hh"
+#include "state_hash.hh"
+#include "status_effect.hh"
+#include "util.hh"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <numeric>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace potmaker {
+
+    namespace {
+
+        // The simulated player brews potions of at most this many
+        // ingredients
+        constexpr std::size_t potion_size = 3;
+
+        // export_runs keeps this many runs in memory at a time
+        constexpr std::uint64_t export_batch = 4096;
+
+        auto composition_of(const enemy_party& enemies) -> std::uint64_t
+        {
+            small_vector<int, 8> types;
+            for (const enemy* e: enemies) {
+                types.push_back(enemy_type_of(*e));
+            }
+            std::ranges::sort(types);
+
+            std::uint64_t hash = 0;
+            for (const int type: types) {
+                hash = hash_key(hash_part::enemy,
+                                static_cast<std::uint64_t>(type), hash);
+            }
+            return hash;
+        }
+
+        auto choose_action(game_state& game, const enemy_party& enemies,
+                           battle_action& action) -> void
+        {
+            player& p = game.current_player();
+
+            std::size_t target = 0;
+            for (std::size_t i = 1; i < enemies.size(); ++i) {
+                if (enemies[i]->health() < enemies[target]->health()) {
+                    target = i;
+                }
+            }
+            action.target = target;
+            action.picks.clear();
+
+            // A basic attack is enough to finish off a weak enemy
+            if (enemies[target]->health() <= p.damage() * 0.8) {
+                action.type = battle_action::kind::basic_attack;
+                return;
+            }
+
+            const auto& stacks = p.stored_ingredients().stacks();
+            for (std::size_t s = 0; s < stacks.size(); ++s) {
+                if (!stacks[s].units.empty()
+                    && stacks[s].units.front()->expected_value() > 0.0) {
+                    action.picks.push_back(s);
+                }
+            }
+            std::ranges::sort(action.picks, [&stacks](const auto a,
+                                                      const auto b) {
+                return stacks[a].units.front()->expected_value()
+                       > stacks[b].units.front()->expected_value();
+            });
+            if (action.picks.size() > potion_size) {
+                action.picks.resize(potion_size);
+            }
+
+            if (action.picks.size() >= 2 && enemies.size() > 1) {
+                action.type = battle_action::kind::splash_potion;
+            }
+            else if (!action.picks.empty()) {
+                action.type = battle_action::kind::potion;
+            }
+            else {
+                action.type = battle_action::kind::basic_attack;
+            }
+        }
+
+        /**
+         * Counts the ingredients a player holds, by type
+         */
+        auto count_ingredients(const player& p,
+                               std::vector<std::uint32_t>& counts) -> void
+        {
+            std::ranges::fill(counts, 0);
+            for (const inventory::stack& s:
+                 p.stored_ingredients().stacks()) {
+                if (s.units.empty()) { continue; }
+                const auto type = static_cast<std::size_t>(
+                        ingredient_type_of(*s.units.front()));
+                if (type < counts.size()) {
+                    counts[type] += static_cast<std::uint32_t>(s.units.size());
+                }
+            }
+        }
+
+        /**
+         * Adds how much each count went up from before to after
+         */
+        auto add_increase(const std::vector<std::uint32_t>& before,
+                          const std::vector<std::uint32_t>& after,
+                          std::vector<std::uint32_t>& total) -> void
+        {
+            for (std::size_t i = 0; i < total.size(); ++i) {
+                if (after[i] > before[i]) { total[i] += after[i] - before[i]; }
+            }
+        }
+
+        /**
+         * Records the events of a battle, working out what each turn did
+         * from everyone's health before and after it
+         */
+        class battle_tracer {
+        public:
+            /**
+             * Starts a battle, recording its enemies
+             */
+            battle_tracer(std::vector<events::event>& out,
+                          const std::uint64_t run, const std::int32_t stage,
+                          const enemy_party& enemies)
+                : out_(out), run_(run), stage_(stage)
+            {
+                for (const enemy* e: enemies) {
+                    roster_.push_back(e);
+                    record(events::kind::spawn, roster_.size(),
+                           enemy_type_of(*e), to_double(e->health()));
+                }
+            }
+
+            /**
+             * Notes everyone's health before a turn and records the action
+             */
+            auto before_turn(const std::uint32_t turn, const player& p,
+                             const enemy_party& enemies,
+                             const battle_action& action) -> void
+            {
+                turn_ = turn;
+                health_.clear();
+                health_.push_back(to_double(p.health()));
+                for (const enemy* e: roster_) {
+                    health_.push_back(to_double(e->health()));
+                }
+
+                const enemy* target
+                        = enemies[std::min(action.target, enemies.size() - 1)];
+                record(events::kind::action, entity_of(target),
+                       static_cast<std::int32_t>(action.type), 0.0);
+            }
+
+            /**
+             * Records how everyone's health changed over the turn, and who
+             * fell
+             */
+            auto after_turn(const player& p) -> void
+            {
+                for (std::size_t i = 0; i <= roster_.size(); ++i) {
+                    const entity& who = i == 0 ? static_cast<const entity&>(p)
+                                               : *roster_[i - 1];
+                    const double change = to_double(who.health())
+                                          - health_[i];
+                    if (change != 0.0) {
+                        record(events::kind::health, i, 0, change);
+                    }
+                    if (who.is_dead() && health_[i] > 0.0) {
+                        record(events::kind::death, i, 0, 0.0);
+                    }
+                }
+            }
+
+        private:
+            auto entity_of(const enemy* e) const -> std::size_t
+            {
+                return static_cast<std::size_t>(
+                               std::ranges::find(roster_, e) - roster_.begin())
+                       + 1;
+            }
+
+            auto record(const events::kind kind, const std::size_t entity,
+                        const std::int32_t detail, const double health)
+                    -> void
+            {
+                out_.push_back({run_, stage_, turn_, kind,
+                                static_cast<std::uint32_t>(entity), detail,
+                                health});
+            }
+
+            std::vector<events::event>& out_;
+            std::uint64_t run_;
+            std::int32_t stage_;
+            std::uint32_t turn_ = 0;
+            // The party the battle started with, and everyone's health
+            // before the turn, the player's first
+            small_vector<const enemy*, 8> roster_;
+            small_vector<double, 9> health_;
+        };
+
+        /**
+         * Reseeds the calling thread's generator for one part of a stage of
+         * a run, whatever was drawn before it
+         * @param part 0 for the battle, 1 for the shop after it
+         */
+        auto resynchronize(const std::uint64_t seed, const std::int32_t stage,
+                           const std::uint32_t part) -> void
+        {
+            counter_stream stream(
+                    {seed, static_cast<std::uint32_t>(stage), 0, part});
+            seed_random(stream.next());
+        }
+
+        /**
+         * @return How many strata a reduction draws runs from
+         */
+        auto strata_for(const variance_reduction& reduction)
+                -> std::uint64_t
+        {
+            if (reduction.stratified_enemies > max_stratified_enemies) {
+                throw std::invalid_argument(
+                        "too many enemies to stratify");
+            }
+            std::uint64_t strata = 1;
+            for (std::uint32_t i = 0; i < reduction.stratified_enemies; ++i) {
+                strata *= static_cast<std::uint64_t>(enemy_type_count());
+            }
+            return strata;
+        }
+
+        /**
+         * Checks that count runs drawn with a reduction give every stratum
+         * at least two units, so that each has a mean and a spread of its
+         * own to weigh
+         * @throws std::invalid_argument If they do not
+         */
+        auto check_strata_covered(const std::uint64_t count,
+                                  const variance_reduction& reduction) -> void
+        {
+            const std::uint64_t strata = strata_for(reduction);
+            if (strata == 1) { return; }
+            const std::uint64_t units = reduction.antithetic ? count / 2
+                                                             : count;
+            if (units / 2 < strata) {
+                throw std::invalid_argument(std::format(
+                        "{} runs leave some of the {} strata with fewer "
+                        "than two units, simulate at least {}",
+                        count, strata,
+                        2 * strata * (reduction.antithetic ? 2 : 1)));
+            }
+        }
+
+        /**
+         * Picks how many threads to play count runs on
+         */
+        auto threads_for(const std::uint64_t count, std::size_t thread_count)
+                -> std::size_t
+        {
+            if (thread_count == 0) {
+                thread_count
+                        = std::max(1U, std::thread::hardware_concurrency());
+            }
+            return static_cast<std::size_t>(std::min<std::uint64_t>(
+                    thread_count, std::max<std::uint64_t>(count, 1)));
+        }
+
+        /**
+         * Calls play with every thread number below thread_count, each on
+         * its own thread, and waits for them all. Every thread plays with
+         * the calling thread's balance and stacking policies
+         */
+        template<typename play_t>
+        auto run_threads(const std::size_t thread_count, const play_t& play)
+                -> void
+        {
+            if (thread_count == 1) {
+                play(std::size_t{0});
+                return;
+            }
+
+            const balance_params& balance = active_balance();
+            const stacking_table& stacking = stacking_policies();
+            std::vector<std::jthread> threads;
+            threads.reserve(thread_count);
+            for (std::size_t t = 0; t < thread_count; ++t) {
+                threads.emplace_back(
+                        [&play, &balance,
+                         &stacking](const std::size_t thread) {
+                            const scoped_balance scope(balance);
+                            const scoped_stacking stacking_scope(stacking);
+                            play(thread);
+                        },
+                        t);
+            }
+        }
+
+    } // namespace
+
+    auto sampling_for(const variance_reduction& reduction,
+                      const std::uint64_t index) -> run_sampling
+    {
+        run_sampling sampling;
+        sampling.unit = reduction.antithetic ? index / 2 : index;
+        sampling.common_random_numbers = reduction.common_random_numbers;
+        sampling.antithetic = reduction.antithetic && index % 2 == 1;
+        sampling.stratified_enemies = reduction.stratified_enemies;
+        sampling.stratum = sampling.unit % strata_for(reduction);
+        return sampling;
+    }
+
+    auto simulate_run(const std::uint64_t seed,
+                      const simulation_limits& limits,
+                      const bool record_events, const run_sampling& sampling)
+            -> run_summary
+    {
+        const scoped_quiet_output quiet;
+        std::optional<scoped_antithetic_draws> antithetic;
+        if (sampling.antithetic) { antithetic.emplace(); }
+        seed_random(seed);
+
+        std::optional<scoped_enemy_types> stratified;
+        if (sampling.stratified_enemies != 0) {
+            const auto types = static_cast<std::uint64_t>(enemy_type_count());
+            std::vector<int> first_types(sampling.stratified_enemies);
+            std::uint64_t digits = sampling.stratum;
+            for (int& type: first_types) {
+                type = static_cast<int>(digits % types);
+                digits /= types;
+            }
+            stratified.emplace(std::move(first_types));
+        }
+
+        std::optional<scoped_importance_sampling> importance;
+        if (sampling.bias != nullptr) { importance.emplace(*sampling.bias); }
+
+        game_state game("Simulated");
+
+        run_summary summary;
+        summary.seed = seed;
+        summary.sampling = sampling;
+        summary.kills_by_type.resize(
+                static_cast<std::size_t>(enemy_type_count()));
+        summary.ingredients_bought.resize(
+                static_cast<std::size_t>(ingredient_type_count()));
+        summary.ingredients_used.resize(summary.ingredients_bought.size());
+
+        // Ingredients held before and after a turn or a visit to the shop
+        std::vector<std::uint32_t> held(summary.ingredients_bought.size());
+        std::vector<std::uint32_t> held_after(held.size());
+
+        battle_action action;
+        small_vector<const enemy*, 8> fighting;
+        while (game.running() && game.stage() <= limits.max_stage) {
+            if (sampling.common_random_numbers) {
+                resynchronize(seed, game.stage(), 0);
+            }
+            enemy_party enemies = game.begin_battle();
+
+            battle_summary battle{game.stage(), 0, 0.0,
+                                  composition_of(enemies), false};
+            for (const enemy* e: enemies) {
+                const auto type = static_cast<std::size_t>(enemy_type_of(*e));
+                if (type >= summary.enemies_by_type.size()) {
+                    summary.enemies_by_type.resize(type + 1);
+                }
+                ++summary.enemies_by_type[type];
+            }
+
+            std::optional<battle_tracer> tracer;
+            if (record_events) {
+                tracer.emplace(summary.events, seed, game.stage(), enemies);
+            }
+
+            battle_outcome outcome = battle_outcome::ongoing;
+            while (outcome == battle_outcome::ongoing
+                   && battle.turns < limits.max_turns) {
+                choose_action(game, enemies, action);
+
+                // Fallen enemies leave the party but stay alive in memory
+                // until the next battle, so they can be looked at after
+                fighting.clear();
+                for (const enemy* e: enemies) { fighting.push_back(e); }
+                count_ingredients(game.current_player(), held);
+                if (tracer) {
+                    tracer->before_turn(battle.turns + 1,
+                                        game.current_player(), enemies,
+                                        action);
+                }
+
+                outcome = game.play_turn(enemies, action);
+                ++battle.turns;
+                if (tracer) { tracer->after_turn(game.current_player()); }
+
+                for (const enemy* e: fighting) {
+                    const auto type = static_cast<std::size_t>(
+                            enemy_type_of(*e));
+                    if (e->is_dead() && type < summary.kills_by_type.size()) {
+                        ++summary.kills_by_type[type];
+                    }
+                }
+                count_ingredients(game.current_player(), held_after);
+                add_increase(held_after, held, summary.ingredients_used);
+            }
+
+            battle.won = outcome == battle_outcome::won;
+            if (outcome == battle_outcome::lost) {
+                summary.death = game.defeated_by() == defeat_cause::effects
+                                        ? death_cause::effects
+                                        : death_cause::enemies;
+            }
+            else if (!battle.won) {
+                summary.death = death_cause::turn_limit;
+            }
+
+            battle.gold = to_double(game.end_battle(battle.won));
+            summary.turns += battle.turns;
+            summary.gold += battle.gold;
+            summary.battles.push_back(battle);
+
+            if (battle.won) {
+                if (sampling.common_random_numbers) {
+                    resynchronize(seed, battle.stage, 1);
+                }
+                count_ingredients(game.current_player(), held);
+                game.buy_planned();
+                count_ingredients(game.current_player(), held_after);
+                add_increase(held, held_after, summary.ingredients_bought);
+            }
+        }
+
+        summary.stage_reached = game.stage();
+        if (importance) {
+            summary.log_weight = importance->log_weight();
+            summary.tilted = importance->draws();
+        }
+        return summary;
+    }
+
+    auto run_stats::add(const run_summary& run) -> void
+    {
+        ++runs_;
+        stages_reached_.add(run.stage_reached);
+        for (const battle_summary& battle: run.battles) {
+            turns_per_battle_.add(battle.turns);
+            if (battle.won) { gold_per_battle_.add(battle.gold); }
+            compositions_.add(battle.composition);
+        }
+
+        if (run.enemies_by_type.size() > enemies_by_type_.size()) {
+            enemies_by_type_.resize(run.enemies_by_type.size());
+        }
+        for (std::size_t i = 0; i < run.enemies_by_type.size(); ++i) {
+            enemies_by_type_[i] += run.enemies_by_type[i];
+        }
+    }
+
+    auto run_stats::merge(const run_stats& other) -> void
+    {
+        runs_ += other.runs_;
+        stages_reached_.merge(other.stages_reached_);
+        turns_per_battle_.merge(other.turns_per_battle_);
+        gold_per_battle_.merge(other.gold_per_battle_);
+        compositions_.merge(other.compositions_);
+
+        if (other.enemies_by_type_.size() > enemies_by_type_.size()) {
+            enemies_by_type_.resize(other.enemies_by_type_.size());
+        }
+        for (std::size_t i = 0; i < other.enemies_by_type_.size(); ++i) {
+            enemies_by_type_[i] += other.enemies_by_type_[i];
+        }
+    }
+
+    auto run_stats::runs() const -> std::uint64_t
+    {
+        return runs_;
+    }
+
+    auto run_stats::stages_reached() const -> const t_digest&
+    {
+        return stages_reached_;
+    }
+
+    auto run_stats::turns_per_battle() const -> const t_digest&
+    {
+        return turns_per_battle_;
+    }
+
+    auto run_stats::gold_per_battle() const -> const t_digest&
+    {
+        return gold_per_battle_;
+    }
+
+    auto run_stats::compositions() const -> const hyperloglog&
+    {
+        return compositions_;
+    }
+
+    auto run_stats::enemies_by_type() const
+            -> const std::vector<std::uint64_t>&
+    {
+        return enemies_by_type_;
+    }
+
+    namespace {
+
+        /**
+         * Plays the runs of a batch from its first_index-th run on
+         */
+        auto play_batch(const std::uint64_t first_seed,
+                        const std::uint64_t first_index,
+                        const std::uint64_t count,
+                        const std::size_t thread_count,
+                        const simulation_limits& limits,
+                        const bool record_events,
+                        const variance_reduction& reduction,
+                        const importance_bias* bias = nullptr)
+                -> std::vector<run_summary>
+        {
+            // Each run has its own slot, so the threads never share one
+            std::vector<run_summary> runs(static_cast<std::size_t>(count));
+            const std::size_t threads = threads_for(count, thread_count);
+            run_threads(threads, [&](const std::size_t t) {
+                for (std::uint64_t i = t; i < count; i += threads) {
+                    run_sampling sampling
+                            = sampling_for(reduction, first_index + i);
+                    sampling.bias = bias;
+                    runs[i] = simulate_run(first_seed + sampling.unit, limits,
+                                           record_events, sampling);
+                }
+            });
+            return runs;
+        }
+
+        /**
+         * Feeds a value of every unit of a batch's runs to an estimator
+         */
+        template<typename value_t>
+        auto add_units(mean_estimator& estimator,
+                       const std::vector<run_summary>& runs,
+                       const value_t& value) -> void
+        {
+            small_vector<double, 2> values;
+            for (std::size_t i = 0; i < runs.size(); ++i) {
+                values.push_back(value(i));
+                if (i + 1 == runs.size()
+                    || runs[i + 1].sampling.unit != runs[i].sampling.unit) {
+                    estimator.add(values, static_cast<std::size_t>(
+                                                  runs[i].sampling.stratum));
+                    values.clear();
+                }
+            }
+        }
+
+        /**
+         * Estimators for each of run_estimates' means
+         */
+        struct run_estimators {
+            explicit run_estimators(const variance_reduction& reduction)
+                : stage_reached(strata(reduction)), turns(strata(reduction)),
+                  gold(strata(reduction))
+            {}
+
+            static auto strata(const variance_reduction& reduction)
+                    -> std::size_t
+            {
+                return static_cast<std::size_t>(strata_for(reduction));
+            }
+
+            /**
+             * Counts a batch's runs, or the difference between two
+             * batches of the same runs
+             */
+            auto add(const std::vector<run_summary>& runs,
+                     const std::vector<run_summary>* base = nullptr) -> void
+            {
+                const auto minus = [&](const std::size_t i, auto member) {
+                    const double value = runs[i].*member;
+                    return base ? value - (*base)[i].*member : value;
+                };
+                add_units(stage_reached, runs, [&](const std::size_t i) {
+                    return minus(i, &run_summary::stage_reached);
+                });
+                add_units(turns, runs, [&](const std::size_t i) {
+                    return minus(i, &run_summary::turns);
+                });
+                add_units(gold, runs, [&](const std::size_t i) {
+                    return minus(i, &run_summary::gold);
+                });
+            }
+
+            mean_estimator stage_reached;
+            mean_estimator turns;
+            mean_estimator gold;
+        };
+
+    } // namespace
+
+    auto simulate_batch(const std::uint64_t first_seed,
+                        const std::uint64_t count,
+                        const std::size_t thread_count,
+                        const simulation_limits& limits,
+                        const bool record_events,
+                        const variance_reduction& reduction)
+            -> std::vector<run_summary>
+    {
+        return play_batch(first_seed, 0, count, thread_count, limits,
+                          record_events, reduction);
+    }
+
+    mean_estimator::mean_estimator(const std::size_t strata)
+        : strata_(std::max<std::size_t>(strata, 1))
+    {}
+
+    auto mean_estimator::add(const std::span<const double> values,
+                             const std::size_t stratum) -> void
+    {
+        double unit = 0.0;
+        for (const double value: values) {
+            unit += value;
+            run_sum_ += value;
+            run_sum_squares_ += value * value;
+        }
+        unit /= static_cast<double>(values.size());
+        runs_ += values.size();
+
+        stratum_sums& sums = strata_.at(stratum);
+        ++sums.units;
+        sums.sum += unit;
+        sums.sum_squares += unit * unit;
+    }
+
+    auto mean_estimator::run_variance() const -> double
+    {
+        if (runs_ < 2) { return 0.0; }
+        const auto n = static_cast<double>(runs_);
+        const double mean = run_sum_ / n;
+        return std::max(0.0, (run_sum_squares_ - n * mean * mean) / (n - 1));
+    }
+
+    auto mean_estimator::result() const -> estimate
+    {
+        return result(run_variance());
+    }
+
+    auto mean_estimator::result(const double run_variance) const -> estimate
+    {
+        // Strata are weighted evenly, as they are drawn. Weighing only the
+        // strata that were drawn would leave the others out of the mean, so
+        // unless every stratum has the two units it takes for a variance,
+        // the units are pooled as if they were drawn plainly
+        std::vector<stratum_sums> strata;
+        bool pooled = false;
+        for (const stratum_sums& sums: strata_) {
+            if (sums.units < 2) { pooled = true; }
+            if (sums.units != 0) { strata.push_back(sums); }
+        }
+        if (strata.empty()) { return {}; }
+        if (pooled) {
+            stratum_sums all;
+            for (const stratum_sums& sums: strata) {
+                all.units += sums.units;
+                all.sum += sums.sum;
+                all.sum_squares += sums.sum_squares;
+            }
+            strata = {all};
+        }
+
+        estimate result;
+        double variance = 0.0;
+        const double weight = 1.0 / static_cast<double>(strata.size());
+        for (const stratum_sums& sums: strata) {
+            const auto n = static_cast<double>(sums.units);
+            const double mean = sums.sum / n;
+            result.mean += weight * mean;
+            if (n > 1) {
+                const double spread
+                        = std::max(0.0, (sums.sum_squares - n * mean * mean)
+                                                / (n - 1));
+                variance += weight * weight * spread / n;
+            }
+        }
+
+        result.standard_error = std::sqrt(variance);
+        result.effective_samples = variance > 0.0
+                                           ? run_variance / variance
+                                           : static_cast<double>(runs_);
+        return result;
+    }
+
+    auto estimate_runs(const std::uint64_t first_seed,
+                       const std::uint64_t count,
+                       const std::size_t thread_count,
+                       const simulation_limits& limits,
+                       const variance_reduction& reduction) -> run_estimates
+    {
+        check_strata_covered(count, reduction);
+        run_estimators estimators(reduction);
+        // Batches hold whole units, since export_batch is even
+        for (std::uint64_t done = 0; done < count; done += export_batch) {
+            estimators.add(play_batch(first_seed, done,
+                                      std::min(export_batch, count - done),
+                                      thread_count, limits, false,
+                                      reduction));
+        }
+        return {estimators.stage_reached.result(),
+                estimators.turns.result(), estimators.gold.result()};
+    }
+
+    auto compare_balances(const balance_params& base,
+                          const balance_params& variant,
+                          const std::uint64_t first_seed,
+                          const std::uint64_t count,
+                          const std::size_t thread_count,
+                          const simulation_limits& limits,
+                          const variance_reduction& reduction)
+            -> run_estimates
+    {
+        check_strata_covered(count, reduction);
+        run_estimators base_estimators(reduction);
+        run_estimators variant_estimators(reduction);
+        run_estimators difference(reduction);
+        for (std::uint64_t done = 0; done < count; done += export_batch) {
+            const std::uint64_t batch = std::min(export_batch, count - done);
+            std::vector<run_summary> base_runs;
+            std::vector<run_summary> variant_runs;
+            {
+                const scoped_balance scope(base);
+                base_runs = play_batch(first_seed, done, batch, thread_count,
+                                       limits, false, reduction);
+            }
+            {
+                const scoped_balance scope(variant);
+                variant_runs = play_batch(first_seed, done, batch,
+                                          thread_count, limits, false,
+                                          reduction);
+            }
+            base_estimators.add(base_runs);
+            variant_estimators.add(variant_runs);
+            difference.add(variant_runs, &base_runs);
+        }
+
+        // Independent runs of the two balances would differ by the sum of
+        // their variances
+        const auto independent = [](const mean_estimator& a,
+                                    const mean_estimator& b) {
+            return a.run_variance() + b.run_variance();
+        };
+        return {difference.stage_reached.result(
+                        independent(base_estimators.stage_reached,
+                                    variant_estimators.stage_reached)),
+                difference.turns.result(independent(
+                        base_estimators.turns, variant_estimators.turns)),
+                difference.gold.result(independent(
+                        base_estimators.gold, variant_estimators.gold))};
+    }
+
+    namespace {
+
+        /**
+         * @return An estimate with its 95% confidence interval, within the
+         * [0, 1] a chance lies in
+         */
+        auto chance_interval(const double value, const double standard_error)
+                -> interval_estimate
+        {
+            constexpr double z = 1.96;
+            return {value, standard_error,
+                    std::max(0.0, value - z * standard_error),
+                    std::min(1.0, value + z * standard_error)};
+        }
+
+        /**
+         * @return Where a draw tilted by tilt lands on average
+         */
+        auto tilt_mean(const double tilt) -> double
+        {
+            if (std::abs(tilt) < 1e-4) { return 0.5 - tilt / 12.0; }
+            return 1.0 / tilt - 1.0 / std::expm1(tilt);
+        }
+
+        /**
+         * @return The tilt within [-max_tilt, max_tilt] whose draws land
+         * closest to mean on average
+         */
+        auto tilt_for_mean(const double mean, const double max_tilt)
+                -> double
+        {
+            // The mean falls as the tilt grows
+            double low = -max_tilt;
+            double high = max_tilt;
+            for (int step = 0; step < 60; ++step) {
+                const double middle = (low + high) / 2.0;
+                (tilt_mean(middle) > mean ? low : high) = middle;
+            }
+            return (low + high) / 2.0;
+        }
+
+        /**
+         * The sums estimate_depth keeps for one stage, over every run
+         */
+        struct stage_sums {
+            // Weights of the runs that reached the stage and of those that
+            // won its battle, and their squares
+            double reached = 0.0;
+            double reached_squares = 0.0;
+            double won = 0.0;
+            double won_squares = 0.0;
+            std::uint64_t runs = 0;
+        };
+
+    } // namespace
+
+    auto estimate_depth(const std::uint64_t first_seed,
+                        const std::uint64_t count,
+                        const importance_bias& bias,
+                        const std::size_t thread_count,
+                        const simulation_limits& limits) -> depth_estimates
+    {
+        std::vector<stage_sums> stages;
+        double weights = 0.0;
+        double weight_squares = 0.0;
+        for (std::uint64_t done = 0; done < count; done += export_batch) {
+            const std::vector<run_summary> runs
+                    = play_batch(first_seed + done, 0,
+                                 std::min(export_batch, count - done),
+                                 thread_count, limits, false, {}, &bias);
+            for (const run_summary& run: runs) {
+                const double w = std::exp(run.log_weight);
+                weights += w;
+                weight_squares += w * w;
+
+                const auto deepest = static_cast<std::size_t>(
+                        std::clamp(run.stage_reached, 0, limits.max_stage));
+                if (stages.size() < deepest) { stages.resize(deepest); }
+                for (std::size_t s = 0; s < deepest; ++s) {
+                    stages[s].reached += w;
+                    stages[s].reached_squares += w * w;
+                    ++stages[s].runs;
+                    if (static_cast<std::int32_t>(s) + 1 < run.stage_reached) {
+                        stages[s].won += w;
+                        stages[s].won_squares += w * w;
+                    }
+                }
+            }
+        }
+
+        depth_estimates result;
+        result.runs = count;
+        if (count == 0) { return result; }
+        result.effective_runs = weight_squares > 0.0
+                                        ? weights * weights / weight_squares
+                                        : 0.0;
+
+        const auto n = static_cast<double>(count);
+        for (std::size_t s = 0; s < stages.size(); ++s) {
+            const stage_sums& sums = stages[s];
+            stage_estimate& stage = result.stages.emplace_back();
+            stage.stage = static_cast<std::int32_t>(s + 1);
+            stage.runs_reached = sums.runs;
+
+            // The chance of reaching the stage is the mean weight of the
+            // runs that did, counting the others as zero
+            const double reached = sums.reached / n;
+            const double spread
+                    = n > 1 ? std::max(0.0, (sums.reached_squares
+                                             - n * reached * reached)
+                                                    / (n - 1))
+                            : 0.0;
+            stage.reached = chance_interval(reached, std::sqrt(spread / n));
+
+            // The win rate is a ratio of two such means, whose error comes
+            // from the delta method
+            if (sums.reached > 0.0) {
+                const double rate = sums.won / sums.reached;
+                const double residuals = sums.won_squares * (1.0 - 2.0 * rate)
+                                         + rate * rate * sums.reached_squares;
+                const double error
+                        = n > 1 ? std::sqrt(std::max(0.0, residuals)
+                                            / (n * (n - 1)))
+                                          / reached
+                                : 0.0;
+                stage.win_rate = chance_interval(rate, error);
+            }
+        }
+        return result;
+    }
+
+    auto fit_importance_bias(const std::int32_t stage,
+                             const importance_fitting& options)
+            -> importance_bias
+    {
+        if (stage <= 1) { return {}; }
+
+        const auto types = static_cast<std::size_t>(enemy_type_count());
+        importance_bias bias;
+        bias.enemy_weights.assign(types, 1.0);
+
+        // Runs that reach the stage stop there
+        const simulation_limits limits{.max_stage = stage - 1};
+        const double keep = 1.0 - options.smoothing;
+        for (std::uint32_t round = 0; round < options.max_rounds; ++round) {
+            const std::vector<run_summary> runs = play_batch(
+                    options.first_seed + round * options.round_runs, 0,
+                    options.round_runs, options.thread_count, limits, false,
+                    {}, &bias);
+            if (runs.empty()) { break; }
+
+            // The elite are the runs as deep as the deepest fraction, or
+            // those that reach the stage once there are enough of them
+            std::vector<std::int32_t> depths;
+            depths.reserve(runs.size());
+            double max_log_weight = runs.front().log_weight;
+            for (const run_summary& run: runs) {
+                depths.push_back(run.stage_reached);
+                max_log_weight = std::max(max_log_weight, run.log_weight);
+            }
+            const auto cut = std::min(
+                    depths.size() - 1,
+                    static_cast<std::size_t>(
+                            (1.0 - options.elite_fraction)
+                            * static_cast<double>(depths.size())));
+            std::ranges::nth_element(depths, depths.begin() + cut);
+            const std::int32_t level = std::min(depths[cut], stage);
+
+            // What the elite drew, weighed by their likelihood ratios. Only
+            // the ratios' proportions matter, so they are scaled to stay
+            // finite
+            std::vector<double> enemies(types);
+            std::array<double, 2> draws{};
+            std::array<double, 2> positions{};
+            for (const run_summary& run: runs) {
+                if (run.stage_reached < level) { continue; }
+                const double w = std::exp(run.log_weight - max_log_weight);
+                for (std::size_t t = 0;
+                     t < std::min(types, run.enemies_by_type.size()); ++t) {
+                    enemies[t] += w * run.enemies_by_type[t];
+                }
+                for (std::size_t side = 0; side < draws.size(); ++side) {
+                    draws[side] += w * static_cast<double>(
+                                               run.tilted.counts[side]);
+                    positions[side] += w * run.tilted.positions[side];
+                }
+            }
+
+            const double fought
+                    = std::accumulate(enemies.begin(), enemies.end(), 0.0);
+            if (fought > 0.0) {
+                double total = 0.0;
+                for (std::size_t t = 0; t < types; ++t) {
+                    double& weight = bias.enemy_weights[t];
+                    const double fitted = enemies[t] * types / fought;
+                    weight = std::max(options.smoothing * fitted
+                                              + keep * weight,
+                                      options.min_weight);
+                    total += weight;
+                }
+                for (double& weight: bias.enemy_weights) {
+                    weight *= static_cast<double>(types) / total;
+                }
+            }
+            for (std::size_t side = 0; side < draws.size(); ++side) {
+                if (draws[side] <= 0.0) { continue; }
+                const double fitted = tilt_for_mean(
+                        positions[side] / draws[side], options.max_tilt);
+                bias.tilts[side] = options.smoothing * fitted
+                                   + keep * bias.tilts[side];
+            }
+
+            if (level >= stage) { break; }
+        }
+        return bias;
+    }
+
+    auto simulate_runs(const std::uint64_t first_seed,
+                       const std::uint64_t count,
+                       const std::size_t thread_count,
+                       const simulation_limits& limits) -> run_stats
+    {
+        const std::size_t threads = threads_for(count, thread_count);
+
+        // Thread t plays every threads-th seed from first_seed + t, so which
+        // runs end up in which summary does not depend on timing
+        std::vector<run_stats> partial(threads);
+        run_threads(threads, [&](const std::size_t t) {
+            for (std::uint64_t i = t; i < count; i += threads) {
+                partial[t].add(simulate_run(first_seed + i, limits));
+            }
+        });
+
+        run_stats total;
+        for (const run_stats& stats: partial) { total.merge(stats); }
+        return total;
+    }
+
+    auto export_runs(const std::string& path, const std::uint64_t first_seed,
+                     const std::uint64_t count, const std::size_t thread_count,
+                     const simulation_limits& limits) -> run_stats
+    {
+        const auto ingredient_types
+                = static_cast<std::size_t>(ingredient_type_count());
+        const auto enemy_types = static_cast<std::size_t>(enemy_type_count());
+
+        columns::writer out(path);
+        out.add_column("seed", columns::value_type::int64);
+        out.add_column("stage_reached", columns::value_type::int64);
+        out.add_column("turns", columns::value_type::int64);
+        out.add_column("gold", columns::value_type::float64);
+        out.add_column("death_cause", columns::value_type::int64);
+        for (std::size_t type = 0; type < ingredient_types; ++type) {
+            out.add_column(std::format("bought_{}", type),
+                           columns::value_type::int64);
+        }
+        for (std::size_t type = 0; type < ingredient_types; ++type) {
+            out.add_column(std::format("used_{}", type),
+                           columns::value_type::int64);
+        }
+        for (std::size_t type = 0; type < enemy_types; ++type) {
+            out.add_column(std::format("kills_{}", type),
+                           columns::value_type::int64);
+        }
+
+        const auto push_counts = [&out](const auto& counts,
+                                        const std::size_t size) {
+            for (std::size_t i = 0; i < size; ++i) {
+                out.push(static_cast<std::int64_t>(
+                        i < counts.size() ? counts[i] : 0));
+            }
+        };
+
+        run_stats stats;
+        for (std::uint64_t done = 0; done < count;) {
+            const std::uint64_t batch = std::min(export_batch, count - done);
+            for (const run_summary& run: simulate_batch(
+                         first_seed + done, batch, thread_count, limits)) {
+                out.push(static_cast<std::int64_t>(run.seed));
+                out.push(std::int64_t{run.stage_reached});
+                out.push(std::int64_t{run.turns});
+                out.push(run.gold);
+                out.push(static_cast<std::int64_t>(run.death));
+                push_counts(run.ingredients_bought, ingredient_types);
+                push_counts(run.ingredients_used, ingredient_types);
+                push_counts(run.kills_by_type, enemy_types);
+                out.end_row();
+                stats.add(run);
+            }
+            done += batch;
+        }
+
+        out.finish();
+        return stats;
+    }
+
+    auto trace_runs(const std::string& path, const std::uint64_t first_seed,
+                    const std::uint64_t count, const std::size_t thread_count,
+                    const simulation_limits& limits) -> run_stats
+    {
+        events::writer out(path);
+        run_stats stats;
+        for (std::uint64_t done = 0; done < count;) {
+            const std::uint64_t batch = std::min(export_batch, count - done);
+            for (const run_summary& run:
+                 simulate_batch(first_seed + done, batch, thread_count,
+                                limits, true)) {
+                for (const events::event& e: run.events) { out.add(e); }
+                stats.add(run);
+            }
+            done += batch;
+        }
+
+        out.finish();
+        return stats;
+    }
+
+} // namespace potmaker
@@ -0,0 +1,483 @@
+#ifndef SIMULATION_HH
+#define SIMULATION_HH
+#include "balance.hh"
+#include "event_log.hh"
+#include "potionmaker_game.hh"
+#include "sketches.hh"
+#include "util.hh"
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace potmaker {
+
+    /**
+     * How far a simulated run may go before it is cut short
+     */
+    struct simulation_limits {
+        // Runs that clear this stage stop there
+        std::int32_t max_stage = 100;
+        // Battles that last longer than this count as lost
+        std::uint32_t max_turns = 200;
+    };
+
+    // Stratifying more enemies makes more strata than there are runs to
+    // fill them
+    constexpr std::uint32_t max_stratified_enemies = 3;
+
+    /**
+     * Ways of drawing simulated runs that estimate the same means from fewer
+     * of them
+     */
+    struct variance_reduction {
+        // Reseed each run's generator from its seed and stage before every
+        // battle and every visit to the shop. Two balances played with the
+        // same seed then meet the same draws stage after stage, even after
+        // their runs have gone differently, which takes most of the noise
+        // out of their difference
+        bool common_random_numbers = false;
+        // Play runs in pairs with the same seed, the second one with
+        // antithetic draws
+        bool antithetic = false;
+        // How many of each run's first enemies have their types stratified:
+        // the runs are spread evenly over every combination of those types,
+        // which estimates then weigh equally, as plain draws would. At most
+        // max_stratified_enemies
+        std::uint32_t stratified_enemies = 0;
+    };
+
+    /**
+     * How one run of a batch draws its random numbers
+     */
+    struct run_sampling {
+        // The runs that share a seed form a unit, and are averaged into one
+        // independent sample. A unit's seed is the batch's first seed plus
+        // the unit
+        std::uint64_t unit = 0;
+        bool common_random_numbers = false;
+        // Whether the run is the antithetic half of a pair
+        bool antithetic = false;
+        // The types of the run's first enemies, as the digits of the
+        // stratum in base enemy_type_count, lowest first
+        std::uint32_t stratified_enemies = 0;
+        std::uint64_t stratum = 0;
+        // Draws the run with this bias, if any. Must outlive the run
+        const importance_bias* bias = nullptr;
+    };
+
+    /**
+     * @param reduction How a batch is drawn
+     * @param index A run's place in the batch
+     * @return How the run draws its random numbers
+     * @throws std::invalid_argument If more than max_stratified_enemies
+     * enemies are stratified
+     */
+    [[nodiscard]] auto sampling_for(const variance_reduction& reduction,
+                                    std::uint64_t index) -> run_sampling;
+
+    /**
+     * What happened in one battle of a simulated run
+     */
+    struct battle_summary {
+        std::int32_t stage;
+        std::uint32_t turns;
+        // What calculate_gold_reward paid, zero for a lost battle
+        double gold;
+        // Parties with the same enemy types hash the same
+        std::uint64_t composition;
+        bool won;
+    };
+
+    /**
+     * What ended a simulated run
+     */
+    enum class death_cause : std::uint8_t {
+        none, // The run reached the stage limit
+        enemies, // An enemy's attack
+        effects, // A status effect
+        turn_limit // A battle went on for too long
+    };
+
+    /**
+     * What happened in one simulated run
+     */
+    struct run_summary {
+        std::uint64_t seed = 0;
+        // The stage the run was lost on, or the one after the limit
+        std::int32_t stage_reached = 0;
+        std::uint32_t turns = 0;
+        double gold = 0.0;
+        std::vector<battle_summary> battles;
+        // Enemies fought, by their create_enemy_by_type type
+        std::vector<std::uint32_t> enemies_by_type;
+        // Enemies killed, by the same type, one entry per enemy type
+        std::vector<std::uint32_t> kills_by_type;
+        // Ingredients bought in the shop and thrown in potions, by their
+        // create_ingredient_by_type type, one entry per ingredient type
+        std::vector<std::uint32_t> ingredients_bought;
+        std::vector<std::uint32_t> ingredients_used;
+        death_cause death = death_cause::none;
+        run_sampling sampling;
+        // The log of the run's likelihood ratio and its distinct tilted
+        // draws, when it was drawn with a bias
+        double log_weight = 0.0;
+        importance_draws tilted;
+        // Every combat event of the run, when asked for
+        std::vector<events::event> events;
+    };
+
+    /**
+     * Plays a whole run without a player, from the first stage until it is
+     * lost. The simulated player aims at the weakest enemy, throws its most
+     * valuable ingredients (splashing when several enemies are left) and
+     * falls back to basic attacks, and shops with game_state::buy_planned
+     * between battles. Output is silenced
+     * @param seed Seeds the calling thread's random number generator, so
+     * the same seed plays the same run
+     * @param limits How far the run may go
+     * @param record_events Whether to record the run's combat events
+     * @param sampling How the run draws its random numbers
+     * @return What happened
+     */
+    auto simulate_run(std::uint64_t seed, const simulation_limits& limits = {},
+                      bool record_events = false,
+                      const run_sampling& sampling = {}) -> run_summary;
+
+    /**
+     * Simulates runs with consecutive seeds and keeps every one of them
+     * @param first_seed The seed of the first run
+     * @param count How many runs to simulate
+     * @param thread_count How many threads to use, or 0 for one per
+     * processor
+     * @param limits How far each run may go
+     * @param record_events Whether to record the runs' combat events
+     * @param reduction How the runs are drawn. Runs share seeds in pairs
+     * when they are antithetic
+     * @return The runs, in seed order whatever the thread count
+     */
+    auto simulate_batch(std::uint64_t first_seed, std::uint64_t count,
+                        std::size_t thread_count = 0,
+                        const simulation_limits& limits = {},
+                        bool record_events = false,
+                        const variance_reduction& reduction = {})
+            -> std::vector<run_summary>;
+
+    /**
+     * A mean estimated from simulated runs
+     */
+    struct estimate {
+        double mean = 0.0;
+        double standard_error = 0.0;
+        // How many runs drawn plainly and independently would estimate the
+        // mean as precisely
+        double effective_samples = 0.0;
+    };
+
+    /**
+     * Estimates the mean of a value over runs drawn with variance
+     * reduction. Each unit of runs that share a seed counts as one sample,
+     * and samples are grouped by the stratum they were drawn from
+     */
+    class mean_estimator {
+    public:
+        /**
+         * @param strata How many strata samples are drawn from, evenly
+         */
+        explicit mean_estimator(std::size_t strata = 1);
+
+        /**
+         * Counts a unit of runs
+         * @param values The value of each of its runs
+         * @param stratum The stratum it was drawn from
+         */
+        auto add(std::span<const double> values, std::size_t stratum) -> void;
+
+        /**
+         * @return The variance of the value from one run to the next
+         */
+        [[nodiscard]] auto run_variance() const -> double;
+
+        /**
+         * @return The estimate, with the effective sample size measured
+         * against run_variance. Unless every stratum has at least two
+         * units, they are all pooled as if drawn plainly
+         */
+        [[nodiscard]] auto result() const -> estimate;
+
+        /**
+         * @param run_variance The variance of one plainly drawn run
+         * @return The estimate, with the effective sample size measured
+         * against the given variance
+         */
+        [[nodiscard]] auto result(double run_variance) const -> estimate;
+
+    private:
+        struct stratum_sums {
+            std::uint64_t units = 0;
+            double sum = 0.0;
+            double sum_squares = 0.0;
+        };
+
+        std::vector<stratum_sums> strata_;
+        std::uint64_t runs_ = 0;
+        double run_sum_ = 0.0;
+        double run_sum_squares_ = 0.0;
+    };
+
+    /**
+     * Means over simulated runs
+     */
+    struct run_estimates {
+        estimate stage_reached;
+        estimate turns;
+        estimate gold;
+    };
+
+    /**
+     * Simulates runs with variance reduction and estimates their means
+     * @param first_seed The seed of the first unit of runs
+     * @param count How many runs to simulate
+     * @param thread_count How many threads to use, or 0 for one per
+     * processor
+     * @param limits How far each run may go
+     * @param reduction How the runs are drawn
+     * @return The estimates
+     * @throws std::invalid_argument If count leaves a stratum with fewer
+     * than two units of runs, or too many enemies are stratified
+     */
+    auto estimate_runs(std::uint64_t first_seed, std::uint64_t count,
+                       std::size_t thread_count = 0,
+                       const simulation_limits& limits = {},
+                       const variance_reduction& reduction = {})
+            -> run_estimates;
+
+    /**
+     * Simulates the same runs with two balances and estimates how much
+     * their means differ. Common random numbers make the most of this
+     * @param base The balance compared against
+     * @param variant The other balance
+     * @param first_seed The seed of the first unit of runs
+     * @param count How many runs to simulate with each balance
+     * @param thread_count How many threads to use, or 0 for one per
+     * processor
+     * @param limits How far each run may go
+     * @param reduction How the runs are drawn
+     * @return The variant's means minus the base's. Effective sample sizes
+     * are measured against runs drawn independently for each balance
+     * @throws std::invalid_argument If count leaves a stratum with fewer
+     * than two units of runs, or too many enemies are stratified
+     */
+    auto compare_balances(const balance_params& base,
+                          const balance_params& variant,
+                          std::uint64_t first_seed, std::uint64_t count,
+                          std::size_t thread_count = 0,
+                          const simulation_limits& limits = {},
+                          const variance_reduction& reduction = {})
+            -> run_estimates;
+
+    /**
+     * A value estimated from simulated runs, with a 95% confidence interval
+     */
+    struct interval_estimate {
+        double value = 0.0;
+        double standard_error = 0.0;
+        double low = 0.0;
+        double high = 0.0;
+    };
+
+    /**
+     * How plain runs fare on one stage, estimated from weighed runs
+     */
+    struct stage_estimate {
+        std::int32_t stage = 0;
+        // The chance that a run reaches the stage
+        interval_estimate reached;
+        // The chance that a run that reaches the stage wins its battle
+        interval_estimate win_rate;
+        // How many of the runs drawn reached the stage
+        std::uint64_t runs_reached = 0;
+    };
+
+    /**
+     * How far plain runs get, estimated from runs drawn with a bias
+     */
+    struct depth_estimates {
+        // From the first stage to the deepest one a run reached
+        std::vector<stage_estimate> stages;
+        std::uint64_t runs = 0;
+        // How many plain runs the weighed ones are worth, by Kish's formula
+        double effective_runs = 0.0;
+    };
+
+    /**
+     * Simulates runs with an importance bias and estimates, from their
+     * likelihood ratios, how likely plain runs are to reach and win each
+     * stage. With a bias that favors deep runs, deep stages are estimated
+     * from far fewer runs than plain ones would need
+     * @param first_seed The seed of the first run
+     * @param count How many runs to simulate
+     * @param bias The bias. The default draws the runs plainly
+     * @param thread_count How many threads to use, or 0 for one per
+     * processor
+     * @param limits How far each run may go
+     * @return The estimates
+     * @throws std::invalid_argument If the bias has enemy weights, but not
+     * one per enemy type
+     */
+    auto estimate_depth(std::uint64_t first_seed, std::uint64_t count,
+                        const importance_bias& bias = {},
+                        std::size_t thread_count = 0,
+                        const simulation_limits& limits = {})
+            -> depth_estimates;
+
+    /**
+     * How fit_importance_bias searches
+     */
+    struct importance_fitting {
+        // Each round plays this many runs with the bias fitted so far, with
+        // consecutive seeds from first_seed on
+        std::uint64_t first_seed = 1;
+        std::uint64_t round_runs = 2000;
+        std::uint32_t max_rounds = 10;
+        // The deepest fraction of a round's runs is what the next round's
+        // bias is fitted to
+        double elite_fraction = 0.1;
+        // How far each round moves the bias from the last one to the fit
+        double smoothing = 0.7;
+        // Tilts stay within [-max_tilt, max_tilt], and enemy weights above
+        // min_weight times the even one, which bounds the likelihood
+        // ratios
+        double max_tilt = 3.0;
+        double min_weight = 0.1;
+        // How many threads play the runs, or 0 for one per processor
+        std::size_t thread_count = 0;
+    };
+
+    /**
+     * Fits an importance bias under which runs reach a stage often, by the
+     * cross-entropy method. Each round picks the deepest of its runs and
+     * fits the bias that draws what they drew, weighed by their likelihood
+     * ratios, until the picked runs are those that reach the stage
+     * @param stage The stage to reach
+     * @param options How to search
+     * @return The bias
+     */
+    auto fit_importance_bias(std::int32_t stage,
+                             const importance_fitting& options = {})
+            -> importance_bias;
+
+    /**
+     * Summarizes any number of runs in a few kilobytes, in one pass and
+     * without keeping the runs. Summaries built apart, for instance on
+     * different threads, merge into the summary of all their runs
+     */
+    class run_stats {
+    public:
+        /**
+         * Counts a run
+         * @param run The run
+         */
+        auto add(const run_summary& run) -> void;
+
+        /**
+         * Counts every run another summary has counted
+         * @param other The other summary
+         */
+        auto merge(const run_stats& other) -> void;
+
+        /**
+         * @return How many runs were counted
+         */
+        [[nodiscard]] auto runs() const -> std::uint64_t;
+
+        /**
+         * @return The distribution of the stages the runs reached
+         */
+        [[nodiscard]] auto stages_reached() const -> const t_digest&;
+
+        /**
+         * @return The distribution of battle lengths, in turns
+         */
+        [[nodiscard]] auto turns_per_battle() const -> const t_digest&;
+
+        /**
+         * @return The distribution of the gold paid for battles won
+         */
+        [[nodiscard]] auto gold_per_battle() const -> const t_digest&;
+
+        /**
+         * @return The distinct enemy parties fought
+         */
+        [[nodiscard]] auto compositions() const -> const hyperloglog&;
+
+        /**
+         * @return How many enemies of each type were fought
+         */
+        [[nodiscard]] auto enemies_by_type() const
+                -> const std::vector<std::uint64_t>&;
+
+    private:
+        std::uint64_t runs_ = 0;
+        t_digest stages_reached_;
+        t_digest turns_per_battle_;
+        t_digest gold_per_battle_;
+        hyperloglog compositions_;
+        std::vector<std::uint64_t> enemies_by_type_;
+    };
+
+    /**
+     * Simulates runs with consecutive seeds and summarizes them. Each thread
+     * keeps its own summary, and they are merged once all runs are done.
+     * The counts do not depend on the thread count, but the quantiles may
+     * shift a little with it: digests merged in other groups cluster their
+     * values differently
+     * @param first_seed The seed of the first run
+     * @param count How many runs to simulate
+     * @param thread_count How many threads to use, or 0 for one per
+     * processor
+     * @param limits How far each run may go
+     * @return The summary
+     */
+    auto simulate_runs(std::uint64_t first_seed, std::uint64_t count,
+                       std::size_t thread_count = 0,
+                       const simulation_limits& limits = {}) -> run_stats;
+
+    /**
+     * Simulates runs with consecutive seeds and writes one row per run to a
+     * column file, in seed order. The columns are seed, stage_reached,
+     * turns, gold and death_cause, then bought_<type> and used_<type> for
+     * each ingredient type and kills_<type> for each enemy type
+     * @param path The column file
+     * @param first_seed The seed of the first run
+     * @param count How many runs to simulate
+     * @param thread_count How many threads to use, or 0 for one per
+     * processor
+     * @param limits How far each run may go
+     * @return The summary of the runs
+     * @throws std::runtime_error If the file could not be written
+     */
+    auto export_runs(const std::string& path, std::uint64_t first_seed,
+                     std::uint64_t count, std::size_t thread_count = 0,
+                     const simulation_limits& limits = {}) -> run_stats;
+
+    /**
+     * Simulates runs with consecutive seeds and writes every combat event
+     * of every run to an event log, in seed order
+     * @param path The event log
+     * @param first_seed The seed of the first run
+     * @param count How many runs to simulate
+     * @param thread_count How many threads to use, or 0 for one per
+     * processor
+     * @param limits How far each run may go
+     * @return The summary of the runs
+     * @throws std::runtime_error If the file could not be written
+     */
+    auto trace_runs(const std::string& path, std::uint64_t first_seed,
+                    std::uint64_t count, std::size_t thread_count = 0,
+                    const simulation_limits& limits = {}) -> run_stats;
+
+} // namespace potmaker
+
+#endif // SIMULATION_HH
@@ -0,0 +1,205 @@
+#include "sketches.hh"
+#include "state_hash.hh"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+namespace potmaker {
+
+    t_digest::t_digest(const double compression)
+        : compression_(compression),
+          min_(std::numeric_limits<double>::infinity()),
+          max_(-std::numeric_limits<double>::infinity())
+    {
+        if (!(compression > 0.0)) {
+            throw std::invalid_argument("compression must be positive");
+        }
+    }
+
+    auto t_digest::add(const double value, const double weight) -> void
+    {
+        if (!(weight > 0.0) || std::isnan(value)) { return; }
+
+        buffer_.push_back({value, weight});
+        count_ += weight;
+        sum_ += value * weight;
+        min_ = std::min(min_, value);
+        max_ = std::max(max_, value);
+
+        // Flushing costs a sort, so it waits for a good batch
+        if (buffer_.size() >= static_cast<std::size_t>(compression_) * 5) {
+            flush();
+        }
+    }
+
+    auto t_digest::merge(const t_digest& other) -> void
+    {
+        // Inserting a vector's own elements into it is undefined, so a
+        // digest merges a copy of itself
+        if (&other == this) {
+            const t_digest copy = other;
+            merge(copy);
+            return;
+        }
+
+        buffer_.insert(buffer_.end(), other.centroids_.begin(),
+                       other.centroids_.end());
+        buffer_.insert(buffer_.end(), other.buffer_.begin(),
+                       other.buffer_.end());
+        count_ += other.count_;
+        sum_ += other.sum_;
+        min_ = std::min(min_, other.min_);
+        max_ = std::max(max_, other.max_);
+        flush();
+    }
+
+    auto t_digest::quantile(const double q) const -> double
+    {
+        flush();
+        if (centroids_.empty()) {
+            return std::numeric_limits<double>::quiet_NaN();
+        }
+        if (centroids_.size() == 1 || q <= 0.0) {
+            return q <= 0.0 ? min_ : centroids_.front().mean;
+        }
+        if (q >= 1.0) { return max_; }
+
+        // Each cluster's mean sits at the middle of its weight, and values
+        // between two middles are spread evenly
+        const double target = q * count_;
+        const centroid& first = centroids_.front();
+        if (target < first.weight / 2.0) {
+            return min_ + (first.mean - min_) * (target / (first.weight / 2.0));
+        }
+
+        double below = first.weight / 2.0;
+        for (std::size_t i = 1; i < centroids_.size(); ++i) {
+            const centroid& left = centroids_[i - 1];
+            const centroid& right = centroids_[i];
+            const double gap = (left.weight + right.weight) / 2.0;
+            if (target < below + gap) {
+                const double t = (target - below) / gap;
+                return left.mean + (right.mean - left.mean) * t;
+            }
+            below += gap;
+        }
+
+        const centroid& last = centroids_.back();
+        const double t = (target - below) / (last.weight / 2.0);
+        return last.mean + (max_ - last.mean) * std::min(t, 1.0);
+    }
+
+    auto t_digest::count() const -> double
+    {
+        return count_;
+    }
+
+    auto t_digest::mean() const -> double
+    {
+        return count_ > 0.0 ? sum_ / count_
+                            : std::numeric_limits<double>::quiet_NaN();
+    }
+
+    auto t_digest::min() const -> double
+    {
+        return min_;
+    }
+
+    auto t_digest::max() const -> double
+    {
+        return max_;
+    }
+
+    auto t_digest::flush() const -> void
+    {
+        if (buffer_.empty()) { return; }
+
+        buffer_.insert(buffer_.end(), centroids_.begin(), centroids_.end());
+        std::ranges::sort(buffer_, {}, &centroid::mean);
+        centroids_.clear();
+
+        double total = 0.0;
+        for (const centroid& c: buffer_) { total += c.weight; }
+
+        // Grow the current cluster while the whole of it stays within one
+        // unit of the scale function
+        centroid current = buffer_.front();
+        double before = 0.0;
+        double limit = scale(before / total, total) + 1.0;
+        for (std::size_t i = 1; i < buffer_.size(); ++i) {
+            const centroid& next = buffer_[i];
+            const double q = (before + current.weight + next.weight) / total;
+            if (scale(q, total) <= limit) {
+                current.weight += next.weight;
+                current.mean += (next.mean - current.mean) * next.weight
+                                / current.weight;
+            }
+            else {
+                centroids_.push_back(current);
+                before += current.weight;
+                limit = scale(before / total, total) + 1.0;
+                current = next;
+            }
+        }
+        centroids_.push_back(current);
+        buffer_.clear();
+    }
+
+    auto t_digest::scale(const double q, const double total) const
+            -> double
+    {
+        // Logit, normalized so that a digest of total values ends up with
+        // about compression clusters
+        const double norm = 4.0 * std::log(std::max(total / compression_, 1.0))
+                            + 24.0;
+        const double clamped = std::clamp(q, 1e-12, 1.0 - 1e-12);
+        return compression_ / norm * std::log(clamped / (1.0 - clamped));
+    }
+
+    auto hyperloglog::add(const std::uint64_t hash) -> void
+    {
+        const std::uint64_t mixed = mix_hash(hash);
+        const auto index = static_cast<std::size_t>(mixed >> (64 - index_bits));
+        // A one past the remaining bits caps the run of zeros
+        const std::uint64_t rest = (mixed << index_bits)
+                                   | (std::uint64_t{1} << (index_bits - 1));
+        const auto rank = static_cast<std::uint8_t>(std::countl_zero(rest) + 1);
+        registers_[index] = std::max(registers_[index], rank);
+    }
+
+    auto hyperloglog::merge(const hyperloglog& other) -> void
+    {
+        for (std::size_t i = 0; i < register_count; ++i) {
+            registers_[i] = std::max(registers_[i], other.registers_[i]);
+        }
+    }
+
+    auto hyperloglog::estimate() const -> double
+    {
+        const auto m = static_cast<double>(register_count);
+
+        double sum = 0.0;
+        std::size_t zeros = 0;
+        for (const std::uint8_t r: registers_) {
+            sum += std::ldexp(1.0, -static_cast<int>(r));
+            if (r == 0) { ++zeros; }
+        }
+
+        const double alpha = 0.7213 / (1.0 + 1.079 / m);
+        const double raw = alpha * m * m / sum;
+
+        // Few values leave registers empty, and counting those is more
+        // accurate then. Hashes are 64 bits wide, so the estimate never
+        // needs correcting at the top
+        if (raw <= 2.5 * m && zeros > 0) {
+            return m * std::log(m / static_cast<double>(zeros));
+        }
+        return raw;
+    }
+
+} // namespace potmaker
@@ -0,0 +1,135 @@
+#ifndef SKETCHES_HH
+#define SKETCHES_HH
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace potmaker {
+
+    /**
+     * Estimates quantiles of a stream of values in a few kilobytes, however
+     * long the stream (a merging t-digest). Values are gathered into
+     * clusters that are kept small near both tails and allowed to grow in
+     * the middle, so extreme quantiles stay accurate. Digests built apart,
+     * for instance on different threads, merge into the digest of all their
+     * values
+     */
+    class t_digest {
+    public:
+        /**
+         * Creates an empty digest
+         * @param compression How many clusters the digest keeps, roughly.
+         * More is more accurate
+         * @throws std::invalid_argument If the compression is not positive
+         */
+        explicit t_digest(double compression = 100.0);
+
+        /**
+         * Adds a value
+         * @param value The value
+         * @param weight How many times it occurred
+         */
+        auto add(double value, double weight = 1.0) -> void;
+
+        /**
+         * Adds every value another digest has seen
+         * @param other The other digest, which may be this one
+         */
+        auto merge(const t_digest& other) -> void;
+
+        /**
+         * @param q A fraction in [0, 1]
+         * @return The value that fraction of the values fall below, or NaN
+         * if no value was added
+         */
+        [[nodiscard]] auto quantile(double q) const -> double;
+
+        /**
+         * @return How many values were added, by weight
+         */
+        [[nodiscard]] auto count() const -> double;
+
+        /**
+         * @return The mean of the values, or NaN if no value was added
+         */
+        [[nodiscard]] auto mean() const -> double;
+
+        /**
+         * @return The smallest value added
+         */
+        [[nodiscard]] auto min() const -> double;
+
+        /**
+         * @return The largest value added
+         */
+        [[nodiscard]] auto max() const -> double;
+
+    private:
+        struct centroid {
+            double mean;
+            double weight;
+        };
+
+        /**
+         * Folds the values waiting in the buffer into the clusters
+         */
+        auto flush() const -> void;
+
+        /**
+         * The scale function: roughly how many clusters fit below quantile q
+         * in a digest of total values
+         */
+        [[nodiscard]] auto scale(double q, double total) const -> double;
+
+        double compression_;
+        // Values are buffered and clustered in batches, which keeps adding
+        // them cheap. Reading flushes, so both are logically part of the
+        // digest's value
+        mutable std::vector<centroid> centroids_;
+        mutable std::vector<centroid> buffer_;
+        double count_ = 0.0;
+        double sum_ = 0.0;
+        double min_;
+        double max_;
+    };
+
+    /**
+     * Estimates how many distinct values a stream holds in a fixed four
+     * kilobytes, to within a couple of percent (HyperLogLog). Sketches built
+     * apart merge into the sketch of all their values
+     */
+    class hyperloglog {
+    public:
+        /**
+         * Adds a value
+         * @param hash A hash of the value. It is mixed again, so it need not
+         * be a good one
+         */
+        auto add(std::uint64_t hash) -> void;
+
+        /**
+         * Adds every value another sketch has seen
+         * @param other The other sketch
+         */
+        auto merge(const hyperloglog& other) -> void;
+
+        /**
+         * @return The estimated number of distinct values
+         */
+        [[nodiscard]] auto estimate() const -> double;
+
+    private:
+        // The first bits of a hash pick a register
+        static constexpr int index_bits = 12;
+        static constexpr std::size_t register_count = std::size_t{1}
+                                                      << index_bits;
+
+        // Each register holds the longest run of leading zeros seen, plus
+        // one, among the hashes that picked it
+        std::array<std::uint8_t, register_count> registers_{};
+    };
+
+} // namespace potmaker
+
+#endif // SKETCHES_HH
@@ -0,0 +1,329 @@
+#ifndef SMALL_VECTOR_HH
+#define SMALL_VECTOR_HH
+#include <algorithm>
+#include <cstddef>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <utility>
+
+namespace potmaker {
+
+    /**
+     * A vector that keeps its first few elements inside the object itself and
+     * only allocates once it grows past them. Meant for the many short lists
+     * in the game (status effects, parties, inventories) that would otherwise
+     * allocate every time they are built.
+     *
+     * Iterators are plain pointers and are invalidated like std::vector's
+     * @tparam T The element type
+     * @tparam inline_capacity How many elements fit without allocating
+     */
+    template<typename T, std::size_t inline_capacity> class small_vector {
+        static_assert(inline_capacity > 0);
+
+    public:
+        using value_type = T;
+        using size_type = std::size_t;
+        using difference_type = std::ptrdiff_t;
+        using reference = T&;
+        using const_reference = const T&;
+        using pointer = T*;
+        using const_pointer = const T*;
+        using iterator = T*;
+        using const_iterator = const T*;
+        using reverse_iterator = std::reverse_iterator<iterator>;
+        using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+        small_vector() = default;
+
+        small_vector(const std::initializer_list<T> values)
+        {
+            reserve(values.size());
+            std::uninitialized_copy(values.begin(), values.end(), data_);
+            size_ = values.size();
+        }
+
+        small_vector(const small_vector& other)
+        {
+            reserve(other.size_);
+            std::uninitialized_copy(other.begin(), other.end(), data_);
+            size_ = other.size_;
+        }
+
+        small_vector(small_vector&& other) noexcept { steal(other); }
+
+        ~small_vector()
+        {
+            std::destroy(begin(), end());
+            release();
+        }
+
+        auto operator=(const small_vector& other) -> small_vector&
+        {
+            if (this != &other) {
+                clear();
+                reserve(other.size_);
+                std::uninitialized_copy(other.begin(), other.end(), data_);
+                size_ = other.size_;
+            }
+            return *this;
+        }
+
+        auto operator=(small_vector&& other) noexcept -> small_vector&
+        {
+            if (this != &other) {
+                clear();
+                release();
+                steal(other);
+            }
+            return *this;
+        }
+
+        [[nodiscard]] auto begin() noexcept -> iterator { return data_; }
+        [[nodiscard]] auto end() noexcept -> iterator { return data_ + size_; }
+        [[nodiscard]] auto begin() const noexcept -> const_iterator
+        {
+            return data_;
+        }
+        [[nodiscard]] auto end() const noexcept -> const_iterator
+        {
+            return data_ + size_;
+        }
+        [[nodiscard]] auto rbegin() noexcept -> reverse_iterator
+        {
+            return reverse_iterator(end());
+        }
+        [[nodiscard]] auto rend() noexcept -> reverse_iterator
+        {
+            return reverse_iterator(begin());
+        }
+        [[nodiscard]] auto rbegin() const noexcept -> const_reverse_iterator
+        {
+            return const_reverse_iterator(end());
+        }
+        [[nodiscard]] auto rend() const noexcept -> const_reverse_iterator
+        {
+            return const_reverse_iterator(begin());
+        }
+
+        [[nodiscard]] auto size() const noexcept -> size_type { return size_; }
+        [[nodiscard]] auto empty() const noexcept -> bool { return size_ == 0; }
+        [[nodiscard]] auto capacity() const noexcept -> size_type
+        {
+            return capacity_;
+        }
+
+        /**
+         * @return Whether the elements still live inside the object
+         */
+        [[nodiscard]] auto is_inline() const noexcept -> bool
+        {
+            return data_ == inline_data();
+        }
+
+        [[nodiscard]] auto data() noexcept -> pointer { return data_; }
+        [[nodiscard]] auto data() const noexcept -> const_pointer
+        {
+            return data_;
+        }
+
+        auto operator[](const size_type i) -> reference { return data_[i]; }
+        auto operator[](const size_type i) const -> const_reference
+        {
+            return data_[i];
+        }
+
+        [[nodiscard]] auto front() -> reference { return data_[0]; }
+        [[nodiscard]] auto front() const -> const_reference { return data_[0]; }
+        [[nodiscard]] auto back() -> reference { return data_[size_ - 1]; }
+        [[nodiscard]] auto back() const -> const_reference
+        {
+            return data_[size_ - 1];
+        }
+
+        /**
+         * Makes room for at least new_capacity elements
+         * @param new_capacity The capacity to reach
+         */
+        auto reserve(const size_type new_capacity) -> void
+        {
+            if (new_capacity > capacity_) { grow_to(new_capacity); }
+        }
+
+        template<typename... args_t>
+        auto emplace_back(args_t&&... args) -> reference
+        {
+            if (size_ < capacity_) {
+                std::construct_at(data_ + size_, std::forward<args_t>(args)...);
+            }
+            else {
+                // The arguments may refer to an element, so the new element
+                // is built before the old ones are moved out
+                const size_type new_capacity = capacity_ * 2;
+                T* fresh = allocate(new_capacity);
+                try {
+                    std::construct_at(fresh + size_,
+                                      std::forward<args_t>(args)...);
+                }
+                catch (...) {
+                    deallocate(fresh, new_capacity);
+                    throw;
+                }
+                relocate(fresh, new_capacity);
+            }
+            return data_[size_++];
+        }
+
+        auto push_back(const T& value) -> void { emplace_back(value); }
+        auto push_back(T&& value) -> void { emplace_back(std::move(value)); }
+
+        auto pop_back() -> void { std::destroy_at(data_ + --size_); }
+
+        /**
+         * Removes an element, shifting the following ones down
+         * @param pos The element to remove
+         * @return An iterator to the element that followed it
+         */
+        auto erase(const const_iterator pos) -> iterator
+        {
+            return erase(pos, pos + 1);
+        }
+
+        /**
+         * Removes a range of elements, shifting the following ones down
+         * @param first The first element to remove
+         * @param last One past the last element to remove
+         * @return An iterator to the element that followed the range
+         */
+        auto erase(const const_iterator first, const const_iterator last)
+                -> iterator
+        {
+            iterator from = data_ + (first - data_);
+            iterator to = data_ + (last - data_);
+            if (from != to) {
+                iterator new_end = std::move(to, end(), from);
+                std::destroy(new_end, end());
+                size_ = static_cast<size_type>(new_end - data_);
+            }
+            return from;
+        }
+
+        /**
+         * Grows or shrinks the vector. New elements are value-initialized
+         * @param count The new size
+         */
+        auto resize(const size_type count) -> void
+        {
+            if (count < size_) {
+                erase(begin() + count, end());
+                return;
+            }
+            reserve(count);
+            std::uninitialized_value_construct(end(), data_ + count);
+            size_ = count;
+        }
+
+        /**
+         * Destroys every element. The capacity is kept
+         */
+        auto clear() noexcept -> void
+        {
+            std::destroy(begin(), end());
+            size_ = 0;
+        }
+
+        /**
+         * Removes every element matching a predicate
+         * @param v The vector
+         * @param pred The predicate
+         * @return How many elements were removed
+         */
+        template<typename predicate_t>
+        friend auto erase_if(small_vector& v, predicate_t pred) -> size_type
+        {
+            const iterator new_end = std::remove_if(v.begin(), v.end(), pred);
+            const auto removed = static_cast<size_type>(v.end() - new_end);
+            v.erase(new_end, v.end());
+            return removed;
+        }
+
+    private:
+        [[nodiscard]] auto inline_data() noexcept -> T*
+        {
+            return std::launder(reinterpret_cast<T*>(inline_storage_));
+        }
+        [[nodiscard]] auto inline_data() const noexcept -> const T*
+        {
+            return std::launder(reinterpret_cast<const T*>(inline_storage_));
+        }
+
+        static auto allocate(const size_type count) -> T*
+        {
+            return std::allocator<T>().allocate(count);
+        }
+
+        static auto deallocate(T* p, const size_type count) -> void
+        {
+            std::allocator<T>().deallocate(p, count);
+        }
+
+        /**
+         * Moves the elements into a new buffer and adopts it
+         */
+        auto relocate(T* fresh, const size_type new_capacity) -> void
+        {
+            std::uninitialized_move(begin(), end(), fresh);
+            std::destroy(begin(), end());
+            release();
+            data_ = fresh;
+            capacity_ = new_capacity;
+        }
+
+        auto grow_to(const size_type new_capacity) -> void
+        {
+            relocate(allocate(new_capacity), new_capacity);
+        }
+
+        /**
+         * Frees the heap buffer, if any, and goes back to inline storage.
+         * The elements must already be destroyed
+         */
+        auto release() noexcept -> void
+        {
+            if (!is_inline()) { deallocate(data_, capacity_); }
+            data_ = inline_data();
+            capacity_ = inline_capacity;
+        }
+
+        /**
+         * Takes the elements of another vector, which is left empty. This
+         * vector must be empty and inline
+         */
+        auto steal(small_vector& other) noexcept -> void
+        {
+            if (other.is_inline()) {
+                std::uninitialized_move(other.begin(), other.end(), data_);
+                size_ = other.size_;
+                other.clear();
+            }
+            else {
+                data_ = other.data_;
+                size_ = other.size_;
+                capacity_ = other.capacity_;
+                other.data_ = other.inline_data();
+                other.size_ = 0;
+                other.capacity_ = inline_capacity;
+            }
+        }
+
+        alignas(T) std::byte inline_storage_[sizeof(T) * inline_capacity];
+        T* data_ = inline_data();
+        size_type size_ = 0;
+        size_type capacity_ = inline_capacity;
+    };
+
+} // namespace potmaker
+
+#endif // SMALL_VECTOR_HH
@@ -0,0 +1,74 @@
+#ifndef STATE_HASH_HH
+#define STATE_HASH_HH
+#include <cstdint>
+#include <string_view>
+
+namespace potmaker {
+
+    /**
+     * The parts a battle's state hash is made of. Each part hashes its
+     * values under its own tag, so equal values in different parts do not
+     * cancel out
+     */
+    enum class hash_part : std::uint8_t {
+        identity, // What an entity is: element, name and stats
+        health, // An entity's health, in buckets
+        effect, // A status effect: kind, potency and expiry tick
+        tick, // How many times an entity has ticked
+        ingredient, // One stored ingredient
+        enemy, // An enemy and its place in the party
+        stage // The stage being fought
+    };
+
+    /**
+     * Scrambles a 64-bit value so that every input bit affects every output
+     * bit (the splitmix64 finalizer)
+     * @param value The value
+     * @return The scrambled value
+     */
+    [[nodiscard]] constexpr auto mix_hash(std::uint64_t value)
+            -> std::uint64_t
+    {
+        value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+        return value ^ (value >> 31);
+    }
+
+    /**
+     * Computes the Zobrist key of one piece of state. Keys are combined
+     * with xor when a piece can appear at most once, and with addition when
+     * it can appear several times, so that removing it is the same cheap
+     * operation as adding it
+     * @param part What the piece is
+     * @param first Its first value
+     * @param second Its second value, if any
+     * @return The key
+     */
+    [[nodiscard]] constexpr auto hash_key(const hash_part part,
+                                          const std::uint64_t first,
+                                          const std::uint64_t second = 0)
+            -> std::uint64_t
+    {
+        return mix_hash(mix_hash(first + (static_cast<std::uint64_t>(part)
+                                          * 0x9e3779b97f4a7c15ULL))
+                        ^ second);
+    }
+
+    /**
+     * Hashes a name the same way on every build (FNV-1a)
+     * @param name The name
+     * @return The hash
+     */
+    [[nodiscard]] constexpr auto hash_name(const std::string_view name)
+            -> std::uint64_t
+    {
+        std::uint64_t hash = 0xcbf29ce484222325ULL;
+        for (const char c: name) {
+            hash = (hash ^ static_cast<unsigned char>(c)) * 0x100000001b3ULL;
+        }
+        return hash;
+    }
+
+} // namespace potmaker
+
+#endif // STATE_HASH_HH
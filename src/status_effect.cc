@@ -1,14 +1,44 @@
 #include "status_effect.hh"
 #include "entity.hh"
 #include "util.hh"
-#include <cmath>
+#include <array>
 #include <cstdint>
+#include <cstddef>
 #include <format>
+#include <stdexcept>
 #include <string>
 #include <string_view>
+#include <variant>
 
 namespace potmaker {
 
+    namespace {
+
+        // Damage and healing over time add up, freezing only lasts longer
+        // and stat changes do not stack
+        constexpr stacking_table default_stacking{
+                        stacking_policy::merge_potency, // burning
+                        stacking_policy::refresh_duration, // freezing
+                        stacking_policy::merge_potency, // poison
+                        stacking_policy::keep_strongest, // wither
+                        stacking_policy::merge_potency, // regeneration
+                        stacking_policy::keep_strongest, // protection
+                        stacking_policy::keep_strongest // strength
+        };
+        thread_local const stacking_table* active_stacking = &default_stacking;
+
+        // The multipliers of each effect, raised to the effect's potency
+        constexpr multiplier_table burning_damage{1.1};
+        constexpr multiplier_table freezing_damage{1.25};
+        constexpr multiplier_table freezing_attack{0.9};
+        constexpr multiplier_table poison_healing{1.5};
+        constexpr multiplier_table wither_attack{0.75};
+        constexpr multiplier_table protection_damage{0.8};
+        constexpr multiplier_table strength_damage{0.9};
+        constexpr multiplier_table strength_attack{1.5};
+
+    } // namespace
+
 #define POTMK_STATUS_EFFECT_CONSTRUCTOR(type, dpt)                             \
     type::type(int turns, int potency)                                         \
         : status_effect(#type, turns, potency, dpt)                            \
@@ -24,40 +54,40 @@ namespace potmaker {
 
     // BURNING
 
-    auto burning::modify_damage(const double amount) -> double
+    auto burning::modify_damage(const combat_value amount) -> combat_value
     {
-        return amount * std::pow(1.1, potency_);
+        return amount * burning_damage(potency_);
     }
 
     // FROZEN
 
-    auto freezing::modify_damage(const double amount) -> double
+    auto freezing::modify_damage(const combat_value amount) -> combat_value
     {
-        return amount * std::pow(1.25, potency_);
+        return amount * freezing_damage(potency_);
     }
 
-    auto freezing::modify_attack(const double amount) -> double
+    auto freezing::modify_attack(const combat_value amount) -> combat_value
     {
-        return amount * std::pow(0.9, potency_);
+        return amount * freezing_attack(potency_);
     }
 
     // POISON
 
-    auto poison::modify_healing(const double amount) -> double
+    auto poison::modify_healing(const combat_value amount) -> combat_value
     {
-        return amount / std::pow(1.5, potency_);
+        return amount / poison_healing(potency_);
     }
 
     // WITHER
 
-    auto wither::modify_healing(const double amount) -> double
+    auto wither::modify_healing(const combat_value amount) -> combat_value
     {
         return 0.0;
     }
 
-    auto wither::modify_attack(const double amount) -> double
+    auto wither::modify_attack(const combat_value amount) -> combat_value
     {
-        return amount * std::pow(0.75, potency_);
+        return amount * wither_attack(potency_);
     }
 
     // REGENERATION
@@ -66,21 +96,65 @@ namespace potmaker {
 
     // PROTECTION
 
-    auto protection::modify_damage(const double amount) -> double
+    auto protection::modify_damage(const combat_value amount) -> combat_value
     {
-        return amount * std::pow(0.8, potency_);
+        return amount * protection_damage(potency_);
     }
 
     // STRENGTH
 
-    auto strength::modify_damage(const double amount) -> double
+    auto strength::modify_damage(const combat_value amount) -> combat_value
+    {
+        return amount * strength_damage(potency_);
+    }
+
+    auto strength::modify_attack(const combat_value amount) -> combat_value
+    {
+        return amount * strength_attack(potency_);
+    }
+
+    auto make_status_effect(const std::size_t kind, const int turns,
+                            const int potency) -> status_effect_variant
+    {
+        switch (kind) {
+        case 0:
+            return burning(turns, potency);
+        case 1:
+            return freezing(turns, potency);
+        case 2:
+            return poison(turns, potency);
+        case 3:
+            return wither(turns, potency);
+        case 4:
+            return regeneration(turns, potency);
+        case 5:
+            return protection(turns, potency);
+        case 6:
+            return strength(turns, potency);
+        default:
+            throw std::invalid_argument("invalid status effect kind");
+        }
+    }
+
+    auto stacking_policy_of(const std::size_t kind) -> stacking_policy
+    {
+        return active_stacking->at(kind);
+    }
+
+    auto stacking_policies() -> const stacking_table&
+    {
+        return *active_stacking;
+    }
+
+    scoped_stacking::scoped_stacking(const stacking_table& policies)
+        : previous_(active_stacking)
     {
-        return amount * std::pow(0.9, potency_);
+        active_stacking = &policies;
     }
 
-    auto strength::modify_attack(const double amount) -> double
+    scoped_stacking::~scoped_stacking()
     {
-        return amount * std::pow(1.5, potency_);
+        active_stacking = previous_;
     }
 
-} // namespace potmaker
\ No newline at end of file
+} // namespace potmaker
@@ -1,8 +1,13 @@
 #ifndef STATUS_EFFECT_HH
 #define STATUS_EFFECT_HH
 
+#include "combat_math.hh"
 #include "element_type.hh"
 #include "util.hh"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
 #include <sstream>
 #include <string>
 #include <string_view>
@@ -13,6 +18,16 @@ namespace potmaker {
 
     class entity;
 
+    /**
+     * Decides what happens when an entity receives an effect of a kind it
+     * already has. Either way the entity keeps a single effect of that kind
+     */
+    enum class stacking_policy : std::uint8_t {
+        merge_potency, // Potencies add up and the longer duration is kept
+        refresh_duration, // Potency stays, the longer duration is kept
+        keep_strongest // The effect with the higher potency is kept whole
+    };
+
     /**
      * Modifies how an entity attacks, heals and receives damage
      * throughout the game's course. May also deal damage per turn.
@@ -21,7 +36,7 @@ namespace potmaker {
     template<element_type element_t> class status_effect : public named {
     public:
         status_effect(std::string name, const int turns, const int potency,
-                      const double base_damage_per_turn)
+                      const combat_value base_damage_per_turn)
             : named(std::move(name)), dmg_per_turn_(base_damage_per_turn),
               turns_(turns), potency_(potency)
         {}
@@ -31,31 +46,68 @@ namespace potmaker {
          * @param amt The original input healing
          * @return The new healing value after being transformed
          */
-        virtual auto modify_healing(const double amt) -> double { return amt; }
+        virtual auto modify_healing(const combat_value amt) -> combat_value
+        {
+            return amt;
+        }
 
         /**
          * Transforms the damage received by the afflicted entity
          * @param amt The original input damage
          * @return The new damage value after being transformed
          */
-        virtual auto modify_damage(const double amt) -> double { return amt; }
+        virtual auto modify_damage(const combat_value amt) -> combat_value
+        {
+            return amt;
+        }
 
         /**
          * Transforms the attack dealt by the afflicted entity
          * @param amt The original output attack
          * @return The new attack value after being transformed
          */
-        virtual auto modify_attack(const double amt) -> double { return amt; }
+        virtual auto modify_attack(const combat_value amt) -> combat_value
+        {
+            return amt;
+        }
 
         /**
          * Ticks down the turn timer
+         * @param turns How many turns went by
          */
-        auto tick() -> void { turns_--; }
+        auto tick(const int turns = 1) -> void { turns_ -= turns; }
+
+        /**
+         * Folds a newly received effect of the same kind into this one
+         * @param incoming The new effect
+         * @param policy How the two are combined
+         */
+        auto stack(const status_effect& incoming, const stacking_policy policy)
+                -> void
+        {
+            switch (policy) {
+            case stacking_policy::merge_potency:
+                potency_ += incoming.potency_;
+                turns_ = std::max(turns_, incoming.turns_);
+                break;
+            case stacking_policy::refresh_duration:
+                turns_ = std::max(turns_, incoming.turns_);
+                break;
+            case stacking_policy::keep_strongest:
+                if (incoming.potency_ > potency_
+                    || (incoming.potency_ == potency_
+                        && incoming.turns_ > turns_)) {
+                    potency_ = incoming.potency_;
+                    turns_ = incoming.turns_;
+                }
+                break;
+            }
+        }
 
         /**
          * @return The damage per turn this status effect deals
          */
-        [[nodiscard]] auto total_damage_per_turn() const -> double
+        [[nodiscard]] auto total_damage_per_turn() const -> combat_value
         {
             return dmg_per_turn_ * potency_;
         }
@@ -81,7 +133,7 @@ namespace potmaker {
     protected:
         element_type element_ = element_t;
         std::string_view name_;
-        double dmg_per_turn_;
+        combat_value dmg_per_turn_;
         int turns_;
         int potency_;
     };
@@ -89,27 +141,27 @@ namespace potmaker {
     class burning final : public status_effect<element_type::fire> {
     public:
         burning(int turns, int potency);
-        auto modify_damage(double amount) -> double override;
+        auto modify_damage(combat_value amount) -> combat_value override;
     };
 
     class freezing final : public status_effect<element_type::ice> {
     public:
         freezing(int turns, int potency);
-        auto modify_damage(double amount) -> double override;
-        auto modify_attack(double amount) -> double override;
+        auto modify_damage(combat_value amount) -> combat_value override;
+        auto modify_attack(combat_value amount) -> combat_value override;
     };
 
     class poison final : public status_effect<element_type::nature> {
     public:
         poison(int turns, int potency);
-        auto modify_healing(double amount) -> double override;
+        auto modify_healing(combat_value amount) -> combat_value override;
     };
 
     class wither final : public status_effect<element_type::underworld> {
     public:
         wither(int turns, int potency);
-        auto modify_healing(double amount) -> double override;
-        auto modify_attack(double amount) -> double override;
+        auto modify_healing(combat_value amount) -> combat_value override;
+        auto modify_attack(combat_value amount) -> combat_value override;
     };
 
     class regeneration final
@@ -121,14 +173,14 @@ namespace potmaker {
     class protection final : public status_effect<element_type::protective> {
     public:
         protection(int turns, int potency);
-        auto modify_damage(double amount) -> double override;
+        auto modify_damage(combat_value amount) -> combat_value override;
     };
 
     class strength final : public status_effect<element_type::strengthening> {
     public:
         strength(int turns, int potency);
-        auto modify_damage(double amount) -> double override;
-        auto modify_attack(double amount) -> double override;
+        auto modify_damage(combat_value amount) -> combat_value override;
+        auto modify_attack(combat_value amount) -> combat_value override;
     };
 
     template<element_type element_t>
@@ -186,6 +238,57 @@ namespace potmaker {
             = std::variant<burning, freezing, poison, wither, regeneration,
                            protection, strength>;
 
+    /**
+     * A stacking policy per kind of effect, indexed like
+     * status_effect_variant
+     */
+    using stacking_table
+            = std::array<stacking_policy,
+                         std::variant_size_v<status_effect_variant>>;
+
+    /**
+     * Constructs a status effect from its alternative index in
+     * status_effect_variant
+     * @param kind The index of the effect's type within the variant
+     * @param turns How many turns the effect lasts
+     * @param potency The potency of the effect
+     * @return The new effect
+     */
+    [[nodiscard]] auto make_status_effect(std::size_t kind, int turns,
+                                          int potency) -> status_effect_variant;
+
+    /**
+     * @param kind The index of an effect's type within status_effect_variant
+     * @return How effects of that kind stack
+     */
+    [[nodiscard]] auto stacking_policy_of(std::size_t kind) -> stacking_policy;
+
+    /**
+     * @return How effects of every kind stack on the calling thread
+     */
+    [[nodiscard]] auto stacking_policies() -> const stacking_table&;
+
+    /**
+     * Stacks effects by other policies on the calling thread, until the
+     * scope ends. Like scoped_balance, each thread has its own policies, so
+     * threads never share a table being changed
+     */
+    class scoped_stacking {
+    public:
+        /**
+         * Starts stacking by other policies
+         * @param policies The policies. Must outlive the scope
+         */
+        explicit scoped_stacking(const stacking_table& policies);
+        ~scoped_stacking();
+
+        scoped_stacking(const scoped_stacking&) = delete;
+        auto operator=(const scoped_stacking&) -> scoped_stacking& = delete;
+
+    private:
+        const stacking_table* previous_;
+    };
+
 } // namespace potmaker
 
 #endif // STATUS_EFFECT_HH
\ No newline at end of file
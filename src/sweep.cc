@@ -0,0 +1,236 @@
+#include "sweep.hh"
+#include "checkpoint.hh"
+#include "content_library.hh"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace potmaker {
+
+    namespace {
+
+        auto paces(const sweep_grid& grid, const balance_params& base)
+                -> std::vector<std::int32_t>
+        {
+            return grid.stages_per_enemy.empty()
+                           ? std::vector<std::int32_t>{base.stages_per_enemy}
+                           : grid.stages_per_enemy;
+        }
+
+        /**
+         * @return A mean per run and its standard error, from a sum and a
+         * sum of squares
+         */
+        auto mean_of(const double sum, const double squares,
+                     const std::uint64_t runs) -> estimate
+        {
+            if (runs == 0) { return {}; }
+            const auto n = static_cast<double>(runs);
+            const double mean = sum / n;
+            const double variance
+                    = runs > 1 ? std::max(0.0, (squares - n * mean * mean)
+                                                       / (n - 1))
+                               : 0.0;
+            return {mean, std::sqrt(variance / n), n};
+        }
+
+        /**
+         * @return A hash of everything a sweep's results depend on
+         */
+        auto identify(const balance_params& base, const sweep_grid& grid,
+                      const sweep_options& options) -> std::uint64_t
+        {
+            std::string text = base.to_string();
+            const auto list = [&text](const char* name, const auto& values) {
+                text += name;
+                for (const auto value: values) {
+                    text += std::format(" {}", value);
+                }
+                text += '\n';
+            };
+            list("enemy_health", grid.enemy_health);
+            list("enemy_damage", grid.enemy_damage);
+            list("ingredient_power", grid.ingredient_power);
+            list("stages_per_enemy", paces(grid, base));
+            text += std::format("runs {} {} {}\nlimits {} {}\n",
+                                options.first_seed, options.runs_per_point,
+                                options.unit_runs, options.limits.max_stage,
+                                options.limits.max_turns);
+            const content_library* content = active_content();
+            if (content != nullptr) {
+                text += std::format("content {}\n", content->source_hash());
+            }
+            return checkpoint::checksum(std::as_bytes(std::span(text)));
+        }
+
+        /**
+         * @throws std::invalid_argument If a grid's knob has a value no
+         * balance can be played with
+         */
+        auto check_knobs(const sweep_grid& grid, const balance_params& base)
+                -> void
+        {
+            for (const std::vector<double>* scales:
+                 {&grid.enemy_health, &grid.enemy_damage,
+                  &grid.ingredient_power}) {
+                for (const double scale: *scales) {
+                    // Written so that NaN fails it too
+                    if (!(scale > 0.0)) {
+                        throw std::invalid_argument(std::format(
+                                "the factor {} is not positive", scale));
+                    }
+                }
+            }
+            for (const std::int32_t pace: paces(grid, base)) {
+                if (pace <= 0) {
+                    throw std::invalid_argument(std::format(
+                            "{} stages per enemy is not positive", pace));
+                }
+            }
+        }
+
+    } // namespace
+
+    auto sweep_grid::size() const -> std::size_t
+    {
+        return enemy_health.size() * enemy_damage.size()
+               * ingredient_power.size()
+               * std::max<std::size_t>(stages_per_enemy.size(), 1);
+    }
+
+    auto sweep_grid::knobs(std::size_t point, const balance_params& base) const
+            -> balance_knobs
+    {
+        const std::vector<std::int32_t> pace = paces(*this, base);
+
+        balance_knobs knobs;
+        knobs.stages_per_enemy = pace[point % pace.size()];
+        point /= pace.size();
+        knobs.ingredient_power
+                = ingredient_power[point % ingredient_power.size()];
+        point /= ingredient_power.size();
+        knobs.enemy_damage = enemy_damage[point % enemy_damage.size()];
+        point /= enemy_damage.size();
+        knobs.enemy_health = enemy_health.at(point);
+        return knobs;
+    }
+
+    auto sweep_result::finished() const -> bool
+    {
+        return resumed_units + played_units == units;
+    }
+
+    auto run_sweep(const balance_params& base, const sweep_grid& grid,
+                   const std::string& checkpoint_path,
+                   const sweep_options& options) -> sweep_result
+    {
+        if (grid.size() == 0) {
+            throw std::invalid_argument("the grid has a knob without values");
+        }
+        if (options.unit_runs == 0 || options.runs_per_point == 0) {
+            throw std::invalid_argument("the units have no runs");
+        }
+        check_knobs(grid, base);
+
+        const std::uint64_t units_per_point
+                = (options.runs_per_point + options.unit_runs - 1)
+                  / options.unit_runs;
+        sweep_result result;
+        result.units = grid.size() * units_per_point;
+
+        checkpoint::journal journal(checkpoint_path,
+                                    identify(base, grid, options),
+                                    result.units);
+        result.resumed_units = journal.records().size();
+
+        // The committed records, by unit
+        std::vector<std::optional<checkpoint::unit_record>> done(
+                static_cast<std::size_t>(result.units));
+        for (const checkpoint::unit_record& record: journal.records()) {
+            done[static_cast<std::size_t>(record.unit)] = record;
+        }
+
+        for (std::uint64_t unit = 0; unit < result.units; ++unit) {
+            if (done[static_cast<std::size_t>(unit)]) { continue; }
+            if (result.played_units == options.max_units) { break; }
+
+            // Every point plays the same seeds
+            const std::uint64_t point = unit / units_per_point;
+            const std::uint64_t skipped
+                    = unit % units_per_point * options.unit_runs;
+            const std::uint64_t count = std::min(
+                    options.unit_runs, options.runs_per_point - skipped);
+
+            const balance_params params
+                    = grid.knobs(static_cast<std::size_t>(point), base)
+                              .apply(base);
+            const scoped_balance scope(params);
+            const std::vector<run_summary> runs = simulate_batch(
+                    options.first_seed + skipped, count,
+                    options.thread_count, options.limits);
+
+            checkpoint::unit_record record{};
+            record.unit = unit;
+            record.first_seed = options.first_seed + skipped;
+            record.next_seed = record.first_seed + count;
+            for (const run_summary& run: runs) {
+                for (const battle_summary& battle: run.battles) {
+                    ++record.battles;
+                    if (battle.won) { ++record.wins; }
+                }
+                const double stage = run.stage_reached;
+                const double turns = run.turns;
+                record.stages += stage;
+                record.stage_squares += stage * stage;
+                record.turns += turns;
+                record.turn_squares += turns * turns;
+                record.gold += run.gold;
+                record.gold_squares += run.gold * run.gold;
+            }
+            journal.commit(record);
+            done[static_cast<std::size_t>(unit)] = record;
+            ++result.played_units;
+        }
+
+        // Units are added up in order, whichever order they finished in, so
+        // the sums come out the same
+        result.points.resize(grid.size());
+        for (std::size_t p = 0; p < result.points.size(); ++p) {
+            sweep_point& point = result.points[p];
+            point.knobs = grid.knobs(p, base);
+
+            checkpoint::unit_record sums{};
+            for (std::uint64_t part = 0; part < units_per_point; ++part) {
+                const auto& record
+                        = done[static_cast<std::size_t>(p * units_per_point
+                                                        + part)];
+                if (!record) { continue; }
+                point.runs += record->next_seed - record->first_seed;
+                sums.battles += record->battles;
+                sums.wins += record->wins;
+                sums.stages += record->stages;
+                sums.stage_squares += record->stage_squares;
+                sums.turns += record->turns;
+                sums.turn_squares += record->turn_squares;
+                sums.gold += record->gold;
+                sums.gold_squares += record->gold_squares;
+            }
+
+            point.battles = sums.battles;
+            point.wins = sums.wins;
+            point.stage_reached
+                    = mean_of(sums.stages, sums.stage_squares, point.runs);
+            point.turns = mean_of(sums.turns, sums.turn_squares, point.runs);
+            point.gold = mean_of(sums.gold, sums.gold_squares, point.runs);
+        }
+        return result;
+    }
+
+} // namespace potmaker
@@ -0,0 +1,115 @@
+#ifndef SWEEP_HH
+#define SWEEP_HH
+#include "balance.hh"
+#include "simulation.hh"
+#include "tuner.hh"
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace potmaker {
+
+    /**
+     * The balances a sweep measures: every combination of the values below,
+     * each applied to a base balance as balance_knobs
+     */
+    struct sweep_grid {
+        std::vector<double> enemy_health{1.0};
+        std::vector<double> enemy_damage{1.0};
+        std::vector<double> ingredient_power{1.0};
+        // Empty keeps the base balance's
+        std::vector<std::int32_t> stages_per_enemy;
+
+        /**
+         * @return How many points the grid has
+         */
+        [[nodiscard]] auto size() const -> std::size_t;
+
+        /**
+         * @param point A point of the grid, the last knob changing fastest
+         * @param base The balance the knobs apply to
+         * @return The point's knobs
+         */
+        [[nodiscard]] auto knobs(std::size_t point,
+                                 const balance_params& base) const
+                -> balance_knobs;
+    };
+
+    /**
+     * How a sweep plays its runs
+     */
+    struct sweep_options {
+        // Every point plays runs_per_point runs, seeded consecutively from
+        // first_seed, and those are cut into work units of unit_runs runs.
+        // A unit is the most a sweep cut short can lose
+        std::uint64_t first_seed = 1;
+        std::uint64_t runs_per_point = 2000;
+        std::uint64_t unit_runs = 500;
+        // Stop after playing this many units, leaving the rest to a later
+        // sweep with the same checkpoint
+        std::uint64_t max_units = std::numeric_limits<std::uint64_t>::max();
+        // How many threads play each unit's runs, or 0 for one per
+        // processor. The results do not depend on it
+        std::size_t thread_count = 0;
+        simulation_limits limits;
+    };
+
+    /**
+     * What a sweep measured at one point of its grid
+     */
+    struct sweep_point {
+        balance_knobs knobs;
+        // The runs of the point's finished units, and the battles they
+        // fought and won
+        std::uint64_t runs = 0;
+        std::uint64_t battles = 0;
+        std::uint64_t wins = 0;
+        // Means per run
+        estimate stage_reached;
+        estimate turns;
+        estimate gold;
+    };
+
+    /**
+     * What a sweep has measured so far
+     */
+    struct sweep_result {
+        // Every point of the grid, in order
+        std::vector<sweep_point> points;
+        std::uint64_t units = 0;
+        // The finished units: those found in the checkpoint, and those
+        // played since
+        std::uint64_t resumed_units = 0;
+        std::uint64_t played_units = 0;
+
+        /**
+         * @return Whether every unit is finished
+         */
+        [[nodiscard]] auto finished() const -> bool;
+    };
+
+    /**
+     * Simulates runs at every point of a balance grid, keeping a checkpoint
+     * of every finished unit of runs. A sweep started again with the same
+     * checkpoint, grid, base balance, content and options only plays the
+     * units that were not finished, and ends with the same results, to the
+     * bit, as a sweep that was never cut short
+     * @param base The balance the grid's knobs apply to
+     * @param grid The grid
+     * @param checkpoint_path The checkpoint, created if there is none
+     * @param options How to play the runs
+     * @return The results of every unit finished so far
+     * @throws std::invalid_argument If the grid has a knob without values
+     * or with a value that is not positive, or the units have no runs
+     * @throws std::runtime_error If the checkpoint could not be read or
+     * written, or belongs to another sweep
+     */
+    auto run_sweep(const balance_params& base, const sweep_grid& grid,
+                   const std::string& checkpoint_path,
+                   const sweep_options& options = {}) -> sweep_result;
+
+} // namespace potmaker
+
+#endif // SWEEP_HH
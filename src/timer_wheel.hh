@@ -0,0 +1,108 @@
+#ifndef TIMER_WHEEL_HH
+#define TIMER_WHEEL_HH
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+
+namespace potmaker {
+
+    /**
+     * A hashed timer wheel for a small, fixed set of timers, one per kind.
+     * Each slot holds a bit mask of the kinds that may be due on the ticks
+     * that land on it, so advancing only looks at the timers of one slot.
+     * Timers further away than the wheel's size wait for the wheel to come
+     * around again
+     * @tparam kind_count How many timers there are
+     * @tparam slot_count How many ticks one turn of the wheel covers
+     */
+    template<std::size_t kind_count, std::size_t slot_count = 64>
+    class timer_wheel {
+        static_assert(kind_count <= 32);
+        static_assert(std::has_single_bit(slot_count));
+
+    public:
+        using mask_type = std::uint32_t;
+
+        /**
+         * @return How many times the wheel has advanced
+         */
+        [[nodiscard]] auto now() const -> std::uint32_t { return now_; }
+
+        /**
+         * Sets a timer, replacing the one already set for the kind
+         * @param kind The kind of the timer
+         * @param at The tick on which it is due. Must be after now
+         */
+        auto schedule(const std::size_t kind, const std::uint32_t at) -> void
+        {
+            cancel(kind);
+            due_at_[kind] = at;
+            slots_[at % slot_count] |= bit(kind);
+            scheduled_ |= bit(kind);
+        }
+
+        /**
+         * Stops a timer, if it is set
+         * @param kind The kind of the timer
+         */
+        auto cancel(const std::size_t kind) -> void
+        {
+            if ((scheduled_ & bit(kind)) == 0) { return; }
+            slots_[due_at_[kind] % slot_count] &= ~bit(kind);
+            scheduled_ &= ~bit(kind);
+        }
+
+        /**
+         * Stops every timer
+         */
+        auto cancel_all() -> void
+        {
+            for (mask_type pending = scheduled_; pending != 0;
+                 pending &= pending - 1) {
+                const auto kind
+                        = static_cast<std::size_t>(std::countr_zero(pending));
+                slots_[due_at_[kind] % slot_count] = 0;
+            }
+            scheduled_ = 0;
+        }
+
+        /**
+         * Moves on to the next tick
+         * @return The kinds whose timers are due on it. They are no longer
+         * set
+         */
+        auto advance() -> mask_type
+        {
+            ++now_;
+            mask_type& slot = slots_[now_ % slot_count];
+
+            mask_type due = 0;
+            for (mask_type pending = slot; pending != 0;
+                 pending &= pending - 1) {
+                const auto kind
+                        = static_cast<std::size_t>(std::countr_zero(pending));
+                if (due_at_[kind] == now_) { due |= bit(kind); }
+            }
+
+            slot &= ~due;
+            scheduled_ &= ~due;
+            return due;
+        }
+
+    private:
+        [[nodiscard]] static constexpr auto bit(const std::size_t kind)
+                -> mask_type
+        {
+            return mask_type{1} << kind;
+        }
+
+        std::array<mask_type, slot_count> slots_{};
+        std::array<std::uint32_t, kind_count> due_at_{};
+        mask_type scheduled_ = 0;
+        std::uint32_t now_ = 0;
+    };
+
+} // namespace potmaker
+
+#endif // TIMER_WHEEL_HH
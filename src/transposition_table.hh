@@ -0,0 +1,151 @@
+#ifndef TRANSPOSITION_TABLE_HH
+#define TRANSPOSITION_TABLE_HH
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <type_traits>
+
+namespace potmaker {
+
+    /**
+     * A fixed-size table from state hashes to small values, which any
+     * number of threads may read and write at once without locking. Each
+     * entry stores its key xor'd with its value, so an entry torn by two
+     * threads writing it at once fails the key check and reads as a miss
+     * rather than as a mix of both values.
+     *
+     * Entries are grouped in buckets. A store replaces the entry with the
+     * same key, or else an empty one, or else one picked by the key. The
+     * key zero is never found
+     * @tparam value_t A trivially copyable type of at most eight bytes
+     */
+    template<typename value_t>
+    class transposition_table {
+        static_assert(std::is_trivially_copyable_v<value_t>);
+        static_assert(sizeof(value_t) <= sizeof(std::uint64_t));
+
+    public:
+        static constexpr std::size_t bucket_size = 4;
+
+        /**
+         * Creates an empty table
+         * @param capacity How many entries the table holds at least. It is
+         * rounded up to a whole number of buckets, a power of two of them
+         */
+        explicit transposition_table(const std::size_t capacity)
+            : bucket_mask_(std::bit_ceil(std::max<std::size_t>(
+                                   (capacity + bucket_size - 1) / bucket_size,
+                                   1))
+                           - 1),
+              entries_(std::make_unique<entry[]>(this->capacity()))
+        {}
+
+        /**
+         * Looks a state up
+         * @param key The state's hash
+         * @return The value stored for it, if it is still in the table
+         */
+        [[nodiscard]] auto find(const std::uint64_t key) const
+                -> std::optional<value_t>
+        {
+            if (key == 0) { return std::nullopt; }
+
+            const entry* bucket = bucket_of(key);
+            for (std::size_t i = 0; i < bucket_size; ++i) {
+                const std::uint64_t data
+                        = bucket[i].data.load(std::memory_order_relaxed);
+                const std::uint64_t check
+                        = bucket[i].check.load(std::memory_order_relaxed);
+                if ((check ^ data) == key) { return decode(data); }
+            }
+            return std::nullopt;
+        }
+
+        /**
+         * Stores a value for a state, replacing the one already stored
+         * @param key The state's hash
+         * @param value The value
+         */
+        auto store(const std::uint64_t key, const value_t value) -> void
+        {
+            if (key == 0) { return; }
+
+            entry* bucket = bucket_of(key);
+            entry* target = &bucket[key >> 62 & (bucket_size - 1)];
+            bool found_empty = false;
+            for (std::size_t i = 0; i < bucket_size; ++i) {
+                const std::uint64_t data
+                        = bucket[i].data.load(std::memory_order_relaxed);
+                const std::uint64_t check
+                        = bucket[i].check.load(std::memory_order_relaxed);
+                if ((check ^ data) == key) {
+                    target = &bucket[i];
+                    break;
+                }
+                if (!found_empty && check == 0 && data == 0) {
+                    target = &bucket[i];
+                    found_empty = true;
+                }
+            }
+
+            const std::uint64_t data = encode(value);
+            target->data.store(data, std::memory_order_relaxed);
+            target->check.store(key ^ data, std::memory_order_relaxed);
+        }
+
+        /**
+         * Empties the table. Must not run alongside other calls
+         */
+        auto clear() -> void
+        {
+            for (std::size_t i = 0; i < capacity(); ++i) {
+                entries_[i].data.store(0, std::memory_order_relaxed);
+                entries_[i].check.store(0, std::memory_order_relaxed);
+            }
+        }
+
+        /**
+         * @return How many entries the table holds
+         */
+        [[nodiscard]] auto capacity() const -> std::size_t
+        {
+            return (bucket_mask_ + 1) * bucket_size;
+        }
+
+    private:
+        struct entry {
+            std::atomic<std::uint64_t> check{0};
+            std::atomic<std::uint64_t> data{0};
+        };
+
+        [[nodiscard]] static auto encode(const value_t value) -> std::uint64_t
+        {
+            std::uint64_t data = 0;
+            std::memcpy(&data, &value, sizeof(value_t));
+            return data;
+        }
+
+        [[nodiscard]] static auto decode(const std::uint64_t data) -> value_t
+        {
+            value_t value;
+            std::memcpy(&value, &data, sizeof(value_t));
+            return value;
+        }
+
+        [[nodiscard]] auto bucket_of(const std::uint64_t key) const -> entry*
+        {
+            return &entries_[(key & bucket_mask_) * bucket_size];
+        }
+
+        std::size_t bucket_mask_;
+        std::unique_ptr<entry[]> entries_;
+    };
+
+} // namespace potmaker
+
+#endif // TRANSPOSITION_TABLE_HH
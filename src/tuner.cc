@@ -0,0 +1,305 @@
+#include "tuner.hh"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace potmaker {
+
+    namespace {
+
+        // Knobs stay within these factors of the base balance, which keeps
+        // enemy stats within their 16 bits
+        constexpr double min_scale = 0.25;
+        constexpr double max_scale = 4.0;
+
+        /**
+         * How many battles a batch of runs fought and won on each stage
+         */
+        struct stage_counts {
+            std::vector<std::uint64_t> battles;
+            std::vector<std::uint64_t> wins;
+        };
+
+        /**
+         * A balance being measured, with every batch it has played so far
+         */
+        struct candidate {
+            balance_knobs knobs;
+            balance_params params;
+            std::vector<stage_counts> batches;
+            std::vector<double> losses;
+        };
+
+        enum class verdict { better, worse, tied };
+
+        /**
+         * The loss of a batch: the sum over stages of the battles fought
+         * times the squared distance between the win rate and the target,
+         * per run. A rate measured over n battles is off by p(1 - p) / n
+         * squared on average, so each term takes off that much as estimated
+         * from the batch. Otherwise the noisier of two rates would look
+         * further from the target
+         */
+        auto batch_loss(const stage_counts& counts,
+                        const std::vector<double>& target,
+                        const std::uint64_t runs) -> double
+        {
+            double loss = 0.0;
+            for (std::size_t s = 0; s < target.size(); ++s) {
+                const auto n = static_cast<double>(counts.battles[s]);
+                if (n == 0) { continue; }
+                const double rate = static_cast<double>(counts.wins[s]) / n;
+                double term = (rate - target[s]) * (rate - target[s]);
+                if (n > 1) { term -= rate * (1.0 - rate) / (n - 1); }
+                loss += n * term;
+            }
+            return loss / static_cast<double>(runs);
+        }
+
+        class search {
+        public:
+            search(const balance_params& base,
+                   const std::vector<double>& target,
+                   const tuning_options& options)
+                : base_(base), target_(target), options_(options)
+            {}
+
+            auto make(const balance_knobs& knobs) const -> candidate
+            {
+                return {knobs, knobs.apply(base_), {}, {}};
+            }
+
+            /**
+             * @return The loss of a candidate's batch, played if it was not
+             * yet
+             */
+            auto loss(candidate& c, const std::size_t batch) -> double
+            {
+                while (c.batches.size() <= batch) {
+                    const std::uint64_t first_seed
+                            = options_.first_seed
+                              + c.batches.size() * options_.batch_runs;
+                    c.batches.push_back(play(c.params, first_seed));
+                    c.losses.push_back(batch_loss(c.batches.back(), target_,
+                                                  options_.batch_runs));
+                }
+                return c.losses[batch];
+            }
+
+            /**
+             * Plays batches of both candidates until the sequential test
+             * decides which is closer to the target, or gives up
+             */
+            auto compare(candidate& challenger, candidate& incumbent)
+                    -> verdict
+            {
+                ++comparisons_;
+
+                double sum = 0.0;
+                double sum_squares = 0.0;
+                for (std::uint32_t k = 0; k < options_.max_batches; ++k) {
+                    const double d = loss(challenger, k) - loss(incumbent, k);
+                    sum += d;
+                    sum_squares += d * d;
+
+                    const double n = k + 1;
+                    if (n < options_.min_batches) { continue; }
+                    const double mean = sum / n;
+                    const double variance
+                            = std::max(0.0, (sum_squares - n * mean * mean)
+                                                    / std::max(n - 1, 1.0));
+                    const double error
+                            = options_.confidence * std::sqrt(variance / n);
+                    if (mean + error < 0) { return verdict::better; }
+                    if (mean - error > 0) { return verdict::worse; }
+                }
+                return verdict::tied;
+            }
+
+            [[nodiscard]] auto comparisons() const -> std::uint32_t
+            {
+                return comparisons_;
+            }
+
+            [[nodiscard]] auto runs() const -> std::uint64_t
+            {
+                return runs_;
+            }
+
+        private:
+            auto play(const balance_params& params,
+                      const std::uint64_t first_seed) -> stage_counts
+            {
+                const scoped_balance scope(params);
+                const std::vector<run_summary> runs = simulate_batch(
+                        first_seed, options_.batch_runs,
+                        options_.thread_count,
+                        {static_cast<std::int32_t>(target_.size()),
+                         options_.max_turns},
+                        false, options_.reduction);
+                runs_ += runs.size();
+
+                stage_counts counts{
+                        std::vector<std::uint64_t>(target_.size()),
+                        std::vector<std::uint64_t>(target_.size())};
+                for (const run_summary& run: runs) {
+                    for (const battle_summary& battle: run.battles) {
+                        const auto s
+                                = static_cast<std::size_t>(battle.stage - 1);
+                        if (s >= target_.size()) { continue; }
+                        ++counts.battles[s];
+                        if (battle.won) { ++counts.wins[s]; }
+                    }
+                }
+                return counts;
+            }
+
+            const balance_params& base_;
+            const std::vector<double>& target_;
+            const tuning_options& options_;
+            std::uint32_t comparisons_ = 0;
+            std::uint64_t runs_ = 0;
+        };
+
+        /**
+         * @return The knobs one move away from some knobs, in the order
+         * they are tried
+         */
+        auto neighbours(const balance_knobs& knobs, const double step)
+                -> std::vector<balance_knobs>
+        {
+            const auto scaled = [](const double knob, const double factor) {
+                return std::clamp(knob * factor, min_scale, max_scale);
+            };
+
+            std::vector<balance_knobs> moves;
+            for (const double factor: {1.0 + step, 1.0 / (1.0 + step)}) {
+                balance_knobs health = knobs;
+                health.enemy_health = scaled(knobs.enemy_health, factor);
+                moves.push_back(health);
+
+                balance_knobs damage = knobs;
+                damage.enemy_damage = scaled(knobs.enemy_damage, factor);
+                moves.push_back(damage);
+
+                balance_knobs power = knobs;
+                power.ingredient_power = scaled(knobs.ingredient_power,
+                                                factor);
+                moves.push_back(power);
+            }
+            for (const std::int32_t change: {1, -1}) {
+                balance_knobs pace = knobs;
+                pace.stages_per_enemy
+                        = std::max(1, knobs.stages_per_enemy + change);
+                moves.push_back(pace);
+            }
+
+            std::erase(moves, knobs);
+            return moves;
+        }
+
+        auto scale_stat(const std::int32_t stat, const double factor)
+                -> std::int32_t
+        {
+            return static_cast<std::int32_t>(
+                    std::lround(static_cast<double>(stat) * factor));
+        }
+
+    } // namespace
+
+    auto balance_knobs::apply(const balance_params& base) const
+            -> balance_params
+    {
+        balance_params params = base;
+        params.stages_per_enemy = stages_per_enemy;
+
+        for (enemy_stat_formula& stats: params.enemy_stats) {
+            stats.base_health = scale_stat(stats.base_health, enemy_health);
+            stats.health_per_level
+                    = scale_stat(stats.health_per_level, enemy_health);
+            stats.damage_variance_min
+                    = to_double(stats.damage_variance_min) * enemy_damage;
+            stats.damage_variance_max
+                    = to_double(stats.damage_variance_max) * enemy_damage;
+        }
+
+        for (double* power:
+             {&params.fire_damage, &params.chill_damage, &params.poison_damage,
+              &params.wither_damage, &params.heal_amount, &params.regen_heal,
+              &params.protect_fraction, &params.cleanse_heal,
+              &params.joker_heal, &params.joker_damage}) {
+            *power *= ingredient_power;
+        }
+
+        return params;
+    }
+
+    auto tune_balance(const balance_params& base,
+                      const std::vector<double>& target,
+                      const tuning_options& options) -> tuning_result
+    {
+        if (target.empty()) {
+            throw std::invalid_argument("the target has no stages");
+        }
+        for (const double rate: target) {
+            if (!(rate >= 0.0 && rate <= 1.0)) {
+                throw std::invalid_argument(
+                        "target win rates must be within [0, 1]");
+            }
+        }
+
+        search tuner(base, target, options);
+        balance_knobs start;
+        start.stages_per_enemy = base.stages_per_enemy;
+        candidate best = tuner.make(start);
+
+        std::uint32_t moves = 0;
+        double step = options.step;
+        while (step >= options.min_step && moves < options.max_moves) {
+            bool moved = false;
+            for (const balance_knobs& knobs: neighbours(best.knobs, step)) {
+                candidate challenger = tuner.make(knobs);
+                if (tuner.compare(challenger, best) == verdict::better) {
+                    best = std::move(challenger);
+                    ++moves;
+                    moved = true;
+                    break;
+                }
+            }
+            if (!moved) { step /= 2; }
+        }
+
+        // Make sure the result is measured over at least the minimum
+        tuner.loss(best, std::max(options.min_batches, 1U) - 1);
+
+        tuning_result result;
+        result.knobs = best.knobs;
+        result.params = best.params;
+        result.win_rates.resize(target.size());
+        result.battles.resize(target.size());
+        std::vector<std::uint64_t> wins(target.size());
+        for (const stage_counts& batch: best.batches) {
+            for (std::size_t s = 0; s < target.size(); ++s) {
+                result.battles[s] += batch.battles[s];
+                wins[s] += batch.wins[s];
+            }
+        }
+        for (std::size_t s = 0; s < target.size(); ++s) {
+            if (result.battles[s] != 0) {
+                result.win_rates[s] = static_cast<double>(wins[s])
+                                      / static_cast<double>(result.battles[s]);
+            }
+        }
+        for (const double loss: best.losses) { result.loss += loss; }
+        result.loss /= static_cast<double>(best.losses.size());
+        result.comparisons = tuner.comparisons();
+        result.moves = moves;
+        result.runs = tuner.runs();
+        return result;
+    }
+
+} // namespace potmaker
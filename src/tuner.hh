@@ -0,0 +1,103 @@
+#ifndef TUNER_HH
+#define TUNER_HH
+#include "balance.hh"
+#include "simulation.hh"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace potmaker {
+
+    /**
+     * The knobs tune_balance turns. Each one scales part of a base balance
+     */
+    struct balance_knobs {
+        // Multiplies every enemy type's base health and health per level
+        double enemy_health = 1.0;
+        // Multiplies every enemy type's damage
+        double enemy_damage = 1.0;
+        // Multiplies what every ingredient does right away
+        double ingredient_power = 1.0;
+        std::int32_t stages_per_enemy = 2;
+
+        /**
+         * @param base The balance to scale
+         * @return The base balance with the knobs applied. Knobs of 1 and
+         * the base's stages_per_enemy give the base balance back
+         */
+        [[nodiscard]] auto apply(const balance_params& base) const
+                -> balance_params;
+
+        auto operator==(const balance_knobs&) const -> bool = default;
+    };
+
+    /**
+     * How tune_balance measures and searches
+     */
+    struct tuning_options {
+        // Candidates are measured on batches of runs with consecutive seeds
+        // from first_seed. Every candidate plays the same seeds, so the
+        // difference between two of them is mostly their balance's
+        std::uint64_t first_seed = 1;
+        std::uint64_t batch_runs = 200;
+        // Comparing two candidates plays batches until one is better by
+        // confidence standard errors, with at least min_batches and at most
+        // max_batches. A comparison without a winner keeps the current
+        // balance
+        std::uint32_t min_batches = 3;
+        std::uint32_t max_batches = 30;
+        double confidence = 3.0;
+        // The knobs move by a factor of 1 + step. The step is halved each
+        // time no move improves, and the search ends once it is below
+        // min_step or after max_moves moves
+        double step = 0.25;
+        double min_step = 0.02;
+        std::uint32_t max_moves = 50;
+        // How the runs are drawn. Common random numbers keep the runs of
+        // two candidates in step, so comparisons settle sooner
+        variance_reduction reduction{.common_random_numbers = true};
+        // How many threads play the runs, or 0 for one per processor
+        std::size_t thread_count = 0;
+        // Battles that last longer than this count as lost
+        std::uint32_t max_turns = 200;
+    };
+
+    /**
+     * The balance tune_balance settled on
+     */
+    struct tuning_result {
+        balance_knobs knobs;
+        balance_params params;
+        // The balance's win rate on each stage of the target, and how many
+        // battles it was measured over
+        std::vector<double> win_rates;
+        std::vector<std::uint64_t> battles;
+        // The battle-weighted squared distance from the target, per run
+        double loss = 0.0;
+        // How many comparisons and moves were made, and runs played
+        std::uint32_t comparisons = 0;
+        std::uint32_t moves = 0;
+        std::uint64_t runs = 0;
+    };
+
+    /**
+     * Searches for the balance whose chance of winning each stage's battle
+     * is closest to a target. Runs are simulated as simulate_run plays
+     * them, and the search is a pattern search: each knob in turn is moved
+     * up and down, and a move is kept once a sequential test shows it
+     * closer to the target than the current balance
+     * @param base The balance to start from and scale
+     * @param target The wanted win rate of the battle on each stage, from
+     * the first. Runs stop after the last of them
+     * @param options How to measure and search
+     * @return The tuned balance
+     * @throws std::invalid_argument If the target is empty or has a rate
+     * outside [0, 1]
+     */
+    auto tune_balance(const balance_params& base,
+                      const std::vector<double>& target,
+                      const tuning_options& options = {}) -> tuning_result;
+
+} // namespace potmaker
+
+#endif // TUNER_HH
@@ -1,6 +1,15 @@
 #include "util.hh"
+#include "counter_rng.hh"
+#include "random_buffer.hh"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
 #include <iostream>
+#include <numeric>
 #include <random>
+#include <span>
+#include <stdexcept>
 #include <string>
 #include <utility>
 
@@ -8,48 +17,268 @@ namespace potmaker {
 
     named::named(std::string name): name_(std::move(name)) {}
 
-    auto named::name() const -> std::string
+    auto named::name() const -> const std::string&
     {
         return name_;
     }
 
-    // Ideally, there would be a separate handler for these in class form
-    // to avoid re-opening the random device.
-    auto random_int(const int min, const int max) -> int
+    namespace {
+
+        thread_local counter_stream* active_stream = nullptr;
+        thread_local bool quiet = false;
+        thread_local bool antithetic = false;
+        thread_local scoped_importance_sampling* sampler = nullptr;
+
+        /**
+         * The active stream, drawn from through the importance sampler
+         */
+        class sampled_stream {
+        public:
+            auto next() -> std::uint64_t
+            {
+                return sampler->next(*active_stream);
+            }
+
+            auto int_in(const int min, const int max) -> int
+            {
+                return detail::int_in(*this, min, max);
+            }
+
+            auto double_in(const double min, const double max) -> double
+            {
+                return min + (max - min) * detail::to_unit_double(next());
+            }
+        };
+
+    } // namespace
+
+    scoped_random_stream::scoped_random_stream(counter_stream& stream)
+        : previous_(active_stream)
+    {
+        active_stream = &stream;
+    }
+
+    scoped_random_stream::~scoped_random_stream()
     {
-        std::random_device rd;
-        std::mt19937 gen(rd());
-        std::uniform_int_distribution dis(min, max);
+        active_stream = previous_;
+    }
 
-        return dis(gen);
+    scoped_quiet_output::scoped_quiet_output(): previous_(quiet)
+    {
+        quiet = true;
     }
 
-    auto random_double(const double min, const double max) -> double
+    scoped_quiet_output::~scoped_quiet_output()
+    {
+        quiet = previous_;
+    }
+
+    auto output_quiet() -> bool
+    {
+        return quiet;
+    }
+
+    scoped_antithetic_draws::scoped_antithetic_draws(): previous_(antithetic)
+    {
+        antithetic = true;
+    }
+
+    scoped_antithetic_draws::~scoped_antithetic_draws()
+    {
+        antithetic = previous_;
+    }
+
+    auto antithetic_draws() -> bool
+    {
+        return antithetic;
+    }
+
+    scoped_importance_sampling::scoped_importance_sampling(
+            const importance_bias& bias)
+        : bias_(bias), previous_(sampler)
+    {
+        // The density of a tilt is tilt * exp(-tilt * u) / (1 - exp(-tilt))
+        for (std::size_t side = 0; side < bias_.tilts.size(); ++side) {
+            const double tilt = bias_.tilts[side];
+            if (tilt != 0.0) {
+                log_scales_[side] = std::log(tilt / -std::expm1(-tilt));
+            }
+        }
+        sampler = this;
+    }
+
+    scoped_importance_sampling::~scoped_importance_sampling()
+    {
+        sampler = previous_;
+    }
+
+    auto scoped_importance_sampling::enemy_type(const int drawn,
+                                                const int type_count) -> int
+    {
+        const std::vector<double>& weights = bias_.enemy_weights;
+        if (weights.empty()) { return drawn; }
+        if (weights.size() != static_cast<std::size_t>(type_count)) {
+            throw std::invalid_argument(
+                    "the bias needs a weight per enemy type");
+        }
+
+        const double total = std::accumulate(weights.begin(), weights.end(),
+                                             0.0);
+        if (std::ranges::any_of(weights, [](const double w) { return w < 0; })
+            || !(total > 0.0)) {
+            throw std::invalid_argument("the bias's weights are not valid");
+        }
+        // Even weights are the plain draw, which keeps the run as it was
+        if (std::ranges::all_of(weights, [&](const double w) {
+                return w == weights.front();
+            })) {
+            return drawn;
+        }
+
+        double point = random_source().unit_double() * total;
+        int type = 0;
+        for (int t = 0; t < type_count; ++t) {
+            if (weights[t] <= 0.0) { continue; }
+            type = t;
+            if (point < weights[t]) { break; }
+            point -= weights[t];
+        }
+        // Plainly, every type is as likely as the others
+        log_weight_ += std::log(total / (weights[type] * type_count));
+        return type;
+    }
+
+    auto scoped_importance_sampling::next(counter_stream& stream)
+            -> std::uint64_t
+    {
+        const stream_key key = stream.key();
+        const std::uint64_t index = stream.draws();
+        std::uint64_t raw = stream.next();
+
+        // The battle's player draws from slot 0 and its enemies from theirs
+        const std::size_t side = key.slot == 0 ? 0 : 1;
+        const double tilt = bias_.tilts[side];
+        double u = detail::to_unit_double(raw);
+        if (tilt != 0.0) {
+            // Inverts the tilt's distribution function, keeping the bits
+            // below the double's precision as they were drawn
+            u = std::min(-std::log1p(u * std::expm1(-tilt)) / tilt,
+                         std::nextafter(1.0, 0.0));
+            raw = static_cast<std::uint64_t>(std::ldexp(u, 53)) << 11
+                  | (raw & 0x7FF);
+        }
+
+        std::uint64_t& weighed
+                = weighed_[{key.run, key.stage, key.turn, key.slot}];
+        if (index >= weighed) {
+            weighed = index + 1;
+            if (tilt != 0.0) { log_weight_ -= log_scales_[side] - tilt * u; }
+            ++draws_.counts[side];
+            draws_.positions[side] += u;
+        }
+        return raw;
+    }
+
+    auto scoped_importance_sampling::log_weight() const -> double
+    {
+        return log_weight_;
+    }
+
+    auto scoped_importance_sampling::draws() const -> const importance_draws&
+    {
+        return draws_;
+    }
+
+    auto importance_sampling() -> scoped_importance_sampling*
+    {
+        return sampler;
+    }
+
+    auto random_source() -> random_buffer&
+    {
+        // Per thread, so that runs simulated side by side do not share
+        thread_local random_buffer instance{std::random_device{}()};
+        return instance;
+    }
+
+    auto seed_random(const std::uint64_t seed) -> void
+    {
+        random_source().reseed(seed);
+    }
+
+    auto current_random_state() -> random_state
+    {
+        return random_source().state();
+    }
+
+    auto restore_random_state(const random_state& state) -> void
+    {
+        random_source().restore(state);
+    }
+
+    auto random_int(const int min, const int max) -> int
     {
-        std::random_device rd;
-        std::mt19937 gen(rd());
-        std::uniform_real_distribution dis(min, max);
+        if (active_stream != nullptr) {
+            return sampler != nullptr ? sampled_stream{}.int_in(min, max)
+                                      : active_stream->int_in(min, max);
+        }
+        return random_source().int_in(min, max);
+    }
 
-        return dis(gen);
+    auto random_double(const double min, const double max) -> double
+    {
+        double value = 0.0;
+        if (active_stream == nullptr) {
+            value = random_source().double_in(min, max);
+        }
+        else if (sampler != nullptr) {
+            value = sampled_stream{}.double_in(min, max);
+        }
+        else {
+            value = active_stream->double_in(min, max);
+        }
+        return antithetic ? min + max - value : value;
     }
 
     auto roll_chances(const int odds) -> bool
     {
-        return random_int(1, odds) == 1;
+        if (active_stream != nullptr) {
+            return sampler != nullptr ? sampled_stream{}.int_in(1, odds) == 1
+                                      : active_stream->roll(odds);
+        }
+        return random_source().roll(odds);
+    }
+
+    auto fill_random_ints(const std::span<int> out, const int min,
+                          const int max) -> void
+    {
+        if (active_stream != nullptr && sampler != nullptr) {
+            sampled_stream stream;
+            for (int& value: out) { value = stream.int_in(min, max); }
+            return;
+        }
+        if (active_stream != nullptr) {
+            active_stream->fill_ints(out, min, max);
+            return;
+        }
+        random_source().fill_ints(out, min, max);
     }
 
     auto print_action(const std::string& act) -> void
     {
+        if (quiet) { return; }
         std::cout << ">>> " << act << "\n";
     }
 
     auto print_divider(const std::string& act) -> void
     {
+        if (quiet) { return; }
         std::cout << "[=== " << act << " ===]\n\n";
     }
 
     auto print_special(const std::string& act) -> void
     {
+        if (quiet) { return; }
         std::cout << "-> " << act << "\n";
     }
 
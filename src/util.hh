@@ -1,6 +1,16 @@
 #ifndef UTIL_HH
 #define UTIL_HH
+#include "counter_rng.hh"
+#include "random_buffer.hh"
+#include <array>
+#include <cstdint>
+#include <format>
+#include <map>
+#include <span>
 #include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
 
 namespace potmaker {
 
@@ -15,12 +25,208 @@ namespace potmaker {
         /**
          * @return The name of the object
          */
-        [[nodiscard]] auto name() const -> std::string;
+        [[nodiscard]] auto name() const -> const std::string&;
 
     protected:
         std::string name_;
     };
 
+    /**
+     * Reseeds the game's random number generator. Each thread has its own
+     * generator, seeded from the system's random device on first use
+     * @param seed The seed
+     */
+    auto seed_random(std::uint64_t seed) -> void;
+
+    /**
+     * @return The calling thread's random number generator, for bulk draws
+     */
+    [[nodiscard]] auto random_source() -> random_buffer&;
+
+    /**
+     * @return A snapshot of the random number generator's state
+     */
+    [[nodiscard]] auto current_random_state() -> random_state;
+
+    /**
+     * Replaces the random number generator's state
+     * @param state A snapshot obtained through current_random_state
+     */
+    auto restore_random_state(const random_state& state) -> void;
+
+    /**
+     * Redirects random_int, random_double and roll_chances on the current
+     * thread to a counter-based stream for as long as it is alive. Scopes
+     * nest; the previous stream is restored on destruction
+     */
+    class scoped_random_stream {
+    public:
+        /**
+         * Starts drawing from a stream
+         * @param stream The stream to draw from. Must outlive the scope
+         */
+        explicit scoped_random_stream(counter_stream& stream);
+        ~scoped_random_stream();
+
+        scoped_random_stream(const scoped_random_stream&) = delete;
+        auto operator=(const scoped_random_stream&)
+                -> scoped_random_stream& = delete;
+
+    private:
+        counter_stream* previous_;
+    };
+
+    /**
+     * Silences the game's console output on the current thread for as long
+     * as it is alive, for battles played without a player watching. Scopes
+     * nest; the previous setting is restored on destruction
+     */
+    class scoped_quiet_output {
+    public:
+        scoped_quiet_output();
+        ~scoped_quiet_output();
+
+        scoped_quiet_output(const scoped_quiet_output&) = delete;
+        auto operator=(const scoped_quiet_output&)
+                -> scoped_quiet_output& = delete;
+
+    private:
+        bool previous_;
+    };
+
+    /**
+     * @return Whether console output is silenced on the current thread
+     */
+    [[nodiscard]] auto output_quiet() -> bool;
+
+    /**
+     * Makes random_double on the current thread return antithetic draws for
+     * as long as it is alive: a draw that would have landed a fraction u of
+     * the way through its range lands 1 - u of the way instead. A run
+     * replayed with the same seed under this scope makes the opposite
+     * draws, so averaging the two cancels much of their noise. Scopes nest;
+     * the previous setting is restored on destruction
+     */
+    class scoped_antithetic_draws {
+    public:
+        scoped_antithetic_draws();
+        ~scoped_antithetic_draws();
+
+        scoped_antithetic_draws(const scoped_antithetic_draws&) = delete;
+        auto operator=(const scoped_antithetic_draws&)
+                -> scoped_antithetic_draws& = delete;
+
+    private:
+        bool previous_;
+    };
+
+    /**
+     * @return Whether random_double draws are antithetic on the current
+     * thread
+     */
+    [[nodiscard]] auto antithetic_draws() -> bool;
+
+    /**
+     * How importance sampling biases the draws of a run towards the rare
+     * runs that are worth looking at
+     */
+    struct importance_bias {
+        // How likely each enemy type is to be drawn, relative to the
+        // others. Empty draws them evenly, as plain runs do
+        std::vector<double> enemy_weights;
+        // How the battle draws made for the player (first) and for the
+        // enemies (second) are tilted. Where a plain draw lands a fraction u
+        // of the way through its range evenly, a tilted one lands there
+        // with a density proportional to exp(-tilt * u). Positive tilts
+        // favor low draws, which land chances more often and roll low
+        // values, negative ones the opposite, and 0 draws plainly
+        std::array<double, 2> tilts{};
+    };
+
+    /**
+     * The distinct tilted draws of a run, for each side: how many there
+     * were and the sum of the fractions u they landed at
+     */
+    struct importance_draws {
+        std::array<std::uint64_t, 2> counts{};
+        std::array<double, 2> positions{};
+    };
+
+    /**
+     * Draws the enemies of create_random_enemies and every draw made from a
+     * battle stream on the current thread with a bias, for as long as it is
+     * alive, and keeps the likelihood ratio of everything drawn: how much
+     * likelier it was to be drawn plainly. Weighing what happens in a run
+     * by its ratio estimates what plain runs would do on average.
+     * A battle stream can be read more than once, and every draw is a pure
+     * function of its key and index, so each draw is weighed only the first
+     * time it is read. Scopes nest; the previous sampler is restored on
+     * destruction
+     */
+    class scoped_importance_sampling {
+    public:
+        /**
+         * Starts biasing draws
+         * @param bias The bias. Must outlive the scope
+         */
+        explicit scoped_importance_sampling(const importance_bias& bias);
+        ~scoped_importance_sampling();
+
+        scoped_importance_sampling(const scoped_importance_sampling&)
+                = delete;
+        auto operator=(const scoped_importance_sampling&)
+                -> scoped_importance_sampling& = delete;
+
+        /**
+         * Draws an enemy type with the bias's weights
+         * @param drawn The type drawn plainly, kept if the weights are
+         * empty or even
+         * @param type_count How many enemy types there are
+         * @return The type
+         * @throws std::invalid_argument If there are weights but not one
+         * per type, or a negative one, or no positive one
+         */
+        auto enemy_type(int drawn, int type_count) -> int;
+
+        /**
+         * Draws a raw value from a stream with the bias's tilt
+         * @param stream The stream
+         * @return The raw value
+         */
+        auto next(counter_stream& stream) -> std::uint64_t;
+
+        /**
+         * @return The log of the likelihood ratio of everything drawn so
+         * far
+         */
+        [[nodiscard]] auto log_weight() const -> double;
+
+        /**
+         * @return The distinct tilted draws so far
+         */
+        [[nodiscard]] auto draws() const -> const importance_draws&;
+
+    private:
+        const importance_bias& bias_;
+        // The log of each tilt's density normalization
+        std::array<double, 2> log_scales_{};
+        double log_weight_ = 0.0;
+        importance_draws draws_;
+        // How many draws of each stream have been weighed. Streams are read
+        // in order from their first draw, so those are always its first
+        std::map<std::tuple<std::uint64_t, std::uint32_t, std::uint32_t,
+                            std::uint32_t>,
+                 std::uint64_t>
+                weighed_;
+        scoped_importance_sampling* previous_;
+    };
+
+    /**
+     * @return The current thread's importance sampler, or nullptr if draws
+     * are not biased
+     */
+    [[nodiscard]] auto importance_sampling() -> scoped_importance_sampling*;
+
     /**
      * Generates a random int in the [min, max] range
      * @param min The min value
@@ -44,18 +250,55 @@ namespace potmaker {
      */
     [[nodiscard]] auto roll_chances(int odds) -> bool;
 
+    /**
+     * Generates many random ints in the [min, max] range at once, drawing the
+     * same values as that many random_int calls
+     * @param out The destination
+     * @param min The min value
+     * @param max The max value
+     */
+    auto fill_random_ints(std::span<int> out, int min, int max) -> void;
+
     /**
      * Prints text in action form
      * @param act THe text to print
      */
     auto print_action(const std::string& act) -> void;
 
+    /**
+     * Formats text and prints it in action form. Nothing is formatted while
+     * output is silenced, so simulated battles do not allocate messages
+     * @param format The format string
+     * @param args What to format
+     */
+    template<typename... args_t>
+    auto print_action(std::format_string<args_t...> format, args_t&&... args)
+            -> void
+    {
+        if (output_quiet()) { return; }
+        print_action(std::format(format, std::forward<args_t>(args)...));
+    }
+
     /**
      * Prints text within a divider
      * @param act The text to print
      */
     auto print_divider(const std::string& act) -> void;
 
+    /**
+     * Formats text and prints it within a divider, unless output is
+     * silenced
+     * @param format The format string
+     * @param args What to format
+     */
+    template<typename... args_t>
+    auto print_divider(std::format_string<args_t...> format, args_t&&... args)
+            -> void
+    {
+        if (output_quiet()) { return; }
+        print_divider(std::format(format, std::forward<args_t>(args)...));
+    }
+
     /**
      * Prints text within a special divider
      * @param act The text to print
@@ -0,0 +1,136 @@
+#include "balance.hh"
+#include "check.hh"
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+namespace potmaker {
+
+    namespace {
+
+        using test::check;
+
+        auto round_trip() -> void
+        {
+            balance_params params;
+            params.stages_per_enemy = 3;
+            params.fire_damage = 17.25;
+            params.protect_fraction = 0.125;
+            params.enemy_stats[4].base_health = 77;
+            params.enemy_stats[4].damage_variance_max = 1.5;
+
+            const balance_params read = balance_params::parse(
+                    params.to_string());
+            check(read.to_string() == params.to_string(),
+                  "to_string reads back to the same numbers");
+            check(read.fire_damage == 17.25 && read.stages_per_enemy == 3
+                          && read.enemy_stats[4].base_health == 77,
+                  "numbers survive the round trip");
+        }
+
+        auto partial_files_keep_defaults() -> void
+        {
+            const balance_params read = balance_params::parse(R"(
+# Harder fire, nothing else
+fire_damage 20   # per potency
+
+enemy 2 90 12 0.8 1.2 6 3 0.9 1.1
+)");
+            const balance_params defaults;
+            check(read.fire_damage == 20.0, "named number read");
+            check(read.chill_damage == defaults.chill_damage
+                          && read.stages_per_enemy
+                                     == defaults.stages_per_enemy,
+                  "other numbers keep their defaults");
+            check(read.enemy_stats[2].base_health == 90
+                          && read.enemy_stats[2].damage_level_divisor == 3,
+                  "enemy stats read");
+            check(read.enemy_stats[1].base_health
+                          == defaults.enemy_stats[1].base_health,
+                  "other enemies keep their stats");
+            check(balance_params::parse("").to_string()
+                          == defaults.to_string(),
+                  "an empty file is the default balance");
+        }
+
+        auto malformed_files_rejected() -> void
+        {
+            for (const std::string_view source: {
+                         "fire_damage",
+                         "fire_damage 1 2",
+                         "fire_damage lots",
+                         "fire_damage 1.5x",
+                         "ice_damage 3",
+                         "stages_per_enemy 0",
+                         "stages_per_enemy 1.5",
+                         "enemy 9 1 1 1 1 1 1 1 1",
+                         "enemy 0 1 1 1 1 1 1 1",
+                         "enemy 0 1 1 1 1 1 0 1 1",
+                         "enemy -1 1 1 1 1 1 1 1 1",
+                 }) {
+                test::check_throws<std::runtime_error>(
+                        [source] { (void) balance_params::parse(source); },
+                        std::string(source));
+            }
+        }
+
+        auto load_files() -> void
+        {
+            test::check_throws<std::runtime_error>(
+                    [] {
+                        (void) balance_params::load(
+                                test::temp_path("missing.balance"));
+                    },
+                    "missing file");
+
+            const std::string path = test::temp_path("test.balance");
+            {
+                std::ofstream file(path);
+                file << "joker_damage 40\nstages_per_enemy 4\n";
+            }
+            const balance_params read = balance_params::load(path);
+            check(read.joker_damage == 40.0 && read.stages_per_enemy == 4,
+                  "file read");
+            std::remove(path.c_str());
+        }
+
+        auto enemy_counts_and_scopes() -> void
+        {
+            balance_params params;
+            params.stages_per_enemy = 2;
+            check(params.enemy_count(1) == 1 && params.enemy_count(2) == 1
+                          && params.enemy_count(3) == 2
+                          && params.enemy_count(6) == 3,
+                  "an enemy more every two stages");
+
+            const balance_params& defaults = active_balance();
+            {
+                const scoped_balance outer(params);
+                check(&active_balance() == &params, "outer scope applies");
+                {
+                    const balance_params inner_params;
+                    const scoped_balance inner(inner_params);
+                    check(&active_balance() == &inner_params,
+                          "inner scope applies");
+                }
+                check(&active_balance() == &params,
+                      "the outer scope comes back");
+            }
+            check(&active_balance() == &defaults, "the defaults come back");
+        }
+
+    } // namespace
+
+} // namespace potmaker
+
+auto main() -> int
+{
+    potmaker::round_trip();
+    potmaker::partial_files_keep_defaults();
+    potmaker::malformed_files_rejected();
+    potmaker::load_files();
+    potmaker::enemy_counts_and_scopes();
+    return potmaker::test::report();
+}
@@ -0,0 +1,269 @@
+#include "battle_env.hh"
+#include "check.hh"
+#include "potionmaker_game.hh"
+#include "status_effect.hh"
+#include "util.hh"
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <numeric>
+#include <span>
+#include <stdexcept>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace potmaker {
+
+    namespace {
+
+        using test::check;
+
+        constexpr std::size_t header_size = 5;
+        constexpr std::size_t effect_size = 2;
+        constexpr std::size_t enemy_size = 5;
+        constexpr std::size_t effect_kinds
+                = std::variant_size_v<status_effect_variant>;
+
+        constexpr env_config config{2, 8, 3, 41};
+
+        constexpr auto enemies_at() -> std::size_t
+        {
+            return header_size + effect_kinds * effect_size;
+        }
+
+        constexpr auto inventory_at() -> std::size_t
+        {
+            return enemies_at() + config.max_enemies * enemy_size;
+        }
+
+        auto shape_and_errors() -> void
+        {
+            test::check_throws<std::invalid_argument>(
+                    [] { battle_env env({0, 4, 3, 0}); }, "no runs");
+            test::check_throws<std::invalid_argument>(
+                    [] { battle_env env({1, 4, 0, 0}); }, "no potency");
+
+            battle_env env(config);
+            const auto cells = static_cast<std::size_t>(
+                    ingredient_type_count() * config.max_potency);
+            check(env.size() == config.env_count, "one run per env");
+            check(env.observation_size() == inventory_at() + cells,
+                  "header, effects, enemies and inventory");
+
+            std::vector<float> short_rows(env.observation_size());
+            test::check_throws<std::invalid_argument>(
+                    [&] { env.reset(short_rows); }, "short observations");
+
+            std::vector<float> rows(env.size() * env.observation_size());
+            std::vector<env_action> actions(env.size());
+            std::vector<float> rewards(env.size());
+            std::vector<std::uint8_t> dones(env.size() + 1);
+            test::check_throws<std::invalid_argument>(
+                    [&] { env.step(actions, rows, rewards, dones); },
+                    "too many dones");
+        }
+
+        auto reset_observes_a_new_run() -> void
+        {
+            const scoped_quiet_output quiet;
+
+            // The first run's game, made the way the environment makes it
+            seed_random(config.seed);
+            game_state game("Agent");
+            const enemy_party enemies = game.begin_battle();
+            player& p = game.current_player();
+            std::size_t held = 0;
+            for (const auto& stack: p.stored_ingredients().stacks()) {
+                held += stack.units.size();
+            }
+
+            battle_env env(config);
+            const std::size_t width = env.observation_size();
+            std::vector<float> rows(env.size() * width);
+            seed_random(config.seed);
+            env.reset(rows);
+            const std::span<const float> row(rows.data(), width);
+
+            check(row[0] == 1.0f && row[1] == 0.0f, "stage 1, turn 0");
+            check(row[2] == static_cast<float>(to_double(p.health()))
+                          && row[3]
+                                     == static_cast<float>(
+                                             to_double(p.max_health()))
+                          && row[4]
+                                     == static_cast<float>(
+                                             to_double(p.gold())),
+                  "player health and gold");
+            for (std::size_t k = 0; k < effect_kinds * effect_size; ++k) {
+                check(row[header_size + k] == 0.0f, "no effects yet");
+            }
+
+            for (std::size_t i = 0; i < config.max_enemies; ++i) {
+                const float* cell = &row[enemies_at() + i * enemy_size];
+                if (i >= enemies.size()) {
+                    check(cell[0] == 0.0f && cell[1] == 0.0f,
+                          std::format("place {} is empty", i));
+                    continue;
+                }
+                const enemy& e = *enemies[i];
+                check(cell[0] == 1.0f
+                              && cell[1]
+                                         == static_cast<float>(
+                                                 to_double(e.health()))
+                              && cell[2]
+                                         == static_cast<float>(
+                                                 to_double(e.max_health()))
+                              && cell[3] == static_cast<float>(e.level())
+                              && cell[4] == static_cast<float>(e.element()),
+                      std::format("place {} describes its enemy", i));
+            }
+
+            const float counted = std::accumulate(
+                    row.begin() + static_cast<std::ptrdiff_t>(inventory_at()),
+                    row.end(), 0.0f);
+            check(counted == static_cast<float>(held),
+                  "the histogram counts every ingredient held");
+        }
+
+        /**
+         * @return The health of a row's observed living enemies, and how
+         * many there are
+         */
+        auto enemy_health(const std::span<const float> row)
+                -> std::pair<float, int>
+        {
+            float health = 0.0f;
+            int living = 0;
+            for (std::size_t i = 0; i < config.max_enemies; ++i) {
+                const float* cell = &row[enemies_at() + i * enemy_size];
+                if (cell[0] == 1.0f) {
+                    health += cell[1];
+                    ++living;
+                }
+            }
+            return {health, living};
+        }
+
+        auto steps_in_lockstep() -> void
+        {
+            battle_env env(config);
+            const std::size_t width = env.observation_size();
+            std::vector<float> rows(env.size() * width);
+            std::vector<float> rewards(env.size());
+            std::vector<std::uint8_t> dones(env.size());
+            env.reset(rows);
+
+            // The first run attacks, the second gives up
+            std::vector<env_action> actions(env.size());
+            actions[0].type = static_cast<std::int32_t>(
+                    battle_action::kind::basic_attack);
+            actions[1].type = static_cast<std::int32_t>(
+                    battle_action::kind::surrender);
+
+            int won = 0;
+            int lost = 0;
+            int rewarded = 0;
+            for (int step = 0; step < 2000; ++step) {
+                const std::vector<float> before(rows.begin(),
+                                                rows.begin() + width);
+                env.step(actions, rows, rewards, dones);
+
+                check(dones[1] == 1 && rewards[1] == -1.0f,
+                      "surrendering ends the run at a loss");
+                check(rows[width] == 1.0f && rows[width + 1] == 0.0f,
+                      "the observation after an end is the next run's");
+
+                const std::span<const float> row(rows.data(), width);
+                if (dones[0] == 1) {
+                    ++lost;
+                    check(row[0] == 1.0f && row[1] == 0.0f,
+                          "a lost run starts over");
+                    continue;
+                }
+                if (row[0] == before[0] + 1.0f) {
+                    ++won;
+                    check(row[1] == 0.0f,
+                          "a won battle starts the next stage");
+                    continue;
+                }
+                check(row[0] == before[0] && row[1] == before[1] + 1.0f,
+                      "an ongoing battle counts its turns");
+
+                // While nobody dies, the reward is the health taken from
+                // the enemies minus the player's, in hundreds
+                const auto [health_before, living_before]
+                        = enemy_health(before);
+                const auto [health_after, living_after] = enemy_health(row);
+                if (living_before == living_after) {
+                    const float expected
+                            = ((health_before - health_after)
+                               - (before[2] - row[2]))
+                              / 100.0f;
+                    check(std::abs(rewards[0] - expected) < 1e-3f,
+                          std::format("step {}: reward {} for {}", step,
+                                      rewards[0], expected));
+                    ++rewarded;
+                }
+            }
+            check(won > 0 && lost > 0 && rewarded > 0,
+                  "attacking wins battles, loses runs and deals damage");
+        }
+
+        auto potions_use_the_picked_cell() -> void
+        {
+            battle_env env({1, 8, 3, 43});
+            const std::size_t width = env.observation_size();
+            std::vector<float> rows(width);
+            std::vector<float> rewards(1);
+            std::vector<std::uint8_t> dones(1);
+            env.reset(rows);
+            const auto first_held = [&] {
+                std::size_t cell = inventory_at();
+                while (cell < width && rows[cell] == 0.0f) { ++cell; }
+                return cell;
+            };
+
+            // Runs start empty-handed and shop after each battle won
+            env_action attack;
+            attack.type = static_cast<std::int32_t>(
+                    battle_action::kind::basic_attack);
+            for (int step = 0; step < 500 && first_held() == width; ++step) {
+                env.step({&attack, 1}, rows, rewards, dones);
+            }
+            const std::size_t cell = first_held();
+            check(cell < width, "a run that won a battle holds ingredients");
+            if (cell == width) { return; }
+
+            int thrown = 0;
+            for (int step = 0; step < 20 && rows[cell] > 0.0f; ++step) {
+                env_action action;
+                action.type = static_cast<std::int32_t>(
+                        battle_action::kind::potion);
+                action.ingredients[0]
+                        = static_cast<std::int32_t>(cell - inventory_at());
+                const float stage = rows[0];
+                const float before = rows[cell];
+                env.step({&action, 1}, rows, rewards, dones);
+                // Winning shops for more, so only count ongoing battles
+                if (dones[0] == 0 && rows[0] == stage) {
+                    check(rows[cell] == before - 1.0f,
+                          "throwing takes one ingredient from the cell");
+                    ++thrown;
+                }
+            }
+            check(thrown > 0, "potions were thrown");
+        }
+
+    } // namespace
+
+} // namespace potmaker
+
+auto main() -> int
+{
+    potmaker::shape_and_errors();
+    potmaker::reset_observes_a_new_run();
+    potmaker::steps_in_lockstep();
+    potmaker::potions_use_the_picked_cell();
+    return potmaker::test::report();
+}
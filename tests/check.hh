@@ -0,0 +1,84 @@
+#ifndef CHECK_HH
+#define CHECK_HH
+#include <filesystem>
+#include <format>
+#include <iostream>
+#include <source_location>
+#include <string>
+#include <string_view>
+#include <unistd.h>
+
+namespace potmaker::test {
+
+    /*
+     * Every test is a small program that makes its checks one after the
+     * other and fails, for CTest, if any of them did.
+     * A failed check prints where it is and carries on, so one run shows
+     * everything that is wrong
+     */
+
+    inline int failures = 0;
+
+    /**
+     * Checks a condition
+     * @param ok The condition
+     * @param what What was expected, printed if it does not hold
+     * @param where Where the check is made
+     */
+    inline auto check(const bool ok, const std::string_view what,
+                      const std::source_location where
+                      = std::source_location::current()) -> void
+    {
+        if (ok) { return; }
+        ++failures;
+        std::cerr << std::format("{}:{}: failed: {}\n", where.file_name(),
+                                 where.line(), what);
+    }
+
+    /**
+     * Checks that calling a function throws an exception of a type
+     * @tparam exception_t The exception's type
+     * @param call The function
+     * @param what What was expected, printed if it does not throw
+     * @param where Where the check is made
+     */
+    template<typename exception_t, typename call_t>
+    auto check_throws(const call_t& call, const std::string_view what,
+                      const std::source_location where
+                      = std::source_location::current()) -> void
+    {
+        bool thrown = false;
+        try {
+            call();
+        }
+        catch (const exception_t&) {
+            thrown = true;
+        }
+        check(thrown, what, where);
+    }
+
+    /**
+     * @param name What the file is for
+     * @return A path in the temporary directory no other test process uses
+     */
+    inline auto temp_path(const std::string_view name) -> std::string
+    {
+        return (std::filesystem::temp_directory_path()
+                / std::format("potmk_{}_{}", ::getpid(), name))
+                .string();
+    }
+
+    /**
+     * @return The exit status for the checks made so far
+     */
+    inline auto report() -> int
+    {
+        if (failures != 0) {
+            std::cerr << std::format("{} check(s) failed\n", failures);
+        }
+        return failures == 0 ? 0 : 1;
+    }
+
+} // namespace potmaker::test
+
+#endif // CHECK_HH
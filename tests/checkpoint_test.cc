@@ -0,0 +1,114 @@
+#include "check.hh"
+#include "checkpoint.hh"
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+namespace potmaker {
+
+    namespace {
+
+        using test::check;
+
+        constexpr std::uint64_t sweep = 0x5eed;
+        constexpr std::uint64_t unit_count = 10;
+
+        auto record_for(const std::uint64_t unit) -> checkpoint::unit_record
+        {
+            checkpoint::unit_record record{};
+            record.unit = unit;
+            record.first_seed = 1 + unit * 50;
+            record.next_seed = 1 + (unit + 1) * 50;
+            record.battles = 100 + unit;
+            record.wins = 60 + unit;
+            record.stages = 4.5 * static_cast<double>(unit);
+            record.turns = 17.25;
+            record.gold = 300.0;
+            return record;
+        }
+
+        auto same(const checkpoint::unit_record& a,
+                  const checkpoint::unit_record& b) -> bool
+        {
+            return a.unit == b.unit && a.first_seed == b.first_seed
+                   && a.next_seed == b.next_seed && a.battles == b.battles
+                   && a.wins == b.wins && a.stages == b.stages
+                   && a.turns == b.turns && a.gold == b.gold;
+        }
+
+        auto round_trip(const std::string& path) -> void
+        {
+            {
+                checkpoint::journal journal(path, sweep, unit_count);
+                check(journal.records().empty(), "new checkpoint");
+                for (const std::uint64_t unit: {3, 0, 7}) {
+                    journal.commit(record_for(unit));
+                }
+                test::check_throws<std::invalid_argument>(
+                        [&] { journal.commit(record_for(0)); },
+                        "unit committed twice");
+                test::check_throws<std::invalid_argument>(
+                        [&] { journal.commit(record_for(unit_count)); },
+                        "unit out of range");
+            }
+
+            const checkpoint::journal journal(path, sweep, unit_count);
+            check(journal.records().size() == 3, "records kept");
+            check(journal.records().size() == 3
+                          && same(journal.records()[0], record_for(3))
+                          && same(journal.records()[1], record_for(0))
+                          && same(journal.records()[2], record_for(7)),
+                  "records in commit order");
+
+            test::check_throws<std::runtime_error>(
+                    [&] { const checkpoint::journal other(path, sweep + 1,
+                                                          unit_count); },
+                    "another sweep's checkpoint");
+        }
+
+        auto torn_tail_cut_off(const std::string& path) -> void
+        {
+            const auto whole = std::filesystem::file_size(path);
+
+            // A record only partly written when the process died
+            std::filesystem::resize_file(
+                    path, whole - sizeof(checkpoint::unit_record) / 2);
+            {
+                checkpoint::journal journal(path, sweep, unit_count);
+                check(journal.records().size() == 2, "torn record dropped");
+                journal.commit(record_for(7));
+            }
+            check(std::filesystem::file_size(path) == whole,
+                  "torn record overwritten");
+
+            // A record of the right size whose bytes did not all land
+            {
+                std::fstream file(path, std::ios::in | std::ios::out
+                                                | std::ios::binary);
+                file.seekp(static_cast<std::streamoff>(
+                        whole - sizeof(checkpoint::unit_record) + 8));
+                file.put('\x7f');
+            }
+            const checkpoint::journal journal(path, sweep, unit_count);
+            check(journal.records().size() == 2, "damaged record dropped");
+            check(journal.records().size() == 2
+                          && same(journal.records()[1], record_for(0)),
+                  "records before it kept");
+        }
+
+    } // namespace
+
+} // namespace potmaker
+
+auto main() -> int
+{
+    const std::string path = potmaker::test::temp_path("sweep.ckp");
+    std::remove(path.c_str());
+    potmaker::round_trip(path);
+    potmaker::torn_tail_cut_off(path);
+    std::remove(path.c_str());
+    return potmaker::test::report();
+}
@@ -0,0 +1,138 @@
+#include "check.hh"
+#include "column_file.hh"
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace potmaker {
+
+    namespace {
+
+        using test::check;
+
+        // More than one group of chunks, with a partial one at the end
+        constexpr std::size_t rows = 2 * columns::chunk_rows + 123;
+
+        struct table {
+            std::vector<std::int64_t> seeds;
+            std::vector<std::int64_t> stages;
+            std::vector<std::int64_t> spread;
+            std::vector<double> gold;
+        };
+
+        auto make_table() -> table
+        {
+            std::mt19937_64 engine(5);
+            table t;
+            for (std::size_t row = 0; row < rows; ++row) {
+                // Consecutive values delta-encode, few distinct ones go
+                // into a dictionary, and wide ones are stored plainly
+                t.seeds.push_back(1000 + static_cast<std::int64_t>(row));
+                t.stages.push_back(static_cast<std::int64_t>(engine() % 12));
+                t.spread.push_back(static_cast<std::int64_t>(engine()));
+                t.gold.push_back(static_cast<double>(engine() % 10000)
+                                 / 8.0);
+            }
+            return t;
+        }
+
+        auto write_table(const std::string& path, const table& t) -> void
+        {
+            columns::writer out(path);
+            out.add_column("seed", columns::value_type::int64);
+            out.add_column("stage", columns::value_type::int64);
+            out.add_column("spread", columns::value_type::int64);
+            out.add_column("gold", columns::value_type::float64);
+            for (std::size_t row = 0; row < rows; ++row) {
+                out.push(t.seeds[row]);
+                out.push(t.stages[row]);
+                out.push(t.spread[row]);
+                out.push(t.gold[row]);
+                out.end_row();
+            }
+            out.finish();
+        }
+
+        auto round_trip(const std::string& path) -> void
+        {
+            const table t = make_table();
+            write_table(path, t);
+
+            const columns::reader in(path);
+            check(in.rows() == rows, "row count");
+            check(in.columns() == 4, "column count");
+            check(in.name(3) == "gold", "column name");
+            check(in.find("stage") == 1, "find");
+            check(in.type(3) == columns::value_type::float64, "column type");
+            check(in.integers(0) == t.seeds, "delta column");
+            check(in.integers(1) == t.stages, "dictionary column");
+            check(in.integers(2) == t.spread, "plain column");
+            check(in.reals(3) == t.gold, "floating-point column");
+
+            std::vector<std::uint64_t> expected;
+            for (std::size_t row = 0; row < rows; ++row) {
+                if (t.stages[row] >= 4 && t.stages[row] <= 6) {
+                    expected.push_back(row);
+                }
+            }
+            check(in.scan(1, std::int64_t{4}, std::int64_t{6}) == expected,
+                  "integer scan");
+
+            expected.clear();
+            for (std::size_t row = 0; row < rows; ++row) {
+                if (t.gold[row] >= 100.0 && t.gold[row] <= 250.5) {
+                    expected.push_back(row);
+                }
+            }
+            check(in.scan(3, 100.0, 250.5) == expected, "real scan");
+
+            test::check_throws<std::out_of_range>(
+                    [&] { (void)in.find("missing"); }, "unknown column");
+            test::check_throws<std::invalid_argument>(
+                    [&] { (void)in.scan(3, std::int64_t{0}, std::int64_t{1}); },
+                    "integer scan of a real column");
+        }
+
+        auto misuse_rejected(const std::string& path) -> void
+        {
+            {
+                columns::writer out(path);
+                test::check_throws<std::invalid_argument>(
+                        [&] { out.end_row(); }, "row without columns");
+                test::check_throws<std::invalid_argument>(
+                        [&] { out.finish(); }, "file without columns");
+            }
+            columns::writer out(path);
+            out.add_column("seed", columns::value_type::int64);
+            test::check_throws<std::invalid_argument>(
+                    [&] { out.push(1.5); }, "real in an integer column");
+        }
+
+        auto damaged_files_rejected(const std::string& path) -> void
+        {
+            write_table(path, make_table());
+            std::filesystem::resize_file(
+                    path, std::filesystem::file_size(path) / 2);
+            test::check_throws<std::runtime_error>(
+                    [&] { const columns::reader in(path); },
+                    "truncated file");
+        }
+
+    } // namespace
+
+} // namespace potmaker
+
+auto main() -> int
+{
+    const std::string path = potmaker::test::temp_path("runs.col");
+    potmaker::round_trip(path);
+    potmaker::misuse_rejected(path);
+    potmaker::damaged_files_rejected(path);
+    std::remove(path.c_str());
+    return potmaker::test::report();
+}
@@ -0,0 +1,213 @@
+#include "check.hh"
+#include "combat_math.hh"
+#include <cmath>
+#include <cstdint>
+#include <format>
+#include <limits>
+#include <random>
+#include <type_traits>
+
+namespace potmaker {
+
+    namespace {
+
+        using test::check;
+
+        // Exact in sixteen fractional bits, so they hold at compile time
+        static_assert(fixed_point(1.5) * fixed_point(2.25) == 3.375);
+        static_assert(fixed_point(-1.5) * fixed_point(2.25) == -3.375);
+        static_assert(fixed_point(7) / fixed_point(2) == 3.5);
+        static_assert(fixed_point(0.25) + fixed_point(3) - 1 == 2.25);
+        // Raw products and shifted dividends that overflow 64 bits
+        static_assert(fixed_point(1000000) * fixed_point(-1000000) == -1e12);
+        static_assert(fixed_point(1e12) / fixed_point(-1000000) == -1000000);
+        static_assert(integer_power(combat_value(2), 10) == 1024);
+        static_assert(integer_power(combat_value(2), -2) == 0.25);
+        // Dividing by zero saturates
+        static_assert((fixed_point(3) / 0).raw()
+                      == std::numeric_limits<std::int64_t>::max());
+        static_assert((fixed_point(-3) / 0).raw()
+                      == std::numeric_limits<std::int64_t>::min());
+        static_assert(fixed_point(0) / 0 == 0);
+
+        auto conversions() -> void
+        {
+            check(fixed_point(0.5).raw() == fixed_point::one / 2, "a half");
+            check(fixed_point(-1.25).raw() == -fixed_point::one * 5 / 4,
+                  "negative");
+            // Halfway between two steps rounds away from zero
+            check(fixed_point(1.5 / 65536.0).raw() == 2
+                          && fixed_point(-1.5 / 65536.0).raw() == -2,
+                  "round to nearest step");
+            check(fixed_point(12345.75).to_double() == 12345.75,
+                  "exact values convert back exactly");
+            check(whole_part(fixed_point(-3.75)) == -3
+                          && whole_part(fixed_point(3.75)) == 3,
+                  "whole part rounds towards zero");
+        }
+
+        auto rounding() -> void
+        {
+            const fixed_point step = fixed_point::from_raw(1);
+            // A product below one step rounds down, so negative ones go
+            // a whole step away from zero
+            check((step * 0.5).raw() == 0, "positive product rounds down");
+            check((-step * 0.5).raw() == -1, "negative product rounds down");
+            check((fixed_point(1) / 3).raw() == 21845
+                          && (fixed_point(-1) / 3).raw() == -21845,
+                  "quotients round towards zero");
+            check(fixed_point(2) < fixed_point(2.5)
+                          && fixed_point(-2) > fixed_point(-2.5),
+                  "ordering");
+        }
+
+        /**
+         * Checks products and quotients against plain 64-bit arithmetic,
+         * with raw values small enough for it to be exact
+         */
+        auto matches_integer_arithmetic() -> void
+        {
+            std::mt19937_64 engine(29);
+            std::uniform_int_distribution<std::int64_t> small(
+                    -(std::int64_t{1} << 31), std::int64_t{1} << 31);
+            std::uniform_int_distribution<std::int64_t> wide(
+                    -(std::int64_t{1} << 46), std::int64_t{1} << 46);
+            int products = 0;
+            int quotients = 0;
+            for (int i = 0; i < 200000; ++i) {
+                const std::int64_t a = small(engine);
+                const std::int64_t b = small(engine);
+                const auto product = fixed_point::from_raw(a)
+                                     * fixed_point::from_raw(b);
+                // Shifting a negative number right rounds it down
+                if (product.raw() != (a * b) >> fixed_point::fraction_bits) {
+                    ++products;
+                }
+
+                const std::int64_t n = wide(engine);
+                const std::int64_t d = b == 0 ? 1 : b;
+                const auto quotient = fixed_point::from_raw(n)
+                                      / fixed_point::from_raw(d);
+                if (quotient.raw() != n * fixed_point::one / d) {
+                    ++quotients;
+                }
+            }
+            check(products == 0, "products match");
+            check(quotients == 0, "quotients match");
+        }
+
+#ifdef __SIZEOF_INT128__
+        /**
+         * Checks products and quotients whose intermediate values overflow
+         * 64 bits against 128-bit arithmetic. This is what the portable
+         * code is for, where it is built with POTMK_NO_INT128
+         */
+        auto matches_wide_arithmetic() -> void
+        {
+            std::mt19937_64 engine(38);
+            std::uniform_int_distribution<std::int64_t> factor(
+                    -(std::int64_t{1} << 39), std::int64_t{1} << 39);
+            std::uniform_int_distribution<std::int64_t> dividend(
+                    -(std::int64_t{1} << 62), std::int64_t{1} << 62);
+            std::uniform_int_distribution<std::int64_t> divisor(
+                    std::int64_t{1} << 20, std::int64_t{1} << 40);
+            int products = 0;
+            int quotients = 0;
+            for (int i = 0; i < 200000; ++i) {
+                const std::int64_t a = factor(engine);
+                const std::int64_t b = factor(engine);
+                const auto product = fixed_point::from_raw(a)
+                                     * fixed_point::from_raw(b);
+                if (product.raw()
+                    != static_cast<std::int64_t>(
+                            (static_cast<__int128>(a) * b)
+                            >> fixed_point::fraction_bits)) {
+                    ++products;
+                }
+
+                const std::int64_t n = dividend(engine);
+                const std::int64_t d = i % 2 == 0 ? divisor(engine)
+                                                  : -divisor(engine);
+                const auto quotient = fixed_point::from_raw(n)
+                                      / fixed_point::from_raw(d);
+                if (quotient.raw()
+                    != static_cast<std::int64_t>(
+                            (static_cast<__int128>(n)
+                             << fixed_point::fraction_bits)
+                            / d)) {
+                    ++quotients;
+                }
+            }
+            check(products == 0, "wide products match");
+            check(quotients == 0, "wide quotients match");
+        }
+#endif
+
+        auto division_by_zero() -> void
+        {
+            constexpr std::int64_t most
+                    = std::numeric_limits<std::int64_t>::max();
+            constexpr std::int64_t least
+                    = std::numeric_limits<std::int64_t>::min();
+            const fixed_point zero;
+            check((fixed_point(0.5) / zero).raw() == most
+                          && (fixed_point::from_raw(least) / zero).raw()
+                                     == least
+                          && (zero / zero).raw() == 0,
+                  "division by zero saturates");
+        }
+
+        auto powers() -> void
+        {
+            const combat_value base = 1.1;
+            const multiplier_table table(base);
+            check(table(0) == 1 && table(1) == base && table(2) == base * base,
+                  "table entries");
+            check(table(20) == integer_power(base, 20)
+                          && table(-2) == integer_power(base, -2),
+                  "exponents past the table");
+        }
+
+        /**
+         * The status effects' multipliers round differently from std::pow,
+         * but stay close to it and on the same side of one
+         */
+        auto powers_follow_pow() -> void
+        {
+            constexpr bool exact = std::is_same_v<combat_value, double>;
+            for (const double base: {1.1, 1.25, 0.9, 1.5, 0.75, 0.8}) {
+                const multiplier_table table(base);
+                for (int exponent = -4; exponent <= 24; ++exponent) {
+                    const double power = to_double(table(exponent));
+                    const double expected = std::pow(base, exponent);
+                    // Fixed-point products lose up to a step each, which
+                    // the later ones scale up
+                    const double tolerance
+                            = exact ? 1e-12 * expected
+                                    : 1e-3 * expected + 1e-3;
+                    check(std::abs(power - expected) <= tolerance
+                                  && (power < 1) == (expected < 1)
+                                  && (power > 1) == (expected > 1),
+                          std::format("{}^{}: {} for {}", base, exponent,
+                                      power, expected));
+                }
+            }
+        }
+
+    } // namespace
+
+} // namespace potmaker
+
+auto main() -> int
+{
+    potmaker::conversions();
+    potmaker::rounding();
+    potmaker::matches_integer_arithmetic();
+#ifdef __SIZEOF_INT128__
+    potmaker::matches_wide_arithmetic();
+#endif
+    potmaker::division_by_zero();
+    potmaker::powers();
+    potmaker::powers_follow_pow();
+    return potmaker::test::report();
+}
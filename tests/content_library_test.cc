@@ -0,0 +1,203 @@
+#include "check.hh"
+#include "content_library.hh"
+#include "entity.hh"
+#include "simulation.hh"
+#include "util.hh"
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+namespace potmaker {
+
+    namespace {
+
+        using test::check;
+
+        // A raider only looks at who is in its party, a medic at how its
+        // allies are doing and a purger at the player's effects
+        constexpr std::string_view source = R"(
+enemy raider fire
+    stats 60 3 0.9 1.1 6 3 0.9 1.1
+    choose 3
+    case 1
+        say "{self} torches everyone"
+        for_each_ally
+            if roll 2
+                effect burning scale 0.5*scale
+            end
+        end
+        target player
+        effect burning 2*scale scale
+    case 2
+        target random_ally
+        amount random 2 4
+        say "{self} patches up {target} for {amount}"
+        heal
+    case 3
+        amount attack 1.5
+        say "{self} hits {target} for {amount}"
+        damage
+    end
+end
+
+enemy medic healing
+    stats 50 3 0.9 1.1 3 5 0.9 1.1
+    select most_wounded 0.5
+    if found
+        amount 10
+        heal
+    end
+end
+
+enemy purger purifying
+    stats 50 3 0.9 1.1 3 5 0.9 1.1
+    if has_effects
+        clear
+    end
+end
+)";
+
+        /**
+         * A player and a party of scripted enemies, all of the first type
+         */
+        struct battle {
+            std::unique_ptr<player> hero;
+            std::vector<std::unique_ptr<enemy>> owned;
+            enemy_party party;
+
+            explicit battle(const content_library& library)
+                : hero(std::make_unique<player>("Hero", 100.0, 10.0, 0.0))
+            {
+                for (int i = 0; i < 4; ++i) {
+                    owned.emplace_back(library.create_enemy(
+                            0, std::format("Raider {}", i), 3 + i,
+                            enemy_rolls{0.5, 0.5}));
+                    party.push_back(owned.back().get());
+                }
+                // Some of the party is hurt, for the heals to change it
+                party[1]->modify_health(-20);
+                party[2]->modify_health(-30);
+            }
+
+            [[nodiscard]] auto hash() -> std::uint64_t
+            {
+                std::uint64_t h = hero->state_hash();
+                for (const enemy* e: party) { h = h * 31 + e->state_hash(); }
+                return h;
+            }
+        };
+
+        auto planned_scripts_match_acting() -> void
+        {
+            const scoped_quiet_output quiet;
+            const content_library library = content_library::parse(source);
+
+            for (std::uint64_t seed = 1; seed <= 60; ++seed) {
+                battle acted(library);
+                battle planned(library);
+
+                seed_random(seed);
+                for (enemy* e: acted.party) {
+                    e->act(*acted.hero, acted.party);
+                }
+                const int acted_draw = random_int(1, 1000000);
+
+                seed_random(seed);
+                for (enemy* e: planned.party) {
+                    enemy_intent intent = e->plan(*planned.hero, planned.party);
+                    check(!intent.deferred,
+                          "a script that reads no battle state is planned");
+                    intent.apply();
+                }
+                const int planned_draw = random_int(1, 1000000);
+
+                check(acted.hash() == planned.hash(),
+                      std::format("seed {}: planning ends in the same battle",
+                                  seed));
+                check(acted_draw == planned_draw,
+                      std::format("seed {}: planning makes the same draws",
+                                  seed));
+            }
+        }
+
+        auto state_reading_scripts_defer() -> void
+        {
+            const content_library library = content_library::parse(source);
+            player hero("Hero", 100.0, 10.0, 0.0);
+            for (std::size_t type = 1; type < library.enemies().size();
+                 ++type) {
+                const std::unique_ptr<enemy> e(library.create_enemy(
+                        type, "Reader", 2, enemy_rolls{0.5, 0.5}));
+                const enemy_party party{e.get()};
+                check(e->plan(hero, party).deferred,
+                      std::format("{} defers to act",
+                                  library.enemies()[type].id));
+            }
+        }
+
+        auto random_ally_of_empty_party_keeps_target() -> void
+        {
+            const content_library library = content_library::parse(R"(
+enemy loner fire
+    stats 50 3 1 1 4 4 1 1
+    target random_ally
+    amount 5
+    damage
+end
+)");
+            const scoped_quiet_output quiet;
+            player hero("Hero", 100.0, 10.0, 0.0);
+            const std::unique_ptr<enemy> e(library.create_enemy(
+                    0, "Loner", 1, enemy_rolls{0.5, 0.5}));
+            enemy_party nobody;
+            e->act(hero, nobody);
+            check(hero.health() == 95.0,
+                  "with nobody to pick, the player stays the target");
+        }
+
+        auto content_file_plays_like_built_ins() -> void
+        {
+            const content_library library = content_library::load(
+                    POTMK_RESOURCES_DIR "/content.potmk");
+            for (std::uint64_t seed = 1; seed <= 100; ++seed) {
+                const run_summary built_in = simulate_run(seed, {}, true);
+                set_active_content(&library);
+                const run_summary scripted = simulate_run(seed, {}, true);
+                set_active_content(nullptr);
+
+                check(scripted.events == built_in.events
+                              && scripted.stage_reached
+                                         == built_in.stage_reached
+                              && scripted.turns == built_in.turns
+                              && scripted.gold == built_in.gold,
+                      std::format("seed {}: the content file plays the "
+                                  "same run as the built-in types",
+                                  seed));
+                check(scripted.enemies_by_type == built_in.enemies_by_type
+                              && scripted.kills_by_type
+                                         == built_in.kills_by_type
+                              && scripted.ingredients_bought
+                                         == built_in.ingredients_bought
+                              && scripted.ingredients_used
+                                         == built_in.ingredients_used,
+                      std::format("seed {}: the content file's types are "
+                                  "counted like the built-in ones",
+                                  seed));
+            }
+        }
+
+    } // namespace
+
+} // namespace potmaker
+
+auto main() -> int
+{
+    potmaker::planned_scripts_match_acting();
+    potmaker::state_reading_scripts_defer();
+    potmaker::random_ally_of_empty_party_keeps_target();
+    potmaker::content_file_plays_like_built_ins();
+    return potmaker::test::report();
+}
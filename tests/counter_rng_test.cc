@@ -0,0 +1,117 @@
+#include "check.hh"
+#include "counter_rng.hh"
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace potmaker {
+
+    namespace {
+
+        using test::check;
+
+        auto philox_known_answers() -> void
+        {
+            // The known-answer vectors published with Random123
+            using words = std::array<std::uint32_t, 4>;
+            check(philox4x32({0, 0, 0, 0}, {0, 0})
+                          == words{0x6627e8d5, 0xe169c58d, 0xbc57ac4c,
+                                   0x9b00dbd8},
+                  "zero counter and key");
+            check(philox4x32({0xffffffff, 0xffffffff, 0xffffffff,
+                              0xffffffff},
+                             {0xffffffff, 0xffffffff})
+                          == words{0x408f276d, 0x41c83b0e, 0xa20bc7c6,
+                                   0x6d5451fd},
+                  "all-ones counter and key");
+            check(philox4x32({0x243f6a88, 0x85a308d3, 0x13198a2e,
+                              0x03707344},
+                             {0xa4093822, 0x299f31d0})
+                          == words{0xd16cfe09, 0x94fdcceb, 0x5001e420,
+                                   0x24126ea1},
+                  "digits of pi");
+        }
+
+        auto stream_layout() -> void
+        {
+            // The run is the key, and the block index, slot, turn and stage
+            // the counter. Saved replays depend on every draw staying put
+            const stream_key key{0x123456789abcdef0, 4, 9, 2};
+            counter_stream stream(key);
+            for (std::uint32_t block = 0; block < 3; ++block) {
+                const auto words
+                        = philox4x32({block, key.slot, key.turn, key.stage},
+                                     {0x9abcdef0, 0x12345678});
+                const std::uint64_t first = stream.next();
+                const std::uint64_t second = stream.next();
+                check(first == (std::uint64_t{words[0]} << 32 | words[1])
+                              && second
+                                         == (std::uint64_t{words[2]} << 32
+                                             | words[3]),
+                      "two draws per block");
+            }
+            check(stream.draws() == 6, "draw count");
+            check(stream.key().run == key.run && stream.key().slot == key.slot
+                          && stream.key().turn == key.turn
+                          && stream.key().stage == key.stage,
+                  "key");
+
+            counter_stream pinned({1, 2, 3, 4});
+            check(pinned.next() == 0x38f1e0e812ba3d6c
+                          && pinned.next() == 0xa7e92fd63a712f03
+                          && pinned.next() == 0x88a378b6d1f2a878,
+                  "pinned draws");
+        }
+
+        auto streams_are_independent() -> void
+        {
+            counter_stream a({7, 1, 1, 0});
+            counter_stream b({7, 1, 1, 1});
+            check(a.next() != b.next(), "slots draw differently");
+
+            // Drawing from one stream leaves another where it was
+            counter_stream c({7, 1, 1, 0});
+            counter_stream d({7, 1, 1, 1});
+            for (int i = 0; i < 5; ++i) { (void)c.next(); }
+            counter_stream e({7, 1, 1, 1});
+            check(d.next() == e.next(), "stream unaffected by another");
+        }
+
+        auto ranges_and_fills() -> void
+        {
+            counter_stream single({11, 3, 5, 2});
+            counter_stream filled({11, 3, 5, 2});
+            std::vector<int> expected(1000);
+            bool in_range = true;
+            for (int& value: expected) {
+                value = single.int_in(-3, 8);
+                in_range = in_range && value >= -3 && value <= 8;
+            }
+            check(in_range, "int_in stays in range");
+
+            std::vector<int> values(1000);
+            filled.fill_ints(values, -3, 8);
+            check(values == expected, "fill_ints draws what int_in would");
+            check(filled.draws() == single.draws(), "fill_ints draw count");
+
+            counter_stream reals({11, 3, 5, 3});
+            bool reals_in_range = true;
+            for (int i = 0; i < 1000; ++i) {
+                const double value = reals.double_in(2.0, 3.0);
+                reals_in_range = reals_in_range && value >= 2.0 && value < 3.0;
+            }
+            check(reals_in_range, "double_in stays in range");
+        }
+
+    } // namespace
+
+} // namespace potmaker
+
+auto main() -> int
+{
+    potmaker::philox_known_answers();
+    potmaker::stream_layout();
+    potmaker::streams_are_independent();
+    potmaker::ranges_and_fills();
+    return potmaker::test::report();
+}
@@ -0,0 +1,170 @@
+#include "check.hh"
+#include "event_log.hh"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <random>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace potmaker {
+
+    namespace {
+
+        using test::check;
+
+        /**
+         * @return Enough events for several blocks, in run, stage and turn
+         * order, with health on whole steps of the quantum
+         */
+        auto make_events() -> std::vector<events::event>
+        {
+            std::mt19937_64 engine(3);
+            std::vector<events::event> log;
+            for (std::uint64_t run = 1; run <= 400; ++run) {
+                const auto stages = static_cast<std::int32_t>(1 + engine() % 6);
+                for (std::int32_t stage = 1; stage <= stages; ++stage) {
+                    for (std::uint32_t entity = 1; entity <= 3; ++entity) {
+                        log.push_back({run, stage, 0, events::kind::spawn,
+                                       entity, 4, 90.0});
+                    }
+                    const auto turns
+                            = static_cast<std::uint32_t>(1 + engine() % 30);
+                    for (std::uint32_t turn = 1; turn <= turns; ++turn) {
+                        const auto target
+                                = static_cast<std::uint32_t>(engine() % 4);
+                        const auto steps
+                                = static_cast<int>(engine() % 400) - 200;
+                        log.push_back({run, stage, turn, events::kind::action,
+                                       target, 1, 0.0});
+                        log.push_back({run, stage, turn, events::kind::health,
+                                       target, 0, steps * 0.1});
+                    }
+                    log.push_back({run, stage, turns, events::kind::death, 1,
+                                   0, 0.0});
+                }
+            }
+            return log;
+        }
+
+        auto write_log(const std::string& path,
+                       const std::vector<events::event>& log) -> void
+        {
+            events::writer out(path);
+            for (const events::event& e: log) { out.add(e); }
+            out.finish();
+        }
+
+        auto same(const events::event& a, const events::event& b) -> bool
+        {
+            return a.run == b.run && a.stage == b.stage && a.turn == b.turn
+                   && a.kind == b.kind && a.entity == b.entity
+                   && a.detail == b.detail
+                   && std::abs(a.health - b.health) < 1e-9;
+        }
+
+        auto round_trip(const std::string& path) -> void
+        {
+            const std::vector<events::event> log = make_events();
+            write_log(path, log);
+
+            events::reader in(path);
+            check(in.size() == log.size(), "event count");
+            std::size_t matched = 0;
+            events::event e;
+            while (in.next(e)) {
+                if (matched < log.size() && same(e, log[matched])) {
+                    ++matched;
+                }
+                else {
+                    break;
+                }
+            }
+            check(matched == log.size(), "events read back one by one");
+
+            events::reader batched(path);
+            std::vector<events::event> batch(1000);
+            std::vector<events::event> read;
+            while (const std::size_t got = batched.next(batch)) {
+                read.insert(read.end(), batch.begin(),
+                            batch.begin() + static_cast<std::ptrdiff_t>(got));
+            }
+            check(std::ranges::equal(read, log, same),
+                  "events read back in batches");
+
+            // Into the middle of a run, past the first blocks
+            const events::event& target = log[log.size() / 2];
+            in.seek(target.run, target.stage, target.turn);
+            const auto first = std::ranges::find_if(
+                    log, [&](const events::event& x) {
+                        return x.run == target.run && x.stage == target.stage
+                               && x.turn == target.turn;
+                    });
+            check(in.next(e) && same(e, *first), "seek");
+        }
+
+        auto compress_round_trip() -> void
+        {
+            std::mt19937_64 engine(9);
+            std::vector<std::byte> raw;
+            for (int i = 0; i < 20000; ++i) {
+                // Runs of repeats with noise in between
+                const auto value = static_cast<std::byte>(
+                        i % 300 < 200 ? i % 7 : engine() % 256);
+                raw.push_back(value);
+            }
+            std::vector<std::byte> compressed;
+            events::compress(raw, compressed);
+            check(compressed.size() < raw.size(), "repeats shrink");
+
+            std::vector<std::byte> restored(raw.size());
+            events::decompress(compressed, restored);
+            check(restored == raw, "compress round trip");
+
+            compressed.resize(compressed.size() / 2);
+            test::check_throws<std::runtime_error>(
+                    [&] { events::decompress(compressed, restored); },
+                    "cut compressed bytes");
+        }
+
+        auto misuse_rejected(const std::string& path) -> void
+        {
+            events::writer out(path);
+            out.add({5, 2, 3, events::kind::health, 0, 0, 1.0});
+            test::check_throws<std::invalid_argument>(
+                    [&] {
+                        out.add({5, 2, 2, events::kind::health, 0, 0, 1.0});
+                    },
+                    "event out of order");
+        }
+
+        auto torn_tail_rejected(const std::string& path) -> void
+        {
+            // The index is written last, so a log cut short by a crash
+            // lost it
+            write_log(path, make_events());
+            std::filesystem::resize_file(
+                    path, std::filesystem::file_size(path) - 100);
+            test::check_throws<std::runtime_error>(
+                    [&] { const events::reader in(path); }, "torn tail");
+        }
+
+    } // namespace
+
+} // namespace potmaker
+
+auto main() -> int
+{
+    const std::string path = potmaker::test::temp_path("runs.evt");
+    potmaker::round_trip(path);
+    potmaker::compress_round_trip();
+    potmaker::misuse_rejected(path);
+    potmaker::torn_tail_rejected(path);
+    std::remove(path.c_str());
+    return potmaker::test::report();
+}
@@ -0,0 +1,178 @@
+#include "check.hh"
+#include "entity.hh"
+#include "potionmaker_game.hh"
+#include "util.hh"
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <optional>
+#include <vector>
+
+namespace potmaker {
+
+    namespace {
+
+        using test::check;
+
+        /**
+         * What a won battle paid, and what it should have paid for its
+         * enemies before the random variation
+         */
+        struct payout {
+            double paid;
+            double gold_gained;
+            double base;
+        };
+
+        /**
+         * Plays the first battle of a run with basic attacks
+         * @return The payout, or nothing if the battle was lost
+         */
+        auto first_victory(const std::uint64_t seed) -> std::optional<payout>
+        {
+            seed_random(seed);
+            game_state game("Tester");
+            enemy_party enemies = game.begin_battle();
+
+            // Defeated enemies leave the party, so note them up front
+            double base = 0.0;
+            for (const enemy* e: enemies) {
+                base += 5.0 + e->level() * 3.0 + game.stage() * 2.0;
+            }
+
+            const battle_action attack{battle_action::kind::basic_attack, 0,
+                                       {}};
+            battle_outcome outcome = battle_outcome::ongoing;
+            for (int turn = 0;
+                 turn < 200 && outcome == battle_outcome::ongoing; ++turn) {
+                outcome = game.play_turn(enemies, attack);
+            }
+            if (outcome != battle_outcome::won) { return std::nullopt; }
+
+            const combat_value gold_before = game.current_player().gold();
+            const combat_value paid = game.end_battle(true);
+            return payout{to_double(paid),
+                          to_double(game.current_player().gold() - gold_before),
+                          base};
+        }
+
+        auto victory_pays_for_every_enemy() -> void
+        {
+            const scoped_quiet_output quiet;
+            int victories = 0;
+            for (std::uint64_t seed = 1; seed <= 40; ++seed) {
+                const auto battle = first_victory(seed);
+                if (!battle) { continue; }
+                ++victories;
+                check(std::abs(battle->paid - battle->gold_gained) < 1e-9,
+                      std::format("seed {}: the gold returned was added",
+                                  seed));
+                check(battle->paid >= battle->base * 0.8 - 1e-9
+                              && battle->paid <= battle->base * 1.2 + 1e-9,
+                      std::format("seed {}: paid {} for enemies worth {}",
+                                  seed, battle->paid, battle->base));
+            }
+            check(victories > 0, "some first battle is won");
+        }
+
+        auto defeat_pays_nothing() -> void
+        {
+            const scoped_quiet_output quiet;
+            seed_random(3);
+            game_state game("Tester");
+            game.begin_battle();
+            const combat_value gold_before = game.current_player().gold();
+            check(game.end_battle(false) == 0, "a loss pays nothing");
+            check(game.current_player().gold() == gold_before,
+                  "a loss leaves the gold alone");
+        }
+
+        /**
+         * @return Whether two lists of intents make the same changes and say
+         * the same things
+         */
+        auto same_intents(const intent_list& a, const intent_list& b) -> bool
+        {
+            if (a.size() != b.size()) { return false; }
+            for (std::size_t i = 0; i < a.size(); ++i) {
+                if (a[i].steps.size() != b[i].steps.size()
+                    || a[i].reads_allies != b[i].reads_allies
+                    || a[i].deferred != b[i].deferred) {
+                    return false;
+                }
+                for (std::size_t s = 0; s < a[i].steps.size(); ++s) {
+                    const intent_step& x = a[i].steps[s];
+                    const intent_step& y = b[i].steps[s];
+                    if (x.type != y.type || x.target != y.target
+                        || x.amount != y.amount || x.message != y.message
+                        || x.effect.has_value() != y.effect.has_value()
+                        || (x.effect
+                            && x.effect->index() != y.effect->index())) {
+                        return false;
+                    }
+                }
+            }
+            return true;
+        }
+
+        auto parallel_planning_matches_serial() -> void
+        {
+            seed_random(11);
+            game_state game("Tester");
+            constexpr std::size_t party_size
+                    = 4 * game_state::min_enemies_per_thread;
+            enemy_party enemies = create_random_enemies(4, party_size);
+            for (std::size_t i = 0; i < enemies.size(); ++i) {
+                enemies[i]->set_battle_slot(static_cast<std::uint32_t>(i + 1));
+            }
+
+            for (const bool quiet: {false, true}) {
+                for (const bool antithetic: {false, true}) {
+                    std::optional<scoped_quiet_output> quiet_scope;
+                    if (quiet) { quiet_scope.emplace(); }
+                    std::optional<scoped_antithetic_draws> antithetic_scope;
+                    if (antithetic) { antithetic_scope.emplace(); }
+
+                    intent_list serial;
+                    intent_list parallel;
+                    game.plan_enemy_turns(enemies, serial, 1);
+                    game.plan_enemy_turns(enemies, parallel, 4);
+                    // Workers that missed the calling thread's settings
+                    // would word messages or draw numbers differently
+                    check(same_intents(serial, parallel),
+                          std::format("quiet {}, antithetic {}: parallel "
+                                      "planning matches serial",
+                                      quiet, antithetic));
+                }
+            }
+
+            for (const enemy* e: enemies) { delete e; }
+        }
+
+        auto health_fractions() -> void
+        {
+            const scoped_quiet_output quiet;
+            player wounded("Wounded", 80.0, 10.0, 0.0);
+            wounded.modify_health(-20);
+            check(to_double(wounded.health_fraction()) == 0.75,
+                  "health over max health");
+            // Healers look for the lowest fraction, which must not trap on
+            // a division by zero
+            const player hollow("Hollow", 0.0, 10.0, 0.0);
+            check(hollow.health_fraction() == 1,
+                  "without max health there is nothing to heal");
+        }
+
+    } // namespace
+
+} // namespace potmaker
+
+auto main() -> int
+{
+    potmaker::victory_pays_for_every_enemy();
+    potmaker::defeat_pays_nothing();
+    potmaker::parallel_planning_matches_serial();
+    potmaker::health_fractions();
+    return potmaker::test::report();
+}
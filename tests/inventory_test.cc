@@ -0,0 +1,152 @@
+#include "check.hh"
+#include "element_type.hh"
+#include "ingredient.hh"
+#include "inventory.hh"
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace potmaker {
+
+    namespace {
+
+        using test::check;
+
+        /**
+         * Owns the ingredients an inventory points to
+         */
+        struct pantry {
+            auto fire(const std::int32_t potency,
+                      const std::string& name = "Ember") -> ingredient*
+            {
+                return keep(std::make_unique<flaming_ingredient>(name,
+                                                                 potency));
+            }
+
+            auto ice(const std::int32_t potency) -> ingredient*
+            {
+                return keep(std::make_unique<chilling_ingredient>("Frost",
+                                                                  potency));
+            }
+
+            auto keep(std::unique_ptr<ingredient> ing) -> ingredient*
+            {
+                owned.push_back(std::move(ing));
+                return owned.back().get();
+            }
+
+            std::vector<std::unique_ptr<ingredient>> owned;
+        };
+
+        auto stacks_and_lookups() -> void
+        {
+            pantry p;
+            inventory inv;
+            const std::size_t embers = inv.add(p.fire(2));
+            check(inv.add(p.fire(2)) == embers, "same ingredients stack");
+            const std::size_t strong = inv.add(p.fire(3));
+            const std::size_t named = inv.add(p.fire(2, "Cinder"));
+            const std::size_t frost = inv.add(p.ice(2));
+            check(strong != embers && named != embers && frost != embers,
+                  "potency, name and type split stacks");
+            check(inv.size() == 5 && inv.stacks()[embers].units.size() == 2,
+                  "counts");
+            check(inv.stacks_with(element_type::fire).size() == 3,
+                  "stacks by element");
+            check(inv.stacks_with(element_type::fire, 2).size() == 2,
+                  "stacks by element and potency");
+            check(inv.stacks_with(element_type::ice, 3).empty(),
+                  "no such stack");
+        }
+
+        auto taking_and_putting_back() -> void
+        {
+            pantry p;
+            inventory inv;
+            const std::size_t embers = inv.add(p.fire(2));
+            const std::size_t frost = inv.add(p.ice(1));
+            inv.add(p.ice(1));
+            const std::uint64_t full = inv.state_hash();
+
+            const std::vector<std::size_t> picks{embers, embers, frost};
+            const ingredient_list taken = inv.take(picks);
+            check(taken.size() == 2, "an empty stack is skipped");
+            check(inv.size() == 1 && inv.stacks()[embers].units.empty(),
+                  "taken");
+            check(inv.stacks().size() == 2, "an empty stack keeps its place");
+            check(inv.take(embers) == nullptr, "nothing left to take");
+
+            inv.put_back(frost, taken[1]);
+            inv.put_back(embers, taken[0]);
+            check(inv.size() == 3 && inv.state_hash() == full,
+                  "put back where they were");
+
+            test::check_throws<std::out_of_range>(
+                    [&] { inv.put_back(5, taken[0]); }, "no such stack");
+            test::check_throws<std::invalid_argument>(
+                    [&] { inv.put_back(frost, p.fire(2)); },
+                    "ingredient of another stack");
+        }
+
+        auto hash_ignores_order() -> void
+        {
+            pantry p;
+            inventory a;
+            inventory b;
+            std::vector<ingredient*> ingredients{p.fire(1), p.ice(2),
+                                                 p.fire(1), p.fire(4)};
+            for (ingredient* ing: ingredients) { a.add(ing); }
+            for (auto it = ingredients.rbegin(); it != ingredients.rend();
+                 ++it) {
+                b.add(*it);
+            }
+            check(a.state_hash() == b.state_hash(), "order does not matter");
+            (void)b.take(b.stacks_with(element_type::ice).front());
+            check(a.state_hash() != b.state_hash(), "contents do");
+        }
+
+        auto compacting() -> void
+        {
+            pantry p;
+            inventory inv;
+            std::vector<std::size_t> stacks;
+            for (int i = 0; i < 40; ++i) {
+                stacks.push_back(inv.add(p.fire(1, std::format("F{}", i))));
+            }
+
+            // Seven empty stacks are not worth renumbering the rest
+            for (int i = 0; i < 7; ++i) { (void)inv.take(stacks[i * 2]); }
+            check(!inv.compact_if_sparse(), "a few empty stacks");
+            // Ten out of forty are
+            for (int i = 7; i < 10; ++i) { (void)inv.take(stacks[i * 2]); }
+            check(inv.compact_if_sparse(), "a quarter of the stacks");
+            check(inv.stacks().size() == 30 && inv.size() == 30,
+                  "empty stacks dropped");
+            check(inv.stacks()[0].name == "F1" && inv.stacks()[10].name == "F20"
+                          && inv.stacks()[29].name == "F39",
+                  "order kept");
+            check(inv.stacks_with(element_type::fire, 1).size() == 30,
+                  "lookups renumbered");
+            const ingredient* ing = inv.take(inv.stacks_with(element_type::fire,
+                                                             1)[10]);
+            check(ing != nullptr && ing->name() == "F20",
+                  "lookups point at the right stacks");
+            check(!inv.compact_if_sparse(), "nothing left to compact");
+        }
+
+    } // namespace
+
+} // namespace potmaker
+
+auto main() -> int
+{
+    potmaker::stacks_and_lookups();
+    potmaker::taking_and_putting_back();
+    potmaker::hash_ignores_order();
+    potmaker::compacting();
+    return potmaker::test::report();
+}
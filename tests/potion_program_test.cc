@@ -0,0 +1,313 @@
+#include "check.hh"
+#include "content_library.hh"
+#include "entity.hh"
+#include "ingredient.hh"
+#include "potion_program.hh"
+#include "potionmaker_game.hh"
+#include "util.hh"
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace potmaker {
+
+    namespace {
+
+        using test::check;
+
+        /**
+         * What a target looks like after a potion, and where the random
+         * number generator got to
+         */
+        struct outcome {
+            combat_value health;
+            std::uint64_t hash;
+            int next_draw;
+
+            auto operator==(const outcome&) const -> bool = default;
+        };
+
+        auto make_target(const int enemy_type) -> std::unique_ptr<enemy>
+        {
+            return std::unique_ptr<enemy>(create_enemy_by_type(
+                    enemy_type, "Target", 3, enemy_rolls{0.5, 0.5}));
+        }
+
+        auto compiled(const ingredient_list& potion, const int enemy_type,
+                      const std::uint64_t seed) -> outcome
+        {
+            const auto target = make_target(enemy_type);
+            seed_random(seed);
+            potion_program::compile(potion).apply(*target);
+            return {target->health(), target->state_hash(),
+                    random_int(1, 1000000)};
+        }
+
+        /**
+         * Applies a potion the way the game did before potions were
+         * compiled: each ingredient's on_applied in turn, skipping the
+         * rest once the target falls
+         */
+        auto interpreted(const ingredient_list& potion, const int enemy_type,
+                         const std::uint64_t seed) -> outcome
+        {
+            const auto target = make_target(enemy_type);
+            seed_random(seed);
+            for (ingredient* ing: potion) {
+                if (!target->is_dead()) { ing->on_applied(*target); }
+            }
+            return {target->health(), target->state_hash(),
+                    random_int(1, 1000000)};
+        }
+
+        /**
+         * @return A random potion of one to four built-in ingredients
+         */
+        auto random_potion(std::mt19937& engine,
+                           std::vector<std::unique_ptr<ingredient>>& owned)
+                -> ingredient_list
+        {
+            ingredient_list potion;
+            const auto size = 1 + engine() % 4;
+            for (std::uint32_t i = 0; i < size; ++i) {
+                const auto type = static_cast<int>(
+                        engine() % static_cast<std::uint32_t>(
+                                           ingredient_type_count()));
+                const auto potency = static_cast<int>(1 + engine() % 6);
+                owned.emplace_back(create_ingredient_by_type(
+                        type, std::format("I{}", i), potency));
+                potion.push_back(owned.back().get());
+            }
+            return potion;
+        }
+
+        auto same_as_on_applied() -> void
+        {
+            const scoped_quiet_output quiet;
+            std::mt19937 engine(23);
+            int mismatches = 0;
+            for (int trial = 0; trial < 2000; ++trial) {
+                std::vector<std::unique_ptr<ingredient>> owned;
+                const ingredient_list potion = random_potion(engine, owned);
+                const auto enemy_type = static_cast<int>(
+                        engine() % static_cast<std::uint32_t>(
+                                           enemy_type_count()));
+
+                if (compiled(potion, enemy_type, trial)
+                    != interpreted(potion, enemy_type, trial)) {
+                    ++mismatches;
+                }
+            }
+            check(mismatches == 0,
+                  std::format("{} potions differ from on_applied",
+                              mismatches));
+        }
+
+        auto splash_potency() -> void
+        {
+            std::vector<std::unique_ptr<ingredient>> owned;
+            ingredient_list potion;
+            owned.emplace_back(create_ingredient_by_type(0, "Ember", 5));
+            potion.push_back(owned.back().get());
+
+            const potion_program full = potion_program::compile(potion);
+            const potion_program splash
+                    = potion_program::compile_splash(potion);
+            check(full.potency(5) == 5, "full potency");
+            constexpr int divisor = potion_program::splash_potency_divisor;
+            check(splash.potency(5) == 5 / divisor && splash.potency(1) == 1,
+                  "splash potency divided but at least 1");
+        }
+
+        /**
+         * Splashes a party of three with a potion, and notes where the
+         * random number generator got to
+         */
+        auto splashed(const ingredient_list& potion, const int enemy_type,
+                      const std::uint64_t seed) -> outcome
+        {
+            std::vector<std::unique_ptr<enemy>> owned;
+            enemy_party party;
+            for (int i = 0; i < 3; ++i) {
+                owned.push_back(make_target((enemy_type + i)
+                                            % enemy_type_count()));
+                party.push_back(owned.back().get());
+            }
+            seed_random(seed);
+            potion_program::compile_splash(potion).apply_all(party);
+
+            combat_value health = 0;
+            std::uint64_t hash = 0;
+            for (const enemy* e: party) {
+                health += e->health();
+                hash = hash * 31 + e->state_hash();
+            }
+            return {health, hash, random_int(1, 1000000)};
+        }
+
+        auto apply_all_to_one_is_apply() -> void
+        {
+            const scoped_quiet_output quiet;
+            std::mt19937 engine(36);
+            int mismatches = 0;
+            for (int trial = 0; trial < 1000; ++trial) {
+                std::vector<std::unique_ptr<ingredient>> owned;
+                const ingredient_list potion = random_potion(engine, owned);
+                const auto enemy_type = static_cast<int>(
+                        engine() % static_cast<std::uint32_t>(
+                                           enemy_type_count()));
+                const potion_program program
+                        = trial % 2 == 0
+                                  ? potion_program::compile(potion)
+                                  : potion_program::compile_splash(potion);
+
+                const auto applied = make_target(enemy_type);
+                seed_random(trial);
+                program.apply(*applied);
+                const outcome one{applied->health(), applied->state_hash(),
+                                  random_int(1, 1000000)};
+
+                const auto all = make_target(enemy_type);
+                seed_random(trial);
+                program.apply_all({all.get()});
+                const outcome party_of_one{all->health(), all->state_hash(),
+                                           random_int(1, 1000000)};
+
+                if (one != party_of_one) { ++mismatches; }
+            }
+            check(mismatches == 0,
+                  std::format("{} potions splash a lone target differently "
+                              "from applying to it",
+                              mismatches));
+        }
+
+        auto apply_all_skips_the_dead() -> void
+        {
+            const scoped_quiet_output quiet;
+            std::mt19937 engine(37);
+            int mismatches = 0;
+            for (int trial = 0; trial < 500; ++trial) {
+                std::vector<std::unique_ptr<ingredient>> owned;
+                const potion_program program = potion_program::compile_splash(
+                        random_potion(engine, owned));
+
+                // The same two living targets, with and without a dead one
+                // between them
+                std::vector<std::unique_ptr<enemy>> with;
+                std::vector<std::unique_ptr<enemy>> without;
+                for (int i = 0; i < 3; ++i) {
+                    with.push_back(make_target(i));
+                    if (i != 1) { without.push_back(make_target(i)); }
+                }
+                enemy& dead = *with[1];
+                dead.modify_health(-dead.max_health());
+                const std::uint64_t dead_hash = dead.state_hash();
+
+                seed_random(trial);
+                program.apply_all({with[0].get(), &dead, with[2].get()});
+                const int with_draw = random_int(1, 1000000);
+                seed_random(trial);
+                program.apply_all({without[0].get(), without[1].get()});
+                const int without_draw = random_int(1, 1000000);
+
+                if (dead.state_hash() != dead_hash
+                    || with[0]->state_hash() != without[0]->state_hash()
+                    || with[2]->state_hash() != without[1]->state_hash()
+                    || with_draw != without_draw) {
+                    ++mismatches;
+                }
+            }
+            check(mismatches == 0,
+                  std::format("{} potions touch or draw for a dead target",
+                              mismatches));
+        }
+
+        auto content_ingredients_match_built_ins() -> void
+        {
+            const scoped_quiet_output quiet;
+            const content_library library = content_library::load(
+                    POTMK_RESOURCES_DIR "/content.potmk");
+            std::mt19937 engine(29);
+            int mismatches = 0;
+            for (int trial = 0; trial < 1000; ++trial) {
+                std::vector<std::unique_ptr<ingredient>> owned;
+                ingredient_list built_in;
+                ingredient_list scripted;
+                const auto size = 1 + engine() % 3;
+                for (std::uint32_t i = 0; i < size; ++i) {
+                    const auto type = static_cast<int>(
+                            engine() % static_cast<std::uint32_t>(
+                                               ingredient_type_count()));
+                    const auto potency = static_cast<int>(1 + engine() % 6);
+                    const std::string name = std::format("I{}", i);
+                    owned.emplace_back(
+                            create_ingredient_by_type(type, name, potency));
+                    built_in.push_back(owned.back().get());
+                    owned.emplace_back(library.create_ingredient(
+                            static_cast<std::size_t>(type), name, potency));
+                    scripted.push_back(owned.back().get());
+                }
+                const auto enemy_type = static_cast<int>(
+                        engine() % static_cast<std::uint32_t>(
+                                           enemy_type_count()));
+
+                if (compiled(built_in, enemy_type, trial)
+                            != compiled(scripted, enemy_type, trial)
+                    || splashed(built_in, enemy_type, trial)
+                               != splashed(scripted, enemy_type, trial)) {
+                    ++mismatches;
+                }
+            }
+            check(mismatches == 0,
+                  std::format("{} content file potions differ from the "
+                              "built-in ones",
+                              mismatches));
+        }
+
+        auto expected_damage_matches_estimates() -> void
+        {
+            const content_library library = content_library::load(
+                    POTMK_RESOURCES_DIR "/content.potmk");
+            for (int type = 0; type < ingredient_type_count(); ++type) {
+                for (int potency = 1; potency <= 6; ++potency) {
+                    std::vector<std::unique_ptr<ingredient>> owned;
+                    owned.emplace_back(
+                            create_ingredient_by_type(type, "I", potency));
+                    owned.emplace_back(library.create_ingredient(
+                            static_cast<std::size_t>(type), "I", potency));
+                    const double estimate = owned[0]->expected_value();
+
+                    const potion_program program
+                            = potion_program::compile({owned[0].get()});
+                    check(program.expected_damage(
+                                  ingredient::reference_max_health)
+                                  == estimate,
+                          std::format("type {} potency {}: the compiled "
+                                      "potion is worth the estimate",
+                                      type, potency));
+                    check(owned[1]->expected_value() == estimate,
+                          std::format("type {} potency {}: the content file "
+                                      "values it like the built-in one",
+                                      type, potency));
+                }
+            }
+        }
+
+    } // namespace
+
+} // namespace potmaker
+
+auto main() -> int
+{
+    potmaker::same_as_on_applied();
+    potmaker::splash_potency();
+    potmaker::apply_all_to_one_is_apply();
+    potmaker::apply_all_skips_the_dead();
+    potmaker::content_ingredients_match_built_ins();
+    potmaker::expected_damage_matches_estimates();
+    return potmaker::test::report();
+}
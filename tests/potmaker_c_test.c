@@ -0,0 +1,152 @@
+/*
+ * Drives the game through the C interface only, from C, the way an
+ * embedding program would
+ */
+#include "potmaker_c.h"
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+static int failures = 0;
+
+static void check(const int ok, const char* what, const int line)
+{
+    if (ok) { return; }
+    ++failures;
+    fprintf(stderr, "%s:%d: failed: %s (%s)\n", __FILE__, line, what,
+            potmk_last_error());
+}
+
+#define CHECK(ok, what) check((ok), (what), __LINE__)
+
+/*
+ * Plays a run with basic attacks on the first enemy until it is lost
+ * @return A hash of every state along the way
+ */
+static uint64_t play_run(potmk_session* session, int* wins)
+{
+    potmk_action attack;
+    memset(&attack, 0, sizeof attack);
+    attack.type = POTMK_ACTION_BASIC_ATTACK;
+
+    uint64_t trace = 0;
+    int32_t outcome = POTMK_ONGOING;
+    *wins = 0;
+    for (int step = 0; step < 5000 && outcome != POTMK_LOST; ++step) {
+        if (potmk_step(session, &attack, &outcome) != POTMK_OK) {
+            return 0;
+        }
+        potmk_state state;
+        if (potmk_read_state(session, &state) != POTMK_OK) { return 0; }
+        trace = (trace ^ state.state_hash) * 0x100000001b3ULL;
+        if (outcome == POTMK_WON) { ++*wins; }
+    }
+    return outcome == POTMK_LOST ? trace : 0;
+}
+
+static void reproducible_runs(void)
+{
+    potmk_session* session = potmk_create("Embedder");
+    CHECK(session != NULL, "session created");
+    if (session == NULL) { return; }
+
+    int wins = 0;
+    CHECK(potmk_seed(session, 5) == POTMK_OK, "seed");
+    const uint64_t first = play_run(session, &wins);
+    CHECK(first != 0, "the run ends in a loss");
+
+    potmk_action attack;
+    memset(&attack, 0, sizeof attack);
+    int32_t outcome = 0;
+    CHECK(potmk_step(session, &attack, &outcome) == POTMK_RUN_OVER,
+          "no steps after the run is over");
+
+    int again_wins = 0;
+    CHECK(potmk_seed(session, 5) == POTMK_OK, "seed again");
+    CHECK(play_run(session, &again_wins) == first && again_wins == wins,
+          "same seed, same run");
+
+    potmk_destroy(session);
+}
+
+static void reading_state(void)
+{
+    potmk_session* session = potmk_create("Embedder");
+    CHECK(potmk_seed(session, 8) == POTMK_OK, "seed");
+
+    potmk_state state;
+    CHECK(potmk_read_state(session, &state) == POTMK_OK, "read state");
+    CHECK(state.stage == 1 && state.running && state.health > 0.0,
+          "a run at its first battle");
+
+    size_t count = 0;
+    CHECK(potmk_read_enemies(session, NULL, 0, &count)
+                  == POTMK_BUFFER_TOO_SMALL,
+          "no room for enemies");
+    CHECK(count == state.enemy_count && count > 0, "enemy count");
+
+    potmk_enemy enemies[16];
+    CHECK(potmk_read_enemies(session, enemies, 16, &count) == POTMK_OK,
+          "read enemies");
+    CHECK(enemies[0].health > 0.0 && enemies[0].max_health > 0.0,
+          "enemy stats");
+
+    potmk_stack stacks[64];
+    CHECK(potmk_read_inventory(session, stacks, 64, &count) == POTMK_OK,
+          "read inventory");
+    CHECK(count == state.stack_count, "stack count");
+
+    CHECK(potmk_read_state(NULL, &state) == POTMK_INVALID_ARGUMENT,
+          "no session");
+    CHECK(potmk_read_state(session, NULL) == POTMK_INVALID_ARGUMENT,
+          "no state");
+
+    potmk_destroy(session);
+}
+
+static void save_and_load(void)
+{
+    char path[64];
+    snprintf(path, sizeof path, "/tmp/potmk_c_test_%d.sav", (int)getpid());
+
+    potmk_session* session = potmk_create("Embedder");
+    CHECK(potmk_seed(session, 21) == POTMK_OK, "seed");
+
+    potmk_action attack;
+    memset(&attack, 0, sizeof attack);
+    attack.type = POTMK_ACTION_BASIC_ATTACK;
+    int32_t outcome = POTMK_ONGOING;
+    while (outcome == POTMK_ONGOING) {
+        if (potmk_step(session, &attack, &outcome) != POTMK_OK) { break; }
+    }
+
+    potmk_state saved;
+    CHECK(potmk_read_state(session, &saved) == POTMK_OK, "read state");
+    CHECK(potmk_save(session, path) == POTMK_OK, "save");
+
+    potmk_session* other = potmk_create("Someone else");
+    CHECK(potmk_load(other, path) == POTMK_OK, "load");
+    potmk_state loaded;
+    CHECK(potmk_read_state(other, &loaded) == POTMK_OK, "read loaded state");
+    CHECK(loaded.stage == saved.stage && loaded.gold == saved.gold
+                  && loaded.health == saved.health
+                  && loaded.max_health == saved.max_health
+                  && loaded.stack_count == saved.stack_count,
+          "the loaded run is the saved one");
+    CHECK(potmk_load(other, "/nonexistent/potmk.sav") == POTMK_ERROR,
+          "missing save file");
+
+    potmk_destroy(other);
+    potmk_destroy(session);
+    remove(path);
+}
+
+int main(void)
+{
+    CHECK(potmk_abi_version() == POTMK_ABI_VERSION, "ABI version");
+    reproducible_runs();
+    reading_state();
+    save_and_load();
+    if (failures != 0) { fprintf(stderr, "%d check(s) failed\n", failures); }
+    return failures == 0 ? 0 : 1;
+}
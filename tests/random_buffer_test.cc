@@ -0,0 +1,237 @@
+#include "check.hh"
+#include "random_buffer.hh"
+#include <array>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <utility>
+#include <vector>
+
+namespace potmaker {
+
+    namespace {
+
+        using test::check;
+
+        constexpr std::size_t lanes = random_buffer::lane_count;
+
+        /**
+         * One xoshiro256** generator, written out the textbook way
+         */
+        struct xoshiro {
+            std::array<std::uint64_t, 4> s;
+
+            static auto rotl(const std::uint64_t x, const int k)
+                    -> std::uint64_t
+            {
+                return (x << k) | (x >> (64 - k));
+            }
+
+            auto next() -> std::uint64_t
+            {
+                const std::uint64_t result = rotl(s[1] * 5, 7) * 9;
+                const std::uint64_t t = s[1] << 17;
+                s[2] ^= s[0];
+                s[3] ^= s[1];
+                s[1] ^= s[2];
+                s[0] ^= s[3];
+                s[2] ^= t;
+                s[3] = rotl(s[3], 45);
+                return result;
+            }
+        };
+
+        /**
+         * Seeds the lanes like random_buffer does: splitmix64, one word of
+         * every lane at a time
+         */
+        auto seeded_lanes(std::uint64_t seed) -> std::array<xoshiro, lanes>
+        {
+            std::array<xoshiro, lanes> lane{};
+            for (std::size_t word = 0; word < 4; ++word) {
+                for (xoshiro& gen: lane) {
+                    seed += 0x9e3779b97f4a7c15ULL;
+                    std::uint64_t z = seed;
+                    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+                    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+                    gen.s[word] = z ^ (z >> 31);
+                }
+            }
+            return lane;
+        }
+
+        auto matches_scalar_lanes() -> void
+        {
+            for (const std::uint64_t seed: {0ULL, 1ULL, 0xdeadbeefULL}) {
+                random_buffer buffer(seed);
+                std::array<xoshiro, lanes> lane = seeded_lanes(seed);
+                int mismatches = 0;
+                // Three blocks, so refills are covered
+                for (std::size_t i = 0; i < 3 * random_buffer::block_size;
+                     ++i) {
+                    if (buffer.next() != lane[i % lanes].next()) {
+                        ++mismatches;
+                    }
+                }
+                check(mismatches == 0,
+                      std::format("seed {}: values interleave the lanes",
+                                  seed));
+            }
+        }
+
+        auto seeds_reproduce() -> void
+        {
+            random_buffer a(7);
+            random_buffer b(7);
+            random_buffer other(8);
+            bool same = true;
+            bool differs = false;
+            std::vector<std::uint64_t> first;
+            for (int i = 0; i < 3000; ++i) {
+                const std::uint64_t value = a.next();
+                first.push_back(value);
+                same = same && value == b.next();
+                differs = differs || value != other.next();
+            }
+            check(same, "the same seed gives the same values");
+            check(differs, "another seed gives other values");
+
+            other.reseed(7);
+            bool reseeded = true;
+            for (const std::uint64_t value: first) {
+                reseeded = reseeded && value == other.next();
+            }
+            check(reseeded, "reseeding restarts the sequence");
+
+            // Capture part way into a block and replay from there
+            for (int i = 0; i < 100; ++i) { (void) a.next(); }
+            const random_state saved = a.state();
+            std::vector<std::uint64_t> after;
+            for (int i = 0; i < 2000; ++i) { after.push_back(a.next()); }
+            random_buffer restored(99);
+            restored.restore(saved);
+            bool replayed = true;
+            for (const std::uint64_t value: after) {
+                replayed = replayed && value == restored.next();
+            }
+            check(replayed, "restoring a state replays what followed it");
+        }
+
+        auto fill_ints_matches_int_in() -> void
+        {
+            const std::array<std::pair<int, int>, 7> ranges{{
+                    {1, 6},
+                    {-20, 20},
+                    {5, 5},
+                    {0, 1},
+                    {INT_MIN, INT_MAX},
+                    {INT_MIN, INT_MIN + 2},
+                    {-1, INT_MAX},
+            }};
+            for (const auto& [min, max]: ranges) {
+                random_buffer one_by_one(3);
+                random_buffer filled(3);
+                // Longer than a block, starting part way into one
+                (void) one_by_one.next();
+                (void) filled.next();
+                std::vector<int> values(1500);
+                filled.fill_ints(values, min, max);
+
+                bool same = true;
+                for (const int value: values) {
+                    same = same && value == one_by_one.int_in(min, max);
+                }
+                check(same && filled.next() == one_by_one.next(),
+                      std::format("[{}, {}]: fill_ints makes the same draws "
+                                  "as int_in",
+                                  min, max));
+            }
+        }
+
+        auto bounded_ints_in_range() -> void
+        {
+            random_buffer buffer(11);
+
+            bool fixed = true;
+            for (int i = 0; i < 100; ++i) {
+                fixed = fixed && buffer.int_in(5, 5) == 5
+                        && buffer.int_in(INT_MIN, INT_MIN) == INT_MIN
+                        && buffer.int_in(INT_MAX, INT_MAX) == INT_MAX;
+            }
+            check(fixed, "min == max always gives min");
+
+            // Every value shows up about as often as the others
+            constexpr int sides = 6;
+            constexpr int draws = 60000;
+            std::array<int, sides> counts{};
+            bool inside = true;
+            for (int i = 0; i < draws; ++i) {
+                const int value = buffer.int_in(1, sides);
+                if (value < 1 || value > sides) {
+                    inside = false;
+                    continue;
+                }
+                ++counts[static_cast<std::size_t>(value - 1)];
+            }
+            check(inside, "die rolls stay within [1, 6]");
+            for (const int count: counts) {
+                check(count > draws / sides * 9 / 10
+                              && count < draws / sides * 11 / 10,
+                      std::format("a side came up {} times", count));
+            }
+
+            // The full range reaches both signs, and narrow ranges at its
+            // ends never overflow
+            bool negative = false;
+            bool positive = false;
+            bool edges = true;
+            for (int i = 0; i < 1000; ++i) {
+                const int value = buffer.int_in(INT_MIN, INT_MAX);
+                negative = negative || value < 0;
+                positive = positive || value > 0;
+                const int low = buffer.int_in(INT_MIN, INT_MIN + 1);
+                const int high = buffer.int_in(INT_MAX - 1, INT_MAX);
+                edges = edges && low <= INT_MIN + 1 && high >= INT_MAX - 1;
+            }
+            check(negative && positive, "the full range covers both signs");
+            check(edges, "ranges at the ends of int stay inside them");
+
+            bool bounded = true;
+            for (const std::uint32_t range: {1U, 2U, 3U, 1000U, UINT32_MAX}) {
+                for (int i = 0; i < 1000; ++i) {
+                    bounded = bounded && buffer.bounded(range) < range;
+                }
+            }
+            check(bounded, "bounded stays below its range");
+        }
+
+        auto unit_doubles() -> void
+        {
+            random_buffer one_by_one(5);
+            random_buffer filled(5);
+            std::vector<double> values(2500);
+            filled.fill_unit_doubles(values);
+            bool same = true;
+            bool inside = true;
+            for (const double value: values) {
+                same = same && value == one_by_one.unit_double();
+                inside = inside && value >= 0.0 && value < 1.0;
+            }
+            check(same, "fill_unit_doubles matches unit_double");
+            check(inside, "unit doubles lie in [0, 1)");
+        }
+
+    } // namespace
+
+} // namespace potmaker
+
+auto main() -> int
+{
+    potmaker::matches_scalar_lanes();
+    potmaker::seeds_reproduce();
+    potmaker::fill_ints_matches_int_in();
+    potmaker::bounded_ints_in_range();
+    potmaker::unit_doubles();
+    return potmaker::test::report();
+}
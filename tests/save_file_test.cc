@@ -0,0 +1,151 @@
+#include "check.hh"
+#include "potionmaker_game.hh"
+#include "save_file.hh"
+#include "status_effect.hh"
+#include "util.hh"
+#include <cstddef>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+namespace potmaker {
+
+    namespace {
+
+        using test::check;
+
+        auto records_round_trip(const std::string& path) -> void
+        {
+            save::writer out;
+            out.header().stage = 7;
+            out.header().gold = 42.5;
+            out.header().run_id = 99;
+            out.add_ingredient(3, 2, "Ember");
+            out.add_ingredient(5, 1, "Mint");
+            out.add_shop_item(1, 4, "Frost", 17.5);
+            out.add_effect(2, 3, 5);
+            out.add_recipe("Fire and ice");
+            out.add_recipe_slot(3, 1, 2);
+            out.add_recipe_slot(1, 2, 4);
+            out.write(path);
+
+            const save::reader in(path);
+            check(in.header().version == save::format_version, "version");
+            check(in.header().stage == 7, "stage");
+            check(in.header().gold == 42.5, "gold");
+            check(in.header().run_id == 99, "run id");
+            check(in.ingredients().size() == 2, "ingredient count");
+            check(in.ingredients()[1].type == 5
+                          && in.ingredients()[1].potency == 1,
+                  "ingredient fields");
+            check(in.string_at(in.ingredients()[0].name_offset,
+                               in.ingredients()[0].name_length)
+                          == "Ember",
+                  "ingredient name");
+            check(in.shop_items().size() == 1
+                          && in.shop_items()[0].price == 17.5,
+                  "shop item");
+            check(in.effects().size() == 1 && in.effects()[0].kind == 2
+                          && in.effects()[0].turns == 3
+                          && in.effects()[0].potency == 5,
+                  "effect");
+            check(in.recipes().size() == 1
+                          && in.recipes()[0].slot_count == 2,
+                  "recipe");
+            check(in.string_at(in.recipes()[0].name_offset,
+                               in.recipes()[0].name_length)
+                          == "Fire and ice",
+                  "recipe name");
+            check(in.recipe_slots().size() == 2
+                          && in.recipe_slots()[1].potency == 4,
+                  "recipe slots");
+        }
+
+        auto damaged_files_rejected(const std::string& path) -> void
+        {
+            save::writer out;
+            out.add_ingredient(3, 2, "Ember");
+            out.write(path);
+
+            const auto size = std::filesystem::file_size(path);
+            std::filesystem::resize_file(path, size - 8);
+            test::check_throws<std::runtime_error>(
+                    [&] { const save::reader in(path); }, "truncated file");
+
+            out.write(path);
+            {
+                std::fstream file(path, std::ios::in | std::ios::out
+                                                | std::ios::binary);
+                file.put('X');
+            }
+            test::check_throws<std::runtime_error>(
+                    [&] { const save::reader in(path); }, "bad magic");
+        }
+
+        auto game_round_trip(const std::string& path) -> void
+        {
+            const scoped_quiet_output quiet;
+            seed_random(11);
+            game_state saved("Tester");
+            saved.begin_battle();
+            saved.end_battle(true);
+            saved.buy_planned();
+            saved.current_player().add_status_effect(
+                    make_status_effect(4, 3, 2));
+            saved.save_game(path);
+            const int next_draw = random_int(1, 1000000);
+
+            seed_random(12);
+            game_state loaded("Someone else");
+            loaded.load_game(path);
+            check(loaded.stage() == saved.stage(), "game stage");
+            check(loaded.current_player().gold()
+                          == saved.current_player().gold(),
+                  "game gold");
+            check(loaded.current_player().name()
+                          == saved.current_player().name(),
+                  "player name");
+            check(loaded.state_hash({}) == saved.state_hash({}),
+                  "player, effects and inventory");
+            check(random_int(1, 1000000) == next_draw, "random state");
+        }
+
+        auto bad_games_rejected(const std::string& path) -> void
+        {
+            const scoped_quiet_output quiet;
+            game_state game("Tester");
+            const auto rejected = [&](const int type, const int stage,
+                                      const std::string_view what) {
+                save::writer out;
+                save::header& h = out.header();
+                h.stage = stage;
+                out.add_ingredient(type, 2, "Ember");
+                out.write(path);
+                test::check_throws<std::runtime_error>(
+                        [&] { game.load_game(path); }, what);
+            };
+            rejected(-1, 1, "negative ingredient type");
+            rejected(ingredient_type_count(), 1, "unknown ingredient type");
+            rejected(0, 0, "stage 0");
+            rejected(0, -3, "negative stage");
+            check(game.stage() == 1 && game.current_player().name() == "Tester",
+                  "a rejected save leaves the game alone");
+        }
+
+    } // namespace
+
+} // namespace potmaker
+
+auto main() -> int
+{
+    const std::string path = potmaker::test::temp_path("save.sav");
+    potmaker::records_round_trip(path);
+    potmaker::damaged_files_rejected(path);
+    potmaker::game_round_trip(path);
+    potmaker::bad_games_rejected(path);
+    std::remove(path.c_str());
+    return potmaker::test::report();
+}
@@ -0,0 +1,116 @@
+#include "check.hh"
+#include "shm_channel.hh"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace potmaker {
+
+    namespace {
+
+        using test::check;
+
+        using record = std::array<std::uint64_t, 2>;
+
+        constexpr std::size_t record_count = 10000;
+        // Far more than the rings hold, so both sides wait on each other
+        constexpr std::size_t send_batch = 700;
+        constexpr std::size_t echo_batch = 50;
+
+        /**
+         * The other process: sends back every record it gets, changed so
+         * that the echo cannot be mistaken for the original, until the
+         * channel closes
+         */
+        auto echo(const std::string& name) -> int
+        {
+            shm_channel channel(name);
+            std::vector<record> batch(echo_batch);
+            while (channel.inbound().read(std::as_writable_bytes(
+                    std::span(batch)))) {
+                for (record& r: batch) { r[1] = ~r[1]; }
+                if (!channel.outbound().write(
+                            std::as_bytes(std::span(batch)))) {
+                    break;
+                }
+            }
+            return 0;
+        }
+
+        auto round_trip(const std::string& name) -> void
+        {
+            shm_channel channel(name, {64, sizeof(record), sizeof(record)});
+            const pid_t child = ::fork();
+            if (child == 0) { ::_exit(echo(name)); }
+
+            std::vector<record> sent(record_count);
+            for (std::size_t i = 0; i < record_count; ++i) {
+                sent[i] = {i, i * 0x9e3779b97f4a7c15ULL};
+            }
+            std::jthread writer([&] {
+                for (std::size_t i = 0; i < record_count; i += send_batch) {
+                    const std::size_t n = std::min(send_batch,
+                                                   record_count - i);
+                    if (!channel.outbound().write(std::as_bytes(
+                                std::span(sent).subspan(i, n)))) {
+                        return;
+                    }
+                }
+            });
+
+            std::vector<record> echoed(record_count);
+            check(channel.inbound().read(
+                          std::as_writable_bytes(std::span(echoed))),
+                  "every record came back");
+            writer.join();
+
+            bool same = true;
+            for (std::size_t i = 0; i < record_count; ++i) {
+                same = same && echoed[i][0] == sent[i][0]
+                       && echoed[i][1] == ~sent[i][1];
+            }
+            check(same, "records came back whole and in order");
+
+            // The echo is waiting for more, and closing wakes it up
+            channel.close();
+            int status = 0;
+            ::waitpid(child, &status, 0);
+            check(WIFEXITED(status) && WEXITSTATUS(status) == 0,
+                  "the other side noticed the channel closing");
+
+            std::vector<record> more(1);
+            check(!channel.inbound().read(
+                          std::as_writable_bytes(std::span(more))),
+                  "reads fail once closed");
+        }
+
+        auto bad_channels_rejected(const std::string& name) -> void
+        {
+            test::check_throws<std::runtime_error>(
+                    [&] { const shm_channel missing(name + "_missing"); },
+                    "no such channel");
+            test::check_throws<std::runtime_error>(
+                    [&] { const shm_channel empty(name, {0, 8, 8}); },
+                    "empty rings");
+        }
+
+    } // namespace
+
+} // namespace potmaker
+
+auto main() -> int
+{
+    const std::string name = std::format("/potmk_test_{}", ::getpid());
+    potmaker::round_trip(name);
+    potmaker::bad_channels_rejected(name);
+    return potmaker::test::report();
+}
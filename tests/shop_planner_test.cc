@@ -0,0 +1,114 @@
+#include "check.hh"
+#include "shop_planner.hh"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <random>
+#include <vector>
+
+namespace potmaker {
+
+    namespace {
+
+        using test::check;
+
+        /**
+         * @return The best score of any basket, trying every one. Harmful
+         * items are never bought, as the planner promises
+         */
+        auto brute_force(const shop_planner& planner,
+                         const std::vector<shop_offer>& offers,
+                         const double gold) -> double
+        {
+            double best = 0.0;
+            const std::uint32_t baskets = std::uint32_t{1} << offers.size();
+            for (std::uint32_t basket = 1; basket < baskets; ++basket) {
+                double cost = 0.0;
+                double value = 0.0;
+                bool allowed = true;
+                for (std::size_t i = 0; i < offers.size(); ++i) {
+                    if ((basket >> i & 1) == 0) { continue; }
+                    cost += offers[i].price;
+                    value += offers[i].value;
+                    allowed = allowed && offers[i].value >= 0.0;
+                }
+                if (!allowed || cost > gold) { continue; }
+                best = std::max(best,
+                                value + planner.continuation_value(gold
+                                                                   - cost));
+            }
+            return best;
+        }
+
+        auto matches_brute_force() -> void
+        {
+            std::mt19937 engine(31);
+            int worse = 0;
+            int inconsistent = 0;
+            for (int trial = 0; trial < 300; ++trial) {
+                std::vector<restock_outcome> restock;
+                const auto kinds = 1 + engine() % 5;
+                for (std::uint32_t i = 0; i < kinds; ++i) {
+                    const auto cost = static_cast<double>(5 + engine() % 30);
+                    const auto value
+                            = static_cast<double>(engine() % 60) - 10.0;
+                    restock.push_back({1.0 / kinds, cost, value});
+                }
+                const double gold = static_cast<double>(engine() % 150);
+                const shop_planner planner(restock, gold);
+
+                std::vector<shop_offer> offers;
+                const auto count = engine() % 11;
+                for (std::uint32_t i = 0; i < count; ++i) {
+                    offers.push_back(
+                            {static_cast<double>(1 + engine() % 40),
+                             static_cast<double>(engine() % 55) - 5.0});
+                }
+
+                const shop_plan plan = planner.plan(offers, gold);
+                if (std::abs(plan.value + plan.continuation
+                             - brute_force(planner, offers, gold))
+                    > 1e-9) {
+                    ++worse;
+                }
+
+                double cost = 0.0;
+                double value = 0.0;
+                for (const std::size_t pick: plan.picks) {
+                    cost += offers.at(pick).price;
+                    value += offers.at(pick).value;
+                }
+                if (cost != plan.cost || value != plan.value || cost > gold
+                    || !std::ranges::is_sorted(plan.picks, std::greater<>())
+                    || std::ranges::adjacent_find(plan.picks)
+                               != plan.picks.end()) {
+                    ++inconsistent;
+                }
+            }
+            check(worse == 0, "plans as good as the best basket");
+            check(inconsistent == 0, "picks add up to the plan");
+        }
+
+        auto continuation() -> void
+        {
+            // One item that always restocks, for 10 gold and worth 3
+            const std::vector<restock_outcome> restock{{1.0, 10.0, 3.0}};
+            const shop_planner planner(restock, 100.0);
+            check(planner.continuation_value(9.5) == 0.0, "too poor");
+            check(planner.continuation_value(35.0) == 9.0,
+                  "buys as many as the gold lasts");
+            check(planner.continuation_value(-1.0) == 0.0, "no gold");
+        }
+
+    } // namespace
+
+} // namespace potmaker
+
+auto main() -> int
+{
+    potmaker::matches_brute_force();
+    potmaker::continuation();
+    return potmaker::test::report();
+}
@@ -0,0 +1,299 @@
+#include "balance.hh"
+#include "check.hh"
+#include "potionmaker_game.hh"
+#include "simulation.hh"
+#include "util.hh"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <initializer_list>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace potmaker {
+
+    namespace {
+
+        using test::check;
+
+        auto near(const double a, const double b) -> bool
+        {
+            return std::abs(a - b) < 1e-9;
+        }
+
+        /**
+         * Adds one unit per list of values, all to one stratum
+         */
+        auto add_units(mean_estimator& estimator,
+                       const std::initializer_list<std::vector<double>> units,
+                       const std::size_t stratum) -> void
+        {
+            for (const std::vector<double>& values: units) {
+                estimator.add(values, stratum);
+            }
+        }
+
+        auto plain_units() -> void
+        {
+            check(mean_estimator().result().mean == 0.0
+                          && mean_estimator().result().effective_samples
+                                     == 0.0,
+                  "nothing added estimates nothing");
+
+            mean_estimator plain;
+            add_units(plain, {{1.0}, {2.0}, {3.0}, {4.0}}, 0);
+            const estimate e = plain.result();
+            check(near(plain.run_variance(), 5.0 / 3.0), "run variance");
+            check(near(e.mean, 2.5)
+                          && near(e.standard_error, std::sqrt(5.0 / 12.0)),
+                  "plain mean and standard error");
+            check(near(e.effective_samples, 4.0),
+                  "plain runs are worth themselves");
+
+            mean_estimator flat;
+            add_units(flat, {{7.0}, {7.0}, {7.0}}, 0);
+            check(flat.result().standard_error == 0.0
+                          && flat.result().effective_samples == 3.0,
+                  "without any spread every run counts once");
+        }
+
+        auto paired_units() -> void
+        {
+            // Pairs that pull against each other: the units vary less than
+            // the runs, so each run is worth more than a plain one
+            mean_estimator pairs;
+            add_units(pairs, {{1.0, 3.0}, {2.0, 4.0}}, 0);
+            const estimate e = pairs.result();
+            check(near(e.mean, 2.5), "paired mean");
+            check(near(e.standard_error, 0.5), "spread of the unit means");
+            check(near(e.effective_samples, (5.0 / 3.0) / 0.25),
+                  "effective runs measured against the run variance");
+            check(near(pairs.result(1.0).effective_samples, 4.0),
+                  "or against a given variance");
+        }
+
+        auto stratified_units() -> void
+        {
+            // Strata weigh evenly however many units they hold
+            mean_estimator strata(2);
+            add_units(strata, {{0.0}, {2.0}}, 0);
+            add_units(strata, {{10.0}, {14.0}, {12.0}, {12.0}}, 1);
+            const estimate e = strata.result();
+            const double variance
+                    = 0.25 * 2.0 / 2.0 + 0.25 * (8.0 / 3.0) / 4.0;
+            check(near(e.mean, 0.5 * 1.0 + 0.5 * 12.0), "strata weigh evenly");
+            check(near(e.standard_error, std::sqrt(variance)),
+                  "variance within strata only");
+            check(near(e.effective_samples, strata.run_variance() / variance),
+                  "stratified effective runs");
+
+            test::check_throws<std::out_of_range>(
+                    [&] { strata.add(std::vector{1.0}, 2); },
+                    "a stratum out of range");
+        }
+
+        auto thin_strata_pool() -> void
+        {
+            // A stratum with a single unit has no variance of its own, so
+            // all units count as plain draws
+            mean_estimator strata(2);
+            add_units(strata, {{0.0}, {2.0}}, 0);
+            add_units(strata, {{10.0}}, 1);
+            const estimate e = strata.result();
+            check(near(e.mean, 4.0), "pooled mean");
+            check(near(e.standard_error, std::sqrt(28.0 / 3.0)),
+                  "pooled standard error");
+
+            // So does an empty one, which even weighing would leave out
+            mean_estimator empty(3);
+            add_units(empty, {{1.0}, {3.0}}, 0);
+            add_units(empty, {{5.0}, {7.0}, {9.0}}, 2);
+            check(near(empty.result().mean, 5.0),
+                  "an empty stratum pools the others");
+        }
+
+        auto strata_must_be_covered() -> void
+        {
+            const simulation_limits limits{.max_stage = 3};
+            variance_reduction reduction;
+            reduction.stratified_enemies = 1;
+            const auto strata = static_cast<std::uint64_t>(enemy_type_count());
+            test::check_throws<std::invalid_argument>(
+                    [&] {
+                        estimate_runs(1, 2 * strata - 1, 1, limits, reduction);
+                    },
+                    "a stratum with a single run");
+            reduction.antithetic = true;
+            test::check_throws<std::invalid_argument>(
+                    [&] {
+                        estimate_runs(1, 4 * strata - 2, 1, limits, reduction);
+                    },
+                    "a stratum with a single antithetic pair");
+            test::check_throws<std::invalid_argument>(
+                    [&] {
+                        compare_balances(active_balance(), active_balance(), 1,
+                                         2 * strata, 1, limits, reduction);
+                    },
+                    "comparing with a thin stratum");
+            reduction.stratified_enemies = max_stratified_enemies + 1;
+            test::check_throws<std::invalid_argument>(
+                    [&] { (void) sampling_for(reduction, 0); },
+                    "too many stratified enemies");
+
+            reduction.stratified_enemies = 1;
+            const run_estimates covered
+                    = estimate_runs(1, 4 * strata, 1, limits, reduction);
+            check(covered.stage_reached.mean > 0.0,
+                  "two units per stratum are enough");
+        }
+
+        /**
+         * @return Whether two estimates of one mean agree within four of
+         * their combined standard errors
+         */
+        auto agree(const estimate& a, const estimate& b) -> bool
+        {
+            const double error = std::sqrt(a.standard_error * a.standard_error
+                                           + b.standard_error
+                                                     * b.standard_error);
+            return std::abs(a.mean - b.mean) <= 4.0 * error;
+        }
+
+        auto reductions_are_unbiased() -> void
+        {
+            constexpr std::uint64_t runs = 1000;
+            const simulation_limits limits{.max_stage = 10};
+            const run_estimates plain = estimate_runs(1, runs, 0, limits);
+
+            std::vector<std::pair<const char*, variance_reduction>> reductions(
+                    3);
+            reductions[0].first = "common random numbers";
+            reductions[0].second.common_random_numbers = true;
+            reductions[1].first = "antithetic pairs";
+            reductions[1].second.antithetic = true;
+            reductions[2].first = "stratified enemies";
+            reductions[2].second.stratified_enemies = 1;
+            for (const auto& [what, reduction]: reductions) {
+                // Other seeds, so the estimates are independent
+                const run_estimates reduced
+                        = estimate_runs(100001, runs, 0, limits, reduction);
+                check(agree(reduced.stage_reached, plain.stage_reached)
+                              && agree(reduced.turns, plain.turns)
+                              && agree(reduced.gold, plain.gold),
+                      std::format("{} estimate the plain means", what));
+                check(reduced.stage_reached.standard_error > 0.0
+                              && reduced.stage_reached.effective_samples > 0.0,
+                      std::format("{} measure their precision", what));
+            }
+        }
+
+        auto same_balance_differs_by_nothing() -> void
+        {
+            variance_reduction reduction;
+            reduction.common_random_numbers = true;
+            const run_estimates difference = compare_balances(
+                    active_balance(), active_balance(), 1, 200, 0,
+                    {.max_stage = 10}, reduction);
+            for (const estimate& e: {difference.stage_reached,
+                                     difference.turns, difference.gold}) {
+                check(e.mean == 0.0 && e.standard_error == 0.0,
+                      "a balance compared with itself");
+            }
+        }
+
+        auto even_bias_draws_plainly() -> void
+        {
+            // No tilts and even weights describe the plain draws, so runs
+            // drawn with them are the plain ones, weighed by one
+            importance_bias even;
+            even.enemy_weights.assign(
+                    static_cast<std::size_t>(enemy_type_count()), 2.0);
+            const importance_bias none;
+            int differing = 0;
+            int weighed = 0;
+            for (std::uint64_t seed = 1; seed <= 30; ++seed) {
+                const run_summary plain = simulate_run(seed);
+                for (const importance_bias* bias:
+                     std::array<const importance_bias*, 2>{&even, &none}) {
+                    run_sampling sampling;
+                    sampling.bias = bias;
+                    const run_summary run
+                            = simulate_run(seed, {}, false, sampling);
+                    if (run.stage_reached != plain.stage_reached
+                        || run.turns != plain.turns || run.gold != plain.gold
+                        || run.enemies_by_type != plain.enemies_by_type) {
+                        ++differing;
+                    }
+                    if (run.log_weight != 0.0) { ++weighed; }
+                }
+            }
+            check(differing == 0,
+                  std::format("{} runs went otherwise than plainly",
+                              differing));
+            check(weighed == 0,
+                  std::format("{} runs weighed other than one", weighed));
+        }
+
+        auto weighed_depth_is_unbiased() -> void
+        {
+            const simulation_limits limits{.max_stage = 8};
+            importance_bias bias;
+            bias.enemy_weights.assign(
+                    static_cast<std::size_t>(enemy_type_count()), 1.0);
+            bias.enemy_weights[0] = 1.5;
+            bias.enemy_weights[1] = 0.75;
+            bias.tilts = {0.1, -0.1};
+
+            const depth_estimates plain = estimate_depth(1, 1000, {}, 0,
+                                                         limits);
+            // Other seeds, so the estimates are independent
+            const depth_estimates weighed = estimate_depth(200001, 1000, bias,
+                                                           0, limits);
+            check(plain.effective_runs == 1000.0,
+                  "plain runs are worth themselves");
+            check(weighed.effective_runs > 0.0
+                          && weighed.effective_runs < 1000.0,
+                  "weighed runs are worth fewer plain ones");
+
+            const auto agree = [](const interval_estimate& a,
+                                  const interval_estimate& b) {
+                const double error = std::sqrt(
+                        a.standard_error * a.standard_error
+                        + b.standard_error * b.standard_error);
+                return std::abs(a.value - b.value) <= 4.0 * error;
+            };
+            const std::size_t stages
+                    = std::min(plain.stages.size(), weighed.stages.size());
+            check(stages >= 5, "runs get past the first stages");
+            for (std::size_t s = 0; s < stages; ++s) {
+                check(agree(plain.stages[s].reached, weighed.stages[s].reached),
+                      std::format("stage {} is reached as often", s + 1));
+                if (plain.stages[s].win_rate.standard_error > 0.0) {
+                    check(agree(plain.stages[s].win_rate,
+                                weighed.stages[s].win_rate),
+                          std::format("stage {} is won as often", s + 1));
+                }
+            }
+        }
+
+    } // namespace
+
+} // namespace potmaker
+
+auto main() -> int
+{
+    potmaker::plain_units();
+    potmaker::paired_units();
+    potmaker::stratified_units();
+    potmaker::thin_strata_pool();
+    potmaker::strata_must_be_covered();
+    potmaker::reductions_are_unbiased();
+    potmaker::same_balance_differs_by_nothing();
+    potmaker::even_bias_draws_plainly();
+    potmaker::weighed_depth_is_unbiased();
+    return potmaker::test::report();
+}
@@ -0,0 +1,108 @@
+#include "check.hh"
+#include "sketches.hh"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+namespace potmaker {
+
+    namespace {
+
+        using test::check;
+
+        constexpr int value_count = 100000;
+
+        /**
+         * @return Whether a digest's quantiles of 1 to value_count land
+         * within a tolerance of the true ones
+         */
+        auto accurate(const t_digest& digest, const double tolerance) -> bool
+        {
+            for (const double q: {0.001, 0.01, 0.1, 0.5, 0.9, 0.99, 0.999}) {
+                const double truth = q * value_count;
+                if (std::abs(digest.quantile(q) - truth)
+                    > tolerance * value_count) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        auto digest_merges() -> void
+        {
+            std::vector<double> values;
+            for (int i = 1; i <= value_count; ++i) { values.push_back(i); }
+            std::mt19937 engine(37);
+            std::ranges::shuffle(values, engine);
+
+            t_digest whole;
+            t_digest first;
+            t_digest second;
+            for (std::size_t i = 0; i < values.size(); ++i) {
+                whole.add(values[i]);
+                (i % 3 == 0 ? first : second).add(values[i]);
+            }
+            check(accurate(whole, 0.005), "quantiles");
+
+            first.merge(second);
+            check(first.count() == whole.count(), "merged count");
+            check(first.min() == 1 && first.max() == value_count,
+                  "merged extremes");
+            check(std::abs(first.mean() - whole.mean()) < 1e-6 * value_count,
+                  "merged mean");
+            check(accurate(first, 0.005), "merged quantiles");
+
+            // Merging a digest into itself counts every value twice
+            const double median = whole.quantile(0.5);
+            whole.merge(whole);
+            check(whole.count() == 2.0 * value_count, "self-merge count");
+            check(whole.min() == 1 && whole.max() == value_count,
+                  "self-merge extremes");
+            check(std::abs(whole.quantile(0.5) - median)
+                          < 0.005 * value_count,
+                  "self-merge keeps the distribution");
+
+            t_digest empty;
+            check(std::isnan(empty.quantile(0.5)), "no values");
+            empty.merge(empty);
+            check(empty.count() == 0.0, "empty self-merge");
+        }
+
+        auto distinct_count_merges() -> void
+        {
+            hyperloglog whole;
+            hyperloglog first;
+            hyperloglog second;
+            for (std::uint64_t i = 0; i < value_count; ++i) {
+                whole.add(i);
+                // Overlapping halves, each seeing some values twice
+                if (i < 60000) { first.add(i); }
+                if (i >= 40000) { second.add(i); }
+                if (i % 2 == 0) { first.add(i); }
+            }
+            check(std::abs(whole.estimate() - value_count)
+                          < 0.05 * value_count,
+                  "distinct count");
+
+            first.merge(second);
+            check(first.estimate() == whole.estimate(),
+                  "merge sees the union");
+
+            const double before = whole.estimate();
+            whole.merge(whole);
+            check(whole.estimate() == before, "self-merge changes nothing");
+        }
+
+    } // namespace
+
+} // namespace potmaker
+
+auto main() -> int
+{
+    potmaker::digest_merges();
+    potmaker::distinct_count_merges();
+    return potmaker::test::report();
+}
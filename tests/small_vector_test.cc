@@ -0,0 +1,149 @@
+#include "check.hh"
+#include "small_vector.hh"
+#include <algorithm>
+#include <cstddef>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace potmaker {
+
+    namespace {
+
+        using test::check;
+
+        /**
+         * Counts how many of its kind are alive, to catch elements that
+         * are never destroyed or destroyed twice
+         */
+        struct tracked {
+            static inline int alive = 0;
+
+            explicit tracked(const int v = 0) : value(v) { ++alive; }
+            tracked(const tracked& other) : value(other.value) { ++alive; }
+            tracked(tracked&& other) noexcept : value(other.value)
+            {
+                ++alive;
+            }
+            auto operator=(const tracked&) -> tracked& = default;
+            auto operator=(tracked&&) noexcept -> tracked& = default;
+            ~tracked() { --alive; }
+
+            auto operator==(const tracked& other) const -> bool
+            {
+                return value == other.value;
+            }
+
+            int value;
+        };
+
+        auto inline_until_full() -> void
+        {
+            small_vector<int, 4> v;
+            for (int i = 0; i < 4; ++i) { v.push_back(i); }
+            check(v.is_inline() && v.capacity() == 4, "inline while it fits");
+            v.push_back(4);
+            check(!v.is_inline() && v.size() == 5, "spills past capacity");
+            check(std::ranges::equal(v, std::vector{0, 1, 2, 3, 4}),
+                  "elements kept when spilling");
+
+            // An argument that refers to an element survives the spill
+            small_vector<std::string, 2> names{"first", "second"};
+            names.push_back(names[0]);
+            check(names.size() == 3 && names[2] == "first",
+                  "push of its own element");
+        }
+
+        auto copies_and_moves() -> void
+        {
+            {
+                small_vector<tracked, 3> small;
+                small.emplace_back(1);
+                small.emplace_back(2);
+                small_vector<tracked, 3> big;
+                for (int i = 0; i < 6; ++i) { big.emplace_back(i); }
+
+                small_vector<tracked, 3> copy = big;
+                check(std::ranges::equal(copy, big), "copy");
+
+                small_vector<tracked, 3> moved_small = std::move(small);
+                small_vector<tracked, 3> moved_big = std::move(big);
+                check(moved_small.size() == 2 && moved_small[1].value == 2
+                              && moved_small.is_inline(),
+                      "move of an inline vector");
+                check(moved_big.size() == 6 && moved_big[5].value == 5,
+                      "move of a spilled vector");
+                check(small.empty() && big.empty() && big.is_inline(),
+                      "moved-from vectors are empty");
+
+                copy = moved_small;
+                check(std::ranges::equal(copy, moved_small), "copy assign");
+                copy = std::move(moved_big);
+                check(copy.size() == 6, "move assign");
+            }
+            check(tracked::alive == 0, "every element destroyed");
+        }
+
+        auto matches_std_vector() -> void
+        {
+            std::mt19937 engine(17);
+            {
+                small_vector<tracked, 4> v;
+                std::vector<int> expected;
+                for (int step = 0; step < 5000; ++step) {
+                    const auto op = engine() % 6;
+                    const int value = static_cast<int>(engine() % 100);
+                    if (op <= 1 || expected.empty()) {
+                        v.emplace_back(value);
+                        expected.push_back(value);
+                    }
+                    else if (op == 2) {
+                        v.pop_back();
+                        expected.pop_back();
+                    }
+                    else if (op == 3) {
+                        const auto at = static_cast<std::ptrdiff_t>(
+                                engine() % expected.size());
+                        v.erase(v.begin() + at);
+                        expected.erase(expected.begin() + at);
+                    }
+                    else if (op == 4) {
+                        const auto size = engine() % 12;
+                        v.resize(size);
+                        expected.resize(size);
+                    }
+                    else {
+                        erase_if(v, [](const tracked& x) {
+                            return x.value % 2 == 1;
+                        });
+                        std::erase_if(expected, [](const int x) {
+                            return x % 2 == 1;
+                        });
+                    }
+
+                    if (!std::ranges::equal(v, expected,
+                                            [](const tracked& a, const int b) {
+                                                return a.value == b;
+                                            })) {
+                        check(false, "same elements as std::vector");
+                        break;
+                    }
+                }
+                v.clear();
+                check(v.empty(), "clear");
+            }
+            check(tracked::alive == 0, "no element leaked");
+        }
+
+    } // namespace
+
+} // namespace potmaker
+
+auto main() -> int
+{
+    potmaker::inline_until_full();
+    potmaker::copies_and_moves();
+    potmaker::matches_std_vector();
+    return potmaker::test::report();
+}
@@ -0,0 +1,137 @@
+#include "check.hh"
+#include "combat_math.hh"
+#include "entity.hh"
+#include "potionmaker_game.hh"
+#include "state_hash.hh"
+#include "status_effect.hh"
+#include "util.hh"
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <memory>
+#include <random>
+#include <variant>
+
+namespace potmaker {
+
+    namespace {
+
+        using test::check;
+
+        auto make_enemy(const int type) -> std::unique_ptr<enemy>
+        {
+            return std::unique_ptr<enemy>(create_enemy_by_type(
+                    type, "Target", 3, enemy_rolls{0.5, 0.5}));
+        }
+
+        auto health_key(const entity& e) -> std::uint64_t
+        {
+            return hash_key(hash_part::health,
+                            static_cast<std::uint64_t>(whole_part(e.health())));
+        }
+
+        /**
+         * Hashes an enemy from scratch, from what can be seen of it
+         * @param identity The part of the hash that never changes
+         * @param ticks How many times the enemy has ticked
+         */
+        auto rehash(enemy& e, const std::uint64_t identity,
+                    const std::uint32_t ticks) -> std::uint64_t
+        {
+            std::uint64_t hash = identity ^ health_key(e)
+                                 ^ hash_key(hash_part::tick, ticks);
+            for (const status_effect_variant& effect: e.status_effects()) {
+                const int potency = std::visit(
+                        [](const auto& current) { return current.potency(); },
+                        effect);
+                const auto expiry = ticks
+                                    + static_cast<std::uint32_t>(
+                                            e.turns_left(effect));
+                hash ^= hash_key(hash_part::effect,
+                                 effect.index() << 32
+                                         | static_cast<std::uint32_t>(potency),
+                                 expiry);
+            }
+            return hash;
+        }
+
+        auto incremental_matches_scratch() -> void
+        {
+            const scoped_quiet_output quiet;
+            std::mt19937 engine(39);
+            constexpr std::size_t kinds
+                    = std::variant_size_v<status_effect_variant>;
+            int mismatches = 0;
+            int deaths = 0;
+            for (int run = 0; run < 50; ++run) {
+                const int type = run % enemy_type_count();
+                const auto e = make_enemy(type);
+                // A fresh enemy has no effects and has never ticked
+                const std::uint64_t identity
+                        = make_enemy(type)->state_hash() ^ health_key(*e)
+                          ^ hash_key(hash_part::tick, 0);
+                std::uint32_t ticks = 0;
+
+                for (int step = 0; step < 200 && !e->is_dead(); ++step) {
+                    switch (engine() % 5) {
+                    case 0:
+                    case 1:
+                        e->add_status_effect(make_status_effect(
+                                engine() % kinds,
+                                static_cast<int>(1 + engine() % 6),
+                                static_cast<int>(1 + engine() % 4)));
+                        break;
+                    case 2:
+                        e->modify_health(-static_cast<int>(engine() % 9));
+                        break;
+                    case 3:
+                        e->tick();
+                        ++ticks;
+                        break;
+                    default:
+                        if (engine() % 4 == 0) { e->clear_status_effects(); }
+                        break;
+                    }
+                    if (e->state_hash() != rehash(*e, identity, ticks)) {
+                        ++mismatches;
+                    }
+                }
+                if (e->is_dead()) { ++deaths; }
+            }
+            check(mismatches == 0,
+                  std::format("{} steps hash differently from scratch",
+                              mismatches));
+            check(deaths > 0, "some enemies die on the way");
+        }
+
+        auto equal_states_hash_equal() -> void
+        {
+            const scoped_quiet_output quiet;
+            const auto direct = make_enemy(0);
+            direct->add_status_effect(make_status_effect(0, 4, 2));
+            direct->modify_health(-10);
+
+            // The same state reached through an effect that came and went
+            const auto roundabout = make_enemy(0);
+            roundabout->add_status_effect(make_status_effect(3, 2, 1));
+            roundabout->clear_status_effects();
+            roundabout->modify_health(-10);
+            roundabout->add_status_effect(make_status_effect(0, 4, 2));
+            check(direct->state_hash() == roundabout->state_hash(),
+                  "a removed effect leaves nothing behind");
+
+            roundabout->modify_health(-1);
+            check(direct->state_hash() != roundabout->state_hash(),
+                  "health changes the hash");
+        }
+
+    } // namespace
+
+} // namespace potmaker
+
+auto main() -> int
+{
+    potmaker::incremental_matches_scratch();
+    potmaker::equal_states_hash_equal();
+    return potmaker::test::report();
+}
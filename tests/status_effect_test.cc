@@ -0,0 +1,168 @@
+#include "check.hh"
+#include "entity.hh"
+#include "status_effect.hh"
+#include "util.hh"
+#include <cstddef>
+#include <format>
+#include <thread>
+#include <variant>
+
+namespace potmaker {
+
+    namespace {
+
+        using test::check;
+
+        constexpr std::size_t burning_kind = 0;
+
+        /**
+         * @return A table that stacks every kind of effect by one policy
+         */
+        auto every_kind(const stacking_policy policy) -> stacking_table
+        {
+            stacking_table table{};
+            table.fill(policy);
+            return table;
+        }
+
+        /**
+         * The potency and turns left of an entity's effect of some kind
+         */
+        struct stacked {
+            int potency;
+            int turns;
+
+            auto operator==(const stacked&) const -> bool = default;
+        };
+
+        auto effect_of(entity& e, const std::size_t kind) -> stacked
+        {
+            for (const status_effect_variant& effect: e.status_effects()) {
+                if (effect.index() != kind) { continue; }
+                const int potency = std::visit(
+                        [](const auto& current) { return current.potency(); },
+                        effect);
+                return {potency, e.turns_left(effect)};
+            }
+            return {0, 0};
+        }
+
+        /**
+         * Gives a fresh player one burning effect and then another, under
+         * a policy
+         */
+        auto stack_burning(const stacking_policy policy, const burning& first,
+                           const burning& second) -> stacked
+        {
+            const stacking_table table = every_kind(policy);
+            const scoped_stacking scope(table);
+            player hero("Hero", 100.0, 10.0, 0.0);
+            hero.add_status_effect(burning(first));
+            hero.add_status_effect(burning(second));
+            check(hero.status_effects().size() == 1,
+                  "the second effect stacks onto the first");
+            return effect_of(hero, burning_kind);
+        }
+
+        auto each_policy_stacks() -> void
+        {
+            check(stack_burning(stacking_policy::merge_potency,
+                                burning(3, 2), burning(5, 1))
+                          == stacked{3, 5},
+                  "merge_potency adds potencies and keeps the longer one");
+            check(stack_burning(stacking_policy::refresh_duration,
+                                burning(3, 2), burning(5, 1))
+                          == stacked{2, 5},
+                  "refresh_duration keeps potency and the longer duration");
+            check(stack_burning(stacking_policy::refresh_duration,
+                                burning(5, 2), burning(3, 4))
+                          == stacked{2, 5},
+                  "refresh_duration never shortens an effect");
+            check(stack_burning(stacking_policy::keep_strongest,
+                                burning(3, 2), burning(5, 1))
+                          == stacked{2, 3},
+                  "keep_strongest ignores a weaker effect");
+            check(stack_burning(stacking_policy::keep_strongest,
+                                burning(3, 2), burning(1, 4))
+                          == stacked{4, 1},
+                  "keep_strongest takes a stronger effect whole");
+            check(stack_burning(stacking_policy::keep_strongest,
+                                burning(3, 2), burning(6, 2))
+                          == stacked{2, 6},
+                  "keep_strongest breaks ties by duration");
+        }
+
+        auto stacking_counts_elapsed_turns() -> void
+        {
+            const scoped_quiet_output quiet;
+            const stacking_table table
+                    = every_kind(stacking_policy::merge_potency);
+            const scoped_stacking scope(table);
+            player hero("Hero", 100.0, 10.0, 0.0);
+            hero.add_status_effect(burning(3, 2));
+            hero.tick();
+            hero.add_status_effect(burning(2, 1));
+            check(effect_of(hero, burning_kind) == stacked{3, 2},
+                  "the turns an effect already lasted are not given back");
+        }
+
+        auto one_effect_per_kind() -> void
+        {
+            player hero("Hero", 100.0, 10.0, 0.0);
+            constexpr std::size_t kinds
+                    = std::variant_size_v<status_effect_variant>;
+            for (int round = 0; round < 3; ++round) {
+                for (std::size_t kind = 0; kind < kinds; ++kind) {
+                    hero.add_status_effect(
+                            make_status_effect(kind, 2 + round, 1));
+                }
+            }
+            check(hero.status_effects().size() == kinds,
+                  std::format("{} effects held, one per kind",
+                              hero.status_effects().size()));
+            for (std::size_t kind = 0; kind < kinds; ++kind) {
+                check(effect_of(hero, kind).turns == 4,
+                      std::format("kind {} holds its longest duration", kind));
+            }
+        }
+
+        auto scoped_stacking_nests_per_thread() -> void
+        {
+            const stacking_table defaults = stacking_policies();
+            const stacking_table merged
+                    = every_kind(stacking_policy::merge_potency);
+            const stacking_table strongest
+                    = every_kind(stacking_policy::keep_strongest);
+            {
+                const scoped_stacking outer(merged);
+                check(stacking_policies() == merged, "outer scope applies");
+                {
+                    const scoped_stacking inner(strongest);
+                    check(stacking_policy_of(burning_kind)
+                                  == stacking_policy::keep_strongest,
+                          "inner scope applies");
+
+                    stacking_table seen{};
+                    std::jthread([&seen] { seen = stacking_policies(); })
+                            .join();
+                    check(seen == defaults,
+                          "other threads keep their own policies");
+                }
+                check(stacking_policies() == merged,
+                      "the outer scope comes back");
+            }
+            check(stacking_policies() == defaults, "the defaults come back");
+        }
+
+    } // namespace
+
+} // namespace potmaker
+
+auto main() -> int
+{
+    potmaker::each_policy_stacks();
+    potmaker::stacking_counts_elapsed_turns();
+    potmaker::one_effect_per_kind();
+    potmaker::scoped_stacking_nests_per_thread();
+    return potmaker::test::report();
+}
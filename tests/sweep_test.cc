@@ -0,0 +1,149 @@
+#include "balance.hh"
+#include "check.hh"
+#include "content_library.hh"
+#include "sweep.hh"
+#include <cstdint>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+
+namespace potmaker {
+
+    namespace {
+
+        using test::check;
+
+        auto small_grid() -> sweep_grid
+        {
+            sweep_grid grid;
+            grid.enemy_health = {0.8, 1.2};
+            grid.stages_per_enemy = {2, 3};
+            return grid;
+        }
+
+        auto small_options() -> sweep_options
+        {
+            sweep_options options;
+            options.first_seed = 40;
+            options.runs_per_point = 30;
+            options.unit_runs = 8;
+            options.thread_count = 1;
+            options.limits.max_stage = 6;
+            return options;
+        }
+
+        auto same_estimate(const estimate& a, const estimate& b) -> bool
+        {
+            return a.mean == b.mean && a.standard_error == b.standard_error
+                   && a.effective_samples == b.effective_samples;
+        }
+
+        auto same_results(const sweep_result& a, const sweep_result& b)
+                -> bool
+        {
+            if (a.points.size() != b.points.size() || a.units != b.units) {
+                return false;
+            }
+            for (std::size_t i = 0; i < a.points.size(); ++i) {
+                const sweep_point& x = a.points[i];
+                const sweep_point& y = b.points[i];
+                if (x.runs != y.runs || x.battles != y.battles
+                    || x.wins != y.wins
+                    || !same_estimate(x.stage_reached, y.stage_reached)
+                    || !same_estimate(x.turns, y.turns)
+                    || !same_estimate(x.gold, y.gold)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        auto resumed_sweep_matches(const std::string& whole_path,
+                                   const std::string& cut_path) -> void
+        {
+            const balance_params& base = active_balance();
+            const sweep_result whole = run_sweep(base, small_grid(),
+                                                 whole_path, small_options());
+            check(whole.finished() && whole.played_units == whole.units,
+                  "uninterrupted sweep");
+
+            // Cut short twice, then finished with more threads
+            sweep_options options = small_options();
+            options.max_units = 3;
+            const sweep_result first
+                    = run_sweep(base, small_grid(), cut_path, options);
+            check(!first.finished() && first.played_units == 3,
+                  "first part");
+            options.max_units = 5;
+            const sweep_result second
+                    = run_sweep(base, small_grid(), cut_path, options);
+            check(second.resumed_units == 3 && second.played_units == 5,
+                  "second part");
+            options.max_units = small_options().max_units;
+            options.thread_count = 3;
+            const sweep_result last
+                    = run_sweep(base, small_grid(), cut_path, options);
+            check(last.finished() && last.resumed_units == 8,
+                  "last part");
+            check(same_results(last, whole),
+                  "same results, to the bit, as the uninterrupted sweep");
+
+            const sweep_result again
+                    = run_sweep(base, small_grid(), cut_path, options);
+            check(again.played_units == 0 && same_results(again, whole),
+                  "a finished sweep plays nothing");
+        }
+
+        auto other_sweeps_rejected(const std::string& path) -> void
+        {
+            const balance_params& base = active_balance();
+            sweep_grid grid = small_grid();
+            grid.enemy_health = {0.8, 1.3};
+            test::check_throws<std::runtime_error>(
+                    [&] { (void)run_sweep(base, grid, path, small_options()); },
+                    "another grid");
+
+            const content_library content = content_library::load(
+                    POTMK_RESOURCES_DIR "/content.potmk");
+            set_active_content(&content);
+            test::check_throws<std::runtime_error>(
+                    [&] {
+                        (void)run_sweep(base, small_grid(), path,
+                                        small_options());
+                    },
+                    "other content");
+            set_active_content(nullptr);
+        }
+
+        auto unplayable_knobs_rejected(const std::string& path) -> void
+        {
+            const balance_params& base = active_balance();
+            sweep_grid grid = small_grid();
+            grid.stages_per_enemy = {2, 0};
+            test::check_throws<std::invalid_argument>(
+                    [&] { (void)run_sweep(base, grid, path, small_options()); },
+                    "no stages per enemy");
+            grid = small_grid();
+            grid.ingredient_power = {-1.0};
+            test::check_throws<std::invalid_argument>(
+                    [&] { (void)run_sweep(base, grid, path, small_options()); },
+                    "negative factor");
+        }
+
+    } // namespace
+
+} // namespace potmaker
+
+auto main() -> int
+{
+    const std::string whole = potmaker::test::temp_path("whole.ckp");
+    const std::string cut = potmaker::test::temp_path("cut.ckp");
+    const std::string unused = potmaker::test::temp_path("unused.ckp");
+    potmaker::resumed_sweep_matches(whole, cut);
+    potmaker::other_sweeps_rejected(cut);
+    potmaker::unplayable_knobs_rejected(unused);
+    for (const std::string& path: {whole, cut, unused}) {
+        std::remove(path.c_str());
+    }
+    return potmaker::test::report();
+}
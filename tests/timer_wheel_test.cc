@@ -0,0 +1,85 @@
+#include "check.hh"
+#include "timer_wheel.hh"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <random>
+
+namespace potmaker {
+
+    namespace {
+
+        using test::check;
+
+        constexpr std::size_t kinds = 7;
+
+        /**
+         * The same timers kept the obvious way: every tick looks at every
+         * timer
+         */
+        struct linear_timers {
+            auto advance() -> std::uint32_t
+            {
+                ++now;
+                std::uint32_t due = 0;
+                for (std::size_t kind = 0; kind < kinds; ++kind) {
+                    if (at[kind] == now) {
+                        due |= std::uint32_t{1} << kind;
+                        at[kind].reset();
+                    }
+                }
+                return due;
+            }
+
+            std::array<std::optional<std::uint32_t>, kinds> at;
+            std::uint32_t now = 0;
+        };
+
+        /**
+         * Runs random schedules and cancellations, some further away than
+         * the wheel goes around, on both and compares every tick
+         */
+        template<std::size_t slot_count>
+        auto matches_linear_tick(const std::uint32_t seed) -> void
+        {
+            std::mt19937 engine(seed);
+            timer_wheel<kinds, slot_count> wheel;
+            linear_timers linear;
+            std::size_t differences = 0;
+            for (int tick = 0; tick < 20000; ++tick) {
+                const auto op = engine() % 10;
+                const auto kind = static_cast<std::size_t>(engine() % kinds);
+                if (op < 4) {
+                    const auto at = linear.now + 1
+                                    + static_cast<std::uint32_t>(
+                                            engine() % (3 * slot_count));
+                    wheel.schedule(kind, at);
+                    linear.at[kind] = at;
+                }
+                else if (op == 4) {
+                    wheel.cancel(kind);
+                    linear.at[kind].reset();
+                }
+                else if (op == 5 && engine() % 50 == 0) {
+                    wheel.cancel_all();
+                    linear.at.fill(std::nullopt);
+                }
+
+                if (wheel.advance() != linear.advance()) { ++differences; }
+            }
+            check(differences == 0, "same timers due as a linear tick");
+            check(wheel.now() == linear.now, "same tick");
+        }
+
+    } // namespace
+
+} // namespace potmaker
+
+auto main() -> int
+{
+    potmaker::matches_linear_tick<64>(1);
+    potmaker::matches_linear_tick<64>(2);
+    potmaker::matches_linear_tick<8>(3);
+    return potmaker::test::report();
+}
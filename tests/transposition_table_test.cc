@@ -0,0 +1,107 @@
+#include "check.hh"
+#include "transposition_table.hh"
+#include <cstdint>
+#include <format>
+#include <thread>
+#include <vector>
+
+namespace potmaker {
+
+    namespace {
+
+        using test::check;
+
+        /**
+         * A value whose halves must always be read together
+         */
+        struct pair_value {
+            std::uint32_t first;
+            std::uint32_t second;
+        };
+
+        auto probe_and_replace() -> void
+        {
+            transposition_table<int> table(10);
+            check(table.capacity() == 16,
+                  "capacity rounds up to a power of two of buckets");
+
+            check(!table.find(42), "an empty table finds nothing");
+            table.store(42, 7);
+            check(table.find(42) == 7, "a stored value is found");
+            table.store(42, 9);
+            check(table.find(42) == 9, "storing again replaces the value");
+            check(!table.find(43), "other keys are not found");
+
+            table.store(0, 5);
+            check(!table.find(0), "the key zero is never stored");
+
+            table.clear();
+            check(!table.find(42), "clearing forgets every value");
+        }
+
+        auto full_bucket_replaces_one() -> void
+        {
+            transposition_table<int> table(4);
+            check(table.capacity() == 4, "a single bucket");
+
+            // Every key lands in the one bucket; the fifth one evicts one
+            // of the others
+            for (int key = 1; key <= 5; ++key) { table.store(key, key * 10); }
+            int found = 0;
+            for (int key = 1; key <= 5; ++key) {
+                if (const auto value = table.find(key)) {
+                    check(*value == key * 10,
+                          std::format("key {} keeps its own value", key));
+                    ++found;
+                }
+            }
+            check(found == 4, "a full bucket keeps four entries");
+            check(table.find(5) == 50, "the newest entry is kept");
+
+            // Storing a key already present never evicts another one
+            table.store(5, 55);
+            int still_found = 0;
+            for (int key = 1; key <= 5; ++key) {
+                if (table.find(key)) { ++still_found; }
+            }
+            check(still_found == 4 && table.find(5) == 55,
+                  "replacing a value keeps the rest of the bucket");
+        }
+
+        auto torn_writes_miss() -> void
+        {
+            // Threads keep storing values whose halves match under keys
+            // that share a few entries, while another thread reads them
+            transposition_table<pair_value> table(8);
+            constexpr std::uint32_t rounds = 20000;
+            std::vector<std::jthread> writers;
+            for (std::uint32_t t = 1; t <= 2; ++t) {
+                writers.emplace_back([&table, t] {
+                    for (std::uint32_t i = 0; i < rounds; ++i) {
+                        const std::uint32_t v = t * rounds + i;
+                        table.store(1 + (i & 3), {v, v});
+                    }
+                });
+            }
+
+            int torn = 0;
+            for (std::uint32_t i = 0; i < rounds; ++i) {
+                if (const auto value = table.find(1 + (i & 3))) {
+                    if (value->first != value->second) { ++torn; }
+                }
+            }
+            writers.clear();
+            check(torn == 0, std::format("{} values read torn", torn));
+        }
+
+    } // namespace
+
+} // namespace potmaker
+
+auto main() -> int
+{
+    potmaker::probe_and_replace();
+    potmaker::full_bucket_replaces_one();
+    potmaker::torn_writes_miss();
+    return potmaker::test::report();
+}
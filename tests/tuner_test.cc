@@ -0,0 +1,110 @@
+#include "balance.hh"
+#include "check.hh"
+#include "tuner.hh"
+#include <cmath>
+#include <cstdint>
+#include <format>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+namespace potmaker {
+
+    namespace {
+
+        using test::check;
+
+        auto knobs_scale_the_base() -> void
+        {
+            const balance_params base;
+            check(balance_knobs{}.apply(base).to_string() == base.to_string(),
+                  "knobs of 1 give the base back");
+
+            balance_knobs knobs;
+            knobs.enemy_health = 2.0;
+            knobs.ingredient_power = 0.5;
+            knobs.stages_per_enemy = 3;
+            const balance_params scaled = knobs.apply(base);
+            check(scaled.enemy_stats[0].base_health
+                          == 2 * base.enemy_stats[0].base_health,
+                  "enemy health scaled");
+            check(scaled.enemy_stats[0].base_damage
+                          == base.enemy_stats[0].base_damage,
+                  "enemy damage left alone");
+            check(scaled.fire_damage == base.fire_damage / 2,
+                  "ingredient power scaled");
+            check(scaled.stages_per_enemy == 3, "pace set");
+        }
+
+        auto bad_targets_rejected() -> void
+        {
+            for (const std::vector<double>& target:
+                 {std::vector<double>{}, std::vector<double>{0.5, 1.5},
+                  std::vector<double>{-0.1},
+                  std::vector<double>{
+                          std::numeric_limits<double>::quiet_NaN()}}) {
+                test::check_throws<std::invalid_argument>(
+                        [&target] { (void) tune_balance({}, target); },
+                        std::format("target of {} stages", target.size()));
+            }
+        }
+
+        auto converges_on_the_target() -> void
+        {
+            // A balance whose first two battles are won too often
+            balance_knobs start;
+            start.enemy_health = 2.5;
+            const balance_params base = start.apply({});
+            const std::vector<double> target{0.9, 0.8};
+
+            tuning_options options;
+            options.batch_runs = 50;
+            options.max_batches = 8;
+            options.step = 0.5;
+            options.min_step = 0.2;
+            options.max_moves = 8;
+            options.thread_count = 1;
+
+            tuning_options unmoved = options;
+            unmoved.max_moves = 0;
+            const tuning_result before = tune_balance(base, target, unmoved);
+            check(before.moves == 0 && before.knobs == balance_knobs{},
+                  "no moves keep the base");
+
+            const tuning_result tuned = tune_balance(base, target, options);
+            check(tuned.moves > 0, "the search moves");
+            check(tuned.loss < before.loss / 4,
+                  std::format("loss falls from {} to {}", before.loss,
+                              tuned.loss));
+            check(tuned.win_rates[0] < before.win_rates[0]
+                          && std::abs(tuned.win_rates[0] - target[0]) < 0.05
+                          && std::abs(tuned.win_rates[1] - target[1]) < 0.05,
+                  std::format("win rates {} and {} near the target",
+                              tuned.win_rates[0], tuned.win_rates[1]));
+            check(tuned.battles[0] >= options.min_batches
+                                              * options.batch_runs,
+                  "the result is measured over the minimum of batches");
+            check(tuned.params.to_string()
+                          == tuned.knobs.apply(base).to_string(),
+                  "the balance is the knobs applied to the base");
+
+            // Runs depend on their seeds alone, so threads change nothing
+            options.thread_count = 2;
+            const tuning_result threaded = tune_balance(base, target, options);
+            check(threaded.knobs == tuned.knobs
+                          && threaded.loss == tuned.loss
+                          && threaded.runs == tuned.runs,
+                  "tuning is reproducible across thread counts");
+        }
+
+    } // namespace
+
+} // namespace potmaker
+
+auto main() -> int
+{
+    potmaker::knobs_scale_the_base();
+    potmaker::bad_targets_rejected();
+    potmaker::converges_on_the_target();
+    return potmaker::test::report();
+}